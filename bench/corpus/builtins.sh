@@ -0,0 +1,27 @@
+# the built ins shared with a POSIX shell
+cd /
+pwd
+cd /tmp && pwd
+printf '%5s|%-5s|%d|%x|%o|%.2f\n' ab cd 42 255 8 3.14159
+printf '%b\n' 'a\tb\101'
+printf '%s-' one two three; echo
+printf '%d %c\n' "'A" hello
+test 3 -gt 2 && echo greater
+test abc = abc -a -n x && echo and
+[ -z "" ] && echo brackets
+test ! -e /nonexistent && echo missing
+export SEEN=exported
+sh -c 'echo $SEEN'
+hidden=local
+sh -c 'echo "[$hidden]"'
+TEMP=prefix sh -c 'echo $TEMP'
+echo "[$TEMP]"
+: colon ignores its arguments
+echo -n no newline; echo
+f() { echo in function "$@"; }
+f a b | tr a-z A-Z
+echo lost > /dev/full 2> /dev/null; echo $?
+printf lost > /dev/full 2> /dev/null; echo $?
+echo lost >&- 2> /dev/null; echo $?
+test 1 -eq x 2> /dev/null; echo $?
+[ x -lt 1 ] 2> /dev/null; echo $?
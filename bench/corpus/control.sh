@@ -0,0 +1,36 @@
+# if, loops, case and functions
+for i in 1 2 3; do
+    if test $i = 2; then
+        echo two
+    elif test $i = 3; then
+        echo three
+    else
+        echo other
+    fi
+done
+i=0
+while test $i -lt 5; do
+    i=$(expr $i + 1)
+    test $i = 2 && continue
+    test $i = 4 && break
+    echo while $i
+done
+until test -n "$done"; do
+    done=yes
+    echo until
+done
+for word in apple b.txt zed; do
+    case $word in
+        a*) echo starts with a ;;
+        *.txt|*.log) echo file ;;
+        *) echo default ;;
+    esac
+done
+count() {
+    for n in "$@"; do
+        test $n = stop && return 7
+        echo n $n
+    done
+}
+count 1 2 stop 3
+echo returned $?
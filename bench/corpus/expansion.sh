@@ -0,0 +1,35 @@
+# parameters, command substitution and field splitting
+name=world
+echo hello $name ${name}s "${name}" '$name'
+empty=
+printf '[%s]\n' $empty "$empty" x${empty}y
+echo $(echo inner $(echo nested)) "$(printf 'a\nb')"
+echo `echo backquoted`
+lines=$(printf 'one\ntwo  three\n')
+printf '[%s]\n' $lines
+printf '[%s]\n' "$lines"
+args() {
+    echo $# "$1" "$2"
+    for a in "$@"; do echo "<$a>"; done
+    echo $* "$*"
+}
+args one 'two words' ''
+args
+IFS=' '
+printf '[%s]\n' $lines
+HOME=/home/someone
+echo ~ ~/notes "~" \~ a~ ~b
+args one two
+echo ${#} "${#}"
+words() {
+    for w in $*; do printf '[%s]' "$w"; done; echo
+    for w in $@; do printf '[%s]' "$w"; done; echo
+    for w in "$@"; do printf '[%s]' "$w"; done; echo
+    for w in "$*"; do printf '[%s]' "$w"; done; echo
+    for w in x$@y; do printf '[%s]' "$w"; done; echo
+}
+words "a b" c "" " d  e "
+words
+IFS=:
+words "a b" c
+IFS=' '
@@ -0,0 +1,38 @@
+# here-documents, quoted and expanded
+name=doc
+cat <<END
+plain $name
+  indented \$kept
+END
+cat <<'END'
+quoted $name $(echo none)
+END
+cat <<A | tr a-z A-Z
+piped $name
+A
+sed 's/^/got /' <<EOF2
+first
+second
+EOF2
+cat <<END > document
+written
+END
+cat document
+x=val
+cat <<E
+a $(echo hi) b `echo there` $x
+$(printf 'l1\nl2\n')
+\$(not) \`not\`
+E
+cat <<'E'
+$(echo quoted)
+E
+cat <<-EOF
+	indented $HOME
+		two
+  spaces
+	EOF
+cat <<- 'E'
+	$x
+E
+echo done
@@ -0,0 +1,20 @@
+# quotes, backslashes and the words they make
+printf '[%s]\n' 'single $HOME `x` \n' "double \$ \" \\ \`"
+printf '[%s]\n' a\ b "c"'d'e f\$g
+printf '[%s]\n' '' "" x
+echo "it's" 'say "hi"'
+x='a  b'
+echo $x "$x"
+printf '[%s]\n' $x "$x" ''
+printf '[%s]\n' "tab	in" a'  'b
+echo # a comment
+echo not#a comment
+echo "a
+b" c
+echo x \
+  y
+echo 'p
+
+q' $(echo s
+echo t)
+echo `echo u`
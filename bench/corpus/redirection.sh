@@ -0,0 +1,28 @@
+# files, descriptors and pipes
+echo first > out
+echo second >> out
+cat < out
+cat out | sort -r
+ls /nonexistent 2> errors || echo failed
+test -s errors && echo errors kept
+echo both > both 2>&1
+cat both
+echo to three 3> three >&3
+cat three
+cat 4< out <&4
+echo read write <> rw
+cat rw
+: > empty
+test -s empty || echo empty file
+echo a b c | tr ' ' '\n' | wc -l | tr -d ' '
+ls /nonexistent 2>&1 | wc -l | tr -d ' '
+# built ins run in the shell make and write their redirections too
+jobs > jobs.out
+test -e jobs.out && echo jobs made its file
+SHOWN=1; export SHOWN
+export -p > exports
+grep SHOWN= exports
+rm exports
+cd /nonexistent 2> /dev/null || echo cd failed quietly
+cd . > cd.out
+test -e cd.out && echo cd made its file
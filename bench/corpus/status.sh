@@ -0,0 +1,36 @@
+# exit statuses of commands, lists and pipelines
+true; echo $?
+false; echo $?
+! true; echo $?
+! false; echo $?
+false || echo or ran
+true && echo and ran
+false && echo skipped
+true | false; echo $?
+false | true; echo $?
+sh -c 'exit 42'; echo $?
+f() { return 5; }
+f; echo $?
+if false; then :; fi; echo $?
+test 1 -eq 2; echo $?
+waitone() {
+    sh -c 'exit 3' &
+    wait $!
+    echo wait status $? >&2
+    sh -c 'exit 5' &
+    sh -c 'sleep 0.2; exit 6' &
+    wait $!
+    echo wait last $? >&2
+    wait
+    echo waited all $? >&2
+}
+waitone > /dev/null
+x=1 env | grep '^x='
+y=2 env | cat | grep '^y='
+echo "after [$x] [$y]"
+x=$(false); echo $?
+x=$(exit 4); echo $?
+cd /nonexistent 2>/dev/null && echo moved || echo not moved
+test "$(echo $$)" = "$$" && echo same pid
+test "`echo $$`" = "$$" && echo same pid again
+exit 9
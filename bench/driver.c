@@ -0,0 +1,1132 @@
+/***********************************************************************************
+** Program name: driver
+**
+** Description: This program times a shell for the benchmark suite. In script
+** mode it runs the shell over a script once and reports how many commands it
+** ran a second and the peak resident memory of the shell and its children. In
+** latency mode it feeds the shell one command at a time through a pipe, each
+** followed by echo @, and times every command from writing it to reading the @
+** back, then reports the median and 99th percentile and the resident memory of
+** the shell. A setup command can be run first to grow the shell before timing.
+** In spawn mode it starts a fresh shell with -c for every command, and in
+** serve mode it sends the command to a smallsh server over a number of
+** connections at once, and both report the commands run a second along with
+** the median and 99th percentile. In compare mode it runs a script under two
+** shells, each in an empty directory of its own, and reports whether their
+** output, errors, exit value and the files they made are the same, along with
+** the milliseconds each took. In fuzz mode it feeds the shell lines glued
+** together at random from pieces of quoting, expansion and redirection, and
+** reports the line the shell died on, if any, which a build with the
+** sanitizers turns from silent corruption into a crash, or the report a
+** sanitizer wrote to the errors of the shell.
+**
+** Usage: driver script SHELL SCRIPT NUMCOMMANDS
+**        driver latency SHELL COMMAND COUNT [SETUP]
+**        driver spawn SHELL COMMAND COUNT
+**        driver serve SOCKET COMMAND COUNT CONNECTIONS
+**        driver compare SHELL REFERENCE SCRIPT
+**        driver fuzz SHELL COUNT SEED
+*********************************************************************************/
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <limits.h>
+#include <signal.h>
+
+// what a shell did with a script run by runCaptured
+struct capturedRun
+{
+    int exitMethod;
+    double seconds;
+    char *output;
+    size_t outputLength;
+    char *errors;
+    size_t errorLength;
+};
+
+double secondsNow();
+int compareDoubles(const void *first, const void *second);
+int runScript(char *shell, char *script, long numCommands);
+int runLatency(char *shell, const char *command, long count, const char *setup);
+int waitForMarker(int fd, int timeoutMs);
+long residentKb(pid_t pid);
+int runSpawn(char *shell, char *command, long count);
+int runServe(const char *socketPath, const char *command, long count, int numConnections);
+void printLatencies(double *latencies, long count, double elapsed);
+int runCompare(char *shell, char *reference, const char *script);
+int runCaptured(char *shell, const char *script, const char *directory, struct capturedRun *run);
+char* readAll(int fd, size_t *length);
+const char* compareDirectories(const char *first, const char *second);
+void removeDirectory(const char *directory);
+char* absoluteShell(char *shell, char *resolved);
+int runFuzz(char *shell, long count, unsigned int seed);
+pid_t startFuzzShell(char *shell, const char *directory, int errorFd, int *toShellFd, int *fromShellFd);
+const char* sanitizerReport(const char *errors, size_t length);
+int closeFuzzLine(char *request, int length, size_t size);
+
+int main(int argc, char *argv[])
+{
+    if(argc == 5 && strcmp(argv[1], "script") == 0)
+    {
+        return runScript(argv[2], argv[3], atol(argv[4]));
+    }
+    if((argc == 5 || argc == 6) && strcmp(argv[1], "latency") == 0)
+    {
+        return runLatency(argv[2], argv[3], atol(argv[4]), argc == 6 ? argv[5] : NULL);
+    }
+    if(argc == 5 && strcmp(argv[1], "spawn") == 0)
+    {
+        return runSpawn(argv[2], argv[3], atol(argv[4]));
+    }
+    if(argc == 6 && strcmp(argv[1], "serve") == 0)
+    {
+        return runServe(argv[2], argv[3], atol(argv[4]), atoi(argv[5]));
+    }
+    if(argc == 5 && strcmp(argv[1], "compare") == 0)
+    {
+        return runCompare(argv[2], argv[3], argv[4]);
+    }
+    if(argc == 5 && strcmp(argv[1], "fuzz") == 0)
+    {
+        return runFuzz(argv[2], atol(argv[3]), (unsigned int)strtoul(argv[4], NULL, 10));
+    }
+
+    fprintf(stderr, "usage: %s script SHELL SCRIPT NUMCOMMANDS\n       %s latency SHELL COMMAND COUNT [SETUP]\n"
+                    "       %s spawn SHELL COMMAND COUNT\n       %s serve SOCKET COMMAND COUNT CONNECTIONS\n"
+                    "       %s compare SHELL REFERENCE SCRIPT\n       %s fuzz SHELL COUNT SEED\n",
+            argv[0], argv[0], argv[0], argv[0], argv[0], argv[0]);
+    return 2;
+}
+
+/*************************************************************************************************
+** Name: secondsNow
+**
+** Description: This function reads the monotonic clock.
+**
+** Parameters: N/A
+**
+** Returns: seconds since an arbitrary point
+*************************************************************************************************/
+
+double secondsNow()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/*************************************************************************************************
+** Name: compareDoubles
+**
+** Description: This function orders two doubles for qsort.
+**
+** Parameters: the two doubles
+**
+** Returns: negative, zero or positive
+*************************************************************************************************/
+
+int compareDoubles(const void *first, const void *second)
+{
+    double difference = *(const double *)first - *(const double *)second;
+    return (difference > 0) - (difference < 0);
+}
+
+/*************************************************************************************************
+** Name: runScript
+**
+** Description: This function runs the shell over a script with its output thrown away and prints
+** the commands run a second and the peak resident memory reported by wait4, which covers the shell
+** and every child it waited for.
+**
+** Parameters: shell to run, script to run, number of commands in the script
+**
+** Returns: 0 on success, 1 if the shell could not be run
+*************************************************************************************************/
+
+int runScript(char *shell, char *script, long numCommands)
+{
+    double startTime = secondsNow();
+
+    pid_t shellPid = fork();
+    if(shellPid == 0)
+    {
+        int nullFd = open("/dev/null", O_RDWR);
+        dup2(nullFd, STDIN_FILENO);
+        dup2(nullFd, STDOUT_FILENO);
+        dup2(nullFd, STDERR_FILENO);
+        execlp(shell, shell, script, (char *)NULL);
+        _exit(127);
+    }
+
+    int exitMethod;
+    struct rusage usage;
+    if(shellPid == -1 || wait4(shellPid, &exitMethod, 0, &usage) == -1 || WEXITSTATUS(exitMethod) == 127)
+    {
+        fprintf(stderr, "driver: could not run %s\n", shell);
+        return 1;
+    }
+
+    double elapsed = secondsNow() - startTime;
+    printf("%.0f %ld\n", numCommands / elapsed, usage.ru_maxrss);
+    return 0;
+}
+
+/*************************************************************************************************
+** Name: runLatency
+**
+** Description: This function times single commands. The shell reads from one pipe and writes to
+** another, and every command is sent followed by echo @ so the @ coming back shows it is done. The
+** echo is a built in of every shell compared, so it adds the same small cost to each of them.
+** The resident memory of the shell is read once the commands are done.
+**
+** Parameters: shell to run, command to time, number of times to run it, command to run once
+** before timing or NULL
+**
+** Returns: 0 on success, 1 if the shell could not be run
+*************************************************************************************************/
+
+int runLatency(char *shell, const char *command, long count, const char *setup)
+{
+    int toShell[2];
+    int fromShell[2];
+    if(pipe2(toShell, O_CLOEXEC) == -1 || pipe2(fromShell, O_CLOEXEC) == -1)
+    {
+        perror("driver: pipe");
+        return 1;
+    }
+
+    pid_t shellPid = fork();
+    if(shellPid == 0)
+    {
+        int nullFd = open("/dev/null", O_WRONLY);
+        dup2(toShell[0], STDIN_FILENO);
+        dup2(fromShell[1], STDOUT_FILENO);
+        dup2(nullFd, STDERR_FILENO);
+        execlp(shell, shell, (char *)NULL);
+        _exit(127);
+    }
+    close(toShell[0]);
+    close(fromShell[1]);
+
+    char request[4096];
+    int requestLength;
+    double *latencies = malloc(count * sizeof(double));
+    long i;
+
+    if(setup != NULL)
+    {
+        requestLength = snprintf(request, sizeof(request), "%s\necho @\n", setup);
+        if(write(toShell[1], request, requestLength) != requestLength || waitForMarker(fromShell[0], -1) == -1)
+        {
+            fprintf(stderr, "driver: %s could not run the setup\n", shell);
+            return 1;
+        }
+    }
+
+    requestLength = snprintf(request, sizeof(request), "%s\necho @\n", command);
+    for(i = 0; i < count; i++)
+    {
+        double startTime = secondsNow();
+        if(write(toShell[1], request, requestLength) != requestLength)
+        {
+            fprintf(stderr, "driver: could not run %s\n", shell);
+            return 1;
+        }
+        if(waitForMarker(fromShell[0], -1) == -1)
+        {
+            fprintf(stderr, "driver: %s stopped answering\n", shell);
+            return 1;
+        }
+        latencies[i] = secondsNow() - startTime;
+    }
+
+    long rssKb = residentKb(shellPid);
+    close(toShell[1]);
+    waitpid(shellPid, NULL, 0);
+
+    qsort(latencies, count, sizeof(double), compareDoubles);
+    printf("%.1f %.1f %ld\n", latencies[count / 2] * 1e6, latencies[count * 99 / 100] * 1e6, rssKb);
+    free(latencies);
+    return 0;
+}
+
+/*************************************************************************************************
+** Name: waitForMarker
+**
+** Description: This function reads the output of the shell until a line holding just the @, which
+** may be split across reads.
+**
+** Parameters: descriptor the shell writes to, milliseconds to wait for each read or -1 to wait for
+** as long as it takes
+**
+** Returns: 0 once the @ is read, -1 if the shell stopped answering first
+*************************************************************************************************/
+
+int waitForMarker(int fd, int timeoutMs)
+{
+    char reply[65536];
+    char previous = '\n';
+    char beforePrevious = '\n';
+    struct pollfd shellOutput = {fd, POLLIN, 0};
+
+    while(1)
+    {
+        if(poll(&shellOutput, 1, timeoutMs) == 0)
+        {
+            return -1;
+        }
+
+        ssize_t numRead = read(fd, reply, sizeof(reply));
+        if(numRead <= 0)
+        {
+            return -1;
+        }
+
+        ssize_t j;
+        for(j = 0; j < numRead; j++)
+        {
+            if(reply[j] == '\n' && previous == '@' && beforePrevious == '\n')
+            {
+                return 0;
+            }
+            beforePrevious = previous;
+            previous = reply[j];
+        }
+    }
+}
+
+/*************************************************************************************************
+** Name: residentKb
+**
+** Description: This function reads the resident memory of a process from /proc.
+**
+** Parameters: pid of the process
+**
+** Returns: resident memory in kilobytes, or 0 if it could not be read
+*************************************************************************************************/
+
+long residentKb(pid_t pid)
+{
+    char fileName[64];
+    char line[256];
+    long rssKb = 0;
+
+    snprintf(fileName, sizeof(fileName), "/proc/%d/status", (int)pid);
+    FILE *statusFile = fopen(fileName, "r");
+    if(statusFile == NULL)
+    {
+        return 0;
+    }
+
+    while(fgets(line, sizeof(line), statusFile) != NULL)
+    {
+        if(sscanf(line, "VmRSS: %ld", &rssKb) == 1)
+        {
+            break;
+        }
+    }
+    fclose(statusFile);
+    return rssKb;
+}
+
+/*************************************************************************************************
+** Name: runSpawn
+**
+** Description: This function times a fresh shell for every command, the way a program which runs
+** each command with SHELL -c pays for starting the shell every time.
+**
+** Parameters: shell to run, command to run, number of times to run it
+**
+** Returns: 0 on success, 1 if the shell could not be run
+*************************************************************************************************/
+
+int runSpawn(char *shell, char *command, long count)
+{
+    double *latencies = malloc(count * sizeof(double));
+    double startTime = secondsNow();
+    long i;
+
+    for(i = 0; i < count; i++)
+    {
+        double commandStart = secondsNow();
+
+        pid_t shellPid = fork();
+        if(shellPid == 0)
+        {
+            int nullFd = open("/dev/null", O_RDWR);
+            dup2(nullFd, STDIN_FILENO);
+            dup2(nullFd, STDOUT_FILENO);
+            dup2(nullFd, STDERR_FILENO);
+            execlp(shell, shell, "-c", command, (char *)NULL);
+            _exit(127);
+        }
+
+        int exitMethod;
+        if(shellPid == -1 || waitpid(shellPid, &exitMethod, 0) == -1 || WEXITSTATUS(exitMethod) == 127)
+        {
+            fprintf(stderr, "driver: could not run %s\n", shell);
+            return 1;
+        }
+        latencies[i] = secondsNow() - commandStart;
+    }
+
+    printLatencies(latencies, count, secondsNow() - startTime);
+    free(latencies);
+    return 0;
+}
+
+/*************************************************************************************************
+** Name: runServe
+**
+** Description: This function times a smallsh server. Every connection has one request in flight
+** at a time and sends the next as soon as the X frame of the last one comes back, so the number of
+** connections is the number of commands the server runs at once. Output frames are read and
+** thrown away.
+**
+** Parameters: socket of the server, command to run, number of requests, number of connections
+**
+** Returns: 0 on success, 1 if the server could not be reached or stopped answering
+*************************************************************************************************/
+
+int runServe(const char *socketPath, const char *command, long count, int numConnections)
+{
+    uint32_t commandLength = strlen(command);
+    char *request = malloc(5 + commandLength);
+    uint32_t networkLength = htonl(commandLength);
+    request[0] = 'C';
+    memcpy(request + 1, &networkLength, 4);
+    memcpy(request + 5, command, commandLength);
+
+    struct sockaddr_un address = {0};
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, socketPath, sizeof(address.sun_path) - 1);
+
+    struct pollfd *connections = calloc(numConnections, sizeof(struct pollfd));
+    double *sentAt = calloc(numConnections, sizeof(double));
+    char **replies = calloc(numConnections, sizeof(char *));
+    size_t *replyLengths = calloc(numConnections, sizeof(size_t));
+    double *latencies = malloc(count * sizeof(double));
+    long numSent = 0;
+    long numDone = 0;
+    int i;
+
+    double startTime = secondsNow();
+    for(i = 0; i < numConnections; i++)
+    {
+        connections[i].fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        connections[i].events = POLLIN;
+        replies[i] = malloc(65536 + 5);
+        if(connect(connections[i].fd, (struct sockaddr *)&address, sizeof(address)) == -1)
+        {
+            perror(socketPath);
+            return 1;
+        }
+        if(numSent < count)
+        {
+            sentAt[i] = secondsNow();
+            write(connections[i].fd, request, 5 + commandLength);
+            numSent++;
+        }
+    }
+
+    while(numDone < count)
+    {
+        poll(connections, numConnections, -1);
+
+        for(i = 0; i < numConnections; i++)
+        {
+            if(connections[i].revents == 0)
+            {
+                continue;
+            }
+
+            ssize_t numRead = read(connections[i].fd, replies[i] + replyLengths[i], 65536 + 5 - replyLengths[i]);
+            if(numRead <= 0)
+            {
+                fprintf(stderr, "driver: the server stopped answering\n");
+                return 1;
+            }
+            replyLengths[i] += numRead;
+
+            // use up every whole frame, keeping a partial one at the front of the buffer
+            size_t used = 0;
+            while(replyLengths[i] - used >= 5)
+            {
+                uint32_t frameLength;
+                memcpy(&frameLength, replies[i] + used + 1, 4);
+                frameLength = ntohl(frameLength);
+                if(replyLengths[i] - used - 5 < frameLength)
+                {
+                    break;
+                }
+
+                if(replies[i][used] == 'X')
+                {
+                    latencies[numDone++] = secondsNow() - sentAt[i];
+                    if(numSent < count)
+                    {
+                        sentAt[i] = secondsNow();
+                        write(connections[i].fd, request, 5 + commandLength);
+                        numSent++;
+                    }
+                }
+                used += 5 + frameLength;
+            }
+
+            memmove(replies[i], replies[i] + used, replyLengths[i] - used);
+            replyLengths[i] -= used;
+        }
+    }
+
+    printLatencies(latencies, count, secondsNow() - startTime);
+    for(i = 0; i < numConnections; i++)
+    {
+        close(connections[i].fd);
+        free(replies[i]);
+    }
+    free(connections);
+    free(sentAt);
+    free(replies);
+    free(replyLengths);
+    free(latencies);
+    free(request);
+    return 0;
+}
+
+/*************************************************************************************************
+** Name: printLatencies
+**
+** Description: This function prints the commands run a second and the median and 99th percentile
+** of their latencies in microseconds.
+**
+** Parameters: latency of every command in seconds, which are sorted, number of commands, seconds
+** they took altogether
+**
+** Returns: N/A
+*************************************************************************************************/
+
+void printLatencies(double *latencies, long count, double elapsed)
+{
+    qsort(latencies, count, sizeof(double), compareDoubles);
+    printf("%.0f %.1f %.1f\n", count / elapsed, latencies[count / 2] * 1e6, latencies[count * 99 / 100] * 1e6);
+}
+
+/*************************************************************************************************
+** Name: runCompare
+**
+** Description: This function runs a script under a shell and under a reference shell and compares
+** what they did. It prints same, or the first of status, output, errors or files which differs,
+** followed by the milliseconds each shell took.
+**
+** Parameters: shell to check, shell to compare it with, script to run
+**
+** Returns: 0 if the shells did the same, 1 if they differ or could not be run
+*************************************************************************************************/
+
+int runCompare(char *shell, char *reference, const char *script)
+{
+    char scriptPath[PATH_MAX];
+    char shellDirectory[] = "/tmp/driver-compare.XXXXXX";
+    char referenceDirectory[] = "/tmp/driver-compare.XXXXXX";
+    if(realpath(script, scriptPath) == NULL || mkdtemp(shellDirectory) == NULL || mkdtemp(referenceDirectory) == NULL)
+    {
+        perror("driver: compare");
+        return 1;
+    }
+
+    char shellPath[PATH_MAX];
+    char referencePath[PATH_MAX];
+    shell = absoluteShell(shell, shellPath);
+    reference = absoluteShell(reference, referencePath);
+
+    struct capturedRun shellRun;
+    struct capturedRun referenceRun;
+    int result = 1;
+    if(runCaptured(shell, scriptPath, shellDirectory, &shellRun) == 0 &&
+       runCaptured(reference, scriptPath, referenceDirectory, &referenceRun) == 0)
+    {
+        const char *difference = compareDirectories(shellDirectory, referenceDirectory);
+        if(shellRun.exitMethod != referenceRun.exitMethod)
+        {
+            difference = "status";
+        }
+        else if(shellRun.outputLength != referenceRun.outputLength || memcmp(shellRun.output, referenceRun.output, shellRun.outputLength) != 0)
+        {
+            difference = "output";
+        }
+        else if(shellRun.errorLength != referenceRun.errorLength || memcmp(shellRun.errors, referenceRun.errors, shellRun.errorLength) != 0)
+        {
+            difference = "errors";
+        }
+
+        printf("%s %.1f %.1f\n", difference == NULL ? "same" : difference, shellRun.seconds * 1e3, referenceRun.seconds * 1e3);
+        result = difference == NULL ? 0 : 1;
+
+        free(shellRun.output);
+        free(shellRun.errors);
+        free(referenceRun.output);
+        free(referenceRun.errors);
+    }
+
+    removeDirectory(shellDirectory);
+    removeDirectory(referenceDirectory);
+    return result;
+}
+
+/*************************************************************************************************
+** Name: runCaptured
+**
+** Description: This function runs a shell over a script from a directory, with its input empty and
+** its output and errors kept in anonymous files so that only the files the script makes end up in
+** the directory.
+**
+** Parameters: shell to run, script to run, directory to run it from, run to fill in
+**
+** Returns: 0 on success, 1 if the shell could not be run
+*************************************************************************************************/
+
+int runCaptured(char *shell, const char *script, const char *directory, struct capturedRun *run)
+{
+    int outputFd = memfd_create("output", MFD_CLOEXEC);
+    int errorFd = memfd_create("errors", MFD_CLOEXEC);
+    if(outputFd == -1 || errorFd == -1)
+    {
+        perror("driver: memfd_create");
+        return 1;
+    }
+
+    double startTime = secondsNow();
+
+    pid_t shellPid = fork();
+    if(shellPid == 0)
+    {
+        int nullFd = open("/dev/null", O_RDONLY);
+        dup2(nullFd, STDIN_FILENO);
+        dup2(outputFd, STDOUT_FILENO);
+        dup2(errorFd, STDERR_FILENO);
+        if(chdir(directory) == -1)
+        {
+            _exit(127);
+        }
+        execlp(shell, shell, script, (char *)NULL);
+        _exit(127);
+    }
+
+    if(shellPid == -1 || waitpid(shellPid, &run->exitMethod, 0) == -1 || WEXITSTATUS(run->exitMethod) == 127)
+    {
+        fprintf(stderr, "driver: could not run %s\n", shell);
+        close(outputFd);
+        close(errorFd);
+        return 1;
+    }
+    run->seconds = secondsNow() - startTime;
+
+    run->output = readAll(outputFd, &run->outputLength);
+    run->errors = readAll(errorFd, &run->errorLength);
+    close(outputFd);
+    close(errorFd);
+    return 0;
+}
+
+/*************************************************************************************************
+** Name: readAll
+**
+** Description: This function reads a file from its start to its end.
+**
+** Parameters: descriptor of the file, length to set
+**
+** Returns: the contents, which the caller frees
+*************************************************************************************************/
+
+char* readAll(int fd, size_t *length)
+{
+    size_t capacity = 65536;
+    char *contents = malloc(capacity);
+    *length = 0;
+
+    ssize_t numRead;
+    while((numRead = pread(fd, contents + *length, capacity - *length, *length)) > 0)
+    {
+        *length += numRead;
+        if(*length == capacity)
+        {
+            capacity *= 2;
+            contents = realloc(contents, capacity);
+        }
+    }
+
+    return contents;
+}
+
+/*************************************************************************************************
+** Name: compareDirectories
+**
+** Description: This function compares the names and contents of the files two scripts made.
+**
+** Parameters: the two directories
+**
+** Returns: NULL if they hold the same files, "files" otherwise
+*************************************************************************************************/
+
+const char* compareDirectories(const char *first, const char *second)
+{
+    struct dirent **firstNames;
+    struct dirent **secondNames;
+    int numFirst = scandir(first, &firstNames, NULL, alphasort);
+    int numSecond = scandir(second, &secondNames, NULL, alphasort);
+    const char *difference = numFirst == numSecond && numFirst != -1 ? NULL : "files";
+
+    int i;
+    for(i = 0; difference == NULL && i < numFirst; i++)
+    {
+        if(strcmp(firstNames[i]->d_name, secondNames[i]->d_name) != 0)
+        {
+            difference = "files";
+            break;
+        }
+
+        char firstPath[PATH_MAX];
+        char secondPath[PATH_MAX];
+        snprintf(firstPath, sizeof(firstPath), "%s/%s", first, firstNames[i]->d_name);
+        snprintf(secondPath, sizeof(secondPath), "%s/%s", second, secondNames[i]->d_name);
+
+        // directories the scripts made are only compared by name
+        struct stat fileInfo;
+        if(lstat(firstPath, &fileInfo) == -1 || S_ISREG(fileInfo.st_mode) == 0)
+        {
+            continue;
+        }
+
+        int firstFd = open(firstPath, O_RDONLY | O_CLOEXEC);
+        int secondFd = open(secondPath, O_RDONLY | O_CLOEXEC);
+        size_t firstLength = 0;
+        size_t secondLength = 0;
+        char *firstContents = firstFd == -1 ? NULL : readAll(firstFd, &firstLength);
+        char *secondContents = secondFd == -1 ? NULL : readAll(secondFd, &secondLength);
+        if(firstContents == NULL || secondContents == NULL || firstLength != secondLength ||
+           memcmp(firstContents, secondContents, firstLength) != 0)
+        {
+            difference = "files";
+        }
+
+        free(firstContents);
+        free(secondContents);
+        if(firstFd != -1)
+        {
+            close(firstFd);
+        }
+        if(secondFd != -1)
+        {
+            close(secondFd);
+        }
+    }
+
+    for(i = 0; i < numFirst; i++)
+    {
+        free(firstNames[i]);
+    }
+    for(i = 0; i < numSecond; i++)
+    {
+        free(secondNames[i]);
+    }
+    if(numFirst != -1)
+    {
+        free(firstNames);
+    }
+    if(numSecond != -1)
+    {
+        free(secondNames);
+    }
+
+    return difference;
+}
+
+/*************************************************************************************************
+** Name: removeDirectory
+**
+** Description: This function removes a scratch directory along with the files a script made in it.
+** Directories the script made are left alone, so one which made any keeps its scratch directory.
+**
+** Parameters: the directory
+**
+** Returns: N/A
+*************************************************************************************************/
+
+void removeDirectory(const char *directory)
+{
+    DIR *scratch = opendir(directory);
+    if(scratch != NULL)
+    {
+        struct dirent *entry;
+        while((entry = readdir(scratch)) != NULL)
+        {
+            unlinkat(dirfd(scratch), entry->d_name, 0);
+        }
+        closedir(scratch);
+    }
+
+    rmdir(directory);
+}
+
+/*************************************************************************************************
+** Name: runFuzz
+**
+** Description: This function feeds the shell random lines, each followed by echo @ like in latency
+** mode, after an empty echo in case the line was an echo -n, from an empty directory of its own.
+** Every line is glued together from pieces of quotes, parameters, substitutions, redirections and
+** separators, which stop the line at errors in every part of the lexer and the expander. Every
+** piece which can end up as a command or a file name is harmless, and every < comes after a blank
+** so two of them never make a here-document. A quote or substitution a line leaves open would carry
+** on into the next line, so it is closed at the end of the line, and a shell which does not answer
+** within five seconds has hung. The same seed gives
+** the same lines. A shell which leaves with 2 at a syntax error is started again for the next line.
+** The errors of the shell are kept in an anonymous file and searched once it is done,
+** since a sanitizer which finds undefined behaviour or a leak reports it there without crashing.
+**
+** Parameters: shell to run, number of lines, seed of the random numbers
+**
+** Returns: 0 if the shell answered every line without a sanitizer report, 1 if it died or hung on
+** one or a sanitizer reported anything
+*************************************************************************************************/
+
+int runFuzz(char *shell, long count, unsigned int seed)
+{
+    static const char *pieces[] = {"echo", "printf", "%s\\n", "true", "test", "x", "-n", "=", " ", " ", " ", "'", "\"",
+                                   "\\", "$", "$$", "$?", "$!", "$#", "$@", "$*", "$1", "${", "}", "${HOME}", "${x}", "$x",
+                                   "$(", ")", "`", "~", "#", "*", ";", "&", ">", ">>", " <", " <>", "2>&1", ">&", " <<<", "2>",
+                                   "/dev/null", "x=1", "\t", "0", "9"};
+    int numPieces = sizeof(pieces) / sizeof(pieces[0]);
+
+    char directory[] = "/tmp/driver-fuzz.XXXXXX";
+    char shellPath[PATH_MAX];
+    shell = absoluteShell(shell, shellPath);
+    int toShell;
+    int fromShell;
+    int errorFd = memfd_create("errors", MFD_CLOEXEC);
+    pid_t shellPid = -1;
+    if(mkdtemp(directory) == NULL || errorFd == -1 || (shellPid = startFuzzShell(shell, directory, errorFd, &toShell, &fromShell)) == -1)
+    {
+        perror("driver: fuzz");
+        return 1;
+    }
+
+    // a shell which has left is found by its exit value, not by the signal writing to it raises
+    signal(SIGPIPE, SIG_IGN);
+
+    srand(seed);
+    char request[4096];
+    int result = 0;
+    long numRestarts = 0;
+    long i;
+    for(i = 0; i < count && result == 0; i++)
+    {
+        int requestLength = snprintf(request, sizeof(request), "echo ");
+        int numLinePieces = 1 + rand() % 16;
+        int j;
+        for(j = 0; j < numLinePieces; j++)
+        {
+            requestLength += snprintf(request + requestLength, sizeof(request) - requestLength, "%s", pieces[rand() % numPieces]);
+        }
+
+        // the line is printed the way it was sent if the shell does not get through it
+        requestLength = closeFuzzLine(request, requestLength, sizeof(request));
+        char *lineEnd = request + requestLength;
+        requestLength += snprintf(lineEnd, sizeof(request) - requestLength, "\necho\necho @\n");
+        if(write(toShell, request, requestLength) == requestLength && waitForMarker(fromShell, 5000) == 0)
+        {
+            continue;
+        }
+
+        // a shell reading from a pipe leaves with 2 at a syntax error, like dash, and is started
+        // again. one which has not closed its output has hung
+        struct pollfd shellOutput = {fromShell, POLLIN, 0};
+        char byte;
+        int exitMethod = 0;
+        pid_t donePid = 0;
+        if(poll(&shellOutput, 1, 0) == 1 && read(fromShell, &byte, 1) == 0)
+        {
+            donePid = waitpid(shellPid, &exitMethod, 0);
+        }
+        close(toShell);
+        close(fromShell);
+
+        if(donePid == shellPid && WIFEXITED(exitMethod) && WEXITSTATUS(exitMethod) == 2 &&
+           (shellPid = startFuzzShell(shell, directory, errorFd, &toShell, &fromShell)) != -1)
+        {
+            numRestarts++;
+            continue;
+        }
+
+        *lineEnd = '\0';
+        printf("failed after %ld lines: %s\n", i, request);
+        result = 1;
+        if(donePid == 0 && shellPid != -1)
+        {
+            kill(shellPid, SIGKILL);
+            waitpid(shellPid, NULL, 0);
+        }
+        shellPid = -1;
+    }
+
+    if(shellPid != -1)
+    {
+        close(toShell);
+        close(fromShell);
+        waitpid(shellPid, NULL, 0);
+    }
+    removeDirectory(directory);
+
+    // a report is shown up to its first 4 KB
+    size_t errorLength;
+    char *errors = readAll(errorFd, &errorLength);
+    close(errorFd);
+    const char *report = sanitizerReport(errors, errorLength);
+    if(report != NULL)
+    {
+        size_t reportLength = errors + errorLength - report;
+        printf("sanitizer report after %ld lines:\n%.*s\n", i, (int)(reportLength < 4096 ? reportLength : 4096), report);
+        result = 1;
+    }
+    free(errors);
+
+    if(result == 0)
+    {
+        printf("%ld lines, %ld syntax errors\n", count, numRestarts);
+    }
+    return result;
+}
+
+/*************************************************************************************************
+** Name: startFuzzShell
+**
+** Description: This function starts the shell for fuzz mode from its scratch directory, reading
+** from one pipe, writing its output to another and its errors to the file kept for them.
+**
+** Parameters: shell to run, directory to run it from, descriptor for its errors, set to the write
+** end of its input and the read end of its output
+**
+** Returns: pid of the shell, or -1 if it could not be started
+*************************************************************************************************/
+
+pid_t startFuzzShell(char *shell, const char *directory, int errorFd, int *toShellFd, int *fromShellFd)
+{
+    int toShell[2];
+    int fromShell[2];
+    if(pipe2(toShell, O_CLOEXEC) == -1)
+    {
+        return -1;
+    }
+    if(pipe2(fromShell, O_CLOEXEC) == -1)
+    {
+        close(toShell[0]);
+        close(toShell[1]);
+        return -1;
+    }
+
+    pid_t shellPid = fork();
+    if(shellPid == 0)
+    {
+        dup2(toShell[0], STDIN_FILENO);
+        dup2(fromShell[1], STDOUT_FILENO);
+        dup2(errorFd, STDERR_FILENO);
+        if(chdir(directory) == -1)
+        {
+            _exit(127);
+        }
+        execlp(shell, shell, (char *)NULL);
+        _exit(127);
+    }
+    close(toShell[0]);
+    close(fromShell[1]);
+
+    if(shellPid == -1)
+    {
+        close(toShell[1]);
+        close(fromShell[0]);
+        return -1;
+    }
+
+    *toShellFd = toShell[1];
+    *fromShellFd = fromShell[0];
+    return shellPid;
+}
+
+/*************************************************************************************************
+** Name: sanitizerReport
+**
+** Description: This function finds the first report AddressSanitizer, LeakSanitizer or
+** UndefinedBehaviorSanitizer wrote among the errors of a shell.
+**
+** Parameters: errors of the shell, their length
+**
+** Returns: start of the line the report begins on, or NULL if there is none
+*************************************************************************************************/
+
+const char* sanitizerReport(const char *errors, size_t length)
+{
+    static const char *markers[] = {"AddressSanitizer", "LeakSanitizer", "UndefinedBehaviorSanitizer", ": runtime error: "};
+
+    const char *report = NULL;
+    size_t i;
+    for(i = 0; i < sizeof(markers) / sizeof(markers[0]); i++)
+    {
+        const char *found = memmem(errors, length, markers[i], strlen(markers[i]));
+        if(found != NULL && (report == NULL || found < report))
+        {
+            report = found;
+        }
+    }
+
+    // back up to the start of its line
+    while(report != NULL && report > errors && report[-1] != '\n')
+    {
+        report--;
+    }
+
+    return report;
+}
+
+/*************************************************************************************************
+** Name: closeFuzzLine
+**
+** Description: This function closes every quote and substitution a fuzz line leaves open, the way
+** the shell finds their ends. Outside quotes a ' " ` or $( opens one and a # at the start of a word
+** begins a comment. Inside double quotes only a ` or $( nests. Inside $( quotes are skipped and
+** parentheses are counted, and inside ` or ' nothing nests. A backslash left at the end escapes a
+** blank so it cannot escape the closing characters.
+**
+** Parameters: line, its length, size of its buffer
+**
+** Returns: length of the closed line
+*************************************************************************************************/
+
+int closeFuzzLine(char *request, int length, size_t size)
+{
+    char open[4096];
+    int depth = 0;
+    int inWord = 0;
+    int escaped = 0;
+    int i;
+    for(i = 0; i < length; i++)
+    {
+        char top = depth > 0 ? open[depth - 1] : '\0';
+        char character = request[i];
+        if(escaped == 1)
+        {
+            escaped = 0;
+            inWord = 1;
+        }
+        else if(top == '\'')
+        {
+            depth -= character == '\'';
+        }
+        else if(character == '\\')
+        {
+            escaped = 1;
+        }
+        else if(top == '`')
+        {
+            depth -= character == '`';
+        }
+        else if(top == '"' || top == 'q')
+        {
+            if(character == '"')
+            {
+                depth--;
+            }
+            else if(top == '"' && character == '`')
+            {
+                open[depth++] = '`';
+            }
+            else if(top == '"' && character == '$' && request[i + 1] == '(')
+            {
+                open[depth++] = '(';
+                i++;
+            }
+        }
+        else if(top == '(')
+        {
+            if(character == '\'')
+            {
+                open[depth++] = '\'';
+            }
+            else if(character == '"')
+            {
+                open[depth++] = 'q';
+            }
+            else if(character == '(')
+            {
+                open[depth++] = '(';
+            }
+            else if(character == ')')
+            {
+                depth--;
+            }
+        }
+        else if(character == '#' && inWord == 0)
+        {
+            break;
+        }
+        else
+        {
+            inWord = strchr(" \t;&|<>()", character) == NULL;
+            if(character == '\'' || character == '"' || character == '`')
+            {
+                open[depth++] = character;
+            }
+            else if(character == '$' && request[i + 1] == '(')
+            {
+                open[depth++] = '(';
+                i++;
+            }
+        }
+    }
+
+    if(escaped == 1)
+    {
+        length += snprintf(request + length, size - length, " ");
+    }
+    while(depth > 0)
+    {
+        char top = open[--depth];
+        length += snprintf(request + length, size - length, "%c", top == 'q' ? '"' : top == '(' ? ')' : top);
+    }
+    request[length] = '\0';
+    return length;
+}
+
+/*************************************************************************************************
+** Name: absoluteShell
+**
+** Description: This function makes the path of a shell absolute so it still runs from a scratch
+** directory. A shell without a slash is found on PATH and is left as it is.
+**
+** Parameters: shell as it was given, buffer of PATH_MAX bytes for its absolute path
+**
+** Returns: shell to run
+*************************************************************************************************/
+
+char* absoluteShell(char *shell, char *resolved)
+{
+    if(strchr(shell, '/') == NULL || realpath(shell, resolved) == NULL)
+    {
+        return shell;
+    }
+
+    return resolved;
+}
@@ -0,0 +1,136 @@
+#!/bin/sh
+# Runs the benchmark suite: every workload is generated into a scratch
+# directory and run by smallsh and by whichever of dash and bash are
+# installed, reporting commands a second and peak memory for the whole
+# script and the median and 99th percentile latency of single commands.
+# Commands are run by path so every shell spawns them instead of running
+# its own built in, except for the loop, which runs a case and a test once
+# for every command to measure how cheaply the shell runs its own control
+# flow. Every workload but the background one is then run by smallsh and
+# dash from empty directories, and what they print, their exit values and
+# the files they make have to match. Then comes one smallsh server answering
+# requests over a socket on one and on several connections, against a fresh
+# smallsh for every command. Then smallsh is grown by capturing a large
+# output and starting a command and a command substitution are timed as it
+# grows, with the copies for command substitution forked by smallsh itself
+# and by its zygote. Last, smallsh is fed random lines of quoting, expansion
+# and redirection, which is worth most with make SANITIZE=address,undefined.
+# The suite runs to the end either way, but exits with 1 if smallsh and dash
+# differed on a workload or a random line crashed or hung smallsh.
+#
+# usage: bench/run.sh SMALLSH DRIVER [SHELL...]
+
+set -e
+
+smallsh=$1
+driver=$2
+shift 2
+shells="$smallsh ${*:-dash bash}"
+
+# sizes can be scaled down for a quick run
+COMMANDS=${COMMANDS:-10000}
+JOBS=${JOBS:-1000}
+SAMPLES=${SAMPLES:-2000}
+CAPTURES=${CAPTURES:-50}
+REQUESTS=${REQUESTS:-5000}
+CONNECTIONS=${CONNECTIONS:-8}
+GROWTH=${GROWTH:-0 100 400}
+FUZZ=${FUZZ:-2000}
+
+work=$(mktemp -d)
+server=
+failed=0
+trap 'test -z "$server" || kill "$server"; rm -rf "$work"' EXIT
+
+# repeat LINE COUNT writes the line COUNT times
+repeat() {
+    awk -v line="$1" -v count="$2" 'BEGIN { for (i = 0; i < count; i++) print line }'
+}
+
+dollars=$(repeat '$$' 200 | tr '\n' ' ')
+
+repeat '/bin/true' "$COMMANDS" > "$work/true.sh"
+repeat "/bin/true > $work/out" "$COMMANDS" > "$work/redirect.sh"
+repeat '/bin/true &' "$JOBS" > "$work/background.sh"
+repeat "echo $dollars > /dev/null" "$COMMANDS" > "$work/dollar.sh"
+
+# a loop of built ins, parsed once and run COMMANDS times
+loop='case $i in *0) echo $i ;; *) test $i -gt 0 ;; esac'
+echo "for i in \$(seq $COMMANDS); do $loop; done" > "$work/loop.sh"
+
+# command substitution capturing a few megabytes of output
+head -c 3000000 /dev/urandom | od -An -tx1 > "$work/capture"
+repeat "echo \"\$(cat $work/capture)\" > /dev/null" "$CAPTURES" > "$work/capture.sh"
+
+printf '%-12s %-10s %12s %10s %10s %10s\n' workload shell cmds/sec p50-us p99-us rss-kb
+
+for workload in true redirect background dollar loop capture; do
+    case $workload in
+        true) count=$COMMANDS; command='/bin/true' ;;
+        redirect) count=$COMMANDS; command="/bin/true > $work/out" ;;
+        background) count=$JOBS; command='/bin/true &' ;;
+        dollar) count=$COMMANDS; command="echo $dollars > /dev/null" ;;
+        loop) count=$COMMANDS; command="for i in 1 2 3 4 5 6 7 8 9 10; do $loop; done" ;;
+        capture) count=$CAPTURES; command="echo \"\$(cat $work/capture)\" > /dev/null" ;;
+    esac
+
+    for shell in $shells; do
+        if ! command -v "$shell" > /dev/null 2>&1; then
+            continue
+        fi
+
+        set -- $("$driver" script "$shell" "$work/$workload.sh" "$count")
+        rate=$1 rss=$2
+        set -- $("$driver" latency "$shell" "$command" "$(( count < SAMPLES ? count : SAMPLES ))")
+        printf '%-12s %-10s %12s %10s %10s %10s\n' "$workload" "$(basename "$shell")" "$rate" "$1" "$2" "$rss"
+    done
+done
+
+# the workloads have to do the same under dash. background is left out since
+# smallsh reports the pid of every job it starts
+if command -v dash > /dev/null 2>&1; then
+    printf '\n%-12s %-10s %12s %10s\n' workload result smallsh-ms dash-ms
+    for workload in true redirect dollar loop capture; do
+        result=$("$driver" compare "$smallsh" dash "$work/$workload.sh") || failed=1
+        set -- $result
+        printf '%-12s %-10s %12s %10s\n' "$workload" "$1" "$2" "$3"
+    done
+    echo
+fi
+
+# requests to a server, against starting smallsh -c for every one of them
+"$smallsh" --serve "$work/socket" 2> /dev/null &
+server=$!
+while [ ! -S "$work/socket" ]; do
+    sleep 0.01
+done
+
+set -- $("$driver" spawn "$smallsh" /bin/true "$REQUESTS")
+printf '%-12s %-10s %12s %10s %10s %10s\n' request fresh "$1" "$2" "$3" -
+for connections in 1 "$CONNECTIONS"; do
+    set -- $("$driver" serve "$work/socket" /bin/true "$REQUESTS" "$connections")
+    printf '%-12s %-10s %12s %10s %10s %10s\n' request "serve-$connections" "$1" "$2" "$3" -
+done
+
+# starting commands from a shell which has grown by SIZE megabytes
+for size in $GROWTH; do
+    grow="echo \"\$(head -c ${size}000000 /dev/zero | tr '\\0' a)\" > /dev/null"
+    for shell in smallsh zygote; do
+        zygote=
+        test $shell = zygote && zygote=1
+        for workload in spawn subst; do
+            case $workload in
+                spawn) command='/bin/true' ;;
+                subst) command='echo "$(/bin/true)"' ;;
+            esac
+            set -- $(SMALLSH_ZYGOTE=$zygote "$driver" latency "$smallsh" "$command" "$SAMPLES" "$grow")
+            printf '%-12s %-10s %12s %10s %10s %10s\n' "$workload-${size}mb" $shell - "$1" "$2" "$3"
+        done
+    done
+done
+
+# random lines, reproducible from the seed
+result=$("$driver" fuzz "$smallsh" "$FUZZ" 1) || failed=1
+printf '%-12s %-10s %s\n' fuzz smallsh "$result"
+
+exit $failed
@@ -8,26 +8,74 @@
 **  CS344_400_W2020
 **
 ** Description: This assignment creates a shell which runs command line
-** instructions similar to bash. The shell allows for redirection of
-** both standard input and output and supports foreground and background
-** processes. The shell supports three built in commands: exit, cd & status.
-** Using exit will leave the shell. Using cd will change directories
-** The shells also supports comments. Commands that are not one of the
-** built in commands are forked off into child processes which then are
-** handled according to the user input. Invalid commands are rejected.
-** Commands which need to be forked are called using system calls to run
-** after which the program returns to the shell after running. The shell
-** command line is limited to accepting a max of 2048 characters and 512
-** arguments. The shell also keeps track of processes requested to run in
-** the background and reports their completion when in between foreground
-** calls and reports immediately the termination of background child processes.
-** The shell also allows for foreground only mode (which ignores &) which
-** prevents commands to be run in the background. This feature can be
-** toggled on an off as the user desires. The program also uses signals
-** to manipulate the way pressing cntrl+c and cntrl+z are handled in the
-** shell
+** instructions similar to bash. The shell allows for redirection of any
+** descriptor with <, >, >>, <>, n>&m, n<&m and &>, here-documents (<<WORD) and
+** here-strings (<<<word) and supports foreground and background processes. The
+** shell supports seventeen built in commands: exit, cd, status, hash, jobs,
+** wait, fg, bg, parallel, history, trace, setaffinity, joblog, export, break,
+** continue & return. Using exit will leave the shell, with the exit value it
+** is given or that of the last command. Using cd will change directories.
+** Using hash shows or clears the cache of where commands were found on PATH.
+** Using jobs lists the background jobs still running or stopped. Using wait
+** blocks until background jobs are done, all of them, the ones named or with
+** -n the next one to finish. At a terminal every job is a process group of its
+** own which is given the terminal while it runs in the foreground, so cntrl+z
+** stops the foreground job, fg brings a job back to the foreground and bg
+** continues a stopped job in the background. Using parallel runs a command
+** once for every input with a fixed number of them running at the same time.
+** Using history lists or searches the command lines entered at the prompt,
+** which are kept in a history file shared by every session and can be run
+** again with !!, !n, !-n, !prefix or !?text?. Using trace, or setting
+** SMALLSH_TRACE to a file name, records how long every phase of a command
+** takes as a Chrome trace. Using setaffinity, or setting SMALLSH_PLACEMENT,
+** pins every background job to a CPU of its own, spread across the NUMA nodes
+** or packed onto one, optionally keeping a CPU for the shell alone. Using
+** joblog on, or setting SMALLSH_JOBLOG, keeps what every background job
+** started afterwards writes to its output and errors in memory, the newest
+** bytes within a budget for each job and one for all of them, and joblog %n
+** prints what was kept. The common utilities :, echo, printf, true, false,
+** test, [, pwd and kill also run inside the shell itself, with their
+** redirections applied to the shell for as long as they run, so they cost no
+** child process. Any command line can be prefixed with time to report the wall
+** time, CPU time, memory and context switches it used, which status -v also
+** shows for the last foreground command. At a terminal the line is read by a
+** line editor with cursor movement, browsing of the history with the arrow
+** keys, and tab completion of file names and of commands, which come from an
+** index of the executables on PATH that inotify keeps up to date. Started with
+** --serve and the path of a socket, the shell runs the command lines any
+** number of clients send it over the Unix domain socket instead, each in a
+** copy of itself, and streams back what they print and their exit value, and
+** smallsh --client socket command is such a client. Setting SMALLSH_ZYGOTE
+** starts a small helper while the shell is still small which forks the copies
+** of the shell that run command substitutions, so they cost the same however
+** large the shell has grown. Commands can be separated by ; or newlines,
+** joined by && and ||, and put in if, while, until, for and case commands, { }
+** groups and functions, which may take several lines. Everything a command
+** takes is parsed once into a syntax tree whose words are expanded every time
+** they run, so a loop costs no parsing per pass. break and continue leave
+** loops, return leaves a function, NAME=value sets a variable of the shell,
+** which only commands started with NAME=value before them or after export NAME
+** see, and cntrl+c stops a loop the shell is running. Functions and built ins
+** in a pipeline or in the background run in a copy of the shell. The shells
+** also supports comments. Commands that are not one of the built in commands
+** are forked off into child processes which then are handled according to the
+** user input. Invalid commands are rejected. Commands which need to be forked
+** are called using system calls to run after which the program returns to the
+** shell after running. The shell command line is limited to accepting a max of
+** 512 arguments. Variables such as $$, $?, $!, $NAME and the positional
+** parameters $1, $# and $@ are expanded as each command runs, and so are
+** $(command) and `command`, which are replaced by what the command printed.
+** The shell also keeps track of processes requested to run in the background
+** and reports their completion when in between foreground calls and reports
+** immediately the termination of background child processes. The shell also
+** allows for foreground only mode (which ignores &) which prevents commands to
+** be run in the background. This feature can be toggled on an off as the user
+** desires. The program also uses signals to manipulate the way pressing
+** cntrl+c and cntrl+z are handled in the shell
 *********************************************************************************/
 
+#define _GNU_SOURCE
+
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
@@ -40,898 +88,12595 @@
 #include <sys/wait.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <limits.h>
+#include <sys/signalfd.h>
+#include <sys/epoll.h>
+#include <sys/inotify.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <dirent.h>
+#include <stdint.h>
+#include <sys/time.h>
+#include <sys/resource.h>
 #include <signal.h>
+#include <spawn.h>
+#include <sched.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <arpa/inet.h>
+#include <fnmatch.h>
 
 // constants
-#define MAX_CHARS 2048
 #define MAX_ARGS 512
+#define MAX_REQUEST 1048576         // longest command line a client of the server may send
+#define MAX_PENDING_REPLY 1048576   // reply bytes a client may fall behind by before output waits for it
+
+// kinds of token the lexer produces
+// every kind after TOKEN_AMP is a redirection
+enum tokenType {TOKEN_WORD, TOKEN_PIPE, TOKEN_SEMI, TOKEN_DSEMI, TOKEN_AND_IF, TOKEN_OR_IF, TOKEN_LPAREN,
+                TOKEN_RPAREN, TOKEN_NEWLINE, TOKEN_AMP, TOKEN_LESS, TOKEN_GREAT, TOKEN_DGREAT, TOKEN_LESSGREAT,
+                TOKEN_LESSAND, TOKEN_GREATAND, TOKEN_ANDGREAT, TOKEN_HEREDOC, TOKEN_HERESTRING};
+
+// what lexLine does with the words it finds. a command is lexed with its words kept as written so
+// they can be expanded every time it runs, and each of those words is expanded on its own
+enum lexMode {LEX_RAW, LEX_EXPAND, LEX_EXPAND_UNSPLIT};
+
+struct token
+{
+    enum tokenType type;
+    char *text;                 // word with quotes removed, or as written when lexed raw, or the operator itself
+    bool quoted;                // the word had quotes or backslashes in it
+    int ioNumber;               // descriptor written right before a redirection, -1 if none
+    size_t start;               // where the token starts in the text it was lexed from
+    size_t end;                 // where it ends
+};
+
+// an operator as it is written and the kind of token it becomes
+struct lexOperator
+{
+    const char *text;
+    enum tokenType type;
+};
+
+// a redirection operator and the file, descriptor or text it names
+struct redirection
+{
+    enum tokenType type;
+    int fd;                     // descriptor being redirected, -1 for the default of the operator
+    char *target;               // file name, descriptor, here-string, or here-document delimiter until its body is read
+    bool quoted;                // here-document delimiter was quoted so its body is not expanded
+};
+
+// one step of a redirection plan. the command gets sourceFd duplicated onto targetFd, or has
+// targetFd closed when sourceFd is -1
+struct redirectStep
+{
+    int targetFd;
+    int sourceFd;
+};
+
+// descriptors 0 to 9 of the shell as they were before a built in was redirected
+struct savedDescriptors
+{
+    int fds[10];                // close-on-exec copy, -1 if unchanged, -2 if it was closed
+    int flags[10];              // descriptor flags to put back
+};
+
+// one command of a pipeline
+struct commandStage
+{
+    char **argv;                // NULL terminated arguments ready for posix_spawn
+    int argc;
+    struct redirection *redirections;
+    int numRedirections;
+    char **assignments;         // NAME=value words before the command, which only it sees
+    int numAssignments;
+};
+
+// a parsed command line. everything it points to lives in the line arena
+struct pipeline
+{
+    struct commandStage *stages;
+    int numStages;
+    bool background;            // line ended with &
+    bool timed;                 // line started with time
+    char *text;                 // the command line as entered
+};
+
+// kinds of command in the syntax tree of the input
+enum nodeType {NODE_PIPELINE, NODE_NOT, NODE_AND, NODE_OR, NODE_IF, NODE_WHILE, NODE_UNTIL, NODE_FOR,
+               NODE_CASE, NODE_GROUP, NODE_FUNCTION};
+
+// a command of the syntax tree. the tree is built once for everything the input takes to complete a
+// command, and its words are kept as written and expanded every time the command runs, so a loop
+// never lexes or parses its body again
+struct node
+{
+    enum nodeType type;
+    struct node *next;          // next command of the list this one is part of
+    struct node *first;         // condition, left side of && or ||, or body of a group or function
+    struct node *second;        // part run when the condition holds, right side, or body of a loop
+    struct node *third;         // else part of an if, another if for an elif
+    struct pipeline *commandPipeline; // pipeline with its words as written
+    char *name;                 // variable of a for loop, word of a case, name of a function
+    char **words;               // words of a for loop, NULL if it goes through the positional parameters
+    struct caseItem *items;
+    int numItems;
+    struct commandStage *redirections; // redirections of a compound command, NULL if it has none
+};
+
+// patterns of a case and the commands run when one of them matches
+struct caseItem
+{
+    char **patterns;            // NULL terminated
+    struct node *body;
+};
+
+// state of the parser going through the tokens of a command
+struct parser
+{
+    struct token *tokens;
+    int numTokens;
+    int position;
+    const char *text;           // text the tokens were lexed from
+    bool incomplete;            // the tokens ran out before the command was complete
+    bool failed;                // a syntax error was found and reported
+};
+
+// string which doubles its capacity as it grows
+struct stringBuffer
+{
+    char *data;
+    size_t length;
+    size_t capacity;
+};
+
+// memory for everything made from one command line. blocks are handed out from front to back and
+// the whole arena is reset at once when the command is done
+struct arenaBlock
+{
+    struct arenaBlock *next;
+    size_t size;
+    size_t used;
+    char data[];
+};
+
+struct arena
+{
+    struct arenaBlock *head;    // block currently handed out from, always the largest
+};
+
+// how far an arena had handed out memory, to give back everything handed out after it
+struct arenaMark
+{
+    struct arenaBlock *block;
+    size_t used;
+};
+
+// syntax tree which defined functions, kept for as long as any of them is defined or running
+struct keptTree
+{
+    struct arena memory;
+    int references;             // functions whose body is in the tree, calls running and the command running
+};
+
+// a shell function and the syntax tree its body is part of
+struct shellFunction
+{
+    char *name;
+    struct node *body;
+    struct keptTree *tree;
+};
+
+// how running commands of the syntax tree stops early. break and continue unwind the number of
+// loops they were given, return unwinds the function and an interrupt unwinds everything
+enum unwindKind {UNWIND_NONE, UNWIND_BREAK, UNWIND_CONTINUE, UNWIND_RETURN, UNWIND_INTERRUPT};
+
+// environment handed to every spawned command
+extern char **environ;
+
+// a job is one command line started by the shell, which may be a pipeline of several processes
+enum jobState {JOB_FREE, JOB_RUNNING, JOB_STOPPED, JOB_DONE};
+
+struct job
+{
+    pid_t *pids;                // pid of every stage of the job
+    int numPids;
+    int numLive;                // stages not reaped yet
+    int lastStatus;             // exit method of the last stage
+    char *commandLine;          // the command line as the user entered it
+    struct timespec startTime;  // CLOCK_MONOTONIC time the job was started
+    struct rusage usage;        // resources used by the stages reaped so far
+    bool timed;                 // report the resources used once the job is done
+    pid_t pgid;                 // process group of the job, 0 if it was started without job control
+    enum jobState state;
+    int next;                   // next job in the free list or the running list
+    int prev;                   // previous job in the running list
+};
+
+// a pid of a running job and the slot of that job in the table
+struct pidEntry
+{
+    pid_t pid;
+    int jobIndex;
+};
+
+// growable table of jobs. free slots are kept in a free list and running jobs in a doubly linked
+// list so inserting, removing and finding a job by pid never has to scan the table
+struct jobTable
+{
+    struct job *jobs;
+    int capacity;
+    int freeHead;
+    int liveHead;
+    struct pidEntry *pidHash;   // open addressing hash of pid to job slot, pid 0 marks an empty entry
+    int hashCapacity;
+    int hashCount;
+};
+
+// exit status of a background job which finished before wait asked for it. the newest are kept in a
+// ring so wait PID or wait %n still finds the status of a job reaped while the shell did something else
+struct reapedJob
+{
+    pid_t pid;                  // pid of the last stage of the job, 0 for an unused entry
+    int jobNumber;
+    int exitMethod;             // exit method of the job
+};
+
+#define MAX_REAPED 64
+
+// location of a command found on PATH. the entry is valid while the directory it was found in keeps
+// the modification time it had at the time
+struct commandEntry
+{
+    char *name;                 // command name, NULL marks an empty slot
+    char *path;                 // absolute path the command runs from
+    size_t dirLength;           // length of the directory part of path
+    struct timespec dirMtime;
+    int hits;                   // number of times the entry was used
+};
+
+// open addressing hash of command names to their location, along with the PATH they were found with
+struct commandCache
+{
+    struct commandEntry *entries;
+    int capacity;
+    int count;
+    char *pathCopy;
+};
+
+// a run of the parallel built in. every job slot runs at most one child at a time and the reaping
+// path hands back the children which are not part of a background job
+struct parallelRun
+{
+    pid_t *slotPids;            // child running in every slot, -1 for a free slot
+    int *slotInputs;            // input the child of every slot was started for
+    int numSlots;
+    int numRunning;
+    int numDone;
+    int numFailed;
+    bool interrupted;           // a child was stopped by SIGINT so no more are started
+    char **inputs;
+    struct rusage usage;        // resources used by the children reaped so far
+};
+
+// command history. lines from earlier sessions are read from the history file, which is mapped at
+// startup and only indexed the first time an entry is looked up, so starting the shell costs the
+// same however long the history is. lines of this session are kept in memory and appended to the file
+struct history
+{
+    int fd;                     // history file opened for appending, -1 if there is none
+    char *mapped;               // history file as it was at startup
+    size_t mappedLength;
+    size_t *fileLines;          // offset of every line of the mapped file, NULL until first needed
+    int numFileLines;
+    struct stringBuffer sessionText;    // lines of this session, each ended by a newline
+    size_t *sessionLines;       // offset of every line in sessionText
+    int numSessionLines;
+    int sessionCapacity;
+};
+
+// executables on PATH offered by command completion. names are kept sorted, each with a bit for every
+// PATH directory it is found in so a file appearing or leaving one directory is a single update.
+// inotify watches on the directories keep the index fresh without scanning them again
+struct executableEntry
+{
+    char *name;
+    uint64_t dirs;              // bit n is set when the name is an executable in directory n
+};
+
+struct executableIndex
+{
+    struct executableEntry *entries;
+    int count;
+    int capacity;
+    bool built;                 // false until first needed and again when it has to be rebuilt
+    char *pathCopy;             // PATH the index was built for
+    char *dirs[64];             // absolute PATH directories by bit number
+    int watches[64];            // inotify watch of every directory, -1 if it is not watched
+    int numDirs;
+};
+
+// ways background jobs can be placed on the CPUs
+enum placementPolicy {PLACE_OFF, PLACE_SPREAD, PLACE_PACK, PLACE_RESERVE_SHELL};
+
+// CPUs background jobs are pinned to in turn. the order depends on the policy, alternating between
+// NUMA nodes to spread jobs or going through one node after another to pack them
+struct cpuPlacement
+{
+    enum placementPolicy policy;
+    int *cpuOrder;              // CPUs in the order jobs are given them
+    int numCpus;
+    int nextCpu;                // position in cpuOrder of the CPU the next job gets
+    int shellCpu;               // CPU kept for the shell, -1 if none is
+    cpu_set_t shellMask;        // affinity the shell started with
+    cpu_set_t childMask;        // CPUs children not pinned to one may use
+    bool loaded;                // the CPUs have been read from /sys
+};
+
+// what a readiness event of the server is about. the events of a client carry its slot times four
+// plus one of these, and the listening socket and the signalfd have tags of their own
+enum requestEvent {REQUEST_CLIENT, REQUEST_STDOUT, REQUEST_STDERR};
+#define SERVER_LISTEN_EVENT UINT64_MAX
+#define SERVER_SIGNAL_EVENT (UINT64_MAX - 1)
+
+// output of a background job kept while capture is on. the newest bytes are kept in a ring which
+// grows as output arrives, up to the budget of one job, and the log is kept after its job is done
+// until the job number is used again or its memory is needed by another log
+struct jobLog
+{
+    int jobNumber;              // number the log was kept under, counting up from 1, 0 when the slot is free
+    int jobIndex;               // slot of the job in the job table
+    pid_t pid;                  // pid of the last stage of the job
+    char *commandLine;
+    int fd;                     // read end of the pipe the job writes to, -1 once it is closed
+    char *ring;
+    size_t capacity;            // bytes allocated for the ring
+    size_t start;               // offset of the oldest byte kept
+    size_t length;              // bytes kept
+    unsigned long long dropped; // oldest bytes there was no room for
+};
+
+// capture of background job output. the pipes of the logs are watched by an epoll of their own,
+// which is itself watched by the event loop, so the shell can drain them wherever it waits
+struct jobCapture
+{
+    bool enabled;               // jobs started now are captured
+    size_t jobBudget;           // most bytes kept for one job
+    size_t totalBudget;         // most bytes kept for all jobs together
+    size_t totalUsed;           // bytes allocated to rings
+    struct jobLog *logs;
+    int numLogs;                // slots in logs
+    int numOpen;                // logs whose pipe is still open
+    int epollFd;
+    int nextJobNumber;          // number of the next log, never reused so the oldest are given up first
+};
+
+// what the shell tells its zygote about a command line to run in a copy. the command line and the
+// NUL separated environment follow it, and standard input, output and error of the copy and the
+// working directory come with it as descriptors
+struct zygoteRequest
+{
+    uint32_t textLength;
+    uint32_t environmentLength;
+    int exitMethod;             // $? of the shell
+    pid_t lastBackgroundPid;    // $! of the shell
+    pid_t shellPid;             // $$ of the shell
+    bool foregroundOnly;
+};
+
+// a connection to the server and the request it is running. requests of one connection run one
+// after another, so the frames of the next one wait in the input until the running one is answered
+struct serverClient
+{
+    int socketFd;               // -1 when the slot is free
+    struct stringBuffer input;  // bytes read from the client
+    size_t inputUsed;           // bytes of input belonging to requests already started
+    struct stringBuffer output; // frames not yet written to the client
+    size_t outputSent;          // bytes of output already written
+    pid_t requestPid;           // copy of the shell running the request, 0 when the client is idle
+    int outputFds[2];           // read ends of the standard output and error of the copy, -1 once closed
+    int exitMethod;             // exit method of the copy once it has been reaped
+    bool reaped;
+    bool inputEnded;            // the client sends no more requests
+    bool outputPaused;          // the output of the request is not read while the client is behind
+};
 
 // global variables
-static int pidIndex = 0;
-int pidArray[100] = {0};
+
+// operators the lexer knows. an operator comes before any shorter one it starts with
+const struct lexOperator lexOperators[] =
+{
+    {"<<<", TOKEN_HERESTRING}, {"<<-", TOKEN_HEREDOC}, {"<<", TOKEN_HEREDOC}, {"<>", TOKEN_LESSGREAT},
+    {"<&", TOKEN_LESSAND}, {"<", TOKEN_LESS}, {">>", TOKEN_DGREAT}, {">&", TOKEN_GREATAND}, {">", TOKEN_GREAT},
+    {"&>", TOKEN_ANDGREAT}, {"&&", TOKEN_AND_IF}, {"&", TOKEN_AMP}, {"||", TOKEN_OR_IF}, {"|", TOKEN_PIPE},
+    {";;", TOKEN_DSEMI}, {";", TOKEN_SEMI}, {"(", TOKEN_LPAREN}, {")", TOKEN_RPAREN}, {"\n", TOKEN_NEWLINE}
+};
+
+struct commandCache commandCache = {NULL, 0, 0, NULL};
+char *lookupScratch = NULL;
+struct jobTable jobTable = {NULL, 0, -1, -1, NULL, 0, 0};
+struct reapedJob reapedJobs[MAX_REAPED] = {{0}};
+int nextReaped = 0;
 bool isForegroundOnly = false;
-int childExitMethod = -5;
+int childExitMethod = 0;
+int pipeStatus[MAX_ARGS];
+int numPipeStages = 0;
 bool askInput = true;
+struct arena lineArena = {NULL};
+struct stringBuffer wordBuffer = {NULL, 0, 0};
+struct stringBuffer substitutionText = {NULL, 0, 0};
+struct stringBuffer substitutionOutput = {NULL, 0, 0};
+// the argument of an integer comparison of test which is not a number
+const char *testBadNumber = NULL;
+// set when a line lexed raw ends inside a quote, a substitution or after a backslash
+bool lexIncomplete = false;
+pid_t lastBackgroundPid = -1;
+int numSubstitutions = 0;
+pid_t shellPid;
+char shellPidString[16];
+int shellPidLength = 0;
+
+// resources used by the most recent foreground command, shown by status -v
+struct rusage lastUsage = {0};
+struct timespec lastWallTime = {0};
+bool lastUsageKnown = false;
+struct parallelRun *activeParallel = NULL;
+struct history commandHistory = {-1, NULL, 0, NULL, 0, {NULL, 0, 0}, NULL, 0, 0};
+struct stringBuffer expandedLine = {NULL, 0, 0};
+
+// line editor state. the line being edited lives in editBuffer, which readCommandLine hands out
+bool lineEditor = false;
+const char *promptText = ":";
+struct stringBuffer editBuffer = {NULL, 0, 0};
+struct stringBuffer editSaved = {NULL, 0, 0};
+struct stringBuffer editOutput = {NULL, 0, 0};
+size_t editCursor = 0;
+int historyPosition = -1;
+struct executableIndex executableIndex = {NULL, 0, 0, false, NULL, {NULL}, {0}, 0};
+int inotifyFd = -1;
+
+// trace of the phases of every command, NULL while tracing is off
+FILE *traceFile = NULL;
+bool traceHasEvents = false;
+pid_t tracePid;
+
+// where background jobs run
+struct cpuPlacement cpuPlacement = {PLACE_OFF, NULL, 0, 0, -1};
+
+// server mode, where command lines come from clients of a Unix domain socket instead of the input
+const char *serverSocket = NULL;
+int serverListenFd = -1;
+struct serverClient *serverClients = NULL;
+int numServerClients = 0;
+
+// logs of background job output, 64 KB a job and 1 MB in all unless joblog on says otherwise
+struct jobCapture jobCapture = {false, 65536, 1048576, 0, NULL, 0, 0, -1, 1};
+
+// a SIGCHLD read from the signalfd while waiting for a foreground job, still to be reported
+bool childSignalPending = false;
+
+// the command being run. its syntax tree is built in treeArena, which is handed over to a kept tree
+// once it defines a function, and everything made from the words of a pipeline is in lineArena
+struct arena treeArena = {NULL};
+struct stringBuffer programText = {NULL, 0, 0};
+struct keptTree *runningTree = NULL;
+struct shellFunction *shellFunctions = NULL;
+int numShellFunctions = 0;
+
+// NAME=value strings of the variables of the shell which are not exported, or NAME alone for one
+// export marked before it had a value, and the NAME=value strings the shell put in the environment
+char **shellVariables = NULL;
+int numShellVariables = 0;
+char **exportedVariables = NULL;
+int numExportedVariables = 0;
+enum unwindKind unwinding = UNWIND_NONE;
+int unwindLevels = 0;
+int loopDepth = 0;
+int functionDepth = 0;
+volatile sig_atomic_t interruptRequested = 0;
+
+// arguments of the function being run, or of the script
+char **positionalParams = NULL;
+int numPositional = 0;
+
+// socket to the zygote which forks the copies of the shell for command substitution, -1 if there is none
+int zygoteFd = -1;
+
+// signal setup handed to children, filled in once at startup
+struct sigaction terminateFgChild = {0};
+struct sigaction ignoreSIGTSTP = {0};
+
+// event loop state. input is read in large chunks into inputBuffer, or is a mapped script or the
+// -c argument, and is handed out a line at a time. inputFd is -1 once there is nothing more to read
+int signalFd = -1;
+int epollFd = -1;
+bool interactiveShell = true;
+
+// job control is on when the shell owns its terminal. jobs are then given the terminal while they
+// run in the foreground and it goes back to the shell with the modes it had
+bool jobControl = false;
+pid_t shellPgid;
+struct termios shellTerminal;
+bool stdinPollable = false;
+int inputFd = STDIN_FILENO;
+struct stringBuffer lastLine = {NULL, 0, 0};
+char *inputBuffer = NULL;
+size_t inputStart = 0;
+size_t inputLength = 0;
+size_t inputCapacity = 0;
 
 // function prototypes
 void catchSIGTSTP(int signo);
-void printShellPrompt();
-int numArguments(const char *userString);
-char** tokenizeString(char *commandLine);
-void builtInFunctions(char **commandLine, int lastIndex, struct sigaction *terminateFgChild, struct sigaction *ignoreSIGTSTP);
-void createFork(char **commandLine, int lastIndex, struct sigaction *terminateFgChild, struct sigaction *ignoreSIGTSTP);
-void executeCommand(char **commandLine, bool runBackground);
-void ioRedirect(char **commandLine, bool runBackground);
-void execError();
+bool printShellPrompt();
+void* arenaAlloc(struct arena *memoryArena, size_t size);
+void arenaReset(struct arena *memoryArena);
+struct arenaMark arenaMark(struct arena *memoryArena);
+void arenaRollback(struct arena *memoryArena, struct arenaMark mark);
+int lexLine(const char *lineEntered, struct arena *lineArena, struct token **tokens, enum lexMode mode);
+bool isFieldSeparator(char character, const char *fieldSeparators);
+bool parsePipeline(struct token *tokens, int numTokens, struct arena *lineArena, char *lineText, struct pipeline *commandPipeline);
+struct node* readCommand(char *firstLine, bool *isSyntaxError);
+struct node* parseList(struct parser *commandParser);
+struct node* parseAndOr(struct parser *commandParser);
+struct node* parseCommand(struct parser *commandParser);
+struct node* parseCompound(struct parser *commandParser);
+struct node* parseIf(struct parser *commandParser);
+struct node* parseFor(struct parser *commandParser);
+struct node* parseCase(struct parser *commandParser);
+struct node* parseSimplePipeline(struct parser *commandParser);
+struct node* parseBody(struct parser *commandParser);
+char* sourceText(struct parser *commandParser, size_t start, size_t end);
+struct node* newNode(enum nodeType type);
+bool isReservedWord(struct parser *commandParser, const char *word);
+bool expectReservedWord(struct parser *commandParser, const char *word);
+void skipNewLines(struct parser *commandParser);
+void syntaxError(struct parser *commandParser);
+void runCommand(struct node *program);
+void runList(struct node *list);
+void runNode(struct node *command);
+void runLoop(struct node *loop);
+void runFor(struct node *loop);
+void runCase(struct node *caseCommand);
+bool loopUnwound();
+void runPipeline(struct pipeline *rawPipeline);
+bool expandPipeline(struct pipeline *rawPipeline, struct pipeline *commandPipeline);
+bool expandRedirections(struct commandStage *rawStage, struct commandStage *stage);
+char* expandString(const char *rawWord);
+size_t nameLength(const char *text);
+void setVariable(const char *name, const char *value);
+int findShellVariable(const char *name, size_t length);
+const char* variableValue(const char *name, size_t length);
+void exportVariable(const char *name, const char *value);
+void unexportVariable(const char *name);
+int exportCommand(char **commandLine);
+int compareVariables(const void *first, const void *second);
+int flowCommand(char **commandLine);
+int findFunction(const char *name);
+void defineFunction(struct node *definition);
+void callFunction(int functionIndex, struct commandStage *stage);
+void releaseTree(struct keptTree *tree);
+void builtInFunctions(struct pipeline *commandPipeline, struct sigaction *terminateFgChild, struct sigaction *ignoreSIGTSTP);
+void createFork(struct pipeline *commandPipeline, struct sigaction *terminateFgChild, struct sigaction *ignoreSIGTSTP);
+void initSpawnAttributes(posix_spawnattr_t *spawnAttributes, bool runBackground, sigset_t *childMask, struct sigaction *terminateFgChild);
+bool setPlacement(const char *policyName);
+void loadCpuTopology();
+bool readCpuList(const char *fileName, cpu_set_t *cpus);
+bool placeChildren(bool isJob);
+void restorePlacement();
+int setaffinityCommand(char **commandLine);
+void parallelCommand(struct commandStage *stage, struct sigaction *terminateFgChild, struct sigaction *ignoreSIGTSTP);
+int readParallelInputs(struct commandStage *stage, char ***inputs);
+void splitInputLines(const char *text, size_t length, char ***inputs, int *numInputs, int *capacity);
+pid_t startParallelChild(char **command, int numCommandWords, const char *input, int inputFd, const posix_spawnattr_t *spawnAttributes);
+bool parallelChildDone(pid_t pid, int exitMethod, const struct rusage *usage);
+void setPipeSize(int pipeFd);
+pid_t executeCommand(struct commandStage *stage, bool runBackground, int inputPipe, int outputPipe, int captureFd, const posix_spawnattr_t *spawnAttributes, bool takeTerminal);
+char** stageEnvironment(struct commandStage *stage);
+bool runsInShell(const char *commandName);
+pid_t forkStage(struct commandStage *stage, bool runBackground, int inputPipe, int outputPipe, int captureFd, const posix_spawnattr_t *spawnAttributes, bool takeTerminal);
+bool ioRedirect(struct commandStage *stage, bool runBackground, int inputPipe, int outputPipe, int captureFd, posix_spawn_file_actions_t *fileActions, int *openedFds, int *numOpened);
+bool planRedirections(struct commandStage *stage, struct redirectStep *steps, int *numSteps, int *openedFds, int *numOpened);
+int openRedirection(struct redirection *fileRedirection);
+int highDescriptor(int fileDescriptor);
+void execError(int errorNumber);
+void exitShell(char **commandLine);
 void changeDirectory(char **commandLine);
-bool isBackgroundProcess(char **commandLine, int lastIndex);
-void checkBackgroundStatus();
+bool isFastBuiltIn(const char *commandName);
+void runFastBuiltIn(struct commandStage *stage);
+bool redirectBuiltIn(struct commandStage *stage, struct savedDescriptors *saved);
+void restoreBuiltIn(struct savedDescriptors *saved);
+int echoCommand(char **commandLine);
+int printfCommand(char **commandLine);
+size_t printfEscape(const char *escape, bool isArgument, int *character);
+const char* printfArgument(char ***arguments, bool *usedArgument);
+long printfInteger(const char *argument, bool isUnsigned, int *exitStatus);
+double printfFloat(const char *argument, int *exitStatus);
+int testCommand(char **commandLine);
+bool testArguments(char **args, int numArgs, bool *result);
+bool testOr(char **args, int numArgs, int *position, bool *result);
+bool testAnd(char **args, int numArgs, int *position, bool *result);
+bool testPrimary(char **args, int numArgs, int *position, bool *result);
+bool testUnary(const char *operator, const char *operand, bool *result);
+bool testBinary(const char *left, const char *operator, const char *right, bool *result);
+int pwdCommand();
+int killCommand(char **commandLine);
+int signalNumber(const char *signalName);
+bool isBackgroundProcess(struct pipeline *commandPipeline);
+int checkBackgroundStatus();
+int noteChildStatus(pid_t pid, int exitMethod, const struct rusage *usage, int *jobStatus);
+void stopForegroundJob(const pid_t *pids, int numPids, const char *commandLine, pid_t pgid);
+void setupJobControl();
+void catchSIGINT(int signo);
+int waitCommand(char **commandLine);
+int findJobArgument(const char *jobName, const char *builtInName);
+int foregroundCommand(char **commandLine);
+int backgroundCommand(char **commandLine);
 void killBackgroundProcesses();
-void checkEmptyLine(const char *lineEntered);
-void variableExpansion(char *lineEntered, int *numCharsEntered);
-void getStatus();
-
-
-int main()
+int addJob(const pid_t *pids, int numPids, const char *commandLine);
+void removeJob(int jobIndex);
+int findJob(pid_t pid);
+void insertPid(pid_t pid, int jobIndex);
+void deletePid(pid_t pid);
+void recordReapedJob(pid_t pid, int jobNumber, int exitMethod);
+int findReapedJob(pid_t pid, int jobNumber);
+size_t variableExpansion(const char *dollarSign, struct stringBuffer *word);
+size_t commandSubstitution(const char *start, struct stringBuffer *output);
+const char* substitutionEnd(const char *start);
+void runSubstitution(const char *commandText, struct stringBuffer *output);
+int exitValue(int exitMethod);
+void bufferAppend(struct stringBuffer *buffer, const char *text, size_t length);
+void bufferAppendChar(struct stringBuffer *buffer, char character);
+char* bufferToArena(struct stringBuffer *buffer, struct arena *memoryArena);
+void getStatus(char **commandLine);
+void addUsage(struct rusage *total, const struct rusage *more);
+void usageSince(const struct rusage *before, struct rusage *after);
+void elapsedSince(const struct timespec *startTime, struct timespec *wallTime);
+void printUsage(const struct timespec *wallTime, const struct rusage *usage);
+bool startTrace(const char *fileName);
+void stopTrace();
+double traceTime();
+void traceEvent(const char *name, pid_t track, double startTime, const char *detail);
+void traceTrackName(pid_t track, int jobNumber, const char *commandLine);
+void traceString(const char *text);
+int traceCommand(char **commandLine);
+void listJobs(char **commandLine);
+const char* lookupCommand(const char *commandName);
+unsigned int hashCommandName(const char *commandName);
+int findCachedCommand(const char *commandName);
+const char* insertCachedCommand(const char *commandName, char *path, size_t dirLength, const struct timespec *dirMtime);
+void deleteCachedCommand(int slot);
+void clearCommandCache();
+void hashCommands(char **commandLine);
+void setupEventLoop();
+bool drainSignalFd();
+ssize_t readCommandLine(char **lineEntered);
+ssize_t readInput();
+void setupLineEditor();
+ssize_t editLine(char **lineEntered);
+ssize_t editKey();
+void refreshLine();
+void editInsert(const char *text, size_t length);
+void editDelete(size_t start, size_t length);
+void editHistory(int direction);
+void completeWord();
+void addCandidate(char ***candidates, int *numCandidates, int *capacity, char *candidate);
+void buildExecutableIndex();
+void clearExecutableIndex();
+int findExecutable(const char *name, bool *found);
+void addExecutable(const char *name, int dirIndex);
+void removeExecutable(const char *name, int dirIndex);
+void processExecutableEvents();
+void openInput(int argc, char *argv[]);
+void setupSignals();
+void openHistory();
+void addHistory(const char *line);
+void indexHistoryFile();
+int numHistoryEntries();
+const char* historyEntry(int entryNumber, size_t *entryLength);
+bool historyMatches(const char *entryText, size_t entryLength, const char *text, size_t textLength, bool prefixOnly);
+int findHistory(const char *text, size_t textLength, bool prefixOnly);
+int expandHistory(const char *line, struct stringBuffer *expanded);
+int historyCommand(char **commandLine);
+bool readHereDocuments(struct token *tokens, int numTokens, struct arena *treeArena);
+bool expandHereDocumentLine(const char *line, struct stringBuffer *body);
+int hereDocumentFd(const char *text, bool addNewLine);
+void runLineInCopy(const char *commandText);
+void becomeCopy();
+int serveRequests(const char *socketPath);
+void acceptClients();
+void readClient(int slot, uint32_t events);
+void startNextRequest(int slot);
+bool startRequest(int slot, const char *commandText, size_t length);
+void readRequestOutput(int slot, int stream);
+void reapRequests();
+void finishRequest(int slot);
+void appendFrame(struct stringBuffer *output, char type, const void *data, uint32_t length);
+void flushClient(int slot);
+void pauseRequestOutput(int slot, bool pause);
+void closeClient(int slot);
+int runClient(int argc, char *argv[]);
+bool readFully(int fd, void *data, size_t length);
+bool sendFully(int socketFd, const void *data, size_t length);
+void startZygote();
+void runZygote(int socketFd);
+bool sendToZygote(const char *commandText, int outputFd);
+pid_t waitChild(pid_t pid, int *exitMethod, int options, struct rusage *usage);
+int joblogCommand(char **commandLine);
+bool setCapture(const char *jobBudgetText, const char *totalBudgetText);
+bool parseByteSize(const char *text, size_t *size);
+void startJobLog(int jobIndex, pid_t pid, const char *commandLine, int fd);
+int findJobLog(int jobNumber);
+bool jobLogRunning(const struct jobLog *log);
+void drainCaptures();
+void closeJobLog(struct jobLog *log);
+void appendJobLog(struct jobLog *log, const char *data, size_t length);
+bool growJobLog(struct jobLog *log, size_t wanted);
+void freeJobLog(struct jobLog *log);
+
+
+int main(int argc, char *argv[])
 {
     bool runShell = true;
 
-    // main starts an infinite loop to keep user inside shell until exit is called
-    do
-    {
-        printShellPrompt();
-
-    }while(runShell == true);
-}
+    // $$ is the pid of the shell even in the copies it forks, so it is taken before there are any
+    shellPid = getpid();
+    shellPidLength = snprintf(shellPidString, sizeof(shellPidString), "%d", shellPid);
 
-/*************************************************************************************************
-** Name: numArguments
-**
-** Description: Takes a string and counts the number of blank spaces and new lines in order to
-** determine how many arguments the string has. The function subtracts 1 from the total
- * arguments due to the newline character being included in the count.
-**
-** Parameters: string of characters
-**
-** Returns: integer representing number of arguments
-*************************************************************************************************/
+    // read commands from a terminal, a script, -c or the clients of a socket
+    openInput(argc, argv);
 
-int numArguments(const char *userString)
-{
-    int i = 0;
+    // a person at a terminal gets the history of earlier sessions
+    openHistory();
 
-    int totalArguments = 0;
+    // signals are set up once for the whole session
+    setupSignals();
 
-    char blankSpace = ' ';
+    // a shell which owns its terminal hands it to the jobs it runs
+    setupJobControl();
 
-    // check entire string until null character
-    while(blankSpace != '\0')
+    // the zygote has to be forked while the shell is still small
+    const char *zygoteName = getenv("SMALLSH_ZYGOTE");
+    if(zygoteName != NULL && zygoteName[0] != '\0')
     {
-        blankSpace = userString[i];
+        startZygote();
+    }
 
-        // for each blank space or new line increment count for arguments in string
-        if (isspace(blankSpace))
-        {
-            totalArguments++;
-        }
+    // waiting for input and for children happens in one place
+    setupEventLoop();
+
+    // a terminal gets the line editor
+    setupLineEditor();
 
-        i++;
+    // background jobs can be placed from the first command
+    const char *placementName = getenv("SMALLSH_PLACEMENT");
+    if(placementName != NULL && placementName[0] != '\0')
+    {
+        setPlacement(placementName);
     }
 
-    return (totalArguments - 1);
-}
+    // tracing can be on from the first command
+    const char *traceName = getenv("SMALLSH_TRACE");
+    if(traceName != NULL && traceName[0] != '\0')
+    {
+        startTrace(traceName);
+    }
 
-/*************************************************************************************************
-** Name: tokenizeString
-**
-** Description: function takes a string and tokenizes it using space as the delimeter. It then places
-** each token into an array containing strings.
-**
-** Parameters: string representing user input
-**
-** Returns: array of strings
-*************************************************************************************************/
+    // a server runs the command lines its clients send instead of reading any
+    if(serverSocket != NULL)
+    {
+        return serveRequests(serverSocket);
+    }
 
-char** tokenizeString(char *commandLine)
-{
-    // create array of char pointers for all command & arg in string
-    char **userCommands = malloc((MAX_ARGS) * sizeof(char *));
+    // background jobs can have their output kept from the first command
+    const char *captureBudgets = getenv("SMALLSH_JOBLOG");
+    if(captureBudgets != NULL && captureBudgets[0] != '\0')
+    {
+        char *jobBudgetText = strdup(captureBudgets);
+        char *totalBudgetText = strchr(jobBudgetText, ',');
+        if(totalBudgetText != NULL)
+        {
+            *totalBudgetText++ = '\0';
+        }
+        setCapture(strcmp(jobBudgetText, "on") == 0 ? NULL : jobBudgetText, totalBudgetText);
+        free(jobBudgetText);
+    }
 
-    int numTokens = 0;
+    // main starts a loop to keep user inside shell until exit is called or input ends
+    do
+    {
+        runShell = printShellPrompt();
+
+    }while(runShell == true);
 
-    // now populate the array with the tokens
-    userCommands[numTokens++] = strtok(commandLine, " \n");
-    while ((userCommands[numTokens++] = strtok(0, " \n")));
+    // leaving at the end of input works just like exit
+    killBackgroundProcesses();
 
-    return userCommands;
+    return exitValue(childExitMethod);
 }
 
 /*************************************************************************************************
-** Name: builtInFunctions
+** Name: arenaAlloc
 **
-** Description: This function is for the built-in functions of the shell. It checks the tokenized
-** string of the users input and checks if the first token is equal to any of the built-in functions.
-** if so, it calls the appropriate function. Otherwise the function calls a fork and passes the
-** tokenized string to be processed as a child process. It also sends the fork the structs and last
-** token to check for background process requests.
+** Description: This function hands out memory from an arena. Memory comes from the front of the
+** current block, and when it does not fit a new block at least twice as large is put in front. The
+** memory is never freed on its own, only all at once by arenaReset or back to a mark by arenaRollback.
 **
-** Parameters: string user input, last index of the tokenized string, struct for SIGINT, struct
-** for SIGTSTP
+** Parameters: arena to allocate from, number of bytes needed
 **
-** Returns: N/A
+** Returns: pointer to the memory, aligned for any type
 *************************************************************************************************/
 
-void builtInFunctions(char **commandLine, int lastIndex, struct sigaction *terminateFgChild, struct sigaction *ignoreSIGTSTP)
+void* arenaAlloc(struct arena *memoryArena, size_t size)
 {
-    // if user entered exit
-    if(strcmp(commandLine[0], "exit") == 0)
-    {
-        killBackgroundProcesses();
+    // keep everything aligned for any type
+    size = (size + 15) & ~(size_t)15;
 
-        exit(EXIT_SUCCESS);
-    }
-    // if user entered cd
-    else if(strcmp(commandLine[0], "cd") == 0)
-    {
-        changeDirectory(commandLine);
-    }
-    // if user entered status
-    else if(strcmp(commandLine[0], "status") == 0)
-    {
-        // call function to get the status
-        getStatus();
-    }
-    // otherwise create a fork and try running those commands
-    else
+    struct arenaBlock *block = memoryArena->head;
+    if(block == NULL || block->size - block->used < size)
     {
-        createFork(commandLine, lastIndex, terminateFgChild, ignoreSIGTSTP);
+        size_t blockSize = block == NULL ? 65536 : block->size * 2;
+        while(blockSize < size)
+        {
+            blockSize *= 2;
+        }
+
+        block = malloc(sizeof(struct arenaBlock) + blockSize);
+        block->size = blockSize;
+        block->used = 0;
+        block->next = memoryArena->head;
+        memoryArena->head = block;
     }
+
+    void *memory = block->data + block->used;
+    block->used += size;
+
+    return memory;
 }
 
 /*************************************************************************************************
-** Name: getStatus
+** Name: arenaReset
 **
-** Description: This function gets the status of the most recent process. It checks if it was
-** terminated via a signal and if so prints a message stating that and the signal that terminated
-** it. Else if the process ended normally get the exit status and display that with a message.
+** Description: This function releases everything allocated from an arena at once. Only the largest
+** block is kept, emptied, so a shell running similar commands over and over stops calling malloc
+** for them after the first few lines.
 **
-** Parameters: N/A
+** Parameters: arena to reset
 **
 ** Returns: N/A
 *************************************************************************************************/
 
-void getStatus()
+void arenaReset(struct arena *memoryArena)
 {
-    // if the process was terminated by a signal
-    if(WIFSIGNALED(childExitMethod))
+    struct arenaBlock *block = memoryArena->head;
+    if(block == NULL)
     {
-        printf("terminated by signal %d\n", WTERMSIG(childExitMethod));
-        fflush(stdout);
+        return;
     }
-    else // if the process ended normally
+
+    // the newest block is the largest one. free the older ones
+    struct arenaBlock *oldBlock = block->next;
+    while(oldBlock != NULL)
     {
-        // get the exit value of last foreground process
-        printf("exit value %d\n", WEXITSTATUS(childExitMethod));
-        fflush(stdout);
+        struct arenaBlock *nextBlock = oldBlock->next;
+        free(oldBlock);
+        oldBlock = nextBlock;
     }
+
+    block->next = NULL;
+    block->used = 0;
 }
 
 /*************************************************************************************************
-** Name: killBackgroundProcesses
+** Name: arenaMark
 **
-** Description: This function is used to kill any background processes to prepare the shell for
-** exiting. The function looks in the array holding background process PIDs. If it finds any
-** processes in the array it uses a kill command which uses SIGKILL which cannot be caught and
-** has no core dump to completely destroy them for a clean exit.
+** Description: This function marks how far an arena has handed out memory, so what is handed out
+** after it can be given back by arenaRollback without releasing what came before.
 **
-** Parameters: N/A
+** Parameters: arena to mark
 **
-** Returns: N/A
+** Returns: the mark
 *************************************************************************************************/
 
-void killBackgroundProcesses()
+struct arenaMark arenaMark(struct arena *memoryArena)
 {
-    int i;
-
-    // check array of PIDS containing background processes
-    for (i = 0; i < 100; i++)
-    {
-        // if any exits use kill command with SIGKILL to kill them
-        if (pidArray[i] != 0)
-        {
-            kill(pidArray[i], SIGKILL);
-        }
-    }
+    struct arenaMark mark = {memoryArena->head, memoryArena->head == NULL ? 0 : memoryArena->head->used};
+    return mark;
 }
 
 /*************************************************************************************************
-** Name: changeDirectory
+** Name: arenaRollback
 **
-** Description: This function takes the user input which was requesting a cd (change directory)
-** and determines where/if the user can move to using the command. The function takes the second
-** token of the user input string and compares it using conditionals. If the use entered cd with
-** no following arguments, the command is used to change to the user's home directory. If the
-** argument with cd is "." the function does not change the directory. Lastly, if the user enter's
-** anything else, the argument is used to move to the specified directory if it exists. The function
-** checks for bad/inaccessible directory names.
+** Description: This function gives back everything an arena handed out since a mark. Blocks put in
+** front since the mark are freed and the block the mark is in hands out from the mark again.
 **
-** Parameters: string for user input which has been tokenized
+** Parameters: arena to roll back, mark taken by arenaMark
 **
 ** Returns: N/A
 *************************************************************************************************/
 
-void changeDirectory(char **commandLine)
+void arenaRollback(struct arena *memoryArena, struct arenaMark mark)
 {
-    if(commandLine[1] == NULL)
-    {
-        chdir(getenv("HOME"));
-    }
-    else if (strcmp(commandLine[1], ".") == 0)
+    while(memoryArena->head != mark.block)
     {
-        // does nothing
-        return;
+        struct arenaBlock *newerBlock = memoryArena->head;
+        memoryArena->head = newerBlock->next;
+        free(newerBlock);
     }
 
-    // attempt to change into specified directory otherwise generate error
-    else if(chdir(commandLine[1]) != 0)
+    if(memoryArena->head != NULL)
     {
-        perror("\nERROR: The directory you have requested does not exist\n");
-        fflush(stderr);
+        memoryArena->head->used = mark.used;
     }
 }
 
 /*************************************************************************************************
-** Name: createFork
-**
-** Description: This function is used when the user has entered something other than the built-in
-** commands and needs to create a fork to run processes the user has requested. The function first
-** gets the boolean associated with weather or not the user requested a background process to run.
-** The function then assigns a PID to the process using fork() which is then tested for errors in
-** created. If the fork was successful, the function first checks if the process is going to run
-** in the background. If not then the process is a foreground process and the signal for SIGINT
-** is set to allow interruptions with cntrl+c. Next all kids of forked child processes are set to
-** ignore SIGTSTP from cntrl+z. Then the execute function runs. The function then for each background
-** process adds the PID to an array which can be used to check if processes finish or kill them off
-** when the user wants to exit. THe parent is not waiting for any child that is not finished and the
-** background boolean is reset to its original value of false. Otherwise the function track any process
-** in which gets terminated with a signal and reports that signal to the terminal and a message stating
-** that the process has ended. The function also blocks the SIGTSTP sighandler from temporarily executing
-** until the foreground process finishes and unblocks after its completion letting the user switch modes.
+** Name: lexLine
 **
-** SOURCE: code modified after being taken from professor LECTURES 3.1 slide 22 &  3.1 slide 34
+** Description: This function breaks a command line up into tokens in a single pass over the line.
+** Words are separated by blanks and by the operators in lexOperators which become tokens of their
+** own, the longest operator at that point of the line being taken. A single unquoted digit right
+** before a < or > operator is the descriptor it redirects rather than a word. Inside single quotes
+** every character is taken literally. Inside double quotes a backslash only escapes $, `, ", \ and
+** newline. Outside quotes a backslash takes the next character literally. Lexed raw, as a command
+** is before it is parsed, every word is kept as it was written, quotes, parameters and
+** substitutions included, a newline is an operator which ends a command like ; and a # at the start
+** of a word begins a comment which runs to the end of the line. Each word is then expanded by
+** lexing it on its own every time its command runs. Expanding, quotes and escaping backslashes are
+** removed from the words, so a quoted operator is just a word. An unquoted ~ which is the whole
+** word or is followed by a / is replaced by the value of HOME. A $ outside single quotes is
+** expanded by variableExpansion as the word is built, so expansion is part of the same forward
+** pass. A $(command) or `command` outside single quotes is replaced by the output of the command
+** from commandSubstitution. Inside double quotes the output becomes part of the word as it is,
+** outside quotes the white space of IFS in it separates words the same way blanks in the line do,
+** unless the word is not to be split, and so does the white space in the value of a parameter
+** outside double quotes. Other characters of IFS do not separate words. $@, and $* outside quotes,
+** make every positional parameter a word of its own, which outside quotes is split further. An unquoted word which expands to nothing is
+** dropped, and so is a "$@" without any parameters. Each word is built in the growable word
+** buffer, since expansion can make it longer than the line, and copied into the arena once it is
+** complete.
 **
-** Parameters: string for user input, last index of tokenized input, structs for SIGINT and SIGTSTP
+** Parameters: line entered by the user, arena to allocate the tokens from, pointer which is set to
+** the array of tokens, whether the words are kept raw, expanded, or expanded without being split
 **
-** Returns: N/A
+** Returns: number of tokens or -1 if the line has an unterminated quote or bad substitution. Lexed
+** raw, a line which ends inside a quote or substitution or with a backslash is not an error, it just
+** goes on in the next line, so -1 is returned quietly with lexIncomplete set
 *************************************************************************************************/
 
-void createFork(char **commandLine, int lastIndex, struct sigaction *terminateFgChild, struct sigaction *ignoreSIGTSTP)
+int lexLine(const char *lineEntered, struct arena *lineArena, struct token **tokens, enum lexMode mode)
 {
-    pid_t spawnPid = -5;
-
-    bool isBackground = false;
-
-    // save whether user requested process to run in background
-    isBackground = isBackgroundProcess(commandLine, lastIndex);
-
-    // change signal mask of currently blocked signals
-    sigset_t sigtStpMask;
-    sigemptyset(&sigtStpMask);
-    // adding SIGTSTP to the set
-    sigaddset(&sigtStpMask, SIGTSTP);
+    size_t lineLength = strlen(lineEntered);
+
+    // there can never be more tokens than characters, unless a command substitution or $@ adds words
+    size_t tokenCapacity = lineLength + 1;
+    struct token *tokenList = arenaAlloc(lineArena, tokenCapacity * sizeof(struct token));
+    bool inWord = false;
+    bool wordQuoted = false;
+    const char *wordStart = NULL;
+    int numTokens = 0;
+    char quote = '\0';
 
-    spawnPid = fork();
+    // fields are split on the white space of IFS, which is a blank, tab and newline when it is not set
+    const char *fieldSeparators = variableValue("IFS", 3);
+    if(fieldSeparators == NULL)
+    {
+        fieldSeparators = " \t\n";
+    }
 
+    wordBuffer.length = 0;
+    lexIncomplete = false;
 
-    switch (spawnPid)
+    const char *currChar = lineEntered;
+    while(*currChar != '\0')
     {
-        // if an error occurred
-        case -1:
+        // everything inside single quotes is literal
+        if(quote == '\'')
         {
-            perror("ERROR: Unable to create fork\n");
-            fflush(stderr);
-            exit(1);
-        }
-
-        // fork was successful child is created
-        case 0:
-        {
-            // if child spawned is foreground allow termination
-            if(isBackground == false)
+            if(*currChar == '\'')
             {
-                sigaction(SIGINT, terminateFgChild, NULL);
+                quote = '\0';
             }
-
-            // child processes ignore SIGTSTP
-            sigaction(SIGTSTP, ignoreSIGTSTP, NULL);
-
-            // call function to execute commands
-            executeCommand(commandLine, isBackground);
+            else
+            {
+                bufferAppendChar(&wordBuffer, *currChar);
+            }
+            currChar++;
+            continue;
         }
 
-        // parent process
-        default:
+        // command substitutions are replaced by the output of their command, and outside double quotes
+        // parameters are expanded the same way so their values are split into fields like the output is
+        bool isSubstitution = (*currChar == '$' && currChar[1] == '(') || *currChar == '`';
+        bool isSplitParameter = *currChar == '$' && mode == LEX_EXPAND && quote != '"' &&
+                                ((currChar[1] != '@' && currChar[1] != '*') || strpbrk(fieldSeparators, " \t\n") != NULL);
+        if(isSubstitution == true || isSplitParameter == true)
         {
-            // if the process is a background process
-            if(isBackground == true)
+            // a raw word keeps the substitution, which is run every time the word is expanded
+            if(mode == LEX_RAW)
             {
-                printf("background pid is %d\n", spawnPid);
-
-                // add the pid to an array and dont let the parent wait (unless child finished)
-                pidArray[pidIndex++] = spawnPid;
-
-                waitpid(spawnPid, &childExitMethod, WNOHANG);
+                const char *substitutionLast = substitutionEnd(currChar);
+                if(substitutionLast == NULL)
+                {
+                    lexIncomplete = true;
+                    return -1;
+                }
+                if(inWord == false)
+                {
+                    inWord = true;
+                    wordQuoted = false;
+                    wordStart = currChar;
+                }
+                currChar = substitutionLast + 1;
+                continue;
+            }
 
-                isBackground = false;
+            size_t numUsed;
+            if(isSubstitution == true)
+            {
+                numUsed = commandSubstitution(currChar, &substitutionOutput);
+            }
+            else if(currChar[1] == '@' || currChar[1] == '*')
+            {
+                // every parameter is a field of its own before each of them is split further
+                char separator = *strpbrk(fieldSeparators, " \t\n");
+                substitutionOutput.length = 0;
+                int i;
+                for(i = 0; i < numPositional; i++)
+                {
+                    if(i > 0)
+                    {
+                        bufferAppendChar(&substitutionOutput, separator);
+                    }
+                    bufferAppend(&substitutionOutput, positionalParams[i], strlen(positionalParams[i]));
+                }
+                numUsed = 2;
             }
             else
             {
-                // block the SIGTSTP signal and check for errors in block attempt
-                if(sigprocmask(SIG_BLOCK, &sigtStpMask, NULL) < 0)
+                substitutionOutput.length = 0;
+                numUsed = variableExpansion(currChar, &substitutionOutput);
+            }
+            if(numUsed == 0)
+            {
+                return -1;
+            }
+            const char *substitutionStart = currChar;
+            currChar += numUsed;
+
+            // inside double quotes, or in a word which is not split, the output is part of the word as it is
+            if(quote == '"' || mode == LEX_EXPAND_UNSPLIT)
+            {
+                if(inWord == false)
+                {
+                    inWord = true;
+                    wordQuoted = false;
+                    wordStart = substitutionStart;
+                    wordBuffer.length = 0;
+                }
+                bufferAppend(&wordBuffer, substitutionOutput.data, substitutionOutput.length);
+                continue;
+            }
+
+            // outside quotes every run of field separators in the output separates words. make room
+            // for them along with the tokens the rest of the line can still make
+            size_t numFields = 0;
+            size_t i;
+            for(i = 0; i < substitutionOutput.length; i++)
+            {
+                if(isFieldSeparator(substitutionOutput.data[i], fieldSeparators) == false &&
+                   (i == 0 || isFieldSeparator(substitutionOutput.data[i - 1], fieldSeparators) == true))
                 {
-                    perror("ERROR: Blocking SIGTSTP has failed!");
-                    fflush(stderr);
-                    exit(1);
+                    numFields++;
                 }
+            }
 
-                // block this parent until specified child process terminates for foreground processes
-                if(waitpid(spawnPid, &childExitMethod, 0) > 0)
+            size_t tokensNeeded = numTokens + numFields + (lineLength - (currChar - lineEntered)) + 1;
+            if(tokensNeeded > tokenCapacity)
+            {
+                struct token *largerList = arenaAlloc(lineArena, tokensNeeded * sizeof(struct token));
+                memcpy(largerList, tokenList, numTokens * sizeof(struct token));
+                tokenList = largerList;
+                tokenCapacity = tokensNeeded;
+            }
+
+            i = 0;
+            while(i < substitutionOutput.length)
+            {
+                if(isFieldSeparator(substitutionOutput.data[i], fieldSeparators) == true)
                 {
-                    // unblock the SIGTSTP signal and check for errors
-                    if(sigprocmask(SIG_UNBLOCK, &sigtStpMask, NULL) < 0)
+                    if(inWord == true)
                     {
-                        perror("ERROR: Unblocking SIGTSTP has failed!");
-                        fflush(stderr);
-                        exit(1);
+                        tokenList[numTokens].type = TOKEN_WORD;
+                        tokenList[numTokens].quoted = wordQuoted;
+                        tokenList[numTokens].start = wordStart - lineEntered;
+                        tokenList[numTokens].end = currChar - lineEntered;
+                        tokenList[numTokens++].text = bufferToArena(&wordBuffer, lineArena);
+                        inWord = false;
                     }
+                    i++;
+                    continue;
+                }
 
-                    // if process ended via signal display message with termination value
-                    if(WIFSIGNALED(childExitMethod))
-                    {
-                        printf("terminated by signal %d\n", WTERMSIG(childExitMethod));
-                        fflush(stdout);
-                    }
+                if(inWord == false)
+                {
+                    inWord = true;
+                    wordQuoted = false;
+                    wordStart = substitutionStart;
+                    wordBuffer.length = 0;
+                }
+
+                // copy the whole run up to the next separator at once
+                size_t runStart = i;
+                while(i < substitutionOutput.length && isFieldSeparator(substitutionOutput.data[i], fieldSeparators) == false)
+                {
+                    i++;
                 }
+                bufferAppend(&wordBuffer, substitutionOutput.data + runStart, i - runStart);
             }
+            continue;
         }
-    }
-}
 
-/*************************************************************************************************
-** Name: executeCommand
-**
-** Description: This function simply calls helper functions for I/O handling, calling execvp
-** to run the command entered and its arguments, and a function which handles the situation for
-** execvp not running due to bad command entry.
-**
-** Parameters: string for user input, boolean value determining if process runs in background
-**
-** Returns: N/A
-*************************************************************************************************/
+        // $@ makes every positional parameter a word of its own, and so does $* outside quotes
+        if(*currChar == '$' && mode == LEX_EXPAND && (currChar[1] == '@' || (currChar[1] == '*' && quote != '"')))
+        {
+            size_t tokensNeeded = numTokens + numPositional + (lineLength - (currChar - lineEntered)) + 1;
+            if(tokensNeeded > tokenCapacity)
+            {
+                struct token *largerList = arenaAlloc(lineArena, tokensNeeded * sizeof(struct token));
+                memcpy(largerList, tokenList, numTokens * sizeof(struct token));
+                tokenList = largerList;
+                tokenCapacity = tokensNeeded;
+            }
 
-void executeCommand(char **commandLine, bool runBackground)
-{
-    // check and process any redirection entered as commands
-    ioRedirect(commandLine, runBackground);
+            // a word which is nothing but "$@" goes away along with the parameters when there are none
+            if(numPositional == 0 && quote == '"' && inWord == true && wordBuffer.length == 0 && wordStart == currChar - 1 &&
+               currChar[2] == '"' && (currChar[3] == '\0' || isspace((unsigned char)currChar[3]) || strchr("<>|&;()", currChar[3]) != NULL))
+            {
+                wordQuoted = false;
+            }
 
-    // call exec to start processing command and arguments
-    execvp(commandLine[0], commandLine);
+            int i;
+            for(i = 0; i < numPositional; i++)
+            {
+                if(i > 0)
+                {
+                    tokenList[numTokens].type = TOKEN_WORD;
+                    tokenList[numTokens].quoted = wordQuoted;
+                    tokenList[numTokens].start = wordStart - lineEntered;
+                    tokenList[numTokens].end = currChar - lineEntered;
+                    tokenList[numTokens++].text = bufferToArena(&wordBuffer, lineArena);
+                    inWord = false;
+                }
 
-    // this code only reached if exec has failed. will exit and output error
-    execError();
-}
+                // every parameter of "$@" is a quoted word, so an empty one is kept
+                if(inWord == false)
+                {
+                    inWord = true;
+                    wordQuoted = quote == '"';
+                    wordStart = currChar;
+                    wordBuffer.length = 0;
+                }
+                bufferAppend(&wordBuffer, positionalParams[i], strlen(positionalParams[i]));
+            }
+            currChar += 2;
+            continue;
+        }
 
-/*************************************************************************************************
-** Name: ioRedirect
-**
-** Description: This function handles redirection of the commands. The function pre-emptively sets
-** input and output redirection to /dev/null with input and output permissions set respectively.
-** The function then loops through the tokens which is the user's input broken down into an array of
-** strings and checks for > and <. If these commands are found, the function sets opens the appropriate
-** input or output file with the relevant permissions and used dup2 to create copies of the pertinent
-** file descriptors to be passed to execvp. The functions also have error handling for files which
-** cannot be opened. The redirection symbols are also set to null so that they are not passed on to
-** execvp for processing. Lastly the re-directions symbols are set to NULL so that they are not
-** processed by execvp.
-**
-** SOURCE code modified from professors code in LECTURE 3.4 slide 12
-**
-** Parameters: tokenized string of user's input, boolean indicating if background process
-**
-** Returns: N/A
+        // parameters are expanded everywhere else, unless the word is kept raw
+        if(*currChar == '$' && mode != LEX_RAW)
+        {
+            if(inWord == false)
+            {
+                inWord = true;
+                wordQuoted = false;
+                wordStart = currChar;
+                wordBuffer.length = 0;
+            }
+
+            size_t numUsed = variableExpansion(currChar, &wordBuffer);
+            if(numUsed == 0)
+            {
+                return -1;
+            }
+            currChar += numUsed;
+            continue;
+        }
+
+        // inside double quotes only a few characters can be escaped
+        if(quote == '"')
+        {
+            if(*currChar == '"')
+            {
+                quote = '\0';
+            }
+            else if(*currChar == '\\' && currChar[1] != '\0' && strchr("$`\"\\\n", currChar[1]) != NULL)
+            {
+                bufferAppendChar(&wordBuffer, *++currChar);
+            }
+            else
+            {
+                bufferAppendChar(&wordBuffer, *currChar);
+            }
+            currChar++;
+            continue;
+        }
+
+        // a blank or an operator ends the word being built. lexed raw a newline is an operator
+        bool isBlank = isspace((unsigned char)*currChar) && (*currChar != '\n' || mode != LEX_RAW);
+        if(isBlank == true || strchr("<>|&;()\n", *currChar) != NULL)
+        {
+            // a lone digit written against a redirection is the descriptor it redirects
+            int ioNumber = -1;
+            const char *operatorStart = currChar;
+            if(inWord == true && wordQuoted == false && currChar - wordStart == 1 && isdigit((unsigned char)*wordStart) && strchr("<>", *currChar) != NULL)
+            {
+                ioNumber = *wordStart - '0';
+                operatorStart = wordStart;
+                inWord = false;
+            }
+
+            if(inWord == true)
+            {
+                if(mode == LEX_RAW)
+                {
+                    wordBuffer.length = 0;
+                    bufferAppend(&wordBuffer, wordStart, currChar - wordStart);
+                }
+                tokenList[numTokens].type = TOKEN_WORD;
+                tokenList[numTokens].quoted = wordQuoted;
+                tokenList[numTokens].start = wordStart - lineEntered;
+                tokenList[numTokens].end = currChar - lineEntered;
+                tokenList[numTokens++].text = bufferToArena(&wordBuffer, lineArena);
+                inWord = false;
+            }
+
+            if(isBlank == true)
+            {
+                currChar++;
+                continue;
+            }
+
+            // take the longest operator starting here
+            const struct lexOperator *lineOperator = lexOperators;
+            while(strncmp(currChar, lineOperator->text, strlen(lineOperator->text)) != 0)
+            {
+                lineOperator++;
+            }
+            currChar += strlen(lineOperator->text);
+
+            tokenList[numTokens].type = lineOperator->type;
+            tokenList[numTokens].text = (char *)lineOperator->text;
+            tokenList[numTokens].quoted = false;
+            tokenList[numTokens].start = operatorStart - lineEntered;
+            tokenList[numTokens].end = currChar - lineEntered;
+            tokenList[numTokens++].ioNumber = ioNumber;
+            continue;
+        }
+
+        // a comment runs to the end of the line
+        if(*currChar == '#' && inWord == false && mode == LEX_RAW)
+        {
+            currChar += strcspn(currChar, "\n");
+            continue;
+        }
+
+        // an escaped newline between words just joins the lines
+        if(*currChar == '\\' && currChar[1] == '\n' && inWord == false)
+        {
+            currChar += 2;
+            continue;
+        }
+
+        // anything else is part of a word, even an empty pair of quotes
+        if(inWord == false)
+        {
+            inWord = true;
+            wordQuoted = false;
+            wordStart = currChar;
+            wordBuffer.length = 0;
+        }
+
+        // an unquoted ~ alone or before a / at the start of a word is the home directory
+        bool isTilde = *currChar == '~' && mode != LEX_RAW && currChar == wordStart &&
+                       (currChar[1] == '\0' || currChar[1] == '/' || isspace((unsigned char)currChar[1]) || strchr("<>|&;()", currChar[1]) != NULL);
+        const char *homeDirectory = isTilde == true ? variableValue("HOME", 4) : NULL;
+
+        if(*currChar == '\'' || *currChar == '"')
+        {
+            quote = *currChar;
+            wordQuoted = true;
+        }
+        else if(homeDirectory != NULL)
+        {
+            bufferAppend(&wordBuffer, homeDirectory, strlen(homeDirectory));
+        }
+        else if(*currChar == '\\')
+        {
+            wordQuoted = true;
+            // an escaped newline just joins the lines
+            currChar++;
+            if(*currChar == '\0')
+            {
+                // lexed raw the line goes on in the next one
+                if(mode == LEX_RAW)
+                {
+                    lexIncomplete = true;
+                    return -1;
+                }
+                break;
+            }
+            if(*currChar != '\n')
+            {
+                bufferAppendChar(&wordBuffer, *currChar);
+            }
+        }
+        else
+        {
+            bufferAppendChar(&wordBuffer, *currChar);
+        }
+        currChar++;
+    }
+
+    if(quote != '\0' && mode == LEX_RAW)
+    {
+        lexIncomplete = true;
+        return -1;
+    }
+    if(quote != '\0')
+    {
+        fprintf(stderr, "ERROR: unterminated %c quote\n", quote);
+        fflush(stderr);
+        return -1;
+    }
+
+    if(inWord == true)
+    {
+        if(mode == LEX_RAW)
+        {
+            wordBuffer.length = 0;
+            bufferAppend(&wordBuffer, wordStart, currChar - wordStart);
+        }
+        tokenList[numTokens].type = TOKEN_WORD;
+        tokenList[numTokens].quoted = wordQuoted;
+        tokenList[numTokens].start = wordStart - lineEntered;
+        tokenList[numTokens].end = currChar - lineEntered;
+        tokenList[numTokens++].text = bufferToArena(&wordBuffer, lineArena);
+    }
+
+    // an unquoted word which expanded to nothing is no word at all
+    if(mode == LEX_EXPAND)
+    {
+        int numKept = 0;
+        int i;
+        for(i = 0; i < numTokens; i++)
+        {
+            if(tokenList[i].type != TOKEN_WORD || tokenList[i].quoted == true || tokenList[i].text[0] != '\0')
+            {
+                tokenList[numKept++] = tokenList[i];
+            }
+        }
+        numTokens = numKept;
+    }
+
+    *tokens = tokenList;
+    return numTokens;
+}
+
+/*************************************************************************************************
+** Name: isFieldSeparator
+**
+** Description: This function checks if a character of an unquoted expansion separates fields. Only
+** the white space characters of IFS do, so an IFS without any leaves expansions unsplit.
+**
+** Parameters: character, value of IFS
+**
+** Returns: true if the character separates fields
+*************************************************************************************************/
+
+bool isFieldSeparator(char character, const char *fieldSeparators)
+{
+    return character != '\0' && isspace((unsigned char)character) && strchr(fieldSeparators, character) != NULL;
+}
+
+/*************************************************************************************************
+** Name: parsePipeline
+**
+** Description: This function turns the tokens of one pipeline of a command into a pipeline. Whether
+** it runs in the background is up to the & after it, which parseList takes care of. Every
+** redirection operator takes the word after it as its file or descriptor along with the descriptor
+** written before it, if any. A << takes the word after it as the delimiter of a here-document whose
+** body is read by readHereDocuments, and a <<< takes the word after it as the text of a here-string.
+** A leading time word asks for the resources used by the rest of the line to be reported and is not
+** part of the command. Every | starts a new stage. Words make up the argument list of their stage,
+** so none of the operators ever reach the command. A stage without a command or an operator without
+** a file is a syntax error.
+**
+** Parameters: tokens of the line, number of tokens, arena to allocate from, text of the line, pipeline
+** to fill in
+**
+** Returns: true if the line was a valid pipeline, false otherwise
+*************************************************************************************************/
+
+bool parsePipeline(struct token *tokens, int numTokens, struct arena *lineArena, char *lineText, struct pipeline *commandPipeline)
+{
+    commandPipeline->background = false;
+    commandPipeline->text = lineText;
+
+    // time on its own is left to run as a command
+    commandPipeline->timed = false;
+    if(numTokens > 1 && tokens[0].type == TOKEN_WORD && strcmp(tokens[0].text, "time") == 0)
+    {
+        commandPipeline->timed = true;
+        tokens++;
+        numTokens--;
+    }
+
+    // every token is at most one argument or redirection and every stage needs a NULL at the end
+    commandPipeline->stages = arenaAlloc(lineArena, (numTokens + 1) * sizeof(struct commandStage));
+    char **argvPool = arenaAlloc(lineArena, (2 * numTokens + 1) * sizeof(char *));
+    struct redirection *redirectionPool = arenaAlloc(lineArena, (numTokens + 1) * sizeof(struct redirection));
+
+    struct commandStage *stage = &commandPipeline->stages[0];
+    commandPipeline->numStages = 1;
+    stage->argv = argvPool;
+    stage->argc = 0;
+    stage->redirections = redirectionPool;
+    stage->numRedirections = 0;
+    stage->assignments = NULL;
+    stage->numAssignments = 0;
+
+    const char *badToken = NULL;
+
+    int i;
+    for(i = 0; i < numTokens && badToken == NULL; i++)
+    {
+        switch(tokens[i].type)
+        {
+            case TOKEN_WORD:
+                stage->argv[stage->argc++] = tokens[i].text;
+                break;
+
+            case TOKEN_PIPE:
+                if(stage->argc == 0)
+                {
+                    badToken = "|";
+                    break;
+                }
+
+                // finish this stage and start the next one after it
+                stage->argv[stage->argc] = NULL;
+                argvPool = &stage->argv[stage->argc + 1];
+                redirectionPool = &stage->redirections[stage->numRedirections];
+
+                stage = &commandPipeline->stages[commandPipeline->numStages++];
+                stage->argv = argvPool;
+                stage->argc = 0;
+                stage->redirections = redirectionPool;
+                stage->numRedirections = 0;
+                stage->assignments = NULL;
+                stage->numAssignments = 0;
+                break;
+
+            default:
+                // the file name has to follow the redirection
+                if(i + 1 >= numTokens || tokens[i + 1].type != TOKEN_WORD)
+                {
+                    badToken = i + 1 < numTokens ? tokens[i + 1].text : "newline";
+                    break;
+                }
+
+                struct redirection *newRedirection = &stage->redirections[stage->numRedirections++];
+                newRedirection->type = tokens[i].type;
+                newRedirection->fd = tokens[i].ioNumber;
+                newRedirection->quoted = tokens[i + 1].quoted;
+                newRedirection->target = tokens[++i].text;
+                break;
+        }
+    }
+
+    if(badToken == NULL && stage->argc == 0)
+    {
+        badToken = commandPipeline->numStages > 1 ? "|" : "newline";
+    }
+
+    if(badToken != NULL)
+    {
+        fprintf(stderr, "ERROR: syntax error near unexpected token '%s'\n", badToken);
+        fflush(stderr);
+        childExitMethod = W_EXITCODE(1, 0);
+        return false;
+    }
+
+    stage->argv[stage->argc] = NULL;
+
+    return true;
+}
+
+/*************************************************************************************************
+** Name: builtInFunctions
+**
+** Description: This function is for the built-in functions of the shell. It checks the parsed
+** command line of the users input and checks if its command is equal to any of the built-in
+** functions. if so, it calls the appropriate function. Built-ins only run in the shell on their
+** own, a pipeline runs them in copies of the shell. Otherwise the function calls createFork and
+** passes the pipeline to be processed as child processes. It also sends createFork the structs used
+** for the signal setup of the children. A built in the shell runs has its redirections applied to
+** the shell for as long as it runs. A timed built in is measured by the wall time it took and the
+** resources the shell itself used while running it.
+**
+** Parameters: parsed command line of the user, struct for SIGINT, struct for SIGTSTP
+**
+** Returns: N/A
+*************************************************************************************************/
+
+void builtInFunctions(struct pipeline *commandPipeline, struct sigaction *terminateFgChild, struct sigaction *ignoreSIGTSTP)
+{
+    char **commandLine = commandPipeline->stages[0].argv;
+    bool isBuiltIn = true;
+
+    // the other built ins run in the shell have their redirections applied to it while they run, the
+    // same way the fast ones do
+    struct savedDescriptors saved;
+    bool isRedirected = false;
+    if(commandPipeline->numStages == 1 && commandPipeline->stages[0].numRedirections > 0 &&
+       isFastBuiltIn(commandLine[0]) == false && strcmp(commandLine[0], "parallel") != 0 &&
+       findFunction(commandLine[0]) == -1 && runsInShell(commandLine[0]) == true)
+    {
+        if(redirectBuiltIn(&commandPipeline->stages[0], &saved) == false)
+        {
+            restoreBuiltIn(&saved);
+            childExitMethod = W_EXITCODE(1, 0);
+            return;
+        }
+        isRedirected = true;
+    }
+
+    // a timed built in is measured from here
+    struct timespec startTime;
+    struct rusage startUsage;
+    if(commandPipeline->timed == true)
+    {
+        clock_gettime(CLOCK_MONOTONIC, &startTime);
+        getrusage(RUSAGE_SELF, &startUsage);
+    }
+
+    // pipelines are always run as child processes
+    if(commandPipeline->numStages > 1)
+    {
+        isBuiltIn = false;
+        createFork(commandPipeline, terminateFgChild, ignoreSIGTSTP);
+    }
+    // if user entered exit
+    else if(strcmp(commandLine[0], "exit") == 0)
+    {
+        exitShell(commandLine);
+    }
+    // if user entered cd
+    else if(strcmp(commandLine[0], "cd") == 0)
+    {
+        changeDirectory(commandLine);
+    }
+    // if user entered status
+    else if(strcmp(commandLine[0], "status") == 0)
+    {
+        // call function to get the status
+        getStatus(commandLine);
+    }
+    // if user entered hash
+    else if(strcmp(commandLine[0], "hash") == 0)
+    {
+        hashCommands(commandLine);
+    }
+    // if user entered jobs
+    else if(strcmp(commandLine[0], "jobs") == 0)
+    {
+        listJobs(commandLine);
+    }
+    // if user entered export
+    else if(strcmp(commandLine[0], "export") == 0)
+    {
+        childExitMethod = W_EXITCODE(exportCommand(commandLine), 0);
+    }
+    // if user entered wait
+    else if(strcmp(commandLine[0], "wait") == 0)
+    {
+        childExitMethod = W_EXITCODE(waitCommand(commandLine), 0);
+    }
+    // if user entered fg. the job sets the status once it is done
+    else if(strcmp(commandLine[0], "fg") == 0)
+    {
+        isBuiltIn = false;
+        int fgResult = foregroundCommand(commandLine);
+        if(fgResult != 0)
+        {
+            childExitMethod = W_EXITCODE(fgResult, 0);
+        }
+    }
+    // if user entered bg
+    else if(strcmp(commandLine[0], "bg") == 0)
+    {
+        childExitMethod = W_EXITCODE(backgroundCommand(commandLine), 0);
+    }
+    // if user entered trace
+    else if(strcmp(commandLine[0], "trace") == 0)
+    {
+        childExitMethod = W_EXITCODE(traceCommand(commandLine), 0);
+    }
+    // if user entered setaffinity
+    else if(strcmp(commandLine[0], "setaffinity") == 0)
+    {
+        childExitMethod = W_EXITCODE(setaffinityCommand(commandLine), 0);
+    }
+    // utilities quick enough to run in the shell itself. in the background they are still children
+    else if(isFastBuiltIn(commandLine[0]) == true && isBackgroundProcess(commandPipeline) == false)
+    {
+        runFastBuiltIn(&commandPipeline->stages[0]);
+    }
+    // if user entered parallel
+    else if(strcmp(commandLine[0], "parallel") == 0)
+    {
+        isBuiltIn = false;
+        parallelCommand(&commandPipeline->stages[0], terminateFgChild, ignoreSIGTSTP);
+
+        if(commandPipeline->timed == true)
+        {
+            printUsage(&lastWallTime, &lastUsage);
+        }
+    }
+    // otherwise create a fork and try running those commands
+    else
+    {
+        isBuiltIn = false;
+        createFork(commandPipeline, terminateFgChild, ignoreSIGTSTP);
+    }
+
+    if(isRedirected == true)
+    {
+        restoreBuiltIn(&saved);
+    }
+
+    // commands run as children are reported on by createFork
+    if(commandPipeline->timed == true && isBuiltIn == true)
+    {
+        struct timespec wallTime;
+        struct rusage usage;
+        elapsedSince(&startTime, &wallTime);
+        getrusage(RUSAGE_SELF, &usage);
+        usageSince(&startUsage, &usage);
+        printUsage(&wallTime, &usage);
+    }
+}
+
+/*************************************************************************************************
+** Name: getStatus
+**
+** Description: This function gets the status of the most recent process. It checks if it was
+** terminated via a signal and if so prints a message stating that and the signal that terminated
+** it. Else if the process ended normally get the exit status and display that with a message.
+** When the most recent foreground command was a pipeline the status above is the one of its last
+** stage, and a line is added for every stage of the pipeline showing how it ended. With -v the wall
+** time, CPU time, memory and context switches used by the most recent foreground command are shown
+** as well.
+**
+** Parameters: string for user input which has been tokenized
+**
+** Returns: N/A
+*************************************************************************************************/
+
+void getStatus(char **commandLine)
+{
+    // if the process was terminated by a signal
+    if(WIFSIGNALED(childExitMethod))
+    {
+        printf("terminated by signal %d\n", WTERMSIG(childExitMethod));
+        fflush(stdout);
+    }
+    else // if the process ended normally
+    {
+        // get the exit value of last foreground process
+        printf("exit value %d\n", WEXITSTATUS(childExitMethod));
+        fflush(stdout);
+    }
+
+    // a pipeline also reports how each of its stages ended
+    if(numPipeStages > 1)
+    {
+        int i;
+        for(i = 0; i < numPipeStages; i++)
+        {
+            if(WIFSIGNALED(pipeStatus[i]))
+            {
+                printf("pipeline stage %d: terminated by signal %d\n", i + 1, WTERMSIG(pipeStatus[i]));
+            }
+            else
+            {
+                printf("pipeline stage %d: exit value %d\n", i + 1, WEXITSTATUS(pipeStatus[i]));
+            }
+        }
+        fflush(stdout);
+    }
+
+    // the resources are only known once a foreground command has run
+    if(commandLine[1] != NULL && strcmp(commandLine[1], "-v") == 0 && lastUsageKnown == true)
+    {
+        printUsage(&lastWallTime, &lastUsage);
+    }
+}
+
+/*************************************************************************************************
+** Name: killBackgroundProcesses
+**
+** Description: This function is used to kill any background processes to prepare the shell for
+** exiting. The function walks the list of running jobs in the job table and for every process of
+** those jobs uses a kill command which uses SIGKILL which cannot be caught and has no core dump to
+** completely destroy them for a clean exit. Only running jobs are visited, never the free slots.
+**
+** Parameters: N/A
+**
+** Returns: N/A
+*************************************************************************************************/
+
+void killBackgroundProcesses()
+{
+    int jobIndex;
+
+    // check every running job
+    for(jobIndex = jobTable.liveHead; jobIndex != -1; jobIndex = jobTable.jobs[jobIndex].next)
+    {
+        struct job *runningJob = &jobTable.jobs[jobIndex];
+
+        // use kill command with SIGKILL on every process of the job
+        int i;
+        for(i = 0; i < runningJob->numPids; i++)
+        {
+            kill(runningJob->pids[i], SIGKILL);
+        }
+    }
+}
+
+/*************************************************************************************************
+** Name: listJobs
+**
+** Description: This function lists the background jobs which are still running or stopped, in the
+** order of their job numbers. A job number is one more than the slot of the job in the job table. With -l
+** the PID of every process of a job is shown along with how long the job has been running and the
+** resources used by the processes of the job which have already finished.
+**
+** Parameters: string for user input which has been tokenized
+**
+** Returns: N/A
+*************************************************************************************************/
+
+void listJobs(char **commandLine)
+{
+    bool longListing = commandLine[1] != NULL && strcmp(commandLine[1], "-l") == 0;
+
+    // finished jobs are reported first so only running and stopped ones are listed
+    if(drainSignalFd() == true)
+    {
+        checkBackgroundStatus();
+    }
+
+    int jobIndex;
+    for(jobIndex = 0; jobIndex < jobTable.capacity; jobIndex++)
+    {
+        struct job *runningJob = &jobTable.jobs[jobIndex];
+        if(runningJob->state != JOB_RUNNING && runningJob->state != JOB_STOPPED)
+        {
+            continue;
+        }
+
+        const char *stateName = runningJob->state == JOB_STOPPED ? "Stopped" : "Running";
+        if(longListing == false)
+        {
+            printf("[%d] %s\t%s\n", jobIndex + 1, stateName, runningJob->commandLine);
+            continue;
+        }
+
+        struct timespec wallTime;
+        elapsedSince(&runningJob->startTime, &wallTime);
+
+        printf("[%d]", jobIndex + 1);
+        int i;
+        for(i = 0; i < runningJob->numPids; i++)
+        {
+            printf(" %d", runningJob->pids[i]);
+        }
+        printf(" %s\t%s\n", stateName, runningJob->commandLine);
+        printf("    real %ld.%03lds, %d of %d processes done: user %ld.%03lds sys %ld.%03lds maxrss %ld KB ctxsw %ld/%ld\n",
+               (long)wallTime.tv_sec, wallTime.tv_nsec / 1000000L,
+               runningJob->numPids - runningJob->numLive, runningJob->numPids,
+               (long)runningJob->usage.ru_utime.tv_sec, (long)runningJob->usage.ru_utime.tv_usec / 1000L,
+               (long)runningJob->usage.ru_stime.tv_sec, (long)runningJob->usage.ru_stime.tv_usec / 1000L,
+               runningJob->usage.ru_maxrss, runningJob->usage.ru_nvcsw, runningJob->usage.ru_nivcsw);
+    }
+    fflush(stdout);
+}
+
+/*************************************************************************************************
+** Name: exitShell
+**
+** Description: This function is for the built in exit. The background processes are killed off and
+** the shell leaves with the exit value it was given, which is taken modulo 256, or with the exit
+** value of the last command when it was given none. An exit value which is not a number, or more
+** than one of them, is an error and the shell stays.
+**
+** Parameters: string for user input which has been tokenized
+**
+** Returns: N/A, unless the arguments are wrong
+*************************************************************************************************/
+
+void exitShell(char **commandLine)
+{
+    int exitStatus = exitValue(childExitMethod);
+
+    if(commandLine[1] != NULL)
+    {
+        if(commandLine[2] != NULL)
+        {
+            fprintf(stderr, "ERROR: exit: too many arguments\n");
+            fflush(stderr);
+            childExitMethod = W_EXITCODE(1, 0);
+            return;
+        }
+
+        if(commandLine[1][0] == '\0' || commandLine[1][strspn(commandLine[1], "0123456789")] != '\0')
+        {
+            fprintf(stderr, "ERROR: exit: %s: a number is required\n", commandLine[1]);
+            fflush(stderr);
+            childExitMethod = W_EXITCODE(2, 0);
+            return;
+        }
+
+        exitStatus = (int)(strtoul(commandLine[1], NULL, 10) & 0xff);
+    }
+
+    killBackgroundProcesses();
+
+    exit(exitStatus);
+}
+
+/*************************************************************************************************
+** Name: changeDirectory
+**
+** Description: This function takes the user input which was requesting a cd (change directory)
+** and determines where/if the user can move to using the command. The function takes the second
+** token of the user input string and compares it using conditionals. If the use entered cd with
+** no following arguments, the command is used to change to the user's home directory. If the
+** argument with cd is "." the function does not change the directory. Lastly, if the user enter's
+** anything else, the argument is used to move to the specified directory if it exists. The function
+** checks for bad/inaccessible directory names, and the status of the command is 1 when the directory
+** could not be changed and 0 otherwise.
+**
+** Parameters: string for user input which has been tokenized
+**
+** Returns: N/A
+*************************************************************************************************/
+
+void changeDirectory(char **commandLine)
+{
+    const char *directory = commandLine[1] == NULL ? variableValue("HOME", 4) : commandLine[1];
+    childExitMethod = W_EXITCODE(0, 0);
+
+    if(directory == NULL)
+    {
+        fprintf(stderr, "ERROR: cd: HOME not set\n");
+        fflush(stderr);
+        childExitMethod = W_EXITCODE(1, 0);
+        return;
+    }
+    else if (strcmp(directory, ".") == 0)
+    {
+        // does nothing
+        return;
+    }
+
+    // attempt to change into specified directory otherwise generate error
+    if(chdir(directory) != 0)
+    {
+        perror("\nERROR: The directory you have requested does not exist\n");
+        fflush(stderr);
+        childExitMethod = W_EXITCODE(1, 0);
+    }
+}
+
+/*************************************************************************************************
+** Name: isFastBuiltIn
+**
+** Description: This function checks if a command is one of the utilities the shell runs itself
+** instead of starting a child for it, or the history or joblog built in which are run the same way
+** so their output can be redirected.
+**
+** Parameters: name of the command
+**
+** Returns: true if the shell runs the command itself, false otherwise
+*************************************************************************************************/
+
+bool isFastBuiltIn(const char *commandName)
+{
+    return strcmp(commandName, "echo") == 0 || strcmp(commandName, "printf") == 0 ||
+           strcmp(commandName, "true") == 0 || strcmp(commandName, "false") == 0 ||
+           strcmp(commandName, "test") == 0 || strcmp(commandName, "[") == 0 ||
+           strcmp(commandName, "pwd") == 0 || strcmp(commandName, "kill") == 0 || strcmp(commandName, ":") == 0 ||
+           strcmp(commandName, "history") == 0 || strcmp(commandName, "joblog") == 0;
+}
+
+/*************************************************************************************************
+** Name: runFastBuiltIn
+**
+** Description: This function runs one of the utilities the shell implements itself. Its redirections
+** are applied to the shell for as long as it runs and undone afterwards, so it behaves just as the
+** program of the same name would, and its exit value is recorded as the status of the command. The
+** output is flushed before the redirections are undone so it always lands where it was sent and in
+** order with the output of children. Output which could not be written, to a full disk or a closed
+** descriptor, fails the command with 1 and an error on its own standard error, as it would fail the
+** program.
+**
+** Parameters: command of the line
+**
+** Returns: N/A
+*************************************************************************************************/
+
+void runFastBuiltIn(struct commandStage *stage)
+{
+    char **commandLine = stage->argv;
+    struct savedDescriptors saved;
+    int exitStatus = 0;
+
+    if(redirectBuiltIn(stage, &saved) == false)
+    {
+        restoreBuiltIn(&saved);
+        return;
+    }
+    clearerr(stdout);
+
+    if(strcmp(commandLine[0], "echo") == 0)
+    {
+        exitStatus = echoCommand(commandLine);
+    }
+    else if(strcmp(commandLine[0], "printf") == 0)
+    {
+        exitStatus = printfCommand(commandLine);
+    }
+    else if(strcmp(commandLine[0], "false") == 0)
+    {
+        exitStatus = 1;
+    }
+    else if(strcmp(commandLine[0], "test") == 0 || strcmp(commandLine[0], "[") == 0)
+    {
+        exitStatus = testCommand(commandLine);
+    }
+    else if(strcmp(commandLine[0], "pwd") == 0)
+    {
+        exitStatus = pwdCommand();
+    }
+    else if(strcmp(commandLine[0], "kill") == 0)
+    {
+        exitStatus = killCommand(commandLine);
+    }
+    else if(strcmp(commandLine[0], "history") == 0)
+    {
+        exitStatus = historyCommand(commandLine);
+    }
+    else if(strcmp(commandLine[0], "joblog") == 0)
+    {
+        exitStatus = joblogCommand(commandLine);
+    }
+
+    if(fflush(stdout) == EOF || ferror(stdout) != 0)
+    {
+        fprintf(stderr, "%s: write error: %s\n", commandLine[0], strerror(errno));
+        fflush(stderr);
+        clearerr(stdout);
+        exitStatus = 1;
+    }
+
+    restoreBuiltIn(&saved);
+
+    childExitMethod = W_EXITCODE(exitStatus, 0);
+    numPipeStages = 1;
+}
+
+/*************************************************************************************************
+** Name: redirectBuiltIn
+**
+** Description: This function applies the redirections of a command the shell runs itself. The same
+** plan a child would get is made by planRedirections and carried out on the shell. The first time a
+** descriptor is changed it is saved with a close-on-exec duplicate, along with its flags, so it can
+** be put back by restoreBuiltIn. Files the plan opened are closed again once they are in place.
+**
+** Parameters: command of the line, descriptors saved for restoreBuiltIn
+**
+** Returns: true if every redirection could be applied, false otherwise
+*************************************************************************************************/
+
+bool redirectBuiltIn(struct commandStage *stage, struct savedDescriptors *saved)
+{
+    int i;
+    for(i = 0; i < 10; i++)
+    {
+        saved->fds[i] = -1;
+    }
+
+    struct redirectStep steps[2 * MAX_ARGS];
+    int numSteps = 0;
+    int openedFds[MAX_ARGS];
+    int numOpened = 0;
+
+    bool planned = planRedirections(stage, steps, &numSteps, openedFds, &numOpened);
+    if(planned == true && numSteps > 0)
+    {
+        // anything buffered belongs where the output went before
+        fflush(stdout);
+        fflush(stderr);
+
+        for(i = 0; i < numSteps; i++)
+        {
+            int targetFd = steps[i].targetFd;
+
+            // keep the shells own descriptor to put back afterwards
+            if(saved->fds[targetFd] == -1)
+            {
+                saved->flags[targetFd] = fcntl(targetFd, F_GETFD);
+                saved->fds[targetFd] = saved->flags[targetFd] == -1 ? -2 : fcntl(targetFd, F_DUPFD_CLOEXEC, 10);
+            }
+
+            if(steps[i].sourceFd == -1)
+            {
+                close(targetFd);
+            }
+            else
+            {
+                dup2(steps[i].sourceFd, targetFd);
+            }
+        }
+    }
+
+    for(i = 0; i < numOpened; i++)
+    {
+        close(openedFds[i]);
+    }
+
+    return planned;
+}
+
+/*************************************************************************************************
+** Name: restoreBuiltIn
+**
+** Description: This function undoes the redirections of a command the shell ran itself. Anything
+** still buffered is written out first, then the saved descriptors are put back with the flags they
+** had and the copies are closed. A descriptor which was not open before is closed again.
+**
+** Parameters: descriptors saved by redirectBuiltIn
+**
+** Returns: N/A
+*************************************************************************************************/
+
+void restoreBuiltIn(struct savedDescriptors *saved)
+{
+    fflush(stdout);
+    fflush(stderr);
+
+    int i;
+    for(i = 0; i < 10; i++)
+    {
+        if(saved->fds[i] >= 0)
+        {
+            dup3(saved->fds[i], i, (saved->flags[i] & FD_CLOEXEC) ? O_CLOEXEC : 0);
+            close(saved->fds[i]);
+        }
+        else if(saved->fds[i] == -2)
+        {
+            close(i);
+        }
+    }
+}
+
+/*************************************************************************************************
+** Name: echoCommand
+**
+** Description: This function is the echo utility. It writes its arguments separated by spaces and
+** followed by a newline, which is left out when the first argument is -n.
+**
+** Parameters: string for user input which has been tokenized
+**
+** Returns: exit value of the command
+*************************************************************************************************/
+
+int echoCommand(char **commandLine)
+{
+    bool addNewLine = true;
+    int i = 1;
+
+    if(commandLine[1] != NULL && strcmp(commandLine[1], "-n") == 0)
+    {
+        addNewLine = false;
+        i = 2;
+    }
+
+    for(; commandLine[i] != NULL; i++)
+    {
+        fputs(commandLine[i], stdout);
+        if(commandLine[i + 1] != NULL)
+        {
+            putchar(' ');
+        }
+    }
+
+    if(addNewLine == true)
+    {
+        putchar('\n');
+    }
+
+    return 0;
+}
+
+/*************************************************************************************************
+** Name: printfCommand
+**
+** Description: This function is the printf utility. The format is written out with its backslash
+** escapes turned into the characters they stand for, and each conversion takes the next argument.
+** The conversions %s, %b, %c, %d, %i, %u, %o, %x, %X, %f, %F, %e, %E, %g, %G, %a and %A are
+** supported along with flags, width and precision, either of which can be a * taking its value from
+** the next argument, and %% writes a %. %b writes its argument with its backslash escapes turned
+** into characters too, and a \c in it ends the output. A number argument may be a quote followed by
+** a character, which stands for the value of that character. A conversion without an argument left
+** uses an empty string or zero. While arguments remain after the whole format has been used the
+** format is used again.
+**
+** Parameters: string for user input which has been tokenized
+**
+** Returns: exit value of the command
+*************************************************************************************************/
+
+int printfCommand(char **commandLine)
+{
+    if(commandLine[1] == NULL)
+    {
+        fprintf(stderr, "printf: usage: printf format [arguments]\n");
+        fflush(stderr);
+        return 2;
+    }
+
+    const char *format = commandLine[1];
+    char **arguments = &commandLine[2];
+    int exitStatus = 0;
+    bool usedArgument;
+
+    do
+    {
+        usedArgument = false;
+
+        const char *formatChar;
+        for(formatChar = format; *formatChar != '\0'; formatChar++)
+        {
+            if(*formatChar == '\\')
+            {
+                int character;
+                formatChar += printfEscape(formatChar + 1, false, &character);
+                putchar(character);
+                continue;
+            }
+
+            if(*formatChar != '%')
+            {
+                putchar(*formatChar);
+                continue;
+            }
+
+            if(formatChar[1] == '%')
+            {
+                putchar('%');
+                formatChar++;
+                continue;
+            }
+
+            // the flags are kept as they are, while the width and precision are worked out so a *
+            // can take them from the arguments. a negative width aligns the field to the left and
+            // a negative precision is the same as none
+            const char *conversionStart = formatChar;
+            const char *flags = formatChar + 1;
+            size_t flagsLength = strspn(flags, "-+ #0");
+            formatChar = flags + flagsLength;
+
+            long width = 0;
+            long precision = -1;
+            char *numberEnd;
+            if(*formatChar == '*')
+            {
+                width = printfInteger(printfArgument(&arguments, &usedArgument), false, &exitStatus);
+                formatChar++;
+            }
+            else
+            {
+                width = strtol(formatChar, &numberEnd, 10);
+                formatChar = numberEnd;
+            }
+
+            if(*formatChar == '.')
+            {
+                formatChar++;
+                if(*formatChar == '*')
+                {
+                    precision = printfInteger(printfArgument(&arguments, &usedArgument), false, &exitStatus);
+                    formatChar++;
+                }
+                else
+                {
+                    precision = strtol(formatChar, &numberEnd, 10);
+                    formatChar = numberEnd;
+                }
+            }
+
+            bool leftAlign = width < 0 || memchr(flags, '-', flagsLength) != NULL;
+            width = width < 0 ? -width : width;
+
+            char conversionType = *formatChar;
+            if(conversionType == '\0' || strchr("sbcdiuoxXfFeEgGaA", conversionType) == NULL ||
+               flagsLength > 16 || width > INT_MAX || precision > INT_MAX)
+            {
+                fprintf(stderr, "printf: %.*s: invalid conversion\n", (int)(formatChar - conversionStart + (conversionType != '\0')), conversionStart);
+                fflush(stderr);
+                return 1;
+            }
+
+            char conversion[64];
+            int conversionLength = sprintf(conversion, "%%%.*s%s", (int)flagsLength, flags, leftAlign == true ? "-" : "");
+            if(width > 0)
+            {
+                conversionLength += sprintf(conversion + conversionLength, "%ld", width);
+            }
+            if(precision >= 0)
+            {
+                conversionLength += sprintf(conversion + conversionLength, ".%ld", precision);
+            }
+
+            const char *argument = printfArgument(&arguments, &usedArgument);
+
+            switch(conversionType)
+            {
+                case 's':
+                case 'c':
+                    sprintf(conversion + conversionLength, "%c", conversionType);
+                    if(conversionType == 's')
+                    {
+                        printf(conversion, argument);
+                    }
+                    else
+                    {
+                        printf(conversion, argument[0]);
+                    }
+                    break;
+
+                case 'b':
+                {
+                    // the escapes are turned into characters first, which may include a null byte
+                    struct stringBuffer text = {NULL, 0, 0};
+                    bool stopOutput = false;
+                    const char *argumentChar;
+                    for(argumentChar = argument; *argumentChar != '\0' && stopOutput == false; argumentChar++)
+                    {
+                        if(*argumentChar != '\\')
+                        {
+                            bufferAppendChar(&text, *argumentChar);
+                            continue;
+                        }
+
+                        int character;
+                        argumentChar += printfEscape(argumentChar + 1, true, &character);
+                        if(character == -1)
+                        {
+                            stopOutput = true;
+                        }
+                        else
+                        {
+                            bufferAppendChar(&text, character);
+                        }
+                    }
+
+                    size_t textLength = (precision >= 0 && (size_t)precision < text.length) ? (size_t)precision : text.length;
+                    long padding = width - (long)textLength;
+                    for(; padding > 0 && leftAlign == false; padding--)
+                    {
+                        putchar(' ');
+                    }
+                    fwrite(text.data, 1, textLength, stdout);
+                    for(; padding > 0; padding--)
+                    {
+                        putchar(' ');
+                    }
+                    free(text.data);
+
+                    if(stopOutput == true)
+                    {
+                        return exitStatus;
+                    }
+                    break;
+                }
+
+                case 'd':
+                case 'i':
+                case 'u':
+                case 'o':
+                case 'x':
+                case 'X':
+                    sprintf(conversion + conversionLength, "l%c", conversionType);
+                    printf(conversion, printfInteger(argument, conversionType != 'd' && conversionType != 'i', &exitStatus));
+                    break;
+
+                default:
+                    sprintf(conversion + conversionLength, "%c", conversionType);
+                    printf(conversion, printfFloat(argument, &exitStatus));
+                    break;
+            }
+        }
+    }while(*arguments != NULL && usedArgument == true);
+
+    return exitStatus;
+}
+
+/*************************************************************************************************
+** Name: printfEscape
+**
+** Description: This function works out the backslash escape of printf which follows a backslash.
+** Besides the escapes of C for control characters there are octal escapes of up to three digits.
+** In an argument of %b a \0 may be followed by three more digits and \c ends the output. Anything
+** else is not an escape and the backslash stands for itself.
+**
+** Parameters: characters after the backslash, true for an argument of %b, character it stands for
+** which is set to -1 for \c
+**
+** Returns: number of characters the escape takes up after the backslash
+*************************************************************************************************/
+
+size_t printfEscape(const char *escape, bool isArgument, int *character)
+{
+    const char *controlEscapes = "abefnrtv\\";
+    const char *controlCharacters = "\a\b\033\f\n\r\t\v\\";
+    const char *controlEscape = *escape != '\0' ? strchr(controlEscapes, *escape) : NULL;
+
+    if(controlEscape != NULL)
+    {
+        *character = controlCharacters[controlEscape - controlEscapes];
+        return 1;
+    }
+
+    if(isArgument == true && *escape == 'c')
+    {
+        *character = -1;
+        return 1;
+    }
+
+    if(*escape >= '0' && *escape <= '7')
+    {
+        size_t maxDigits = (isArgument == true && *escape == '0') ? 4 : 3;
+        size_t numDigits = 0;
+        *character = 0;
+        while(numDigits < maxDigits && escape[numDigits] >= '0' && escape[numDigits] <= '7')
+        {
+            *character = (*character * 8 + escape[numDigits] - '0') & 0xff;
+            numDigits++;
+        }
+        return numDigits;
+    }
+
+    *character = '\\';
+    return 0;
+}
+
+/*************************************************************************************************
+** Name: printfArgument
+**
+** Description: This function takes the next argument of printf for a conversion, or an empty string
+** once they have all been used.
+**
+** Parameters: arguments left, set when an argument is taken
+**
+** Returns: the argument
+*************************************************************************************************/
+
+const char* printfArgument(char ***arguments, bool *usedArgument)
+{
+    if(**arguments == NULL)
+    {
+        return "";
+    }
+
+    *usedArgument = true;
+    return *(*arguments)++;
+}
+
+/*************************************************************************************************
+** Name: printfInteger
+**
+** Description: This function reads an argument of printf as an integer. An argument starting with a
+** quote stands for the value of the character after it. An argument which is not entirely a number
+** is reported and what could be read of it is used.
+**
+** Parameters: argument, true for an unsigned conversion, exit value which is set to 1 on an error
+**
+** Returns: the integer
+*************************************************************************************************/
+
+long printfInteger(const char *argument, bool isUnsigned, int *exitStatus)
+{
+    if(argument[0] == '\'' || argument[0] == '"')
+    {
+        return (unsigned char)argument[1];
+    }
+
+    char *numberEnd;
+    errno = 0;
+    long number = isUnsigned == true ? (long)strtoul(argument, &numberEnd, 0) : strtol(argument, &numberEnd, 0);
+    if(*numberEnd != '\0' || errno != 0)
+    {
+        fprintf(stderr, "printf: %s: invalid number\n", argument);
+        fflush(stderr);
+        *exitStatus = 1;
+    }
+
+    return number;
+}
+
+/*************************************************************************************************
+** Name: printfFloat
+**
+** Description: This function reads an argument of printf as a floating point number, the same way
+** printfInteger reads an integer.
+**
+** Parameters: argument, exit value which is set to 1 on an error
+**
+** Returns: the number
+*************************************************************************************************/
+
+double printfFloat(const char *argument, int *exitStatus)
+{
+    if(argument[0] == '\'' || argument[0] == '"')
+    {
+        return (unsigned char)argument[1];
+    }
+
+    char *numberEnd;
+    errno = 0;
+    double number = strtod(argument, &numberEnd);
+    if(*numberEnd != '\0' || errno != 0)
+    {
+        fprintf(stderr, "printf: %s: invalid number\n", argument);
+        fflush(stderr);
+        *exitStatus = 1;
+    }
+
+    return number;
+}
+
+/*************************************************************************************************
+** Name: testCommand
+**
+** Description: This function is the test utility, also run as [ in which case the last argument has
+** to be ]. Up to four arguments are read the way POSIX decides by their number: with none the result
+** is false, a single argument is true when it is not empty, and a leading ! negates the rest, a
+** ( and ) around the rest group it, and three arguments with a binary operator in the middle are a
+** binary test, -a and -o included. Anything longer is read by testOr as a full expression of ! and
+** parentheses, unary and binary tests and strings joined by -a, which binds tighter, and -o.
+**
+** Parameters: string for user input which has been tokenized
+**
+** Returns: 0 if the expression is true, 1 if it is false, 2 on a syntax error
+*************************************************************************************************/
+
+int testCommand(char **commandLine)
+{
+    int numArgs = 0;
+    while(commandLine[numArgs + 1] != NULL)
+    {
+        numArgs++;
+    }
+
+    // [ needs a ] to close it which is not part of the expression
+    if(strcmp(commandLine[0], "[") == 0)
+    {
+        if(numArgs == 0 || strcmp(commandLine[numArgs], "]") != 0)
+        {
+            fprintf(stderr, "[: missing ]\n");
+            fflush(stderr);
+            return 2;
+        }
+        numArgs--;
+    }
+
+    bool result = false;
+    testBadNumber = NULL;
+    if(testArguments(&commandLine[1], numArgs, &result) == false)
+    {
+        if(testBadNumber != NULL)
+        {
+            fprintf(stderr, "%s: %s: integer expected\n", commandLine[0], testBadNumber);
+        }
+        else
+        {
+            fprintf(stderr, "%s: syntax error\n", commandLine[0]);
+        }
+        fflush(stderr);
+        return 2;
+    }
+
+    return result == true ? 0 : 1;
+}
+
+/*************************************************************************************************
+** Name: testArguments
+**
+** Description: This function works out an expression of test by the number of its arguments, as
+** described for testCommand, and hands any other expression to testOr.
+**
+** Parameters: arguments of the expression, number of them, result of the test
+**
+** Returns: true if the expression is valid, false on a syntax error
+*************************************************************************************************/
+
+bool testArguments(char **args, int numArgs, bool *result)
+{
+    bool isNegated = numArgs >= 2 && strcmp(args[0], "!") == 0;
+    bool isGrouped = numArgs >= 3 && strcmp(args[0], "(") == 0 && strcmp(args[numArgs - 1], ")") == 0;
+
+    switch(numArgs)
+    {
+        case 0:
+            *result = false;
+            return true;
+
+        case 1:
+            *result = args[0][0] != '\0';
+            return true;
+
+        case 2:
+            if(isNegated == true)
+            {
+                *result = args[1][0] == '\0';
+                return true;
+            }
+            return testUnary(args[0], args[1], result);
+
+        case 3:
+            if(testBinary(args[0], args[1], args[2], result) == true)
+            {
+                return true;
+            }
+            if(testBadNumber != NULL)
+            {
+                return false;
+            }
+            if(strcmp(args[1], "-a") == 0 || strcmp(args[1], "-o") == 0)
+            {
+                bool isLeft = args[0][0] != '\0';
+                bool isRight = args[2][0] != '\0';
+                *result = args[1][1] == 'a' ? (isLeft && isRight) : (isLeft || isRight);
+                return true;
+            }
+            break;
+
+        case 4:
+            break;
+
+        default:
+            isNegated = false;
+            isGrouped = false;
+            break;
+    }
+
+    if(isNegated == true)
+    {
+        bool isValid = testArguments(&args[1], numArgs - 1, result);
+        *result = !*result;
+        return isValid;
+    }
+    if(isGrouped == true)
+    {
+        return testArguments(&args[1], numArgs - 2, result);
+    }
+
+    int position = 0;
+    return testOr(args, numArgs, &position, result) == true && position == numArgs;
+}
+
+/*************************************************************************************************
+** Name: testOr
+**
+** Description: This function reads the expressions of test joined by -o from the current argument
+** on, each of them read by testAnd.
+**
+** Parameters: arguments of the expression, number of them, position of the current argument which
+** is moved past what was read, result of the test
+**
+** Returns: true if the expression is valid, false on a syntax error
+*************************************************************************************************/
+
+bool testOr(char **args, int numArgs, int *position, bool *result)
+{
+    if(testAnd(args, numArgs, position, result) == false)
+    {
+        return false;
+    }
+
+    while(*position < numArgs && strcmp(args[*position], "-o") == 0)
+    {
+        (*position)++;
+        bool rightResult;
+        if(testAnd(args, numArgs, position, &rightResult) == false)
+        {
+            return false;
+        }
+        *result = *result || rightResult;
+    }
+
+    return true;
+}
+
+/*************************************************************************************************
+** Name: testAnd
+**
+** Description: This function reads the expressions of test joined by -a from the current argument
+** on, each of them read by testPrimary.
+**
+** Parameters: arguments of the expression, number of them, position of the current argument which
+** is moved past what was read, result of the test
+**
+** Returns: true if the expression is valid, false on a syntax error
+*************************************************************************************************/
+
+bool testAnd(char **args, int numArgs, int *position, bool *result)
+{
+    if(testPrimary(args, numArgs, position, result) == false)
+    {
+        return false;
+    }
+
+    while(*position < numArgs && strcmp(args[*position], "-a") == 0)
+    {
+        (*position)++;
+        bool rightResult;
+        if(testPrimary(args, numArgs, position, &rightResult) == false)
+        {
+            return false;
+        }
+        *result = *result && rightResult;
+    }
+
+    return true;
+}
+
+/*************************************************************************************************
+** Name: testPrimary
+**
+** Description: This function reads a single expression of test from the current argument on. A
+** binary test comes first so ! and ( can still be compared as strings, then a ! negating the next
+** expression, an expression in parentheses, a unary test, and otherwise a string which is true when
+** it is not empty.
+**
+** Parameters: arguments of the expression, number of them, position of the current argument which
+** is moved past what was read, result of the test
+**
+** Returns: true if the expression is valid, false on a syntax error
+*************************************************************************************************/
+
+bool testPrimary(char **args, int numArgs, int *position, bool *result)
+{
+    char **arg = &args[*position];
+    int numLeft = numArgs - *position;
+
+    if(numLeft <= 0)
+    {
+        return false;
+    }
+
+    if(numLeft >= 3 && testBinary(arg[0], arg[1], arg[2], result) == true)
+    {
+        *position += 3;
+        return true;
+    }
+    if(testBadNumber != NULL)
+    {
+        return false;
+    }
+
+    if(strcmp(arg[0], "!") == 0)
+    {
+        (*position)++;
+        bool isValid = testPrimary(args, numArgs, position, result);
+        *result = !*result;
+        return isValid;
+    }
+
+    if(strcmp(arg[0], "(") == 0)
+    {
+        (*position)++;
+        if(testOr(args, numArgs, position, result) == false || *position >= numArgs || strcmp(args[*position], ")") != 0)
+        {
+            return false;
+        }
+        (*position)++;
+        return true;
+    }
+
+    if(numLeft >= 2 && testUnary(arg[0], arg[1], result) == true)
+    {
+        *position += 2;
+        return true;
+    }
+
+    *result = arg[0][0] != '\0';
+    (*position)++;
+    return true;
+}
+
+/*************************************************************************************************
+** Name: testUnary
+**
+** Description: This function works out a unary test, either a test of a string being empty or not or
+** a test of the type and permissions of a file.
+**
+** Parameters: operator, the string or file it tests, result of the test
+**
+** Returns: true if the operator is known, false otherwise
+*************************************************************************************************/
+
+bool testUnary(const char *operator, const char *operand, bool *result)
+{
+    struct stat fileInfo;
+
+    if(strcmp(operator, "-n") == 0)
+    {
+        *result = operand[0] != '\0';
+    }
+    else if(strcmp(operator, "-z") == 0)
+    {
+        *result = operand[0] == '\0';
+    }
+    else if(strcmp(operator, "-r") == 0)
+    {
+        *result = access(operand, R_OK) == 0;
+    }
+    else if(strcmp(operator, "-w") == 0)
+    {
+        *result = access(operand, W_OK) == 0;
+    }
+    else if(strcmp(operator, "-x") == 0)
+    {
+        *result = access(operand, X_OK) == 0;
+    }
+    else if(strcmp(operator, "-t") == 0)
+    {
+        *result = isatty(atoi(operand)) == 1;
+    }
+    else if(strcmp(operator, "-L") == 0 || strcmp(operator, "-h") == 0)
+    {
+        *result = lstat(operand, &fileInfo) == 0 && S_ISLNK(fileInfo.st_mode);
+    }
+    else if(strlen(operator) == 2 && operator[0] == '-' && strchr("efdspcbS", operator[1]) != NULL)
+    {
+        *result = stat(operand, &fileInfo) == 0;
+        switch(operator[1])
+        {
+            case 'f': *result = *result && S_ISREG(fileInfo.st_mode); break;
+            case 'd': *result = *result && S_ISDIR(fileInfo.st_mode); break;
+            case 's': *result = *result && fileInfo.st_size > 0; break;
+            case 'p': *result = *result && S_ISFIFO(fileInfo.st_mode); break;
+            case 'c': *result = *result && S_ISCHR(fileInfo.st_mode); break;
+            case 'b': *result = *result && S_ISBLK(fileInfo.st_mode); break;
+            case 'S': *result = *result && S_ISSOCK(fileInfo.st_mode); break;
+        }
+    }
+    else
+    {
+        return false;
+    }
+
+    return true;
+}
+
+/*************************************************************************************************
+** Name: testBinary
+**
+** Description: This function works out a binary test, either a comparison of two strings or of two
+** integers. An integer comparison of something which is not an integer is an error, and the operand
+** is left in testBadNumber for the message.
+**
+** Parameters: left operand, operator, right operand, result of the test
+**
+** Returns: true if the operator is known and its operands fit it, false otherwise
+*************************************************************************************************/
+
+bool testBinary(const char *left, const char *operator, const char *right, bool *result)
+{
+    if(strcmp(operator, "=") == 0)
+    {
+        *result = strcmp(left, right) == 0;
+        return true;
+    }
+    if(strcmp(operator, "!=") == 0)
+    {
+        *result = strcmp(left, right) != 0;
+        return true;
+    }
+
+    if(operator[0] != '-' || strlen(operator) != 3)
+    {
+        return false;
+    }
+
+    char *leftEnd;
+    char *rightEnd;
+    long leftNumber = strtol(left, &leftEnd, 10);
+    long rightNumber = strtol(right, &rightEnd, 10);
+    bool isNumbers = left[0] != '\0' && *leftEnd == '\0' && right[0] != '\0' && *rightEnd == '\0';
+
+    if(strcmp(operator, "-eq") == 0)
+    {
+        *result = leftNumber == rightNumber;
+    }
+    else if(strcmp(operator, "-ne") == 0)
+    {
+        *result = leftNumber != rightNumber;
+    }
+    else if(strcmp(operator, "-lt") == 0)
+    {
+        *result = leftNumber < rightNumber;
+    }
+    else if(strcmp(operator, "-le") == 0)
+    {
+        *result = leftNumber <= rightNumber;
+    }
+    else if(strcmp(operator, "-gt") == 0)
+    {
+        *result = leftNumber > rightNumber;
+    }
+    else if(strcmp(operator, "-ge") == 0)
+    {
+        *result = leftNumber >= rightNumber;
+    }
+    else
+    {
+        return false;
+    }
+
+    // comparing something which is not a number is an error rather than false
+    if(isNumbers == false)
+    {
+        testBadNumber = left[0] != '\0' && *leftEnd == '\0' ? right : left;
+        return false;
+    }
+    return true;
+}
+
+/*************************************************************************************************
+** Name: pwdCommand
+**
+** Description: This function is the pwd utility and writes the current working directory.
+**
+** Parameters: N/A
+**
+** Returns: exit value of the command
+*************************************************************************************************/
+
+int pwdCommand()
+{
+    char *currentDirectory = getcwd(NULL, 0);
+    if(currentDirectory == NULL)
+    {
+        perror("pwd");
+        fflush(stderr);
+        return 1;
+    }
+
+    puts(currentDirectory);
+    free(currentDirectory);
+
+    return 0;
+}
+
+/*************************************************************************************************
+** Name: killCommand
+**
+** Description: This function is the kill utility. The signal is SIGTERM unless given as -s NAME,
+** -NAME or -NUMBER, with or without the SIG prefix, and kill -l lists the signal names. Each target
+** is a PID or %N for every process of job N as numbered by the jobs built in.
+**
+** Parameters: string for user input which has been tokenized
+**
+** Returns: exit value of the command
+*************************************************************************************************/
+
+int killCommand(char **commandLine)
+{
+    int killSignal = SIGTERM;
+    int i = 1;
+    int exitStatus = 0;
+
+    if(commandLine[1] != NULL && strcmp(commandLine[1], "-l") == 0)
+    {
+        int listSignal;
+        for(listSignal = 1; listSignal < NSIG; listSignal++)
+        {
+            const char *signalName = sigabbrev_np(listSignal);
+            if(signalName != NULL)
+            {
+                printf("%d) SIG%s\n", listSignal, signalName);
+            }
+        }
+        return 0;
+    }
+
+    // work out which signal to send
+    const char *signalName = NULL;
+    if(commandLine[1] != NULL && strcmp(commandLine[1], "-s") == 0)
+    {
+        signalName = commandLine[2] != NULL ? commandLine[2] : "";
+        i = commandLine[2] != NULL ? 3 : 2;
+    }
+    else if(commandLine[1] != NULL && commandLine[1][0] == '-' && commandLine[1][1] != '\0')
+    {
+        signalName = commandLine[1] + 1;
+        i = 2;
+    }
+
+    if(signalName != NULL && (killSignal = signalNumber(signalName)) == -1)
+    {
+        fprintf(stderr, "kill: %s: invalid signal specification\n", signalName);
+        fflush(stderr);
+        return 1;
+    }
+
+    if(commandLine[i] == NULL)
+    {
+        fprintf(stderr, "usage: kill [-s signal | -signal] pid | %%job ...\n");
+        fflush(stderr);
+        return 2;
+    }
+
+    for(; commandLine[i] != NULL; i++)
+    {
+        char *numberEnd;
+        const char *target = commandLine[i];
+        bool isJob = target[0] == '%';
+        long targetNumber = strtol(isJob == true ? target + 1 : target, &numberEnd, 10);
+
+        if(*numberEnd != '\0' || numberEnd == target + (isJob == true ? 1 : 0))
+        {
+            fprintf(stderr, "kill: %s: arguments must be process or job IDs\n", target);
+            exitStatus = 1;
+        }
+        else if(isJob == true)
+        {
+            // jobs are numbered one more than their slot in the job table
+            if(targetNumber < 1 || targetNumber > jobTable.capacity || jobTable.jobs[targetNumber - 1].state != JOB_RUNNING)
+            {
+                fprintf(stderr, "kill: %s: no such job\n", target);
+                exitStatus = 1;
+                continue;
+            }
+
+            struct job *targetJob = &jobTable.jobs[targetNumber - 1];
+            int j;
+            for(j = 0; j < targetJob->numPids; j++)
+            {
+                kill(targetJob->pids[j], killSignal);
+            }
+        }
+        else if(kill(targetNumber, killSignal) == -1)
+        {
+            fprintf(stderr, "kill: (%ld): %s\n", targetNumber, strerror(errno));
+            exitStatus = 1;
+        }
+    }
+    fflush(stderr);
+
+    return exitStatus;
+}
+
+/*************************************************************************************************
+** Name: signalNumber
+**
+** Description: This function turns the name or number of a signal into its number. Names may be
+** given with or without the SIG prefix in any case.
+**
+** Parameters: name or number of the signal
+**
+** Returns: number of the signal or -1 if there is no such signal
+*************************************************************************************************/
+
+int signalNumber(const char *signalName)
+{
+    char *numberEnd;
+    long number = strtol(signalName, &numberEnd, 10);
+    if(signalName[0] != '\0' && *numberEnd == '\0')
+    {
+        return (number >= 0 && number < NSIG) ? number : -1;
+    }
+
+    if(strncasecmp(signalName, "SIG", 3) == 0)
+    {
+        signalName += 3;
+    }
+
+    int i;
+    for(i = 1; i < NSIG; i++)
+    {
+        const char *knownName = sigabbrev_np(i);
+        if(knownName != NULL && strcasecmp(knownName, signalName) == 0)
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+/*************************************************************************************************
+** Name: createFork
+**
+** Description: This function is used when the user has entered something other than the built-in
+** commands and needs to start a child process to run what the user has requested. The function first
+** gets the boolean associated with weather or not the user requested a background process to run.
+** Rather than copying the whole shell with fork() the child is launched with posix_spawn which uses a
+** vfork style clone and does not duplicate the shells page tables. Because there is no chance to run
+** code in the child before exec, the signal setup the child needs is described up front: foreground
+** children get SIGINT reset to its default so cntrl+c can terminate them, and every child has to
+** ignore SIGTSTP. An ignored disposition is the only one which survives exec, so SIGTSTP is blocked
+** in the parent and briefly switched to the ignore struct while the child is spawned, then the
+** shells own handler is restored. The child is given the signal mask the shell had before SIGTSTP
+** was blocked. The command line may be a pipeline of several commands. Every stage is spawned
+** before any of them is waited on so that they all run at the same time, each connected to the next
+** through a pipe, and the whole pipeline is treated as one command. Each background pipeline is
+** added to the job table as one job which can be used to check if its processes finish or kill them
+** off when the user wants to exit. Otherwise the function waits for every stage of the foreground
+** pipeline with wait4, keeps the status of each stage for the status command along with the
+** resources all of them used, and reports any signal that terminated the last stage. SIGTSTP stays
+** blocked until the foreground process finishes and is unblocked after its completion letting the
+** user switch modes. Under job control every job is a process group of its own and its children get
+** the default action for SIGTSTP, SIGTTIN and SIGTTOU. A foreground job is given the terminal,
+** which the shell takes back once the job is done or stopped, and a foreground job stopped with
+** cntrl+z becomes a stopped job.
+**
+** SOURCE: code modified after being taken from professor LECTURES 3.1 slide 22 &  3.1 slide 34
+**
+** Parameters: parsed command line of the user, structs for SIGINT and SIGTSTP
+**
+** Returns: N/A
+*************************************************************************************************/
+
+void createFork(struct pipeline *commandPipeline, struct sigaction *terminateFgChild, struct sigaction *ignoreSIGTSTP)
+{
+    bool isBackground = false;
+
+    // save whether user requested process to run in background
+    isBackground = isBackgroundProcess(commandPipeline);
+
+    // the commands of the pipeline
+    int numStages = commandPipeline->numStages;
+    pid_t stagePids[MAX_ARGS];
+    int stageStatus[MAX_ARGS];
+
+    // the wall time of the command starts before its first stage does
+    struct timespec startTime;
+    clock_gettime(CLOCK_MONOTONIC, &startTime);
+
+    // change signal mask of currently blocked signals
+    sigset_t sigtStpMask;
+    sigemptyset(&sigtStpMask);
+    // adding SIGTSTP to the set
+    sigaddset(&sigtStpMask, SIGTSTP);
+
+    // block the SIGTSTP signal while the children are created and check for errors in block attempt
+    sigset_t childMask;
+    if(sigprocmask(SIG_BLOCK, &sigtStpMask, &childMask) < 0)
+    {
+        perror("ERROR: Blocking SIGTSTP has failed!");
+        fflush(stderr);
+        exit(1);
+    }
+
+    // spawn attributes describing the signal state of the children
+    posix_spawnattr_t spawnAttributes;
+    initSpawnAttributes(&spawnAttributes, isBackground, &childMask, terminateFgChild);
+
+    // child processes ignore SIGTSTP. swap the ignore struct in just for the spawn
+    struct sigaction shellSIGTSTP;
+    sigaction(SIGTSTP, ignoreSIGTSTP, &shellSIGTSTP);
+
+    // every stage inherits the CPUs the shell is given for the spawns
+    bool isPlaced = placeChildren(isBackground);
+
+    // under job control the job is a process group led by its first stage, and its children stop
+    // on cntrl+z or when they use the terminal while in the background
+    pid_t jobPgid = 0;
+    if(jobControl == true)
+    {
+        short spawnFlags;
+        sigset_t defaultSignals;
+        posix_spawnattr_getflags(&spawnAttributes, &spawnFlags);
+        posix_spawnattr_getsigdefault(&spawnAttributes, &defaultSignals);
+        sigaddset(&defaultSignals, SIGTSTP);
+        sigaddset(&defaultSignals, SIGTTIN);
+        sigaddset(&defaultSignals, SIGTTOU);
+        posix_spawnattr_setsigdefault(&spawnAttributes, &defaultSignals);
+        posix_spawnattr_setflags(&spawnAttributes, spawnFlags | POSIX_SPAWN_SETPGROUP);
+        posix_spawnattr_setpgroup(&spawnAttributes, 0);
+    }
+
+    // a background job started while capture is on writes its output and errors into a pipe which
+    // the shell drains into the log of the job
+    int capturePipe[2] = {-1, -1};
+    if(isBackground == true && jobCapture.enabled == true && pipe2(capturePipe, O_CLOEXEC) == 0)
+    {
+        fcntl(capturePipe[0], F_SETFL, O_NONBLOCK);
+        setPipeSize(capturePipe[1]);
+    }
+
+    // start every stage before waiting on any so they all run at the same time. each stage reads
+    // from the pipe the previous stage writes to
+    int inputPipe = -1;
+    int i;
+    for(i = 0; i < numStages; i++)
+    {
+        int pipeFds[2] = {-1, -1};
+
+        // every stage but the last writes into a new pipe. the shells ends are close-on-exec so
+        // no child holds on to a pipe it does not use
+        if(i < numStages - 1 && pipe2(pipeFds, O_CLOEXEC) < 0)
+        {
+            perror("ERROR: Unable to create pipe");
+            fflush(stderr);
+            childExitMethod = W_EXITCODE(1, 0);
+            pipeFds[0] = -1;
+            pipeFds[1] = -1;
+            stagePids[i] = -1;
+        }
+        else
+        {
+            setPipeSize(pipeFds[1]);
+
+            // the first stage of a foreground job takes the terminal before it runs
+            bool takeTerminal = jobControl == true && isBackground == false && jobPgid == 0;
+
+            // call function to start the command
+            stagePids[i] = executeCommand(&commandPipeline->stages[i], isBackground, inputPipe, pipeFds[1], capturePipe[1], &spawnAttributes, takeTerminal);
+
+            // the stages after the first join its process group
+            if(jobControl == true && jobPgid == 0 && stagePids[i] > 0)
+            {
+                jobPgid = stagePids[i];
+                posix_spawnattr_setpgroup(&spawnAttributes, jobPgid);
+            }
+        }
+
+        // stages which could not be started keep the status their error recorded
+        stageStatus[i] = childExitMethod;
+
+        // the children have their own copies of the pipe ends now
+        if(inputPipe != -1)
+        {
+            close(inputPipe);
+        }
+        if(pipeFds[1] != -1)
+        {
+            close(pipeFds[1]);
+        }
+        inputPipe = pipeFds[0];
+    }
+
+    if(capturePipe[1] != -1)
+    {
+        close(capturePipe[1]);
+    }
+
+    // put the shells handler back. any SIGTSTP received meanwhile is still pending
+    sigaction(SIGTSTP, &shellSIGTSTP, NULL);
+    posix_spawnattr_destroy(&spawnAttributes);
+    if(isPlaced == true)
+    {
+        restorePlacement();
+    }
+
+    // if the process is a background process
+    if(isBackground == true)
+    {
+        // keep only the stages which were started
+        int numStarted = 0;
+        for(i = 0; i < numStages; i++)
+        {
+            if(stagePids[i] > 0)
+            {
+                stagePids[numStarted++] = stagePids[i];
+            }
+        }
+
+        if(numStarted > 0)
+        {
+            printf("background pid is %d\n", stagePids[numStarted - 1]);
+            lastBackgroundPid = stagePids[numStarted - 1];
+
+            // add the job to the job table and dont let the parent wait
+            int jobIndex = addJob(stagePids, numStarted, commandPipeline->text);
+            jobTable.jobs[jobIndex].startTime = startTime;
+            jobTable.jobs[jobIndex].timed = commandPipeline->timed;
+            jobTable.jobs[jobIndex].pgid = jobPgid;
+
+            // every background job gets a track of its own in the trace
+            if(traceFile != NULL)
+            {
+                traceTrackName(stagePids[numStarted - 1], jobIndex + 1, commandPipeline->text);
+            }
+
+            if(capturePipe[0] != -1)
+            {
+                startJobLog(jobIndex, stagePids[numStarted - 1], commandPipeline->text, capturePipe[0]);
+                capturePipe[0] = -1;
+            }
+        }
+
+        if(capturePipe[0] != -1)
+        {
+            close(capturePipe[0]);
+        }
+
+        isBackground = false;
+    }
+    else
+    {
+        // block this parent until every stage terminates for foreground processes
+        // under job control a stage stopping stops the job, which then joins the background jobs
+        double waitStart = traceTime();
+        int waitOptions = jobControl == true ? WUNTRACED : 0;
+        bool isStopped = false;
+        memset(&lastUsage, 0, sizeof(lastUsage));
+        for(i = 0; i < numStages; i++)
+        {
+            struct rusage stageUsage;
+            if(stagePids[i] > 0 && waitChild(stagePids[i], &stageStatus[i], waitOptions, &stageUsage) > 0)
+            {
+                if(WIFSTOPPED(stageStatus[i]))
+                {
+                    stopForegroundJob(&stagePids[i], numStages - i, commandPipeline->text, jobPgid);
+                    childExitMethod = W_EXITCODE(128 + WSTOPSIG(stageStatus[i]), 0);
+                    isStopped = true;
+                    break;
+                }
+                addUsage(&lastUsage, &stageUsage);
+            }
+            pipeStatus[i] = stageStatus[i];
+        }
+        numPipeStages = isStopped == true ? i : numStages;
+        elapsedSince(&startTime, &lastWallTime);
+        lastUsageKnown = true;
+        traceEvent("wait", 0, waitStart, NULL);
+
+        // the shell takes its terminal back the way it left it
+        if(jobPgid != 0)
+        {
+            tcsetpgrp(STDIN_FILENO, shellPgid);
+            tcsetattr(STDIN_FILENO, TCSADRAIN, &shellTerminal);
+        }
+
+        // the pipeline ends the way its last stage did
+        if(isStopped == false)
+        {
+            childExitMethod = stageStatus[numStages - 1];
+        }
+
+        // if process ended via signal display message with termination value
+        if(isStopped == false && stagePids[numStages - 1] > 0 && WIFSIGNALED(childExitMethod))
+        {
+            printf("terminated by signal %d\n", WTERMSIG(childExitMethod));
+            fflush(stdout);
+        }
+
+        if(commandPipeline->timed == true)
+        {
+            printUsage(&lastWallTime, &lastUsage);
+        }
+    }
+
+    // unblock the SIGTSTP signal and check for errors
+    if(sigprocmask(SIG_UNBLOCK, &sigtStpMask, NULL) < 0)
+    {
+        perror("ERROR: Unblocking SIGTSTP has failed!");
+        fflush(stderr);
+        exit(1);
+    }
+}
+
+/*************************************************************************************************
+** Name: initSpawnAttributes
+**
+** Description: This function sets up the spawn attributes describing the signal state children start
+** with. Foreground children get the default action for SIGINT so cntrl+c can terminate them, and
+** every child starts with the signal mask the shell had before it blocked SIGTSTP, except SIGCHLD
+** which only the shell reads through its signalfd.
+**
+** Parameters: attributes to set up, boolean indicating if the children run in the background, mask
+** the shell had before blocking SIGTSTP, struct for SIGINT
+**
+** Returns: N/A
+*************************************************************************************************/
+
+void initSpawnAttributes(posix_spawnattr_t *spawnAttributes, bool runBackground, sigset_t *childMask, struct sigaction *terminateFgChild)
+{
+    // the shell reads SIGCHLD through its signalfd but children get it as usual
+    sigdelset(childMask, SIGCHLD);
+
+    posix_spawnattr_init(spawnAttributes);
+
+    // if child spawned is foreground allow termination
+    sigset_t defaultSignals;
+    sigemptyset(&defaultSignals);
+    if(runBackground == false && terminateFgChild->sa_handler == SIG_DFL)
+    {
+        sigaddset(&defaultSignals, SIGINT);
+    }
+    posix_spawnattr_setsigdefault(spawnAttributes, &defaultSignals);
+
+    // child starts with the mask the shell had before SIGTSTP was blocked
+    posix_spawnattr_setsigmask(spawnAttributes, childMask);
+    posix_spawnattr_setflags(spawnAttributes, POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETSIGMASK);
+}
+
+/*************************************************************************************************
+** Name: setPlacement
+**
+** Description: This function sets how background jobs are placed on the CPUs. With spread each job
+** is pinned to the next CPU in an order which alternates between NUMA nodes, with pack the order
+** fills one node before moving to the next, and with reserve-shell the shell itself is pinned to the
+** first CPU and jobs are spread over the others, which every other child is kept on as well. With
+** off children inherit the affinity the shell started with. Only CPUs the shell was allowed to use
+** when it started are ever handed out.
+**
+** Parameters: name of the policy
+**
+** Returns: true if the policy was set, false if the name is not a policy
+*************************************************************************************************/
+
+bool setPlacement(const char *policyName)
+{
+    enum placementPolicy policy;
+    if(strcmp(policyName, "off") == 0)
+    {
+        policy = PLACE_OFF;
+    }
+    else if(strcmp(policyName, "spread") == 0)
+    {
+        policy = PLACE_SPREAD;
+    }
+    else if(strcmp(policyName, "pack") == 0)
+    {
+        policy = PLACE_PACK;
+    }
+    else if(strcmp(policyName, "reserve-shell") == 0)
+    {
+        policy = PLACE_RESERVE_SHELL;
+    }
+    else
+    {
+        fprintf(stderr, "setaffinity: %s: not a placement policy\n", policyName);
+        fflush(stderr);
+        return false;
+    }
+
+    loadCpuTopology();
+
+    // the shell goes back to the CPUs it started with unless it keeps one for itself
+    sched_setaffinity(0, sizeof(cpu_set_t), &cpuPlacement.shellMask);
+    cpuPlacement.childMask = cpuPlacement.shellMask;
+    cpuPlacement.shellCpu = -1;
+    cpuPlacement.policy = policy;
+    cpuPlacement.nextCpu = 0;
+
+    if(policy == PLACE_OFF)
+    {
+        return true;
+    }
+
+    // spreading takes a CPU from every node in turn, packing goes through the nodes in order
+    char nodePath[64];
+    int numNodes = 0;
+    cpu_set_t nodeCpus[64];
+    while(numNodes < 64)
+    {
+        sprintf(nodePath, "/sys/devices/system/node/node%d/cpulist", numNodes);
+        if(readCpuList(nodePath, &nodeCpus[numNodes]) == false)
+        {
+            break;
+        }
+        CPU_AND(&nodeCpus[numNodes], &nodeCpus[numNodes], &cpuPlacement.shellMask);
+        numNodes++;
+    }
+    if(numNodes == 0)
+    {
+        nodeCpus[0] = cpuPlacement.shellMask;
+        numNodes = 1;
+    }
+
+    int numAllowed = CPU_COUNT(&cpuPlacement.shellMask);
+    cpuPlacement.cpuOrder = realloc(cpuPlacement.cpuOrder, numAllowed * sizeof(int));
+    cpuPlacement.numCpus = 0;
+
+    // the shell keeps the first CPU it may use, as long as that leaves one for the jobs
+    if(policy == PLACE_RESERVE_SHELL && numAllowed > 1)
+    {
+        int cpu = 0;
+        while(CPU_ISSET(cpu, &cpuPlacement.shellMask) == 0)
+        {
+            cpu++;
+        }
+        cpuPlacement.shellCpu = cpu;
+        CPU_CLR(cpu, &cpuPlacement.childMask);
+    }
+
+    int cpu;
+    int node;
+    if(policy == PLACE_PACK)
+    {
+        for(node = 0; node < numNodes; node++)
+        {
+            for(cpu = 0; cpu < CPU_SETSIZE; cpu++)
+            {
+                if(CPU_ISSET(cpu, &nodeCpus[node]) && CPU_ISSET(cpu, &cpuPlacement.childMask))
+                {
+                    cpuPlacement.cpuOrder[cpuPlacement.numCpus++] = cpu;
+                }
+            }
+        }
+    }
+    else
+    {
+        // the n-th CPU of every node before the next CPU of any of them
+        int nextInNode[64] = {0};
+        bool tookCpu = true;
+        while(tookCpu == true)
+        {
+            tookCpu = false;
+            for(node = 0; node < numNodes; node++)
+            {
+                for(cpu = nextInNode[node]; cpu < CPU_SETSIZE; cpu++)
+                {
+                    if(CPU_ISSET(cpu, &nodeCpus[node]) && CPU_ISSET(cpu, &cpuPlacement.childMask))
+                    {
+                        cpuPlacement.cpuOrder[cpuPlacement.numCpus++] = cpu;
+                        tookCpu = true;
+                        cpu++;
+                        break;
+                    }
+                }
+                nextInNode[node] = cpu;
+            }
+        }
+    }
+
+    // a CPU which is on no node still gets jobs, after the others
+    for(cpu = 0; cpu < CPU_SETSIZE && cpuPlacement.numCpus < numAllowed; cpu++)
+    {
+        bool listed = false;
+        int i;
+        for(i = 0; i < cpuPlacement.numCpus && listed == false; i++)
+        {
+            listed = cpuPlacement.cpuOrder[i] == cpu;
+        }
+        if(listed == false && CPU_ISSET(cpu, &cpuPlacement.childMask))
+        {
+            cpuPlacement.cpuOrder[cpuPlacement.numCpus++] = cpu;
+        }
+    }
+
+    if(cpuPlacement.shellCpu != -1)
+    {
+        cpu_set_t shellOnly;
+        CPU_ZERO(&shellOnly);
+        CPU_SET(cpuPlacement.shellCpu, &shellOnly);
+        sched_setaffinity(0, sizeof(cpu_set_t), &shellOnly);
+    }
+
+    return true;
+}
+
+/*************************************************************************************************
+** Name: loadCpuTopology
+**
+** Description: This function records the CPUs the shell may run on the first time placement is
+** used, from its own affinity so CPUs taken away by taskset or a cgroup are never handed out, and
+** keeps only those /sys/devices/system/cpu/online lists as online.
+**
+** Parameters: N/A
+**
+** Returns: N/A
+*************************************************************************************************/
+
+void loadCpuTopology()
+{
+    if(cpuPlacement.loaded == true)
+    {
+        return;
+    }
+
+    if(sched_getaffinity(0, sizeof(cpu_set_t), &cpuPlacement.shellMask) == -1)
+    {
+        CPU_ZERO(&cpuPlacement.shellMask);
+        CPU_SET(0, &cpuPlacement.shellMask);
+    }
+
+    cpu_set_t onlineCpus;
+    if(readCpuList("/sys/devices/system/cpu/online", &onlineCpus) == true)
+    {
+        cpu_set_t allowedOnline;
+        CPU_AND(&allowedOnline, &cpuPlacement.shellMask, &onlineCpus);
+        if(CPU_COUNT(&allowedOnline) > 0)
+        {
+            cpuPlacement.shellMask = allowedOnline;
+        }
+    }
+
+    cpuPlacement.loaded = true;
+}
+
+/*************************************************************************************************
+** Name: readCpuList
+**
+** Description: This function reads a list of CPUs in the format /sys uses, numbers and ranges
+** separated by commas such as 0-3,8,10-11.
+**
+** Parameters: file to read, set which is set to the CPUs listed
+**
+** Returns: true if the file could be read, false otherwise
+*************************************************************************************************/
+
+bool readCpuList(const char *fileName, cpu_set_t *cpus)
+{
+    char listText[4096];
+    int listFd = open(fileName, O_RDONLY | O_CLOEXEC);
+    if(listFd == -1)
+    {
+        return false;
+    }
+
+    ssize_t numRead = read(listFd, listText, sizeof(listText) - 1);
+    close(listFd);
+    if(numRead < 0)
+    {
+        return false;
+    }
+    listText[numRead] = '\0';
+
+    CPU_ZERO(cpus);
+    char *currChar = listText;
+    while(isdigit((unsigned char)*currChar))
+    {
+        long first = strtol(currChar, &currChar, 10);
+        long last = first;
+        if(*currChar == '-')
+        {
+            last = strtol(currChar + 1, &currChar, 10);
+        }
+
+        long cpu;
+        for(cpu = first; cpu <= last && cpu < CPU_SETSIZE; cpu++)
+        {
+            CPU_SET(cpu, cpus);
+        }
+
+        if(*currChar == ',')
+        {
+            currChar++;
+        }
+    }
+
+    return true;
+}
+
+/*************************************************************************************************
+** Name: placeChildren
+**
+** Description: This function sets the affinity the next children are spawned with. posix_spawn has
+** no affinity of its own so the shell changes its own for the spawn and children inherit it, which
+** restorePlacement undoes afterwards. A background job is given the next CPU in turn and anything
+** else is kept off the CPU reserved for the shell, if there is one.
+**
+** Parameters: boolean indicating if the children make up a background job
+**
+** Returns: true if the affinity of the shell was changed and has to be restored, false otherwise
+*************************************************************************************************/
+
+bool placeChildren(bool isJob)
+{
+    if(cpuPlacement.policy == PLACE_OFF || cpuPlacement.numCpus == 0)
+    {
+        return false;
+    }
+
+    if(isJob == true)
+    {
+        cpu_set_t jobCpu;
+        CPU_ZERO(&jobCpu);
+        CPU_SET(cpuPlacement.cpuOrder[cpuPlacement.nextCpu], &jobCpu);
+        cpuPlacement.nextCpu = (cpuPlacement.nextCpu + 1) % cpuPlacement.numCpus;
+        return sched_setaffinity(0, sizeof(cpu_set_t), &jobCpu) == 0;
+    }
+
+    // foreground commands may use every CPU but the shells own
+    if(cpuPlacement.shellCpu != -1)
+    {
+        return sched_setaffinity(0, sizeof(cpu_set_t), &cpuPlacement.childMask) == 0;
+    }
+
+    return false;
+}
+
+/*************************************************************************************************
+** Name: restorePlacement
+**
+** Description: This function puts the affinity of the shell back after children were spawned with
+** the one placeChildren set.
+**
+** Parameters: N/A
+**
+** Returns: N/A
+*************************************************************************************************/
+
+void restorePlacement()
+{
+    if(cpuPlacement.shellCpu != -1)
+    {
+        cpu_set_t shellOnly;
+        CPU_ZERO(&shellOnly);
+        CPU_SET(cpuPlacement.shellCpu, &shellOnly);
+        sched_setaffinity(0, sizeof(cpu_set_t), &shellOnly);
+    }
+    else
+    {
+        sched_setaffinity(0, sizeof(cpu_set_t), &cpuPlacement.shellMask);
+    }
+}
+
+/*************************************************************************************************
+** Name: setaffinityCommand
+**
+** Description: This function is the setaffinity built in. setaffinity POLICY sets the placement of
+** background jobs to off, spread, pack or reserve-shell. With no arguments it shows the policy, the
+** CPU kept for the shell and the order jobs are given CPUs in.
+**
+** Parameters: string for user input which has been tokenized
+**
+** Returns: exit value of the built in
+*************************************************************************************************/
+
+int setaffinityCommand(char **commandLine)
+{
+    static const char *policyNames[] = {"off", "spread", "pack", "reserve-shell"};
+
+    if(commandLine[1] != NULL && commandLine[2] == NULL)
+    {
+        return setPlacement(commandLine[1]) == true ? 0 : 1;
+    }
+
+    if(commandLine[1] != NULL)
+    {
+        fprintf(stderr, "setaffinity: usage: setaffinity [off | spread | pack | reserve-shell]\n");
+        fflush(stderr);
+        return 2;
+    }
+
+    printf("policy: %s\n", policyNames[cpuPlacement.policy]);
+    if(cpuPlacement.shellCpu != -1)
+    {
+        printf("shell cpu: %d\n", cpuPlacement.shellCpu);
+    }
+    if(cpuPlacement.policy != PLACE_OFF)
+    {
+        printf("job cpus:");
+        int i;
+        for(i = 0; i < cpuPlacement.numCpus; i++)
+        {
+            printf(" %d", cpuPlacement.cpuOrder[(cpuPlacement.nextCpu + i) % cpuPlacement.numCpus]);
+        }
+        printf("\n");
+    }
+    fflush(stdout);
+    return 0;
+}
+
+/*************************************************************************************************
+** Name: parallelCommand
+**
+** Description: This function is the parallel built in, parallel [-j N] command [args] [::: inputs].
+** The command is run once for every input, with the input replacing every {} in its words or added
+** as its last argument when there is no {}. Inputs follow ::: on the command line, or otherwise are
+** read a line each from the file given with <, from standard input, or from the rest of the shells
+** own input when that is standard input. Inputs after ::: cannot also be redirected. Every other
+** redirection, such as > or 2>, is applied to the shell while the children run, in either form, so
+** the children and the summary inherit it. Exactly N children are kept running, N being the number
+** of online CPUs unless -j says otherwise, and a slot is refilled as soon as its child is reaped by
+** checkBackgroundStatus, which is woken by the signalfd the same way the prompt is. Every failed
+** input is reported when it finishes and a summary of the number run, failures and throughput is
+** printed to stderr at the end. Once a child is stopped by cntrl+c no further inputs are started.
+** The status is the number of failures, at most 101, and the resources used by all the children are
+** kept for status -v and time.
+**
+** Parameters: command of the line, structs for SIGINT and SIGTSTP
+**
+** Returns: N/A
+*************************************************************************************************/
+
+void parallelCommand(struct commandStage *stage, struct sigaction *terminateFgChild, struct sigaction *ignoreSIGTSTP)
+{
+    char **commandLine = stage->argv;
+    long numSlots = sysconf(_SC_NPROCESSORS_ONLN);
+    int commandStart = 1;
+
+    // -j N or -jN sets the number of job slots
+    if(commandLine[1] != NULL && strncmp(commandLine[1], "-j", 2) == 0)
+    {
+        const char *slotText = commandLine[1][2] != '\0' ? commandLine[1] + 2 : commandLine[2];
+        numSlots = slotText != NULL ? strtol(slotText, NULL, 10) : 0;
+        commandStart = commandLine[1][2] != '\0' ? 2 : 3;
+
+        if(numSlots < 1)
+        {
+            fprintf(stderr, "parallel: -j needs a positive number of job slots\n");
+            fflush(stderr);
+            childExitMethod = W_EXITCODE(2, 0);
+            return;
+        }
+    }
+
+    // the command runs up to the ::: which starts the inputs
+    int numCommandWords = 0;
+    while(commandLine[commandStart + numCommandWords] != NULL && strcmp(commandLine[commandStart + numCommandWords], ":::") != 0)
+    {
+        numCommandWords++;
+    }
+
+    if(numCommandWords == 0)
+    {
+        fprintf(stderr, "usage: parallel [-j N] command [args] [::: inputs]\n");
+        fflush(stderr);
+        childExitMethod = W_EXITCODE(2, 0);
+        return;
+    }
+
+    // the inputs may be redirected with <, a here-document or a here-string. every other redirection
+    // is applied to the shell while the children run so they inherit it
+    struct commandStage inputStage = *stage;
+    struct commandStage outputStage = *stage;
+    inputStage.redirections = arenaAlloc(&lineArena, (stage->numRedirections + 1) * sizeof(struct redirection));
+    outputStage.redirections = arenaAlloc(&lineArena, (stage->numRedirections + 1) * sizeof(struct redirection));
+    inputStage.numRedirections = 0;
+    outputStage.numRedirections = 0;
+
+    int i;
+    for(i = 0; i < stage->numRedirections; i++)
+    {
+        enum tokenType type = stage->redirections[i].type;
+        if((type == TOKEN_LESS || type == TOKEN_HEREDOC || type == TOKEN_HERESTRING) && stage->redirections[i].fd <= 0)
+        {
+            inputStage.redirections[inputStage.numRedirections++] = stage->redirections[i];
+        }
+        else
+        {
+            outputStage.redirections[outputStage.numRedirections++] = stage->redirections[i];
+        }
+    }
+
+    char **command = &commandLine[commandStart];
+    char **inputs = NULL;
+    int numInputs = 0;
+    bool inputsAllocated = false;
+
+    if(command[numCommandWords] != NULL)
+    {
+        if(inputStage.numRedirections > 0)
+        {
+            fprintf(stderr, "parallel: the inputs cannot be redirected when they follow :::\n");
+            fflush(stderr);
+            childExitMethod = W_EXITCODE(1, 0);
+            return;
+        }
+
+        inputs = &command[numCommandWords + 1];
+        numInputs = stage->argc - commandStart - numCommandWords - 1;
+    }
+    else
+    {
+        numInputs = readParallelInputs(&inputStage, &inputs);
+        inputsAllocated = true;
+        if(numInputs == -1)
+        {
+            childExitMethod = W_EXITCODE(1, 0);
+            return;
+        }
+    }
+
+    struct savedDescriptors saved;
+    if(redirectBuiltIn(&outputStage, &saved) == false)
+    {
+        restoreBuiltIn(&saved);
+        if(inputsAllocated == true)
+        {
+            free(inputs);
+        }
+        return;
+    }
+
+    // there is no point in more slots than inputs
+    if(numSlots > numInputs)
+    {
+        numSlots = numInputs > 0 ? numInputs : 1;
+    }
+
+    struct parallelRun run = {0};
+    run.numSlots = numSlots;
+    run.slotPids = malloc(numSlots * sizeof(pid_t));
+    run.slotInputs = malloc(numSlots * sizeof(int));
+    run.inputs = inputs;
+
+    for(i = 0; i < numSlots; i++)
+    {
+        run.slotPids[i] = -1;
+    }
+
+    // children never read the shells own input
+    int nullFd = highDescriptor(open("/dev/null", O_RDONLY | O_CLOEXEC));
+
+    // block SIGTSTP while children run just like a foreground command
+    sigset_t sigtStpMask;
+    sigset_t childMask;
+    sigemptyset(&sigtStpMask);
+    sigaddset(&sigtStpMask, SIGTSTP);
+    if(sigprocmask(SIG_BLOCK, &sigtStpMask, &childMask) < 0)
+    {
+        perror("ERROR: Blocking SIGTSTP has failed!");
+        fflush(stderr);
+        exit(1);
+    }
+
+    posix_spawnattr_t spawnAttributes;
+    initSpawnAttributes(&spawnAttributes, false, &childMask, terminateFgChild);
+
+    struct timespec startTime;
+    clock_gettime(CLOCK_MONOTONIC, &startTime);
+
+    activeParallel = &run;
+    int nextInput = 0;
+
+    while(true)
+    {
+        // fill every free slot. children inherit the ignored SIGTSTP from the spawn
+        struct sigaction shellSIGTSTP;
+        sigaction(SIGTSTP, ignoreSIGTSTP, &shellSIGTSTP);
+
+        int slot = 0;
+        while(run.numRunning < run.numSlots && nextInput < numInputs && run.interrupted == false)
+        {
+            while(run.slotPids[slot] != -1)
+            {
+                slot++;
+            }
+
+            pid_t childPid = startParallelChild(command, numCommandWords, inputs[nextInput], nullFd, &spawnAttributes);
+            if(childPid == -1)
+            {
+                run.numDone++;
+                run.numFailed++;
+            }
+            else
+            {
+                run.slotPids[slot] = childPid;
+                run.slotInputs[slot] = nextInput;
+                run.numRunning++;
+            }
+            nextInput++;
+        }
+
+        sigaction(SIGTSTP, &shellSIGTSTP, NULL);
+
+        if(run.numRunning == 0)
+        {
+            break;
+        }
+
+        // sleep until a child has finished and reap it through the usual path. captured background
+        // jobs are drained meanwhile so none of them waits on the shell
+        struct pollfd waitFds[2] = {{signalFd, POLLIN, 0}, {jobCapture.epollFd, POLLIN, 0}};
+        if(poll(waitFds, jobCapture.numOpen > 0 ? 2 : 1, -1) > 0)
+        {
+            if(waitFds[1].revents != 0)
+            {
+                drainCaptures();
+            }
+            if(waitFds[0].revents != 0 && drainSignalFd() == true)
+            {
+                checkBackgroundStatus();
+            }
+        }
+    }
+
+    activeParallel = NULL;
+    elapsedSince(&startTime, &lastWallTime);
+    lastUsage = run.usage;
+    lastUsageKnown = true;
+
+    posix_spawnattr_destroy(&spawnAttributes);
+    if(nullFd != -1)
+    {
+        close(nullFd);
+    }
+
+    // unblock the SIGTSTP signal and check for errors
+    if(sigprocmask(SIG_UNBLOCK, &sigtStpMask, NULL) < 0)
+    {
+        perror("ERROR: Unblocking SIGTSTP has failed!");
+        fflush(stderr);
+        exit(1);
+    }
+
+    // report how many ran and how fast
+    double seconds = lastWallTime.tv_sec + lastWallTime.tv_nsec / 1e9;
+    fprintf(stderr, "parallel: %d jobs, %d failed, %d not started in %.3fs with %d slots (%.1f jobs/s)\n",
+            run.numDone, run.numFailed, numInputs - nextInput, seconds, run.numSlots,
+            seconds > 0 ? run.numDone / seconds : 0.0);
+    fflush(stderr);
+    restoreBuiltIn(&saved);
+
+    childExitMethod = W_EXITCODE(run.numFailed > 101 ? 101 : run.numFailed, 0);
+
+    free(run.slotPids);
+    free(run.slotInputs);
+    if(inputsAllocated == true)
+    {
+        free(inputs);
+    }
+}
+
+/*************************************************************************************************
+** Name: readParallelInputs
+**
+** Description: This function reads the inputs of parallel when they are not given after :::, one
+** input for every line which is not empty. They come from the file named with < or the text of a
+** here-document or here-string, or otherwise from standard input. Standard input is always read
+** straight from the descriptor, never through the line buffer the shell reads its own commands
+** from, since that belongs to the shell and not to the command. The inputs are copied into the line arena so they last as long as
+** the command line does.
+**
+** Parameters: command of the line with only the redirections of its inputs, pointer which is set to
+** the array of inputs, freed by the caller
+**
+** Returns: number of inputs or -1 if they could not be read
+*************************************************************************************************/
+
+int readParallelInputs(struct commandStage *stage, char ***inputs)
+{
+    int numInputs = 0;
+    int capacity = 0;
+    *inputs = NULL;
+
+    int inputFileDescriptor = STDIN_FILENO;
+    int i;
+    for(i = 0; i < stage->numRedirections; i++)
+    {
+        if(inputFileDescriptor != STDIN_FILENO)
+        {
+            close(inputFileDescriptor);
+            inputFileDescriptor = STDIN_FILENO;
+        }
+
+        // the text of a here-document or here-string is already in memory
+        if(stage->redirections[i].type != TOKEN_LESS)
+        {
+            numInputs = 0;
+            splitInputLines(stage->redirections[i].target, strlen(stage->redirections[i].target), inputs, &numInputs, &capacity);
+            continue;
+        }
+        numInputs = 0;
+
+        if(inputFileDescriptor != STDIN_FILENO)
+        {
+            close(inputFileDescriptor);
+        }
+        inputFileDescriptor = open(stage->redirections[i].target, O_RDONLY | O_CLOEXEC, 0);
+        if(inputFileDescriptor == -1)
+        {
+            perror("ERROR: open() failed. Cannot input to file");
+            fflush(stderr);
+            return -1;
+        }
+    }
+
+    // the last redirection wins just as it does for a child
+    if(stage->numRedirections > 0 && stage->redirections[stage->numRedirections - 1].type != TOKEN_LESS)
+    {
+        return numInputs;
+    }
+
+    // read the whole file with large reads and split it into lines once
+    struct stringBuffer inputText = {NULL, 0, 0};
+    char readBuffer[65536];
+    ssize_t numRead;
+    while((numRead = read(inputFileDescriptor, readBuffer, sizeof(readBuffer))) > 0 || (numRead == -1 && errno == EINTR))
+    {
+        if(numRead > 0)
+        {
+            bufferAppend(&inputText, readBuffer, numRead);
+        }
+    }
+
+    if(inputFileDescriptor != STDIN_FILENO)
+    {
+        close(inputFileDescriptor);
+    }
+
+    splitInputLines(inputText.data, inputText.length, inputs, &numInputs, &capacity);
+    free(inputText.data);
+
+    return numInputs;
+}
+
+/*************************************************************************************************
+** Name: splitInputLines
+**
+** Description: This function adds every line of a block of text which is not empty to the inputs
+** of parallel, copying each into the line arena. The array of inputs doubles as it grows.
+**
+** Parameters: text to split, its length, array of inputs, number of inputs, capacity of the array
+**
+** Returns: N/A
+*************************************************************************************************/
+
+void splitInputLines(const char *text, size_t length, char ***inputs, int *numInputs, int *capacity)
+{
+    size_t lineStart = 0;
+    while(lineStart < length)
+    {
+        const char *newLine = memchr(text + lineStart, '\n', length - lineStart);
+        size_t lineLength = newLine != NULL ? (size_t)(newLine - text) - lineStart : length - lineStart;
+
+        if(lineLength > 0)
+        {
+            if(*numInputs == *capacity)
+            {
+                *capacity = *capacity == 0 ? 64 : *capacity * 2;
+                *inputs = realloc(*inputs, *capacity * sizeof(char *));
+            }
+
+            char *input = arenaAlloc(&lineArena, lineLength + 1);
+            memcpy(input, text + lineStart, lineLength);
+            input[lineLength] = '\0';
+            (*inputs)[(*numInputs)++] = input;
+        }
+
+        lineStart += lineLength + 1;
+    }
+}
+
+/*************************************************************************************************
+** Name: startParallelChild
+**
+** Description: This function starts the command of parallel for one input. Every {} in the words of
+** the command is replaced by the input, and when there is none the input is added as the last
+** argument. The child reads /dev/null and shares the standard output and error of the shell.
+**
+** Parameters: words of the command, number of words, input to run it for, descriptor of /dev/null,
+** attributes describing the signal state of the child
+**
+** Returns: PID of the child or -1 if it could not be started
+*************************************************************************************************/
+
+pid_t startParallelChild(char **command, int numCommandWords, const char *input, int inputFd, const posix_spawnattr_t *spawnAttributes)
+{
+    char *childArgs[MAX_ARGS + 2];
+    bool inputUsed = false;
+
+    int i;
+    for(i = 0; i < numCommandWords; i++)
+    {
+        const char *placeholder = strstr(command[i], "{}");
+        if(placeholder == NULL)
+        {
+            childArgs[i] = command[i];
+            continue;
+        }
+
+        // build the word with every {} replaced by the input
+        wordBuffer.length = 0;
+        const char *wordPart = command[i];
+        while(placeholder != NULL)
+        {
+            bufferAppend(&wordBuffer, wordPart, placeholder - wordPart);
+            bufferAppend(&wordBuffer, input, strlen(input));
+            wordPart = placeholder + 2;
+            placeholder = strstr(wordPart, "{}");
+        }
+        bufferAppend(&wordBuffer, wordPart, strlen(wordPart));
+        childArgs[i] = bufferToArena(&wordBuffer, &lineArena);
+        inputUsed = true;
+    }
+
+    if(inputUsed == false)
+    {
+        childArgs[i++] = (char *)input;
+    }
+    childArgs[i] = NULL;
+
+    struct commandStage childStage = {childArgs, i, NULL, 0};
+
+    // every child is a job of its own when it comes to placing it on a CPU
+    bool isPlaced = placeChildren(true);
+    pid_t childPid = executeCommand(&childStage, false, inputFd, -1, -1, spawnAttributes, false);
+    if(isPlaced == true)
+    {
+        restorePlacement();
+    }
+
+    return childPid;
+}
+
+/*************************************************************************************************
+** Name: parallelChildDone
+**
+** Description: This function is called by checkBackgroundStatus for every child it reaps which is not
+** part of a background job. When the child belongs to the running parallel command its slot is freed
+** to be refilled and its resources are added to those of the run. A child which failed is reported
+** along with its input, and one which was stopped by SIGINT stops any more inputs being started.
+**
+** Parameters: PID of the child, its exit method, resources it used
+**
+** Returns: true if the child belonged to parallel, false otherwise
+*************************************************************************************************/
+
+bool parallelChildDone(pid_t pid, int exitMethod, const struct rusage *usage)
+{
+    struct parallelRun *run = activeParallel;
+    if(run == NULL)
+    {
+        return false;
+    }
+
+    int slot;
+    for(slot = 0; slot < run->numSlots; slot++)
+    {
+        if(run->slotPids[slot] == pid)
+        {
+            break;
+        }
+    }
+
+    if(slot == run->numSlots)
+    {
+        return false;
+    }
+
+    run->slotPids[slot] = -1;
+    run->numRunning--;
+    run->numDone++;
+    addUsage(&run->usage, usage);
+
+    const char *input = run->inputs[run->slotInputs[slot]];
+    if(WIFSIGNALED(exitMethod))
+    {
+        run->numFailed++;
+        fprintf(stderr, "parallel: %s: terminated by signal %d\n", input, WTERMSIG(exitMethod));
+        fflush(stderr);
+
+        if(WTERMSIG(exitMethod) == SIGINT)
+        {
+            run->interrupted = true;
+        }
+    }
+    else if(WEXITSTATUS(exitMethod) != 0)
+    {
+        run->numFailed++;
+        fprintf(stderr, "parallel: %s: exit value %d\n", input, WEXITSTATUS(exitMethod));
+        fflush(stderr);
+    }
+
+    return true;
+}
+
+/*************************************************************************************************
+** Name: setPipeSize
+**
+** Description: This function optionally grows the kernel buffer of a pipe between two stages. When
+** the SMALLSH_PIPESIZE environment variable holds a size in bytes, the pipe is resized with
+** F_SETPIPE_SZ so stages moving a lot of data wake each other up less often. A size the kernel does
+** not accept simply leaves the pipe at its default size.
+**
+** Parameters: file descriptor of either end of the pipe
+**
+** Returns: N/A
+*************************************************************************************************/
+
+void setPipeSize(int pipeFd)
+{
+    const char *pipeSize = variableValue("SMALLSH_PIPESIZE", 16);
+
+    if(pipeFd != -1 && pipeSize != NULL && atoi(pipeSize) > 0)
+    {
+        fcntl(pipeFd, F_SETPIPE_SZ, atoi(pipeSize));
+    }
+}
+
+/*************************************************************************************************
+** Name: executeCommand
+**
+** Description: This function simply calls helper functions for I/O handling, looking up where the
+** command lives, calling posix_spawn to run the command entered and its arguments, and a function
+** which handles the situation for the command not running due to bad command entry. A function or a
+** built in which has no program of its own is started by forkStage instead. A command which cannot
+** be found on PATH is reported without creating a child at all, and an executable file the kernel
+** cannot run, a script without a #! line, is run by /bin/sh instead. Files opened for redirection
+** are only needed until the child has its own copies so they are closed again once the spawn has
+** returned. The first stage of a foreground job under job control makes its process group the
+** foreground one of the terminal itself before it starts, so the command never runs without the
+** terminal.
+**
+** Parameters: command of the pipeline to run, boolean value determining if process runs in
+** background, pipe ends the command reads from and writes to (-1 if none), pipe its output and
+** errors are captured in (-1 if none), attributes describing the signal state of the child, boolean
+** indicating if the child takes the terminal
+**
+** Returns: PID of the child or -1 if it could not be started
+*************************************************************************************************/
+
+pid_t executeCommand(struct commandStage *stage, bool runBackground, int inputPipe, int outputPipe, int captureFd, const posix_spawnattr_t *spawnAttributes, bool takeTerminal)
+{
+    // functions and built ins without a program of their own need the shell to run them
+    if(runsInShell(stage->argv[0]) == true)
+    {
+        return forkStage(stage, runBackground, inputPipe, outputPipe, captureFd, spawnAttributes, takeTerminal);
+    }
+
+    pid_t spawnPid = -1;
+
+    posix_spawn_file_actions_t fileActions;
+    posix_spawn_file_actions_init(&fileActions);
+
+    // the child makes its process group the foreground one before it can touch the terminal
+    if(takeTerminal == true)
+    {
+        posix_spawn_file_actions_addtcsetpgrp_np(&fileActions, STDIN_FILENO);
+    }
+
+    int openedFds[MAX_ARGS];
+    int numOpened = 0;
+
+    // check and process any redirection entered as commands
+    double redirectStart = traceTime();
+    bool isRedirected = ioRedirect(stage, runBackground, inputPipe, outputPipe, captureFd, &fileActions, openedFds, &numOpened);
+    traceEvent("redirect", 0, redirectStart, NULL);
+
+    if(isRedirected == true)
+    {
+        // find the command in the shell so an unknown command never gets as far as a child
+        double lookupStart = traceTime();
+        const char *commandPath = lookupCommand(stage->argv[0]);
+        int spawnResult = ENOENT;
+        traceEvent("lookup", 0, lookupStart, stage->argv[0]);
+
+        // call spawn to start processing command and arguments. it returns once the child has run exec
+        if(commandPath != NULL)
+        {
+            double spawnStart = traceTime();
+            spawnResult = posix_spawn(&spawnPid, commandPath, &fileActions, spawnAttributes, stage->argv, stageEnvironment(stage));
+
+            // a file without a #! line is a script for /bin/sh, the way execvp runs it
+            if(spawnResult == ENOEXEC)
+            {
+                char **shellArgs = arenaAlloc(&lineArena, (stage->argc + 2) * sizeof(char *));
+                shellArgs[0] = "/bin/sh";
+                shellArgs[1] = (char *)commandPath;
+                memcpy(&shellArgs[2], &stage->argv[1], stage->argc * sizeof(char *));
+                spawnResult = posix_spawn(&spawnPid, "/bin/sh", &fileActions, spawnAttributes, shellArgs, stageEnvironment(stage));
+            }
+            traceEvent("spawn", 0, spawnStart, commandPath);
+        }
+
+        // this code only reached if spawn has failed. will output error
+        if(spawnResult != 0)
+        {
+            spawnPid = -1;
+            execError(spawnResult);
+        }
+    }
+
+    // the child has its own copies of the redirected files now
+    int i;
+    for(i = 0; i < numOpened; i++)
+    {
+        close(openedFds[i]);
+    }
+
+    posix_spawn_file_actions_destroy(&fileActions);
+
+    return spawnPid;
+}
+
+/*************************************************************************************************
+** Name: stageEnvironment
+**
+** Description: This function makes the environment a stage of a pipeline is spawned with. A stage
+** without assignments gets the environment of the shell, and one with them gets a copy of it made
+** in the line arena where every variable the stage assigns has its new value.
+**
+** Parameters: command of the pipeline
+**
+** Returns: NULL terminated environment for the command
+*************************************************************************************************/
+
+char** stageEnvironment(struct commandStage *stage)
+{
+    if(stage->numAssignments == 0)
+    {
+        return environ;
+    }
+
+    int numEnvironment = 0;
+    while(environ[numEnvironment] != NULL)
+    {
+        numEnvironment++;
+    }
+
+    char **environment = arenaAlloc(&lineArena, (numEnvironment + stage->numAssignments + 1) * sizeof(char *));
+    int numVariables = 0;
+
+    // leave out the variables the stage gives new values
+    int i;
+    for(i = 0; i < numEnvironment; i++)
+    {
+        bool isAssigned = false;
+        int j;
+        for(j = 0; j < stage->numAssignments && isAssigned == false; j++)
+        {
+            size_t length = strchr(stage->assignments[j], '=') - stage->assignments[j] + 1;
+            isAssigned = strncmp(environ[i], stage->assignments[j], length) == 0;
+        }
+        if(isAssigned == false)
+        {
+            environment[numVariables++] = environ[i];
+        }
+    }
+
+    for(i = 0; i < stage->numAssignments; i++)
+    {
+        environment[numVariables++] = stage->assignments[i];
+    }
+    environment[numVariables] = NULL;
+
+    return environment;
+}
+
+/*************************************************************************************************
+** Name: runsInShell
+**
+** Description: This function checks if a command is a function or a built in which has no program
+** of its own, so it can only be run by the shell.
+**
+** Parameters: name of the command
+**
+** Returns: true if the shell has to run the command, false if it can be spawned
+*************************************************************************************************/
+
+bool runsInShell(const char *commandName)
+{
+    static const char *builtInNames[] = {":", "bg", "break", "cd", "continue", "exit", "export", "fg", "hash", "history", "joblog",
+                                         "jobs", "parallel", "return", "setaffinity", "status", "trace", "wait"};
+
+    if(findFunction(commandName) != -1)
+    {
+        return true;
+    }
+
+    size_t i;
+    for(i = 0; i < sizeof(builtInNames) / sizeof(builtInNames[0]); i++)
+    {
+        if(strcmp(commandName, builtInNames[i]) == 0)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*************************************************************************************************
+** Name: forkStage
+**
+** Description: This function starts a command which only the shell can run, a function or a built
+** in without a program of its own, as a stage of a pipeline or in the background. A copy of the
+** shell is forked and given the process group, terminal and signal state the spawn attributes
+** describe, except that SIGCHLD stays blocked for the signalfd of the copy. The process group is
+** set by the shell as well, so a later stage can join it whichever of them runs first. The copy
+** connects the pipes and applies the redirections of the command itself, the same way ioRedirect
+** has a spawned child do, runs the command like the shell would and leaves with its exit value.
+** Like the shell, the copy holds SIGTSTP while it waits on a command of its own, so cntrl+z stops
+** it once that command is done.
+**
+** Parameters: command of the pipeline to run, boolean value determining if process runs in
+** background, pipe ends the command reads from and writes to (-1 if none), pipe its output and
+** errors are captured in (-1 if none), attributes describing the signal state of the child, boolean
+** indicating if the child takes the terminal
+**
+** Returns: PID of the copy or -1 if it could not be started
+*************************************************************************************************/
+
+pid_t forkStage(struct commandStage *stage, bool runBackground, int inputPipe, int outputPipe, int captureFd, const posix_spawnattr_t *spawnAttributes, bool takeTerminal)
+{
+    short spawnFlags;
+    pid_t processGroup = 0;
+    posix_spawnattr_getflags(spawnAttributes, &spawnFlags);
+    posix_spawnattr_getpgroup(spawnAttributes, &processGroup);
+
+    // nothing buffered may be written twice
+    fflush(stdout);
+    fflush(stderr);
+    if(traceFile != NULL)
+    {
+        fflush(traceFile);
+    }
+
+    pid_t copyPid = fork();
+    if(copyPid == -1)
+    {
+        perror("ERROR: Unable to fork");
+        fflush(stderr);
+        childExitMethod = W_EXITCODE(1, 0);
+        return -1;
+    }
+
+    if(copyPid > 0)
+    {
+        if(spawnFlags & POSIX_SPAWN_SETPGROUP)
+        {
+            setpgid(copyPid, processGroup == 0 ? copyPid : processGroup);
+        }
+        return copyPid;
+    }
+
+    if(spawnFlags & POSIX_SPAWN_SETPGROUP)
+    {
+        setpgid(0, processGroup);
+    }
+    if(takeTerminal == true)
+    {
+        tcsetpgrp(STDIN_FILENO, getpgrp());
+    }
+
+    sigset_t signalSet;
+    posix_spawnattr_getsigdefault(spawnAttributes, &signalSet);
+    int signo;
+    for(signo = 1; signo < NSIG; signo++)
+    {
+        if(sigismember(&signalSet, signo) == 1)
+        {
+            signal(signo, SIG_DFL);
+        }
+    }
+    posix_spawnattr_getsigmask(spawnAttributes, &signalSet);
+    sigaddset(&signalSet, SIGCHLD);
+    sigprocmask(SIG_SETMASK, &signalSet, NULL);
+
+    becomeCopy();
+
+    // the pipes, /dev/null and capture pipe a spawned child would get
+    if(outputPipe != -1)
+    {
+        dup2(outputPipe, STDOUT_FILENO);
+    }
+    if(inputPipe != -1)
+    {
+        dup2(inputPipe, STDIN_FILENO);
+    }
+    if(runBackground == true && outputPipe == -1 && captureFd != -1)
+    {
+        dup2(captureFd, STDOUT_FILENO);
+    }
+    else if(runBackground == true && outputPipe == -1)
+    {
+        int nullFd = open("/dev/null", O_WRONLY | O_CLOEXEC);
+        dup2(nullFd, STDOUT_FILENO);
+        close(nullFd);
+    }
+    if(captureFd != -1)
+    {
+        dup2(captureFd, STDERR_FILENO);
+    }
+    if(runBackground == true && inputPipe == -1)
+    {
+        int nullFd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+        dup2(nullFd, STDIN_FILENO);
+        close(nullFd);
+    }
+
+    struct savedDescriptors saved;
+    if(redirectBuiltIn(stage, &saved) == false)
+    {
+        _exit(1);
+    }
+
+    // the assignments before the command are only made in the copy
+    int i;
+    for(i = 0; i < stage->numAssignments; i++)
+    {
+        char *value = strchr(stage->assignments[i], '=');
+        *value = '\0';
+        exportVariable(stage->assignments[i], value + 1);
+    }
+
+    // the redirections are in place, so the command runs without them
+    struct commandStage bareStage = *stage;
+    bareStage.numRedirections = 0;
+
+    int functionIndex = findFunction(stage->argv[0]);
+    if(functionIndex != -1)
+    {
+        callFunction(functionIndex, &bareStage);
+    }
+    else if(strcmp(stage->argv[0], "break") == 0 || strcmp(stage->argv[0], "continue") == 0 || strcmp(stage->argv[0], "return") == 0)
+    {
+        childExitMethod = W_EXITCODE(flowCommand(stage->argv), 0);
+    }
+    else
+    {
+        struct pipeline stagePipeline = {0};
+        stagePipeline.stages = &bareStage;
+        stagePipeline.numStages = 1;
+        stagePipeline.text = stage->argv[0];
+        builtInFunctions(&stagePipeline, &terminateFgChild, &ignoreSIGTSTP);
+    }
+
+    fflush(stdout);
+    fflush(stderr);
+    _exit(exitValue(childExitMethod));
+}
+
+/*************************************************************************************************
+** Name: ioRedirect
+**
+** Description: This function handles redirection of the commands. A command inside a pipeline first
+** gets the pipe ends it shares with its neighbours duplicated onto its standard input and output.
+** The function pre-emptively sets any input and output of background commands not connected to a
+** pipe to /dev/null with input and output permissions set respectively, unless the job is captured,
+** when its output and errors go to the capture pipe instead. The redirections the parser found for
+** the command are then turned into a plan by planRedirections, which opens every file in the shell
+** itself and checks every descriptor, so a redirection which cannot be done is reported before any
+** child is created. Each step of the plan becomes a dup2 or close file action which the child
+** carries out in order before the command starts.
+**
+** SOURCE code modified from professors code in LECTURE 3.4 slide 12
+**
+** Parameters: command of the pipeline, boolean indicating if background process, pipe ends to
+** connect to standard input and output (-1 if none), capture pipe (-1 if none), file actions for
+** the spawn, array and count of file descriptors opened which the caller closes after spawning
+**
+** Returns: true if every redirection could be set up, false otherwise
+*************************************************************************************************/
+
+bool ioRedirect(struct commandStage *stage, bool runBackground, int inputPipe, int outputPipe, int captureFd, posix_spawn_file_actions_t *fileActions, int *openedFds, int *numOpened)
+{
+    // stages of a pipeline are connected to their neighbours through pipes
+    if(outputPipe != -1)
+    {
+        posix_spawn_file_actions_adddup2(fileActions, outputPipe, 1);
+    }
+    if(inputPipe != -1)
+    {
+        posix_spawn_file_actions_adddup2(fileActions, inputPipe, 0);
+    }
+
+    // assumes no redirection was given to background command
+    if(runBackground == true && outputPipe == -1 && captureFd != -1)
+    {
+        posix_spawn_file_actions_adddup2(fileActions, captureFd, 1);
+    }
+    else if(runBackground == true && outputPipe == -1)
+    {
+        // use /dev/null as file name and allow writing to file
+        posix_spawn_file_actions_addopen(fileActions, 1, "/dev/null", O_WRONLY, 0644);
+    }
+    if(captureFd != -1)
+    {
+        posix_spawn_file_actions_adddup2(fileActions, captureFd, 2);
+    }
+    if(runBackground == true && inputPipe == -1)
+    {
+        // use /dev/null as file name and allow reading from file
+        posix_spawn_file_actions_addopen(fileActions, 0, "/dev/null", O_RDONLY, 0);
+    }
+
+    // work out every redirection in the shell before the child exists
+    struct redirectStep steps[2 * MAX_ARGS];
+    int numSteps = 0;
+    if(planRedirections(stage, steps, &numSteps, openedFds, numOpened) == false)
+    {
+        return false;
+    }
+
+    int i;
+    for(i = 0; i < numSteps; i++)
+    {
+        if(steps[i].sourceFd == -1)
+        {
+            posix_spawn_file_actions_addclose(fileActions, steps[i].targetFd);
+        }
+        else
+        {
+            posix_spawn_file_actions_adddup2(fileActions, steps[i].sourceFd, steps[i].targetFd);
+        }
+    }
+
+    return true;
+}
+
+/*************************************************************************************************
+** Name: planRedirections
+**
+** Description: This function turns the redirections of a command into a plan of steps, each putting a
+** descriptor onto one of descriptors 0 to 9 or closing it, to be carried out in order. A redirection
+** applies to the descriptor written before its operator or else to standard input for <, <>, <&, <<
+** and <<<, and to standard output for the others, and &> also points standard error at the file.
+** Files are opened here in the shell, close-on-exec and above descriptor 9 so no step can overwrite
+** one before it is used. An n>&m or n<&m copies descriptor m, which has to be open either from an
+** earlier step or in the shell without close-on-exec, so internal descriptors of the shell are never
+** handed out, and n>&- closes n. A >& followed by something other than a descriptor is the same as &>.
+** Any problem is reported and fails the whole plan.
+**
+** Parameters: command of the line, array and count of steps to fill in, array and count of file
+** descriptors opened which the caller closes once the steps are carried out
+**
+** Returns: true if every redirection is valid, false otherwise
+*************************************************************************************************/
+
+bool planRedirections(struct commandStage *stage, struct redirectStep *steps, int *numSteps, int *openedFds, int *numOpened)
+{
+    // what the plan has done to descriptors 0 to 9 so far. 0 untouched, 1 open, -1 closed
+    int plannedFds[10] = {0};
+    *numSteps = 0;
+
+    int i;
+    for(i = 0; i < stage->numRedirections; i++)
+    {
+        struct redirection *fileRedirection = &stage->redirections[i];
+        enum tokenType type = fileRedirection->type;
+        bool isInput = type == TOKEN_LESS || type == TOKEN_LESSGREAT || type == TOKEN_LESSAND ||
+                       type == TOKEN_HEREDOC || type == TOKEN_HERESTRING;
+        int targetFd = fileRedirection->fd != -1 ? fileRedirection->fd : (isInput == true ? 0 : 1);
+        int sourceFd;
+
+        const char *target = fileRedirection->target;
+        bool isDescriptor = (type == TOKEN_LESSAND || type == TOKEN_GREATAND) &&
+                            (strcmp(target, "-") == 0 || (isdigit((unsigned char)target[0]) && target[1] == '\0'));
+
+        if(isDescriptor == true && target[0] == '-')
+        {
+            sourceFd = -1;
+        }
+        else if(isDescriptor == true)
+        {
+            // the descriptor copied has to be one the command is meant to have
+            sourceFd = target[0] - '0';
+            int fdFlags = fcntl(sourceFd, F_GETFD);
+            if(plannedFds[sourceFd] == -1 || (plannedFds[sourceFd] == 0 && (fdFlags == -1 || (fdFlags & FD_CLOEXEC))))
+            {
+                fprintf(stderr, "ERROR: %s: bad file descriptor\n", target);
+                fflush(stderr);
+                childExitMethod = W_EXITCODE(1, 0);
+                return false;
+            }
+        }
+        else
+        {
+            if(type == TOKEN_LESSAND || (type == TOKEN_GREATAND && fileRedirection->fd != -1))
+            {
+                fprintf(stderr, "ERROR: %s: ambiguous redirect\n", target);
+                fflush(stderr);
+                childExitMethod = W_EXITCODE(1, 0);
+                return false;
+            }
+
+            sourceFd = openRedirection(fileRedirection);
+
+            // error handling
+            if(sourceFd == -1)
+            {
+                if(type == TOKEN_HEREDOC || type == TOKEN_HERESTRING)
+                {
+                    perror("ERROR: Cannot create here-document");
+                }
+                else if(isInput == true)
+                {
+                    // taken from lecture 3.4
+                    perror("ERROR: open() failed. Cannot input to file");
+                }
+                else
+                {
+                    perror("ERROR: open() failed. Cannot output to file");
+                }
+                fflush(stderr);
+                childExitMethod = W_EXITCODE(1, 0);
+                return false;
+            }
+
+            openedFds[(*numOpened)++] = sourceFd;
+        }
+
+        steps[*numSteps].targetFd = targetFd;
+        steps[(*numSteps)++].sourceFd = sourceFd;
+        plannedFds[targetFd] = sourceFd == -1 ? -1 : 1;
+
+        // &> sends standard error to the same file
+        if(type == TOKEN_ANDGREAT || (type == TOKEN_GREATAND && isDescriptor == false))
+        {
+            steps[*numSteps].targetFd = 2;
+            steps[(*numSteps)++].sourceFd = 1;
+            plannedFds[2] = 1;
+        }
+    }
+
+    return true;
+}
+
+/*************************************************************************************************
+** Name: openRedirection
+**
+** Description: This function opens the file of a redirection with the flags its operator calls for,
+** or puts the text of a here-document or here-string in memory. The descriptor is close-on-exec and
+** is moved above descriptor 9 so it is never one a redirection can name.
+**
+** Parameters: redirection to open
+**
+** Returns: file descriptor or -1 if it could not be opened
+*************************************************************************************************/
+
+int openRedirection(struct redirection *fileRedirection)
+{
+    int fileDescriptor;
+
+    switch(fileRedirection->type)
+    {
+        case TOKEN_LESS:
+            fileDescriptor = open(fileRedirection->target, O_RDONLY | O_CLOEXEC, 0);
+            break;
+
+        case TOKEN_LESSGREAT:
+            fileDescriptor = open(fileRedirection->target, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+            break;
+
+        case TOKEN_DGREAT:
+            fileDescriptor = open(fileRedirection->target, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+            break;
+
+        case TOKEN_HEREDOC:
+        case TOKEN_HERESTRING:
+            fileDescriptor = hereDocumentFd(fileRedirection->target, fileRedirection->type == TOKEN_HERESTRING);
+            break;
+
+        default:
+            // taken from lecture 3.4
+            fileDescriptor = open(fileRedirection->target, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+            break;
+    }
+
+    return highDescriptor(fileDescriptor);
+}
+
+/*************************************************************************************************
+** Name: highDescriptor
+**
+** Description: This function moves a descriptor the shell keeps for itself above descriptor 9, so
+** a redirection applied to the shell for a built in never replaces it. The copy is close-on-exec.
+**
+** Parameters: descriptor to move, which is closed once it has been copied
+**
+** Returns: descriptor 10 or above, or -1 if there was none to move or it could not be copied
+*************************************************************************************************/
+
+int highDescriptor(int fileDescriptor)
+{
+    if(fileDescriptor != -1 && fileDescriptor < 10)
+    {
+        int highFd = fcntl(fileDescriptor, F_DUPFD_CLOEXEC, 10);
+        close(fileDescriptor);
+        fileDescriptor = highFd;
+    }
+
+    return fileDescriptor;
+}
+
+/*************************************************************************************************
+** Name: lookupCommand
+**
+** Description: This function finds the file a command name runs so the shell can spawn the absolute
+** path directly instead of having every PATH directory tried in the child. A name containing a / is
+** used as it is. Otherwise the name is looked up in the command cache first. A cached location is
+** only trusted while PATH is the same as when it was found and the directory it was found in has not
+** been modified since, which is checked with a single stat of that directory. When the cache has no
+** usable entry every directory of PATH is searched for an executable regular file of that name and
+** the result is cached. Commands found through a relative PATH directory depend on the current
+** directory and are never cached.
+**
+** Parameters: name of the command
+**
+** Returns: path to run or NULL if the command was not found
+*************************************************************************************************/
+
+const char* lookupCommand(const char *commandName)
+{
+    if(strchr(commandName, '/') != NULL)
+    {
+        return commandName;
+    }
+
+    const char *pathVariable = variableValue("PATH", 4);
+    if(pathVariable == NULL)
+    {
+        pathVariable = "/bin:/usr/bin";
+    }
+
+    // a different PATH may find different commands so forget everything found with the old one
+    if(commandCache.pathCopy == NULL || strcmp(commandCache.pathCopy, pathVariable) != 0)
+    {
+        clearCommandCache();
+        commandCache.pathCopy = strdup(pathVariable);
+    }
+
+    struct stat fileInfo;
+    int slot = findCachedCommand(commandName);
+
+    if(slot != -1)
+    {
+        struct commandEntry *cachedEntry = &commandCache.entries[slot];
+
+        // the entry is good as long as its directory has not changed
+        cachedEntry->path[cachedEntry->dirLength] = '\0';
+        bool dirUnchanged = stat(cachedEntry->path, &fileInfo) == 0
+                            && fileInfo.st_mtim.tv_sec == cachedEntry->dirMtime.tv_sec
+                            && fileInfo.st_mtim.tv_nsec == cachedEntry->dirMtime.tv_nsec;
+        cachedEntry->path[cachedEntry->dirLength] = '/';
+
+        if(dirUnchanged == true)
+        {
+            cachedEntry->hits++;
+            return cachedEntry->path;
+        }
+
+        deleteCachedCommand(slot);
+    }
+
+    // search every directory of PATH in order. an empty entry means the current directory
+    const char *dirStart = pathVariable;
+    while(true)
+    {
+        size_t dirLength = strcspn(dirStart, ":");
+        size_t candidateSize = dirLength + strlen(commandName) + 3;
+        char *candidate = malloc(candidateSize);
+        if(candidate == NULL)
+        {
+            perror("ERROR: Unable to look up the command");
+            fflush(stderr);
+            return NULL;
+        }
+
+        if(dirLength == 0)
+        {
+            snprintf(candidate, candidateSize, "./%s", commandName);
+        }
+        else
+        {
+            snprintf(candidate, candidateSize, "%.*s/%s", (int)dirLength, dirStart, commandName);
+        }
+
+        if(stat(candidate, &fileInfo) == 0 && S_ISREG(fileInfo.st_mode) && access(candidate, X_OK) == 0)
+        {
+            // relative directories change meaning with cd so they are resolved every time
+            if(candidate[0] != '/')
+            {
+                free(lookupScratch);
+                lookupScratch = candidate;
+                return candidate;
+            }
+
+            size_t candidateDirLength = strrchr(candidate, '/') - candidate;
+            candidate[candidateDirLength] = '\0';
+            stat(candidate, &fileInfo);
+            candidate[candidateDirLength] = '/';
+
+            return insertCachedCommand(commandName, candidate, candidateDirLength, &fileInfo.st_mtim);
+        }
+
+        free(candidate);
+
+        if(dirStart[dirLength] == '\0')
+        {
+            break;
+        }
+        dirStart += dirLength + 1;
+    }
+
+    return NULL;
+}
+
+/*************************************************************************************************
+** Name: hashCommandName
+**
+** Description: This function computes the FNV-1a hash of a command name which picks the slot the
+** search for the name starts at in the command cache.
+**
+** Parameters: name of the command
+**
+** Returns: hash of the name
+*************************************************************************************************/
+
+unsigned int hashCommandName(const char *commandName)
+{
+    unsigned int nameHash = 2166136261u;
+
+    while(*commandName != '\0')
+    {
+        nameHash = (nameHash ^ (unsigned char)*commandName++) * 16777619u;
+    }
+
+    return nameHash;
+}
+
+/*************************************************************************************************
+** Name: findCachedCommand
+**
+** Description: This function looks up a command name in the command cache which is an open addressing
+** hash table using linear probing. The search stops at the first empty slot.
+**
+** Parameters: name of the command
+**
+** Returns: slot of the entry or -1 if the name is not cached
+*************************************************************************************************/
+
+int findCachedCommand(const char *commandName)
+{
+    if(commandCache.capacity == 0)
+    {
+        return -1;
+    }
+
+    unsigned int mask = commandCache.capacity - 1;
+    unsigned int slot = hashCommandName(commandName) & mask;
+
+    while(commandCache.entries[slot].name != NULL)
+    {
+        if(strcmp(commandCache.entries[slot].name, commandName) == 0)
+        {
+            return slot;
+        }
+        slot = (slot + 1) & mask;
+    }
+
+    return -1;
+}
+
+/*************************************************************************************************
+** Name: insertCachedCommand
+**
+** Description: This function adds a command and the path it was found at to the command cache. The
+** cache is kept at most half full and doubles in size when needed. Along with the path the length of
+** its directory part and the modification time of that directory are kept to validate the entry.
+**
+** Parameters: name of the command, allocated path which the cache takes ownership of, length of the
+** directory part of the path, modification time of the directory
+**
+** Returns: the path as stored in the cache
+*************************************************************************************************/
+
+const char* insertCachedCommand(const char *commandName, char *path, size_t dirLength, const struct timespec *dirMtime)
+{
+    // keep the table at most half full so probe sequences stay short
+    if((commandCache.count + 1) * 2 > commandCache.capacity)
+    {
+        struct commandEntry *oldEntries = commandCache.entries;
+        int oldCapacity = commandCache.capacity;
+
+        commandCache.capacity = oldCapacity == 0 ? 64 : oldCapacity * 2;
+        commandCache.entries = calloc(commandCache.capacity, sizeof(struct commandEntry));
+
+        unsigned int mask = commandCache.capacity - 1;
+        int i;
+        for(i = 0; i < oldCapacity; i++)
+        {
+            if(oldEntries[i].name != NULL)
+            {
+                unsigned int slot = hashCommandName(oldEntries[i].name) & mask;
+                while(commandCache.entries[slot].name != NULL)
+                {
+                    slot = (slot + 1) & mask;
+                }
+                commandCache.entries[slot] = oldEntries[i];
+            }
+        }
+        free(oldEntries);
+    }
+
+    unsigned int mask = commandCache.capacity - 1;
+    unsigned int slot = hashCommandName(commandName) & mask;
+
+    while(commandCache.entries[slot].name != NULL)
+    {
+        slot = (slot + 1) & mask;
+    }
+
+    struct commandEntry *newEntry = &commandCache.entries[slot];
+    newEntry->name = strdup(commandName);
+    newEntry->path = path;
+    newEntry->dirLength = dirLength;
+    newEntry->dirMtime = *dirMtime;
+    newEntry->hits = 1;
+    commandCache.count++;
+
+    return path;
+}
+
+/*************************************************************************************************
+** Name: deleteCachedCommand
+**
+** Description: This function removes an entry from the command cache. So that lookups never stop
+** early at the hole left behind, the entries following it in the same probe sequence are shifted
+** back into it.
+**
+** Parameters: slot of the entry
+**
+** Returns: N/A
+*************************************************************************************************/
+
+void deleteCachedCommand(int slot)
+{
+    unsigned int mask = commandCache.capacity - 1;
+
+    free(commandCache.entries[slot].name);
+    free(commandCache.entries[slot].path);
+
+    // shift back any following entry whose home slot is at or before the hole
+    unsigned int hole = slot;
+    unsigned int next = (hole + 1) & mask;
+    while(commandCache.entries[next].name != NULL)
+    {
+        unsigned int home = hashCommandName(commandCache.entries[next].name) & mask;
+        if(((next - home) & mask) >= ((next - hole) & mask))
+        {
+            commandCache.entries[hole] = commandCache.entries[next];
+            hole = next;
+        }
+        next = (next + 1) & mask;
+    }
+
+    commandCache.entries[hole].name = NULL;
+    commandCache.entries[hole].path = NULL;
+    commandCache.count--;
+}
+
+/*************************************************************************************************
+** Name: clearCommandCache
+**
+** Description: This function forgets every command in the command cache along with the PATH the
+** entries were found with.
+**
+** Parameters: N/A
+**
+** Returns: N/A
+*************************************************************************************************/
+
+void clearCommandCache()
+{
+    int i;
+    for(i = 0; i < commandCache.capacity; i++)
+    {
+        free(commandCache.entries[i].name);
+        free(commandCache.entries[i].path);
+        commandCache.entries[i].name = NULL;
+        commandCache.entries[i].path = NULL;
+    }
+    commandCache.count = 0;
+
+    free(commandCache.pathCopy);
+    commandCache.pathCopy = NULL;
+}
+
+/*************************************************************************************************
+** Name: hashCommands
+**
+** Description: This function is the hash built-in which works like the one in bash. With no arguments
+** it lists every cached command with the number of times the cached location was used. With -r the
+** cache is cleared. Any other arguments are command names which are looked up and added to the cache,
+** reporting those which cannot be found.
+**
+** Parameters: tokenized string of user's input
+**
+** Returns: N/A
+*************************************************************************************************/
+
+void hashCommands(char **commandLine)
+{
+    childExitMethod = W_EXITCODE(0, 0);
+
+    // list the cache
+    if(commandLine[1] == NULL)
+    {
+        if(commandCache.count == 0)
+        {
+            printf("hash: hash table empty\n");
+        }
+        else
+        {
+            printf("hits\tcommand\n");
+
+            int i;
+            for(i = 0; i < commandCache.capacity; i++)
+            {
+                if(commandCache.entries[i].name != NULL)
+                {
+                    printf("%4d\t%s\n", commandCache.entries[i].hits, commandCache.entries[i].path);
+                }
+            }
+        }
+        fflush(stdout);
+        return;
+    }
+
+    int i;
+    for(i = 1; commandLine[i] != NULL; i++)
+    {
+        if(strcmp(commandLine[i], "-r") == 0)
+        {
+            clearCommandCache();
+        }
+        else if(findCachedCommand(commandLine[i]) == -1)
+        {
+            if(lookupCommand(commandLine[i]) == NULL)
+            {
+                fprintf(stderr, "hash: %s: not found\n", commandLine[i]);
+                fflush(stderr);
+                childExitMethod = W_EXITCODE(1, 0);
+            }
+            // adding a name by hand does not count as a use
+            else if(findCachedCommand(commandLine[i]) != -1)
+            {
+                commandCache.entries[findCachedCommand(commandLine[i])].hits = 0;
+            }
+        }
+    }
+}
+
+/*************************************************************************************************
+** Name: isBackgroundProcess
+**
+** Description: This function checks if the user's input ended with an & symbol, which the parser
+** has already taken off the command line so that it will not be passed on to the command. If so, the
+** user is requesting the process to be run in the background. Next, the function checks if the user is in
+** foreground only mode which ignores any requests to run in the background. If the user is in
+** normal mode and has requested the process to run in the background, the function returns true
+** If the user did not request the process to run in the background then the function returns false.
+**
+** Parameters: parsed command line of the user
+**
+** Returns: boolean variable true or false depending on whether the user requested the process
+** is to be run in the background or not. The request to run in the background is superseded by
+** a boolean which is set from a SIGTSTP sighandler.
+*************************************************************************************************/
+
+bool isBackgroundProcess(struct pipeline *commandPipeline)
+{
+    // if & was used last in command indicating background process
+    if(commandPipeline->background == true)
+    {
+        // if user has entered foreground only mode then it supersedes request
+        // for process to run in the background
+        if(isForegroundOnly == true)
+        {
+            return false;
+        }
+        // if user not in foreground mode and requested background process, allow it
+        else
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*************************************************************************************************
+** Name: execError
+**
+** Description: This function is used to handle the failure of posix_spawn which is called prior or
+** of a command which could not be found on PATH.
+** This function simply prints a message stating the user has entered an invalid command along with
+** the reason the spawn failed and records an EXIT FAILURE status for the command, the same status a
+** child which could not exec used to exit with. Note that this function will only trigger upon a
+** failed call to the posix_spawn function.
+**
+** Parameters: error number returned by the spawn
+**
+** Returns: N/A
+*************************************************************************************************/
+
+void execError(int errorNumber)
+{
+    errno = errorNumber;
+    perror("ERROR: the command you entered does not exist");
+    fflush(stderr);
+    childExitMethod = W_EXITCODE(EXIT_FAILURE, 0);
+}
+
+/*************************************************************************************************
+** Name: checkBackgroundStatus
+**
+** Description: This function checks on the status of background processes. Rather than asking every
+** background process in turn, it asks the kernel for any child which has terminated, stopped or
+** continued with wait4 on -1 and WNOHANG, so only processes which have actually changed are looked
+** at. Each of them is handed to noteChildStatus which updates and reports its job.
+** SOURCE : improvised from LECTURE CODE in 3.1 slide 26 updated with recommendations in notes
+**
+** Parameters: N/A
+**
+** Returns: number of background jobs reported as done or stopped
+*************************************************************************************************/
+
+int checkBackgroundStatus()
+{
+    int numReported = 0;
+    pid_t donePid;
+    int exitMethod;
+    int jobStatus;
+    struct rusage usage;
+
+    // wait only for children which have changed
+    while((donePid = wait4(-1, &exitMethod, WNOHANG | WUNTRACED | WCONTINUED, &usage)) > 0)
+    {
+        if(noteChildStatus(donePid, exitMethod, &usage, &jobStatus) > 0)
+        {
+            numReported++;
+        }
+    }
+
+    return numReported;
+}
+
+/*************************************************************************************************
+** Name: noteChildStatus
+**
+** Description: This function records what happened to a child reaped or seen stopping by wait4. The
+** PID is looked up in the job table hash to find its job, and one without a job is handed to the
+** parallel built in in case it is one of its children. A job which stops is marked and reported as
+** stopped and one which is continued is running again. A process which ended has the resources it
+** used added to those of its job, and if it was the last running stage of its job the function then
+** checks if a signal caused the termination. If a signal resulted in the child process ending, a
+** message displays stating the child process with stated PID has completed and the type of signal
+** that terminated it. Otherwise if a child process ends via normal methods, the function prints a
+** message stating the child is now done and its exit method. After a job has ended the resources it
+** used are reported if it was timed, and it is removed from the job table so it is not checked again.
+**
+** Parameters: PID of the child, its exit method, resources it used, set to the exit method of the
+** job when it is done or stopped
+**
+** Returns: number of the job if it is now done or stopped, 0 otherwise
+*************************************************************************************************/
+
+int noteChildStatus(pid_t pid, int exitMethod, const struct rusage *usage, int *jobStatus)
+{
+    int jobIndex = findJob(pid);
+
+    // any child which is not part of a background job may be one parallel started
+    if(jobIndex == -1)
+    {
+        if(WIFSTOPPED(exitMethod) == 0 && WIFCONTINUED(exitMethod) == 0)
+        {
+            parallelChildDone(pid, exitMethod, usage);
+        }
+        return 0;
+    }
+
+    struct job *doneJob = &jobTable.jobs[jobIndex];
+
+    // a stopped job stays in the table until it is continued
+    if(WIFSTOPPED(exitMethod))
+    {
+        if(doneJob->state == JOB_STOPPED)
+        {
+            return 0;
+        }
+        doneJob->state = JOB_STOPPED;
+        *jobStatus = W_EXITCODE(128 + WSTOPSIG(exitMethod), 0);
+        printf("[%d] Stopped\t%s\n", jobIndex + 1, doneJob->commandLine);
+        fflush(stdout);
+        return jobIndex + 1;
+    }
+    if(WIFCONTINUED(exitMethod))
+    {
+        doneJob->state = JOB_RUNNING;
+        return 0;
+    }
+
+    deletePid(pid);
+    doneJob->numLive--;
+    addUsage(&doneJob->usage, usage);
+
+    // the job ends the way its last stage did
+    if(pid == doneJob->pids[doneJob->numPids - 1])
+    {
+        doneJob->lastStatus = exitMethod;
+    }
+
+    // report the job only once all of its processes are done
+    if(doneJob->numLive > 0)
+    {
+        return 0;
+    }
+
+    doneJob->state = JOB_DONE;
+    pid_t jobPid = doneJob->pids[doneJob->numPids - 1];
+
+    // if process ended via signal display message with PID of process & termination value
+    if(WIFSIGNALED(doneJob->lastStatus))
+    {
+        printf("background pid %d is done: terminated by signal: %d\n", jobPid, WTERMSIG(doneJob->lastStatus));
+        fflush(stdout);
+    }
+    // if process ended normally display message with PID of process & its exit value
+    else if(WIFEXITED(doneJob->lastStatus))
+    {
+        printf("background pid %d is done: exit value: %d\n", jobPid, doneJob->lastStatus);
+        fflush(stdout);
+    }
+
+    if(doneJob->timed == true)
+    {
+        struct timespec wallTime;
+        elapsedSince(&doneJob->startTime, &wallTime);
+        printUsage(&wallTime, &doneJob->usage);
+    }
+
+    // the job spans its own track from when it was started to now
+    if(traceFile != NULL)
+    {
+        traceEvent("job", jobPid, doneJob->startTime.tv_sec * 1e6 + doneJob->startTime.tv_nsec / 1e3, doneJob->commandLine);
+    }
+
+    // remove the job from being checked again, keeping its status for wait
+    *jobStatus = doneJob->lastStatus;
+    recordReapedJob(jobPid, jobIndex + 1, doneJob->lastStatus);
+    removeJob(jobIndex);
+    return jobIndex + 1;
+}
+
+/*************************************************************************************************
+** Name: stopForegroundJob
+**
+** Description: This function turns a foreground job which was stopped with cntrl+z into a stopped
+** job in the job table, so it can be continued later with fg or bg. Only the stages which have not
+** been reaped yet are part of it.
+**
+** Parameters: PIDs of the stages not reaped yet, number of them, command line of the job, its
+** process group
+**
+** Returns: N/A
+*************************************************************************************************/
+
+void stopForegroundJob(const pid_t *pids, int numPids, const char *commandLine, pid_t pgid)
+{
+    pid_t jobPids[MAX_ARGS];
+    int numJobPids = 0;
+
+    int i;
+    for(i = 0; i < numPids; i++)
+    {
+        if(pids[i] > 0)
+        {
+            jobPids[numJobPids++] = pids[i];
+        }
+    }
+
+    int jobIndex = addJob(jobPids, numJobPids, commandLine);
+    jobTable.jobs[jobIndex].pgid = pgid;
+    jobTable.jobs[jobIndex].state = JOB_STOPPED;
+
+    printf("\n[%d] Stopped\t%s\n", jobIndex + 1, commandLine);
+    fflush(stdout);
+}
+
+/*************************************************************************************************
+** Name: setupJobControl
+**
+** Description: This function turns job control on for an interactive shell which is the foreground
+** process group of its terminal. The shell ignores SIGTTOU and SIGTTIN so it can take the terminal
+** back from a job while it is not the foreground group, and records the terminal modes so they can
+** be put back after every job.
+**
+** Parameters: N/A
+**
+** Returns: N/A
+*************************************************************************************************/
+
+void setupJobControl()
+{
+    shellPgid = getpgrp();
+    if(interactiveShell == false || tcgetpgrp(STDIN_FILENO) != shellPgid || tcgetattr(STDIN_FILENO, &shellTerminal) == -1)
+    {
+        return;
+    }
+
+    struct sigaction ignoreTerminal = {0};
+    ignoreTerminal.sa_handler = SIG_IGN;
+    sigaction(SIGTTOU, &ignoreTerminal, NULL);
+    sigaction(SIGTTIN, &ignoreTerminal, NULL);
+
+    jobControl = true;
+}
+
+/*************************************************************************************************
+** Name: catchSIGINT
+**
+** Description: This function is the handler for SIGINT while wait is blocked or a command runs at a
+** terminal. It interrupts the wait4 the built in is blocked in and asks for the rest of the command
+** to be stopped.
+**
+** Parameters: signal number
+**
+** Returns: N/A
+*************************************************************************************************/
+
+void catchSIGINT(int signo)
+{
+    interruptRequested = 1;
+}
+
+/*************************************************************************************************
+** Name: waitCommand
+**
+** Description: This function is the wait built in. With no arguments it waits until no background
+** job is running, with -n until the next one is done, and otherwise until every job named by %number
+** or by the PID of one of its processes is done. It blocks in wait4 until a child changes instead of
+** polling, only on the processes of the jobs named when it was given any, and every child reaped on
+** the way is reported like any other. A job which finished earlier, even before wait was called, is
+** answered with the status kept for it when it was reaped, and that status is then given up. A
+** stopped job counts as done so the shell is never left waiting on a job which cannot finish.
+** cntrl+c interrupts the wait.
+**
+** Parameters: string for user input which has been tokenized
+**
+** Returns: exit value of the last job waited for, 127 if there was no such job, 128 plus the signal
+** number if the wait was interrupted
+*************************************************************************************************/
+
+int waitCommand(char **commandLine)
+{
+    bool waitNext = commandLine[1] != NULL && strcmp(commandLine[1], "-n") == 0;
+    int targetJobs[MAX_ARGS];
+    int targetStatus[MAX_ARGS];
+    int numTargets = 0;
+    int result = 0;
+    bool nextDone = false;
+
+    int i;
+    for(i = waitNext == true ? 2 : 1; commandLine[i] != NULL; i++)
+    {
+        // a job which is already done is answered with the status kept for it
+        const char *jobName = commandLine[i];
+        char *numberEnd;
+        long number = strtol(jobName + (jobName[0] == '%' ? 1 : 0), &numberEnd, 10);
+        int reapedIndex = -1;
+        if(*numberEnd == '\0' && number > 0)
+        {
+            reapedIndex = jobName[0] == '%' ? findReapedJob(0, number) : findReapedJob(number, 0);
+        }
+
+        if(reapedIndex != -1)
+        {
+            targetJobs[numTargets] = -1;
+            targetStatus[numTargets] = reapedJobs[reapedIndex].exitMethod;
+            reapedJobs[reapedIndex].pid = 0;
+        }
+        else
+        {
+            targetJobs[numTargets] = findJobArgument(jobName, "wait");
+            targetStatus[numTargets] = targetJobs[numTargets] == -1 ? W_EXITCODE(127, 0) : -1;
+        }
+        numTargets++;
+    }
+
+    // cntrl+c makes wait4 return rather than being ignored
+    struct sigaction interruptWait = {0};
+    struct sigaction shellSIGINT;
+    interruptWait.sa_handler = catchSIGINT;
+    sigaction(SIGINT, &interruptWait, &shellSIGINT);
+
+    // jobs which finished before wait was called are reported now
+    if(drainSignalFd() == true)
+    {
+        checkBackgroundStatus();
+    }
+
+    while(true)
+    {
+        // see if what is being waited for is done yet
+        bool isRunning = false;
+        int jobIndex;
+        for(jobIndex = jobTable.liveHead; jobIndex != -1 && isRunning == false; jobIndex = jobTable.jobs[jobIndex].next)
+        {
+            isRunning = jobTable.jobs[jobIndex].state == JOB_RUNNING;
+        }
+
+        bool isWaiting = false;
+        pid_t waitPid = -1;
+        if(waitNext == true)
+        {
+            isWaiting = nextDone == false && isRunning == true;
+            if(isRunning == false && nextDone == false)
+            {
+                result = 127;
+            }
+        }
+        else if(numTargets == 0)
+        {
+            isWaiting = isRunning;
+        }
+        else
+        {
+            for(i = 0; i < numTargets; i++)
+            {
+                if(targetStatus[i] != -1)
+                {
+                    continue;
+                }
+
+                // a job reaped on the way has its status kept, and there is nothing to wait for on a
+                // stopped job
+                struct job *targetJob = &jobTable.jobs[targetJobs[i]];
+                int reapedIndex = findReapedJob(0, targetJobs[i] + 1);
+                if(reapedIndex != -1)
+                {
+                    targetStatus[i] = reapedJobs[reapedIndex].exitMethod;
+                    reapedJobs[reapedIndex].pid = 0;
+                }
+                else if(targetJob->state == JOB_STOPPED)
+                {
+                    targetStatus[i] = W_EXITCODE(128 + SIGTSTP, 0);
+                }
+                else if(isWaiting == false)
+                {
+                    // only a process of a job named is waited for, so other jobs are left alone
+                    int k;
+                    for(k = 0; k < targetJob->numPids && waitPid == -1; k++)
+                    {
+                        if(findJob(targetJob->pids[k]) == targetJobs[i])
+                        {
+                            waitPid = targetJob->pids[k];
+                        }
+                    }
+                    isWaiting = true;
+                }
+            }
+        }
+
+        if(isWaiting == false)
+        {
+            break;
+        }
+
+        int exitMethod;
+        int jobStatus;
+        struct rusage usage;
+        pid_t donePid = waitChild(waitPid, &exitMethod, WUNTRACED, &usage);
+        if(donePid == -1)
+        {
+            if(errno == EINTR)
+            {
+                printf("\n");
+                fflush(stdout);
+                result = 128 + SIGINT;
+            }
+            break;
+        }
+
+        int jobNumber = noteChildStatus(donePid, exitMethod, &usage, &jobStatus);
+        if(jobNumber != 0 && waitNext == true)
+        {
+            result = exitValue(jobStatus);
+            nextDone = true;
+        }
+    }
+
+    sigaction(SIGINT, &shellSIGINT, NULL);
+
+    if(numTargets > 0 && result == 0 && targetStatus[numTargets - 1] != -1)
+    {
+        result = exitValue(targetStatus[numTargets - 1]);
+    }
+
+    return result;
+}
+
+/*************************************************************************************************
+** Name: findJobArgument
+**
+** Description: This function finds the job a built in was given, written as %number or as the PID of
+** one of its processes, and reports when there is no such job.
+**
+** Parameters: job as it was written, name of the built in for the message
+**
+** Returns: slot of the job in the job table or -1 if there is no such job
+*************************************************************************************************/
+
+int findJobArgument(const char *jobName, const char *builtInName)
+{
+    char *numberEnd;
+    long jobNumber = strtol(jobName + (jobName[0] == '%' ? 1 : 0), &numberEnd, 10);
+    int jobIndex = -1;
+
+    if(*numberEnd == '\0' && numberEnd != jobName + (jobName[0] == '%' ? 1 : 0))
+    {
+        if(jobName[0] == '%')
+        {
+            if(jobNumber >= 1 && jobNumber <= jobTable.capacity &&
+               (jobTable.jobs[jobNumber - 1].state == JOB_RUNNING || jobTable.jobs[jobNumber - 1].state == JOB_STOPPED))
+            {
+                jobIndex = jobNumber - 1;
+            }
+        }
+        else if(jobNumber > 0)
+        {
+            jobIndex = findJob(jobNumber);
+        }
+    }
+
+    if(jobIndex == -1)
+    {
+        fprintf(stderr, "%s: %s: no such job\n", builtInName, jobName);
+        fflush(stderr);
+    }
+
+    return jobIndex;
+}
+
+/*************************************************************************************************
+** Name: foregroundCommand
+**
+** Description: This function is the fg built in. The job named, or the most recently started one, is
+** given the terminal and continued if it was stopped, then waited for in the foreground on its
+** process group like a command just entered. When it is done its status becomes the status of the
+** shell and it leaves the job table, and when it is stopped again it stays there as a stopped job.
+** The shell then takes the terminal back with the modes it had.
+**
+** Parameters: string for user input which has been tokenized
+**
+** Returns: 0 once the job has been waited for, 1 if there is no job control or no such job
+*************************************************************************************************/
+
+int foregroundCommand(char **commandLine)
+{
+    if(jobControl == false)
+    {
+        fprintf(stderr, "fg: no job control\n");
+        fflush(stderr);
+        return 1;
+    }
+
+    int jobIndex = commandLine[1] == NULL ? jobTable.liveHead : findJobArgument(commandLine[1], "fg");
+    if(jobIndex == -1)
+    {
+        if(commandLine[1] == NULL)
+        {
+            fprintf(stderr, "fg: no current job\n");
+            fflush(stderr);
+        }
+        return 1;
+    }
+
+    struct job *fgJob = &jobTable.jobs[jobIndex];
+    if(fgJob->pgid == 0)
+    {
+        fprintf(stderr, "fg: job %d was not started with job control\n", jobIndex + 1);
+        fflush(stderr);
+        return 1;
+    }
+
+    printf("%s\n", fgJob->commandLine);
+    fflush(stdout);
+
+    tcsetpgrp(STDIN_FILENO, fgJob->pgid);
+    if(fgJob->state == JOB_STOPPED)
+    {
+        kill(-fgJob->pgid, SIGCONT);
+    }
+    fgJob->state = JOB_RUNNING;
+
+    // wait on the process group until the job is done or stops again
+    while(fgJob->numLive > 0)
+    {
+        int exitMethod;
+        struct rusage usage;
+        pid_t donePid = waitChild(-fgJob->pgid, &exitMethod, WUNTRACED, &usage);
+        if(donePid == -1)
+        {
+            if(errno == EINTR)
+            {
+                continue;
+            }
+            break;
+        }
+
+        if(WIFSTOPPED(exitMethod))
+        {
+            fgJob->state = JOB_STOPPED;
+            childExitMethod = W_EXITCODE(128 + WSTOPSIG(exitMethod), 0);
+            printf("\n[%d] Stopped\t%s\n", jobIndex + 1, fgJob->commandLine);
+            fflush(stdout);
+            break;
+        }
+
+        deletePid(donePid);
+        fgJob->numLive--;
+        addUsage(&fgJob->usage, &usage);
+        if(donePid == fgJob->pids[fgJob->numPids - 1])
+        {
+            fgJob->lastStatus = exitMethod;
+        }
+    }
+
+    tcsetpgrp(STDIN_FILENO, shellPgid);
+    tcsetattr(STDIN_FILENO, TCSADRAIN, &shellTerminal);
+
+    if(fgJob->state == JOB_RUNNING)
+    {
+        childExitMethod = fgJob->lastStatus;
+        numPipeStages = 1;
+        pipeStatus[0] = childExitMethod;
+        if(WIFSIGNALED(childExitMethod))
+        {
+            printf("terminated by signal %d\n", WTERMSIG(childExitMethod));
+            fflush(stdout);
+        }
+        removeJob(jobIndex);
+    }
+
+    return 0;
+}
+
+/*************************************************************************************************
+** Name: backgroundCommand
+**
+** Description: This function is the bg built in. The stopped job named, or the most recently started
+** one, is continued in the background by sending SIGCONT to its process group.
+**
+** Parameters: string for user input which has been tokenized
+**
+** Returns: 0 if the job was continued, 1 otherwise
+*************************************************************************************************/
+
+int backgroundCommand(char **commandLine)
+{
+    int jobIndex = commandLine[1] == NULL ? jobTable.liveHead : findJobArgument(commandLine[1], "bg");
+    if(jobIndex == -1)
+    {
+        if(commandLine[1] == NULL)
+        {
+            fprintf(stderr, "bg: no current job\n");
+            fflush(stderr);
+        }
+        return 1;
+    }
+
+    struct job *bgJob = &jobTable.jobs[jobIndex];
+    if(bgJob->state != JOB_STOPPED)
+    {
+        fprintf(stderr, "bg: job %d is already running\n", jobIndex + 1);
+        fflush(stderr);
+        return 1;
+    }
+
+    if(bgJob->pgid != 0)
+    {
+        kill(-bgJob->pgid, SIGCONT);
+    }
+    else
+    {
+        int i;
+        for(i = 0; i < bgJob->numPids; i++)
+        {
+            kill(bgJob->pids[i], SIGCONT);
+        }
+    }
+    bgJob->state = JOB_RUNNING;
+    printf("[%d] %s &\n", jobIndex + 1, bgJob->commandLine);
+    fflush(stdout);
+    return 0;
+}
+
+/*************************************************************************************************
+** Name: addJob
+**
+** Description: This function adds a job to the job table. A slot is taken from the head of the free
+** list, and when no slot is free the table doubles in size and the new slots are put on the free
+** list. The job records the PIDs of its processes, a copy of its command line and the time it was
+** started, is linked onto the front of the running list, and each of its PIDs is added to the hash.
+**
+** Parameters: array of PIDs of the jobs processes, number of PIDs, command line of the job
+**
+** Returns: slot of the job in the job table
+*************************************************************************************************/
+
+int addJob(const pid_t *pids, int numPids, const char *commandLine)
+{
+    // grow the table when there is no free slot left
+    if(jobTable.freeHead == -1)
+    {
+        int newCapacity = jobTable.capacity == 0 ? 16 : jobTable.capacity * 2;
+        jobTable.jobs = realloc(jobTable.jobs, newCapacity * sizeof(struct job));
+
+        // chain all the new slots onto the free list in order
+        int i;
+        for(i = jobTable.capacity; i < newCapacity; i++)
+        {
+            jobTable.jobs[i].state = JOB_FREE;
+            jobTable.jobs[i].next = (i + 1 < newCapacity) ? i + 1 : -1;
+        }
+        jobTable.freeHead = jobTable.capacity;
+        jobTable.capacity = newCapacity;
+    }
+
+    // take the first free slot
+    int jobIndex = jobTable.freeHead;
+    struct job *newJob = &jobTable.jobs[jobIndex];
+    jobTable.freeHead = newJob->next;
+
+    newJob->pids = malloc(numPids * sizeof(pid_t));
+    memcpy(newJob->pids, pids, numPids * sizeof(pid_t));
+    newJob->numPids = numPids;
+    newJob->numLive = numPids;
+    newJob->lastStatus = 0;
+    newJob->commandLine = strdup(commandLine);
+    clock_gettime(CLOCK_MONOTONIC, &newJob->startTime);
+    memset(&newJob->usage, 0, sizeof(newJob->usage));
+    newJob->timed = false;
+    newJob->pgid = 0;
+    newJob->state = JOB_RUNNING;
+
+    // link the job onto the front of the running list
+    newJob->prev = -1;
+    newJob->next = jobTable.liveHead;
+    if(jobTable.liveHead != -1)
+    {
+        jobTable.jobs[jobTable.liveHead].prev = jobIndex;
+    }
+    jobTable.liveHead = jobIndex;
+
+    int i;
+    for(i = 0; i < numPids; i++)
+    {
+        insertPid(pids[i], jobIndex);
+    }
+
+    // the status kept for an earlier job with this number does not belong to the new one, nor does
+    // the one kept for an earlier process with the same PID
+    int reapedIndex;
+    while((reapedIndex = findReapedJob(0, jobIndex + 1)) != -1 || (reapedIndex = findReapedJob(pids[numPids - 1], 0)) != -1)
+    {
+        reapedJobs[reapedIndex].pid = 0;
+    }
+
+    return jobIndex;
+}
+
+/*************************************************************************************************
+** Name: removeJob
+**
+** Description: This function removes a job from the job table. Any of its PIDs still in the hash
+** are deleted, the job is unlinked from the running list, its memory is released and its slot is
+** put back on the free list to be used by the next job.
+**
+** Parameters: slot of the job in the job table
+**
+** Returns: N/A
+*************************************************************************************************/
+
+void removeJob(int jobIndex)
+{
+    struct job *oldJob = &jobTable.jobs[jobIndex];
+
+    // only processes not reaped yet are still in the hash
+    if(oldJob->numLive > 0)
+    {
+        int i;
+        for(i = 0; i < oldJob->numPids; i++)
+        {
+            deletePid(oldJob->pids[i]);
+        }
+    }
+
+    // unlink the job from the running list
+    if(oldJob->prev != -1)
+    {
+        jobTable.jobs[oldJob->prev].next = oldJob->next;
+    }
+    else
+    {
+        jobTable.liveHead = oldJob->next;
+    }
+    if(oldJob->next != -1)
+    {
+        jobTable.jobs[oldJob->next].prev = oldJob->prev;
+    }
+
+    free(oldJob->pids);
+    free(oldJob->commandLine);
+    oldJob->pids = NULL;
+    oldJob->commandLine = NULL;
+
+    // give the slot back to the free list
+    oldJob->state = JOB_FREE;
+    oldJob->next = jobTable.freeHead;
+    jobTable.freeHead = jobIndex;
+}
+
+/*************************************************************************************************
+** Name: findJob
+**
+** Description: This function looks up the job a PID belongs to in the pid hash of the job table.
+** The hash uses linear probing so the search starts at the slot the PID hashes to and stops at the
+** first empty entry.
+**
+** Parameters: PID to look for
+**
+** Returns: slot of the job in the job table or -1 if no running job has the PID
+*************************************************************************************************/
+
+int findJob(pid_t pid)
+{
+    if(jobTable.hashCapacity == 0)
+    {
+        return -1;
+    }
+
+    unsigned int mask = jobTable.hashCapacity - 1;
+    unsigned int slot = ((unsigned int)pid * 2654435761u) & mask;
+
+    while(jobTable.pidHash[slot].pid != 0)
+    {
+        if(jobTable.pidHash[slot].pid == pid)
+        {
+            return jobTable.pidHash[slot].jobIndex;
+        }
+        slot = (slot + 1) & mask;
+    }
+
+    return -1;
+}
+
+/*************************************************************************************************
+** Name: insertPid
+**
+** Description: This function adds a PID and the slot of its job to the pid hash. The hash is kept
+** at most half full, so before inserting it doubles in size when needed and every entry is placed
+** again in the larger hash.
+**
+** Parameters: PID to add, slot of its job in the job table
+**
+** Returns: N/A
+*************************************************************************************************/
+
+void insertPid(pid_t pid, int jobIndex)
+{
+    // keep the hash at most half full so probe sequences stay short
+    if((jobTable.hashCount + 1) * 2 > jobTable.hashCapacity)
+    {
+        struct pidEntry *oldHash = jobTable.pidHash;
+        int oldCapacity = jobTable.hashCapacity;
+
+        jobTable.hashCapacity = oldCapacity == 0 ? 64 : oldCapacity * 2;
+        jobTable.pidHash = calloc(jobTable.hashCapacity, sizeof(struct pidEntry));
+        jobTable.hashCount = 0;
+
+        int i;
+        for(i = 0; i < oldCapacity; i++)
+        {
+            if(oldHash[i].pid != 0)
+            {
+                insertPid(oldHash[i].pid, oldHash[i].jobIndex);
+            }
+        }
+        free(oldHash);
+    }
+
+    unsigned int mask = jobTable.hashCapacity - 1;
+    unsigned int slot = ((unsigned int)pid * 2654435761u) & mask;
+
+    while(jobTable.pidHash[slot].pid != 0)
+    {
+        slot = (slot + 1) & mask;
+    }
+
+    jobTable.pidHash[slot].pid = pid;
+    jobTable.pidHash[slot].jobIndex = jobIndex;
+    jobTable.hashCount++;
+}
+
+/*************************************************************************************************
+** Name: deletePid
+**
+** Description: This function removes a PID from the pid hash. So that lookups never stop early at the
+** hole left behind, the entries following it in the same probe sequence are shifted back into it
+** instead of leaving a marker for a deleted entry.
+**
+** Parameters: PID to remove
+**
+** Returns: N/A
+*************************************************************************************************/
+
+void deletePid(pid_t pid)
+{
+    if(jobTable.hashCapacity == 0)
+    {
+        return;
+    }
+
+    unsigned int mask = jobTable.hashCapacity - 1;
+    unsigned int slot = ((unsigned int)pid * 2654435761u) & mask;
+
+    // find the entry
+    while(jobTable.pidHash[slot].pid != pid)
+    {
+        if(jobTable.pidHash[slot].pid == 0)
+        {
+            return;
+        }
+        slot = (slot + 1) & mask;
+    }
+
+    // shift back any following entry whose home slot is at or before the hole
+    unsigned int hole = slot;
+    unsigned int next = (hole + 1) & mask;
+    while(jobTable.pidHash[next].pid != 0)
+    {
+        unsigned int home = ((unsigned int)jobTable.pidHash[next].pid * 2654435761u) & mask;
+        if(((next - home) & mask) >= ((next - hole) & mask))
+        {
+            jobTable.pidHash[hole] = jobTable.pidHash[next];
+            hole = next;
+        }
+        next = (next + 1) & mask;
+    }
+
+    jobTable.pidHash[hole].pid = 0;
+    jobTable.hashCount--;
+}
+
+/*************************************************************************************************
+** Name: recordReapedJob
+**
+** Description: This function keeps the exit status of a background job which is done, so wait can
+** still return it after the job has left the job table. The newest statuses are kept in a ring and
+** the oldest one is given up when it is full.
+**
+** Parameters: PID of the last stage of the job, its job number, its exit method
+**
+** Returns: N/A
+*************************************************************************************************/
+
+void recordReapedJob(pid_t pid, int jobNumber, int exitMethod)
+{
+    reapedJobs[nextReaped].pid = pid;
+    reapedJobs[nextReaped].jobNumber = jobNumber;
+    reapedJobs[nextReaped].exitMethod = exitMethod;
+    nextReaped = (nextReaped + 1) % MAX_REAPED;
+}
+
+/*************************************************************************************************
+** Name: findReapedJob
+**
+** Description: This function finds the kept status of a job which is done, by the PID of its last
+** stage or by its job number.
+**
+** Parameters: PID of the last stage of the job, or 0 to find it by its job number instead
+**
+** Returns: entry of the job in the reaped ring or -1 if no status is kept for it
+*************************************************************************************************/
+
+int findReapedJob(pid_t pid, int jobNumber)
+{
+    int entry;
+    for(entry = 0; entry < MAX_REAPED; entry++)
+    {
+        if(reapedJobs[entry].pid != 0 &&
+           (pid != 0 ? reapedJobs[entry].pid == pid : reapedJobs[entry].jobNumber == jobNumber))
+        {
+            return entry;
+        }
+    }
+
+    return -1;
+}
+
+/*************************************************************************************************
+** Name: catchSIGTSTP
+**
+** Description: This function is a signal handler used by the parent to display a message using
+** the write command to allow for re-entrance which states the mode the user is changing to. The
+** function handles the use of cntrl+z to change between foreground only mode: where requests to
+** send processes to teh background are ignored, and regular mode which operates as usual. The
+** function checks on a global variable isForegroundOnly which is originally set to false. The
+** function checks the status of the boolean and prints a message switching modes upon receipt
+** of the SIGTSTP signal and changes the variable to reflect the mode change. The isForegroundOnly
+** variable status is later used in another function that checks if a process should be run in the
+** background. The boolean variable used here will supersede calls to the background and ignore them
+** if Foreground only mode is set to active.
+**
+** Parameters: integer for signal number
+**
+** Returns: N/A
+*************************************************************************************************/
+
+void catchSIGTSTP(int signo)
+{
+    if(isForegroundOnly == false)
+    {
+        char *foreground = "Entering foreground-only mode (& is now ignored)\n";
+        write(STDOUT_FILENO, foreground, 49);
+
+        // change the status to reflect foreground only
+        isForegroundOnly = true;
+    }
+    else
+    {
+        char *fullShell = "Exiting foreground-only mode\n";
+        write(STDOUT_FILENO, fullShell, 29);
+
+        // change the status to reflect exit foreground
+        isForegroundOnly = false;
+    }
+}
+
+/*************************************************************************************************
+** Name: variableExpansion
+**
+** Description: This function expands the parameter starting at a $ and appends its value to the word
+** being built. $$ is the PID of the shell, $? the exit value of the last foreground command (128 plus
+** the signal number if a signal ended it), $! the PID of the last background job, $1 to $9 or ${n}
+** the positional parameters of the function being run or of the script, $# or ${#} how many there
+** are, $@ all of them separated by spaces and $* separated by the first character of IFS, $0 the
+** name of the shell, and $NAME or ${NAME} the value of that environment variable, which is empty if
+** it is not set. A $ followed by anything else is kept as it is. The value is appended straight onto
+** the end of the growable word buffer so a line is expanded in a single forward pass no matter how
+** many expansions it has and nothing is cut off at a fixed size. The PID of the shell never changes so it is only converted to a string once.
+**
+** Parameters: pointer to the $ in the line, word buffer to append the value to
+**
+** Returns: number of characters of the line used up, or 0 for a ${ without its closing }
+*************************************************************************************************/
+
+size_t variableExpansion(const char *dollarSign, struct stringBuffer *word)
+{
+    char valueString[24];
+    const char *nameStart = dollarSign + 1;
+
+    switch(*nameStart)
+    {
+        // the shells pid
+        case '$':
+            bufferAppend(word, shellPidString, shellPidLength);
+            return 2;
+
+        // exit value of the last foreground command
+        case '?':
+            bufferAppend(word, valueString, sprintf(valueString, "%d", exitValue(childExitMethod)));
+            return 2;
+
+        // pid of the last background job
+        case '!':
+            if(lastBackgroundPid > 0)
+            {
+                bufferAppend(word, valueString, sprintf(valueString, "%d", lastBackgroundPid));
+            }
+            return 2;
+
+        // number of positional parameters
+        case '#':
+            bufferAppend(word, valueString, sprintf(valueString, "%d", numPositional));
+            return 2;
+
+        // every positional parameter, which $* separates with the first character of IFS
+        case '@':
+        case '*':
+        {
+            const char *fieldSeparators = variableValue("IFS", 3);
+            char separator = *nameStart == '*' && fieldSeparators != NULL ? fieldSeparators[0] : ' ';
+            int i;
+            for(i = 0; i < numPositional; i++)
+            {
+                if(i > 0 && separator != '\0')
+                {
+                    bufferAppendChar(word, separator);
+                }
+                bufferAppend(word, positionalParams[i], strlen(positionalParams[i]));
+            }
+            return 2;
+        }
+    }
+
+    // the number of positional parameters can be written in braces too
+    if(nameStart[0] == '{' && nameStart[1] == '#' && nameStart[2] == '}')
+    {
+        bufferAppend(word, valueString, sprintf(valueString, "%d", numPositional));
+        return 4;
+    }
+
+    // a positional parameter is one digit, or any number of them in braces
+    if(isdigit((unsigned char)nameStart[0]) || (nameStart[0] == '{' && isdigit((unsigned char)nameStart[1])))
+    {
+        char *numberEnd = (char *)nameStart + 1;
+        long paramNumber = nameStart[0] - '0';
+        if(nameStart[0] == '{')
+        {
+            paramNumber = strtol(nameStart + 1, &numberEnd, 10);
+            if(*numberEnd != '}')
+            {
+                fprintf(stderr, "ERROR: bad substitution\n");
+                fflush(stderr);
+                return 0;
+            }
+            numberEnd++;
+        }
+
+        if(paramNumber == 0)
+        {
+            bufferAppend(word, "smallsh", 7);
+        }
+        else if(paramNumber <= numPositional)
+        {
+            bufferAppend(word, positionalParams[paramNumber - 1], strlen(positionalParams[paramNumber - 1]));
+        }
+        return numberEnd - dollarSign;
+    }
+
+    // ${NAME} may be followed directly by other characters
+    bool braced = *nameStart == '{';
+    if(braced == true)
+    {
+        nameStart++;
+    }
+
+    size_t nameLength = 0;
+    if(isalpha((unsigned char)nameStart[0]) || nameStart[0] == '_')
+    {
+        while(isalnum((unsigned char)nameStart[nameLength]) || nameStart[nameLength] == '_')
+        {
+            nameLength++;
+        }
+    }
+
+    if(braced == true && (nameLength == 0 || nameStart[nameLength] != '}'))
+    {
+        fprintf(stderr, "ERROR: bad substitution\n");
+        fflush(stderr);
+        return 0;
+    }
+
+    // a lone $ is just a dollar sign
+    if(nameLength == 0)
+    {
+        bufferAppendChar(word, '$');
+        return 1;
+    }
+
+    // look the name up without copying it out of the line
+    const char *value = variableValue(nameStart, nameLength);
+    if(value != NULL)
+    {
+        bufferAppend(word, value, strlen(value));
+    }
+
+    return (nameStart - dollarSign) + nameLength + (braced == true ? 1 : 0);
+}
+
+/*************************************************************************************************
+** Name: commandSubstitution
+**
+** Description: This function carries out the command substitution starting at a $( or a backquote.
+** The command runs to the matching ) or the next backquote which is not escaped. Inside backquotes a
+** backslash before $, ` or \ is removed first, as in other shells. The command is run by
+** runSubstitution and what it printed, less any newlines at the end, is left in the output buffer.
+** The exit value of the command becomes $?.
+**
+** Parameters: pointer to the $ or backquote in the line, buffer which is set to the output
+**
+** Returns: number of characters of the line used up, or 0 if the substitution is not terminated
+*************************************************************************************************/
+
+size_t commandSubstitution(const char *start, struct stringBuffer *output)
+{
+    const char *end = substitutionEnd(start);
+    if(end == NULL)
+    {
+        fprintf(stderr, "ERROR: unterminated command substitution\n");
+        fflush(stderr);
+        return 0;
+    }
+
+    // take the command out of the line, which an empty `` leaves empty rather than unset
+    substitutionText.length = 0;
+    bufferAppend(&substitutionText, "", 0);
+    if(*start == '$')
+    {
+        bufferAppend(&substitutionText, start + 2, end - start - 2);
+    }
+    else
+    {
+        const char *currChar;
+        for(currChar = start + 1; currChar < end; currChar++)
+        {
+            if(*currChar == '\\' && strchr("$`\\", currChar[1]) != NULL)
+            {
+                currChar++;
+            }
+            bufferAppendChar(&substitutionText, *currChar);
+        }
+    }
+
+    double substitutionStart = traceTime();
+    runSubstitution(substitutionText.data, output);
+    traceEvent("substitution", 0, substitutionStart, substitutionText.data);
+
+    // newlines at the end of the output are dropped
+    while(output->length > 0 && output->data[output->length - 1] == '\n')
+    {
+        output->length--;
+    }
+    output->data[output->length] = '\0';
+
+    return end - start + 1;
+}
+
+/*************************************************************************************************
+** Name: substitutionEnd
+**
+** Description: This function finds where a command substitution ends. For $( it is the ) which
+** balances it, skipping over anything quoted or escaped and over nested substitutions, and for a
+** backquote it is the next backquote which is not escaped.
+**
+** Parameters: pointer to the $ or backquote starting the substitution
+**
+** Returns: pointer to the character ending the substitution or NULL if there is none
+*************************************************************************************************/
+
+const char* substitutionEnd(const char *start)
+{
+    const char *currChar;
+
+    if(*start == '`')
+    {
+        for(currChar = start + 1; *currChar != '\0'; currChar++)
+        {
+            if(*currChar == '\\' && currChar[1] != '\0')
+            {
+                currChar++;
+            }
+            else if(*currChar == '`')
+            {
+                return currChar;
+            }
+        }
+        return NULL;
+    }
+
+    int depth = 1;
+    char quote = '\0';
+    for(currChar = start + 2; *currChar != '\0'; currChar++)
+    {
+        if(quote == '\'')
+        {
+            if(*currChar == '\'')
+            {
+                quote = '\0';
+            }
+        }
+        else if(*currChar == '\\' && currChar[1] != '\0')
+        {
+            currChar++;
+        }
+        else if(quote == '"')
+        {
+            if(*currChar == '"')
+            {
+                quote = '\0';
+            }
+        }
+        else if(*currChar == '\'' || *currChar == '"')
+        {
+            quote = *currChar;
+        }
+        else if(*currChar == '(')
+        {
+            depth++;
+        }
+        else if(*currChar == ')' && --depth == 0)
+        {
+            return currChar;
+        }
+    }
+
+    return NULL;
+}
+
+/*************************************************************************************************
+** Name: runSubstitution
+**
+** Description: This function runs the command of a command substitution and reads what it prints.
+** The shell forks a copy of itself with its standard output going into a pipe, and the copy runs
+** the command line with runLineInCopy. Forking copies the page tables of the whole shell, so when
+** there is a zygote the copy is forked by it instead and the shell reads the exit value from its
+** socket. The zygote only has the environment the shell sends along, so once there are functions,
+** positional parameters or variables which are not exported the shell forks the copy itself.
+** Commands the copy starts write straight into the pipe. The shell reads the pipe with large reads
+** into a buffer which doubles as it fills, the pipe being enlarged first so a large output takes
+** fewer trips between the two.
+**
+** Parameters: command line to run, buffer which is set to everything the command printed
+**
+** Returns: N/A
+*************************************************************************************************/
+
+void runSubstitution(const char *commandText, struct stringBuffer *output)
+{
+    numSubstitutions++;
+    output->length = 0;
+    bufferAppend(output, "", 0);
+
+    int outputPipe[2];
+    if(pipe2(outputPipe, O_CLOEXEC) < 0)
+    {
+        perror("ERROR: Unable to create pipe");
+        fflush(stderr);
+        childExitMethod = W_EXITCODE(1, 0);
+        return;
+    }
+    setPipeSize(outputPipe[1]);
+
+    pid_t substitutionPid = 0;
+    bool sentToZygote = zygoteFd != -1 && numShellFunctions == 0 && numPositional == 0 && numShellVariables == 0 && sendToZygote(commandText, outputPipe[1]) == true;
+    if(sentToZygote == false)
+    {
+        // nothing buffered may be written twice
+        fflush(stdout);
+        fflush(stderr);
+        if(traceFile != NULL)
+        {
+            fflush(traceFile);
+        }
+
+        substitutionPid = fork();
+        if(substitutionPid == 0)
+        {
+            dup2(outputPipe[1], STDOUT_FILENO);
+            runLineInCopy(commandText);
+        }
+    }
+    close(outputPipe[1]);
+
+    if(substitutionPid == -1)
+    {
+        perror("ERROR: Unable to fork");
+        fflush(stderr);
+        close(outputPipe[0]);
+        childExitMethod = W_EXITCODE(1, 0);
+        return;
+    }
+
+    // read until the command and everything it started have closed the pipe
+    while(true)
+    {
+        if(output->capacity - output->length < 65536)
+        {
+            output->capacity = output->capacity < 65536 ? 131072 : output->capacity * 2;
+            output->data = realloc(output->data, output->capacity);
+        }
+
+        ssize_t numRead = read(outputPipe[0], output->data + output->length, output->capacity - output->length - 1);
+        if(numRead == -1 && errno == EINTR)
+        {
+            continue;
+        }
+        if(numRead <= 0)
+        {
+            break;
+        }
+        output->length += numRead;
+    }
+    output->data[output->length] = '\0';
+    close(outputPipe[0]);
+
+    if(sentToZygote == true)
+    {
+        // a zygote which is gone is not asked again
+        if(readFully(zygoteFd, &childExitMethod, sizeof(childExitMethod)) == false)
+        {
+            close(zygoteFd);
+            zygoteFd = -1;
+            childExitMethod = W_EXITCODE(1, 0);
+        }
+        return;
+    }
+
+    while(waitpid(substitutionPid, &childExitMethod, 0) == -1 && errno == EINTR)
+    {
+    }
+}
+
+/*************************************************************************************************
+** Name: runLineInCopy
+**
+** Description: This function is run by a forked copy of the shell to run a command text the same
+** way the shell would, then leave with its exit value. The text becomes the input of the copy, so
+** it may have any number of lines and here-documents, and functions the shell defined can be called.
+**
+** Parameters: command line to run
+**
+** Returns: N/A, the copy exits
+*************************************************************************************************/
+
+void runLineInCopy(const char *commandText)
+{
+    becomeCopy();
+
+    // the text is all the input the copy has. the command the shell was running is no longer needed,
+    // though the trees of its functions are
+    inputBuffer = strdup(commandText);
+    inputLength = strlen(inputBuffer);
+    arenaReset(&lineArena);
+    arenaReset(&treeArena);
+    runningTree = NULL;
+    unwinding = UNWIND_NONE;
+    loopDepth = 0;
+    functionDepth = 0;
+
+    while(printShellPrompt() == true)
+    {
+    }
+
+    fflush(stdout);
+    fflush(stderr);
+    _exit(exitValue(childExitMethod));
+}
+
+/*************************************************************************************************
+** Name: becomeCopy
+**
+** Description: This function is run first by a forked copy of the shell. The copy owns none of the
+** background jobs, so it never reports or kills them, never writes to the trace, never touches the
+** terminal and forks its own copies. It does not own the commands the shell reads either, so the
+** input buffered by the shell is dropped and nothing more is read from where it came from.
+**
+** Parameters: N/A
+**
+** Returns: N/A
+*************************************************************************************************/
+
+void becomeCopy()
+{
+    traceFile = NULL;
+    jobTable.liveHead = -1;
+    interactiveShell = false;
+    jobControl = false;
+    lineEditor = false;
+    jobCapture.enabled = false;
+    jobCapture.numOpen = 0;
+    inputFd = -1;
+    inputLength = 0;
+    inputStart = 0;
+    if(zygoteFd != -1)
+    {
+        close(zygoteFd);
+        zygoteFd = -1;
+    }
+}
+
+/*************************************************************************************************
+** Name: exitValue
+**
+** Description: This function turns the exit method of a process into the single number $? reports,
+** the exit value of a process which ended normally or 128 plus the signal number of one which was
+** terminated by a signal.
+**
+** Parameters: exit method filled in by wait4
+**
+** Returns: exit value of the process
+*************************************************************************************************/
+
+int exitValue(int exitMethod)
+{
+    if(WIFSIGNALED(exitMethod))
+    {
+        return 128 + WTERMSIG(exitMethod);
+    }
+
+    return WEXITSTATUS(exitMethod);
+}
+
+/*************************************************************************************************
+** Name: addUsage
+**
+** Description: This function adds the resources used by one process to a running total. CPU times
+** and context switches add up, while the memory of a command is the largest any of its processes
+** needed since they do not all have to be running at once.
+**
+** Parameters: total to add to, resources used by the process
+**
+** Returns: N/A
+*************************************************************************************************/
+
+void addUsage(struct rusage *total, const struct rusage *more)
+{
+    timeradd(&total->ru_utime, &more->ru_utime, &total->ru_utime);
+    timeradd(&total->ru_stime, &more->ru_stime, &total->ru_stime);
+    total->ru_nvcsw += more->ru_nvcsw;
+    total->ru_nivcsw += more->ru_nivcsw;
+
+    if(more->ru_maxrss > total->ru_maxrss)
+    {
+        total->ru_maxrss = more->ru_maxrss;
+    }
+}
+
+/*************************************************************************************************
+** Name: usageSince
+**
+** Description: This function turns the resources the shell has used so far into the resources it
+** used since an earlier reading, which is how built ins are measured. The memory reported is the
+** most the shell has ever needed as the kernel does not keep it for shorter spans.
+**
+** Parameters: earlier reading, current reading which is changed into the difference
+**
+** Returns: N/A
+*************************************************************************************************/
+
+void usageSince(const struct rusage *before, struct rusage *after)
+{
+    timersub(&after->ru_utime, &before->ru_utime, &after->ru_utime);
+    timersub(&after->ru_stime, &before->ru_stime, &after->ru_stime);
+    after->ru_nvcsw -= before->ru_nvcsw;
+    after->ru_nivcsw -= before->ru_nivcsw;
+}
+
+/*************************************************************************************************
+** Name: elapsedSince
+**
+** Description: This function finds the wall time passed since a CLOCK_MONOTONIC reading.
+**
+** Parameters: earlier reading, time passed since it
+**
+** Returns: N/A
+*************************************************************************************************/
+
+void elapsedSince(const struct timespec *startTime, struct timespec *wallTime)
+{
+    clock_gettime(CLOCK_MONOTONIC, wallTime);
+    wallTime->tv_sec -= startTime->tv_sec;
+    wallTime->tv_nsec -= startTime->tv_nsec;
+    if(wallTime->tv_nsec < 0)
+    {
+        wallTime->tv_sec--;
+        wallTime->tv_nsec += 1000000000L;
+    }
+}
+
+/*************************************************************************************************
+** Name: printUsage
+**
+** Description: This function prints the resources used by a command, its wall time, the user and
+** system CPU time of its processes, the most memory any of them needed and how often they gave up
+** or were made to give up the CPU. It is printed to stderr like the output of time in other shells
+** so it does not mix with output the command was redirected into.
+**
+** Parameters: wall time of the command, resources used by its processes
+**
+** Returns: N/A
+*************************************************************************************************/
+
+void printUsage(const struct timespec *wallTime, const struct rusage *usage)
+{
+    fprintf(stderr, "real\t%ld.%03lds\n", (long)wallTime->tv_sec, wallTime->tv_nsec / 1000000L);
+    fprintf(stderr, "user\t%ld.%03lds\n", (long)usage->ru_utime.tv_sec, (long)usage->ru_utime.tv_usec / 1000L);
+    fprintf(stderr, "sys\t%ld.%03lds\n", (long)usage->ru_stime.tv_sec, (long)usage->ru_stime.tv_usec / 1000L);
+    fprintf(stderr, "maxrss\t%ld KB\n", usage->ru_maxrss);
+    fprintf(stderr, "ctxsw\t%ld voluntary, %ld involuntary\n", usage->ru_nvcsw, usage->ru_nivcsw);
+    fflush(stderr);
+}
+
+/*************************************************************************************************
+** Name: startTrace
+**
+** Description: This function starts writing a trace of the phases of every command to a file in the
+** Chrome trace event format, which chrome://tracing and Perfetto open. Events are written through a
+** buffered stream as they end and the list they go into is closed when tracing stops or the shell
+** exits, though both viewers also read a trace which was cut off.
+**
+** Parameters: name of the file to write the trace to
+**
+** Returns: true if the file could be opened, false otherwise
+*************************************************************************************************/
+
+bool startTrace(const char *fileName)
+{
+    static bool stopAtExit = false;
+
+    stopTrace();
+
+    traceFile = fopen(fileName, "we");
+    if(traceFile == NULL)
+    {
+        fprintf(stderr, "trace: %s: %s\n", fileName, strerror(errno));
+        fflush(stderr);
+        return false;
+    }
+
+    if(stopAtExit == false)
+    {
+        atexit(stopTrace);
+        stopAtExit = true;
+    }
+
+    fputs("[\n", traceFile);
+    traceHasEvents = false;
+    tracePid = getpid();
+    traceTrackName(0, 0, NULL);
+    return true;
+}
+
+/*************************************************************************************************
+** Name: stopTrace
+**
+** Description: This function finishes the trace being written, if any, and closes its file.
+**
+** Parameters: N/A
+**
+** Returns: N/A
+*************************************************************************************************/
+
+void stopTrace()
+{
+    if(traceFile != NULL)
+    {
+        fputs("\n]\n", traceFile);
+        fclose(traceFile);
+        traceFile = NULL;
+    }
+}
+
+/*************************************************************************************************
+** Name: traceTime
+**
+** Description: This function reads CLOCK_MONOTONIC for the start of a phase. While tracing is off it
+** does not read the clock at all, so the only cost of the tracing left in the shell is a test.
+**
+** Parameters: N/A
+**
+** Returns: microseconds on CLOCK_MONOTONIC, 0 while tracing is off
+*************************************************************************************************/
+
+double traceTime()
+{
+    if(traceFile == NULL)
+    {
+        return 0;
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1e6 + now.tv_nsec / 1e3;
+}
+
+/*************************************************************************************************
+** Name: traceEvent
+**
+** Description: This function writes a phase which has just ended to the trace as a complete event.
+** Nothing is written while tracing is off or for a phase which began before tracing was turned on.
+**
+** Parameters: name of the phase, track it goes on (the PID of a background job or 0 for the shell),
+** microseconds it started at from traceTime, text shown with it or NULL
+**
+** Returns: N/A
+*************************************************************************************************/
+
+void traceEvent(const char *name, pid_t track, double startTime, const char *detail)
+{
+    if(traceFile == NULL || startTime == 0)
+    {
+        return;
+    }
+
+    double endTime = traceTime();
+    fprintf(traceFile, "%s{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%d",
+            traceHasEvents == true ? ",\n" : "", name, startTime, endTime - startTime, tracePid,
+            track == 0 ? tracePid : track);
+    if(detail != NULL)
+    {
+        fputs(",\"args\":{\"detail\":\"", traceFile);
+        traceString(detail);
+        fputs("\"}", traceFile);
+    }
+    fputc('}', traceFile);
+    traceHasEvents = true;
+}
+
+/*************************************************************************************************
+** Name: traceTrackName
+**
+** Description: This function names a track of the trace, the shell itself or a background job, with
+** a metadata event so viewers show what it is.
+**
+** Parameters: track to name (0 for the shell), number of the job, command line of the job
+**
+** Returns: N/A
+*************************************************************************************************/
+
+void traceTrackName(pid_t track, int jobNumber, const char *commandLine)
+{
+    char trackName[64];
+    snprintf(trackName, sizeof(trackName), track == 0 ? "smallsh" : "job %d: ", jobNumber);
+
+    fprintf(traceFile, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s",
+            traceHasEvents == true ? ",\n" : "", tracePid, track == 0 ? tracePid : track, trackName);
+    if(commandLine != NULL)
+    {
+        traceString(commandLine);
+    }
+    fputs("\"}}", traceFile);
+    traceHasEvents = true;
+}
+
+/*************************************************************************************************
+** Name: traceString
+**
+** Description: This function writes text into a string of the trace with the characters JSON needs
+** escaped.
+**
+** Parameters: text to write
+**
+** Returns: N/A
+*************************************************************************************************/
+
+void traceString(const char *text)
+{
+    const unsigned char *currChar;
+    for(currChar = (const unsigned char *)text; *currChar != '\0'; currChar++)
+    {
+        if(*currChar == '"' || *currChar == '\\')
+        {
+            fputc('\\', traceFile);
+            fputc(*currChar, traceFile);
+        }
+        else if(*currChar < 32)
+        {
+            fprintf(traceFile, "\\u%04x", *currChar);
+        }
+        else
+        {
+            fputc(*currChar, traceFile);
+        }
+    }
+}
+
+/*************************************************************************************************
+** Name: traceCommand
+**
+** Description: This function is the trace built in. trace on FILE starts tracing into FILE, trace on
+** alone into the file named by SMALLSH_TRACE or smallsh-trace.json, and trace off stops. Turning it
+** on again starts a new trace. With no arguments it says whether tracing is on.
+**
+** Parameters: string for user input which has been tokenized
+**
+** Returns: exit value of the built in
+*************************************************************************************************/
+
+int traceCommand(char **commandLine)
+{
+    if(commandLine[1] == NULL)
+    {
+        printf("trace is %s\n", traceFile != NULL ? "on" : "off");
+        fflush(stdout);
+        return 0;
+    }
+
+    if(strcmp(commandLine[1], "off") == 0 && commandLine[2] == NULL)
+    {
+        stopTrace();
+        return 0;
+    }
+
+    if(strcmp(commandLine[1], "on") == 0 && (commandLine[2] == NULL || commandLine[3] == NULL))
+    {
+        const char *fileName = commandLine[2];
+        if(fileName == NULL)
+        {
+            fileName = variableValue("SMALLSH_TRACE", 13);
+        }
+        if(fileName == NULL || fileName[0] == '\0')
+        {
+            fileName = "smallsh-trace.json";
+        }
+
+        return startTrace(fileName) == true ? 0 : 1;
+    }
+
+    fprintf(stderr, "trace: usage: trace [on [FILE] | off]\n");
+    fflush(stderr);
+    return 2;
+}
+
+/*************************************************************************************************
+** Name: bufferAppend
+**
+** Description: This function appends characters to a growable string buffer, doubling its capacity
+** whenever they do not fit so that building a string of any length takes linear time. The buffer is
+** always kept null terminated.
+**
+** Parameters: buffer to append to, characters to append, number of characters
+**
+** Returns: N/A
+*************************************************************************************************/
+
+void bufferAppend(struct stringBuffer *buffer, const char *text, size_t length)
+{
+    if(buffer->length + length + 1 > buffer->capacity)
+    {
+        size_t newCapacity = buffer->capacity == 0 ? 256 : buffer->capacity * 2;
+        while(buffer->length + length + 1 > newCapacity)
+        {
+            newCapacity *= 2;
+        }
+
+        buffer->data = realloc(buffer->data, newCapacity);
+        buffer->capacity = newCapacity;
+    }
+
+    memcpy(buffer->data + buffer->length, text, length);
+    buffer->length += length;
+    buffer->data[buffer->length] = '\0';
+}
+
+/*************************************************************************************************
+** Name: bufferAppendChar
+**
+** Description: This function appends a single character to a growable string buffer.
+**
+** Parameters: buffer to append to, character to append
+**
+** Returns: N/A
+*************************************************************************************************/
+
+void bufferAppendChar(struct stringBuffer *buffer, char character)
+{
+    if(buffer->length + 2 > buffer->capacity)
+    {
+        bufferAppend(buffer, &character, 1);
+        return;
+    }
+
+    buffer->data[buffer->length++] = character;
+    buffer->data[buffer->length] = '\0';
+}
+
+/*************************************************************************************************
+** Name: bufferToArena
+**
+** Description: This function copies the string in a buffer into an arena so the buffer can be used
+** to build the next string.
+**
+** Parameters: buffer holding the string, arena to copy it into
+**
+** Returns: the copy in the arena
+*************************************************************************************************/
+
+char* bufferToArena(struct stringBuffer *buffer, struct arena *memoryArena)
+{
+    char *copy = arenaAlloc(memoryArena, buffer->length + 1);
+    memcpy(copy, buffer->data == NULL ? "" : buffer->data, buffer->length);
+    copy[buffer->length] = '\0';
+
+    return copy;
+}
+
+/*************************************************************************************************
+** Name: setupEventLoop
+**
+** Description: This function prepares the event loop the shell waits in between commands. SIGCHLD
+** is blocked and read through a signalfd instead so the end of a child is an event like any other.
+** An epoll instance then watches both standard input and the signalfd so the shell sleeps in the
+** kernel until the user types something or a child finishes, without polling in between. Only an
+** interactive shell watches its input this way. Scripts and piped input are read with plain blocking
+** reads and finished background processes are reported between commands.
+**
+** Parameters: N/A
+**
+** Returns: N/A
+*************************************************************************************************/
+
+void setupEventLoop()
+{
+    // SIGCHLD is only received through the signalfd from now on
+    sigset_t childMask;
+    sigemptyset(&childMask);
+    sigaddset(&childMask, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &childMask, NULL);
+
+    signalFd = highDescriptor(signalfd(-1, &childMask, SFD_NONBLOCK | SFD_CLOEXEC));
+    epollFd = highDescriptor(epoll_create1(EPOLL_CLOEXEC));
+
+    if(signalFd == -1 || epollFd == -1)
+    {
+        perror("ERROR: Unable to set up the event loop");
+        fflush(stderr);
+        exit(1);
+    }
+
+    struct epoll_event watchEvent = {0};
+    watchEvent.events = EPOLLIN;
+    watchEvent.data.fd = signalFd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, signalFd, &watchEvent);
+
+    // a regular file as input is always ready and cannot be added
+    watchEvent.data.fd = STDIN_FILENO;
+    if(interactiveShell == true && epoll_ctl(epollFd, EPOLL_CTL_ADD, STDIN_FILENO, &watchEvent) == 0)
+    {
+        stdinPollable = true;
+    }
+}
+
+/*************************************************************************************************
+** Name: drainSignalFd
+**
+** Description: This function reads every pending signal off the signalfd without blocking. Several
+** children finishing close together may be merged into a single SIGCHLD, so a pending signal only
+** says that one or more children need to be reaped.
+**
+** Parameters: N/A
+**
+** Returns: true if a SIGCHLD was pending, false otherwise
+*************************************************************************************************/
+
+bool drainSignalFd()
+{
+    struct signalfd_siginfo signalInfo[8];
+    bool childSignalled = childSignalPending;
+    childSignalPending = false;
+
+    while(read(signalFd, signalInfo, sizeof(signalInfo)) > 0)
+    {
+        childSignalled = true;
+    }
+
+    return childSignalled;
+}
+
+/*************************************************************************************************
+** Name: readCommandLine
+**
+** Description: This function gets the next line of input from the user. Input is read with large
+** reads into a buffer that is kept between calls, or is already in memory for a mapped script or
+** -c, and a line is handed out as soon as a complete one is buffered. The line is not copied, its
+** newline is replaced with the terminating null character where it sits in the buffer, so it stays
+** valid until the next call. Otherwise the function waits in epoll for standard input or the
+** signalfd, applying any changes to the PATH directories to the executable index as they arrive. At
+** a terminal the line editor reads the line instead. When a child finishes while the user is at the
+** prompt the background processes are checked right away and, if any completion was reported, the
+** prompt is printed again. When the wait is interrupted by the SIGTSTP handler an empty line is
+** returned so the prompt is shown again.
+**
+** Parameters: pointer which is set to the line
+**
+** Returns: number of characters in the line including its newline, or -1 once input has ended
+*************************************************************************************************/
+
+ssize_t readCommandLine(char **lineEntered)
+{
+    // a terminal gets the line editor
+    if(lineEditor == true)
+    {
+        return editLine(lineEntered);
+    }
+
+    while(true)
+    {
+        // hand out a line as soon as a complete one is buffered
+        char *lineStart = inputBuffer + inputStart;
+        char *newLine = inputLength > inputStart ? memchr(lineStart, '\n', inputLength - inputStart) : NULL;
+        if(newLine != NULL)
+        {
+            size_t lineLength = newLine - lineStart + 1;
+            *newLine = '\0';
+            *lineEntered = lineStart;
+            inputStart += lineLength;
+            return lineLength;
+        }
+
+        // once everything has been read a last line without a newline is still a line
+        if(inputFd == -1)
+        {
+            if(inputStart == inputLength)
+            {
+                *lineEntered = "";
+                return -1;
+            }
+
+            lastLine.length = 0;
+            bufferAppend(&lastLine, lineStart, inputLength - inputStart);
+            *lineEntered = lastLine.data;
+            inputStart = inputLength;
+            return lastLine.length + 1;
+        }
+
+        // wait until there is input or a child has finished
+        if(stdinPollable == true)
+        {
+            struct epoll_event readyEvents[4];
+            int numEvents = epoll_wait(epollFd, readyEvents, 4, -1);
+
+            // interrupted by a signal handler
+            if(numEvents == -1)
+            {
+                *lineEntered = "";
+                return 0;
+            }
+
+            bool inputReady = false;
+            int i;
+            for(i = 0; i < numEvents; i++)
+            {
+                if(readyEvents[i].data.fd == signalFd)
+                {
+                    // report finished background processes right away and prompt again
+                    if(drainSignalFd() == true && checkBackgroundStatus() > 0)
+                    {
+                        printf(":");
+                        fflush(stdout);
+                    }
+                }
+                else if(readyEvents[i].data.fd == inotifyFd)
+                {
+                    processExecutableEvents();
+                }
+                else if(readyEvents[i].data.fd == jobCapture.epollFd)
+                {
+                    drainCaptures();
+                }
+                else
+                {
+                    inputReady = true;
+                }
+            }
+
+            if(inputReady == false)
+            {
+                continue;
+            }
+        }
+
+        ssize_t numRead = readInput();
+
+        if(numRead == -1 && errno == EINTR)
+        {
+            *lineEntered = "";
+            return 0;
+        }
+
+        // nothing more will be read
+        if(numRead <= 0)
+        {
+            if(inputFd != STDIN_FILENO)
+            {
+                close(inputFd);
+            }
+            inputFd = -1;
+            continue;
+        }
+    }
+}
+
+/*************************************************************************************************
+** Name: readInput
+**
+** Description: This function reads more input onto the end of the input buffer with one large read.
+** What has not been handed out yet is moved to the front first and the buffer doubles when there is
+** not much room left.
+**
+** Parameters: N/A
+**
+** Returns: number of bytes read, 0 at the end of input, or -1 on an error
+*************************************************************************************************/
+
+ssize_t readInput()
+{
+    // move the partial line to the front and make room for a large read. there is no buffer before
+    // the first read
+    if(inputStart > 0)
+    {
+        memmove(inputBuffer, inputBuffer + inputStart, inputLength - inputStart);
+        inputLength -= inputStart;
+        inputStart = 0;
+    }
+    if(inputCapacity - inputLength < 4096)
+    {
+        inputCapacity = inputCapacity == 0 ? 65536 : inputCapacity * 2;
+        inputBuffer = realloc(inputBuffer, inputCapacity);
+    }
+
+    ssize_t numRead = read(inputFd, inputBuffer + inputLength, inputCapacity - inputLength);
+    if(numRead > 0)
+    {
+        inputLength += numRead;
+    }
+
+    return numRead;
+}
+
+/*************************************************************************************************
+** Name: setupLineEditor
+**
+** Description: This function turns the line editor on when both standard input and output are a
+** terminal the shell can put into raw mode and the terminal is not a dumb one. Otherwise lines are
+** read as the terminal hands them over.
+**
+** Parameters: N/A
+**
+** Returns: N/A
+*************************************************************************************************/
+
+void setupLineEditor()
+{
+    struct termios terminal;
+    const char *terminalType = getenv("TERM");
+
+    lineEditor = interactiveShell == true && stdinPollable == true && isatty(STDOUT_FILENO) == 1 &&
+                 tcgetattr(STDIN_FILENO, &terminal) == 0 && (terminalType == NULL || strcmp(terminalType, "dumb") != 0);
+}
+
+/*************************************************************************************************
+** Name: editLine
+**
+** Description: This function reads a line with the line editor. The terminal is put into raw mode,
+** keeping ISIG so cntrl+c and cntrl+z still raise their signals, for as long as the line is edited
+** and is put back the way it was before the line is returned, so commands always run on the terminal
+** as it was set up. Keys are read into the input buffer like any other input and every key already
+** read is handled before the line is redrawn once, so a paste costs one redraw. While waiting, the
+** editor also reports finished background processes, redrawing the line after them, and applies
+** changes to the directories on PATH to the executable index. A signal handler interrupting the wait
+** has printed a message so the line is redrawn as well.
+**
+** Parameters: pointer which is set to the line
+**
+** Returns: number of characters in the line including its newline, or -1 once input has ended
+*************************************************************************************************/
+
+ssize_t editLine(char **lineEntered)
+{
+    struct termios cookedTerminal;
+    struct termios rawTerminal;
+    tcgetattr(STDIN_FILENO, &cookedTerminal);
+
+    rawTerminal = cookedTerminal;
+    rawTerminal.c_iflag &= ~(ICRNL | IXON | BRKINT | INPCK | ISTRIP);
+    rawTerminal.c_lflag &= ~(ICANON | ECHO | IEXTEN);
+    rawTerminal.c_cflag |= CS8;
+    rawTerminal.c_cc[VMIN] = 1;
+    rawTerminal.c_cc[VTIME] = 0;
+    tcsetattr(STDIN_FILENO, TCSADRAIN, &rawTerminal);
+
+    editBuffer.length = 0;
+    bufferAppend(&editBuffer, "", 0);
+    editCursor = 0;
+    historyPosition = -1;
+
+    ssize_t result = -2;
+    while(result == -2)
+    {
+        // handle every key read so far. -3 means the rest of a key has not arrived yet
+        while(inputStart < inputLength && result == -2)
+        {
+            result = editKey();
+        }
+        if(result >= -1)
+        {
+            break;
+        }
+        result = -2;
+
+        refreshLine();
+
+        struct epoll_event readyEvents[4];
+        int numEvents = epoll_wait(epollFd, readyEvents, 4, -1);
+
+        // a signal handler printed a message so start the line again below it
+        if(numEvents == -1)
+        {
+            continue;
+        }
+
+        int i;
+        for(i = 0; i < numEvents; i++)
+        {
+            if(readyEvents[i].data.fd == signalFd)
+            {
+                // any report is printed on a clear line and the line is drawn again after it
+                write(STDOUT_FILENO, "\r\x1b[0K", 5);
+                if(drainSignalFd() == true)
+                {
+                    checkBackgroundStatus();
+                }
+            }
+            else if(readyEvents[i].data.fd == inotifyFd)
+            {
+                processExecutableEvents();
+            }
+            else if(readyEvents[i].data.fd == jobCapture.epollFd)
+            {
+                drainCaptures();
+            }
+            else
+            {
+                ssize_t numRead = readInput();
+
+                // the terminal went away
+                if(numRead == 0 || (numRead == -1 && errno != EINTR && errno != EAGAIN))
+                {
+                    lineEditor = false;
+                    inputFd = -1;
+                    result = -1;
+                }
+            }
+        }
+    }
+
+    tcsetattr(STDIN_FILENO, TCSADRAIN, &cookedTerminal);
+
+    if(result == -1)
+    {
+        *lineEntered = "";
+        return -1;
+    }
+
+    *lineEntered = editBuffer.data;
+    return result;
+}
+
+/*************************************************************************************************
+** Name: editKey
+**
+** Description: This function handles the next key in the input buffer. Printable characters are
+** inserted at the cursor. The arrow keys, Home, End and Delete are understood along with the emacs
+** style keys cntrl+a, e, b, f, d, k, u, w, l, p and n, backspace moves back a character, tab completes
+** the word at the cursor, and up and down browse the history. Enter finishes the line and cntrl+d on
+** an empty line ends input. An escape sequence which has not fully arrived is left in the buffer.
+**
+** Parameters: N/A
+**
+** Returns: length of the line including its newline when it is finished, -1 at the end of input, -2
+** to keep editing, -3 when more input is needed to finish the key
+*************************************************************************************************/
+
+ssize_t editKey()
+{
+    const unsigned char *keys = (const unsigned char *)inputBuffer + inputStart;
+    size_t numAvailable = inputLength - inputStart;
+    size_t numUsed = 1;
+    ssize_t result = -2;
+    char key = keys[0];
+
+    // turn the escape sequences of special keys into the control key doing the same
+    if(keys[0] == 27)
+    {
+        if(numAvailable < 3)
+        {
+            return -3;
+        }
+
+        numUsed = 3;
+        key = 0;
+        if(keys[1] == '[' || keys[1] == 'O')
+        {
+            switch(keys[2])
+            {
+                case 'A': key = 16; break;
+                case 'B': key = 14; break;
+                case 'C': key = 6; break;
+                case 'D': key = 2; break;
+                case 'H': key = 1; break;
+                case 'F': key = 5; break;
+            }
+
+            // keys such as Delete end with a ~
+            if(isdigit(keys[2]))
+            {
+                if(numAvailable < 4)
+                {
+                    return -3;
+                }
+                numUsed = 4;
+                switch(keys[2])
+                {
+                    case '1': case '7': key = 1; break;
+                    case '4': case '8': key = 5; break;
+                    case '3': key = 4; break;
+                }
+            }
+        }
+    }
+
+    inputStart += numUsed;
+
+    switch(key)
+    {
+        case '\r':
+        case '\n':
+            // keys typed ahead of the line finishing were never drawn, so the line is shown first
+            refreshLine();
+            write(STDOUT_FILENO, "\r\n", 2);
+            result = editBuffer.length + 1;
+            break;
+
+        // cntrl+d ends input on an empty line and deletes under the cursor otherwise
+        case 4:
+            if(numUsed == 1 && editBuffer.length == 0)
+            {
+                write(STDOUT_FILENO, "\r\n", 2);
+                result = -1;
+            }
+            else if(editCursor < editBuffer.length)
+            {
+                editDelete(editCursor, 1);
+            }
+            break;
+
+        case 127:
+        case 8:
+            if(editCursor > 0)
+            {
+                editDelete(editCursor - 1, 1);
+                editCursor--;
+            }
+            break;
+
+        case 1: editCursor = 0; break;
+        case 5: editCursor = editBuffer.length; break;
+        case 2: editCursor -= editCursor > 0 ? 1 : 0; break;
+        case 6: editCursor += editCursor < editBuffer.length ? 1 : 0; break;
+        case 11: editDelete(editCursor, editBuffer.length - editCursor); break;
+        case 16: editHistory(-1); break;
+        case 14: editHistory(1); break;
+        case '\t': completeWord(); break;
+
+        case 21:
+            editDelete(0, editCursor);
+            editCursor = 0;
+            break;
+
+        // cntrl+w deletes the word before the cursor
+        case 23:
+        {
+            size_t wordStart = editCursor;
+            while(wordStart > 0 && editBuffer.data[wordStart - 1] == ' ')
+            {
+                wordStart--;
+            }
+            while(wordStart > 0 && editBuffer.data[wordStart - 1] != ' ')
+            {
+                wordStart--;
+            }
+            editDelete(wordStart, editCursor - wordStart);
+            editCursor = wordStart;
+            break;
+        }
+
+        case 12:
+            write(STDOUT_FILENO, "\x1b[H\x1b[2J", 7);
+            break;
+
+        default:
+            if(numUsed == 1 && keys[0] >= 32)
+            {
+                editInsert(&key, 1);
+            }
+            break;
+    }
+
+    return result;
+}
+
+/*************************************************************************************************
+** Name: refreshLine
+**
+** Description: This function draws the prompt and the line being edited over the current line of
+** the terminal and puts the cursor where it is in the line. A line wider than the terminal scrolls
+** sideways so the cursor is always on screen. Everything is sent with a single write.
+**
+** Parameters: N/A
+**
+** Returns: N/A
+*************************************************************************************************/
+
+void refreshLine()
+{
+    struct winsize terminalSize;
+    size_t numColumns = 80;
+    if(ioctl(STDOUT_FILENO, TIOCGWINSZ, &terminalSize) == 0 && terminalSize.ws_col > 0)
+    {
+        numColumns = terminalSize.ws_col;
+    }
+
+    size_t promptLength = strlen(promptText);
+    const char *visibleText = editBuffer.data;
+    size_t visibleLength = editBuffer.length;
+    size_t cursorColumn = editCursor;
+
+    // scroll the line so the cursor stays on screen
+    if(numColumns > promptLength + 1)
+    {
+        if(promptLength + cursorColumn >= numColumns)
+        {
+            size_t numHidden = promptLength + cursorColumn - numColumns + 1;
+            visibleText += numHidden;
+            visibleLength -= numHidden;
+            cursorColumn -= numHidden;
+        }
+        if(promptLength + visibleLength > numColumns)
+        {
+            visibleLength = numColumns - promptLength;
+        }
+    }
+
+    char cursorMove[32];
+    editOutput.length = 0;
+    bufferAppend(&editOutput, "\r", 1);
+    bufferAppend(&editOutput, promptText, promptLength);
+    bufferAppend(&editOutput, visibleText, visibleLength);
+    bufferAppend(&editOutput, "\x1b[0K\r", 5);
+    if(promptLength + cursorColumn > 0)
+    {
+        bufferAppend(&editOutput, cursorMove, sprintf(cursorMove, "\x1b[%zuC", promptLength + cursorColumn));
+    }
+
+    write(STDOUT_FILENO, editOutput.data, editOutput.length);
+}
+
+/*************************************************************************************************
+** Name: editInsert
+**
+** Description: This function inserts text into the line being edited at the cursor and moves the
+** cursor past it.
+**
+** Parameters: text to insert, its length
+**
+** Returns: N/A
+*************************************************************************************************/
+
+void editInsert(const char *text, size_t length)
+{
+    size_t oldLength = editBuffer.length;
+
+    // grow the buffer then open a gap at the cursor
+    bufferAppend(&editBuffer, text, length);
+    memmove(editBuffer.data + editCursor + length, editBuffer.data + editCursor, oldLength - editCursor);
+    memcpy(editBuffer.data + editCursor, text, length);
+    editCursor += length;
+}
+
+/*************************************************************************************************
+** Name: editDelete
+**
+** Description: This function deletes part of the line being edited. The cursor is left where it is.
+**
+** Parameters: start of the part to delete, its length
+**
+** Returns: N/A
+*************************************************************************************************/
+
+void editDelete(size_t start, size_t length)
+{
+    memmove(editBuffer.data + start, editBuffer.data + start + length, editBuffer.length - start - length + 1);
+    editBuffer.length -= length;
+}
+
+/*************************************************************************************************
+** Name: editHistory
+**
+** Description: This function moves through the history from the line being edited, to older entries
+** with up and back with down. The line typed before moving into the history is kept and comes back
+** when moving down past the newest entry.
+**
+** Parameters: -1 to move to an older entry, 1 to move to a newer one
+**
+** Returns: N/A
+*************************************************************************************************/
+
+void editHistory(int direction)
+{
+    int numEntries = numHistoryEntries();
+    int position = historyPosition == -1 ? numEntries + 1 : historyPosition;
+    int newPosition = position + direction;
+
+    if(newPosition < 1 || newPosition > numEntries + 1)
+    {
+        return;
+    }
+
+    // keep what was typed before leaving it
+    if(position == numEntries + 1)
+    {
+        editSaved.length = 0;
+        bufferAppend(&editSaved, editBuffer.data, editBuffer.length);
+    }
+
+    editBuffer.length = 0;
+    if(newPosition == numEntries + 1)
+    {
+        bufferAppend(&editBuffer, editSaved.data, editSaved.length);
+    }
+    else
+    {
+        size_t entryLength;
+        const char *entryText = historyEntry(newPosition, &entryLength);
+        bufferAppend(&editBuffer, entryText, entryLength);
+    }
+
+    editCursor = editBuffer.length;
+    historyPosition = newPosition;
+}
+
+/*************************************************************************************************
+** Name: completeWord
+**
+** Description: This function completes the word before the cursor. The first word of a command is
+** completed from the built ins and the executable index unless it has a / in it. Any other word is
+** completed from the names in its directory, where directories get a / added. A single match is
+** completed in full and followed by a space, several are completed as far as they agree, and when
+** that adds nothing they are listed below the line. No match rings the bell.
+**
+** Parameters: N/A
+**
+** Returns: N/A
+*************************************************************************************************/
+
+void completeWord()
+{
+    static char *builtInNames[] = {"bg", "break", "cd", "continue", "exit", "export", "fg", "hash", "history", "joblog", "jobs", "parallel", "return", "setaffinity", "status", "time", "trace", "wait"};
+
+    // the word runs back from the cursor to a blank or operator
+    size_t wordStart = editCursor;
+    while(wordStart > 0 && strchr(" \t|&;<>", editBuffer.data[wordStart - 1]) == NULL)
+    {
+        wordStart--;
+    }
+
+    // a command starts the line or follows an operator
+    size_t beforeWord = wordStart;
+    while(beforeWord > 0 && editBuffer.data[beforeWord - 1] == ' ')
+    {
+        beforeWord--;
+    }
+    bool isCommand = beforeWord == 0 || strchr("|&;", editBuffer.data[beforeWord - 1]) != NULL;
+
+    char word[PATH_MAX];
+    size_t wordLength = editCursor - wordStart;
+    if(wordLength >= sizeof(word))
+    {
+        return;
+    }
+    memcpy(word, editBuffer.data + wordStart, wordLength);
+    word[wordLength] = '\0';
+
+    char **candidates = NULL;
+    int numCandidates = 0;
+    int capacity = 0;
+    const char *baseName = word;
+    bool freeCandidates = false;
+
+    if(isCommand == true && strchr(word, '/') == NULL)
+    {
+        // the index is built the first time and again whenever PATH has changed
+        const char *pathValue = variableValue("PATH", 4);
+        if(executableIndex.built == false || strcmp(pathValue == NULL ? "" : pathValue, executableIndex.pathCopy) != 0)
+        {
+            buildExecutableIndex();
+        }
+
+        bool found;
+        int entry;
+        for(entry = findExecutable(word, &found); entry < executableIndex.count; entry++)
+        {
+            if(strncmp(executableIndex.entries[entry].name, word, wordLength) != 0)
+            {
+                break;
+            }
+            addCandidate(&candidates, &numCandidates, &capacity, executableIndex.entries[entry].name);
+        }
+
+        // built ins sharing a name with an executable are already there
+        size_t i;
+        for(i = 0; i < sizeof(builtInNames) / sizeof(builtInNames[0]); i++)
+        {
+            if(strncmp(builtInNames[i], word, wordLength) != 0)
+            {
+                continue;
+            }
+            findExecutable(builtInNames[i], &found);
+            if(found == false)
+            {
+                addCandidate(&candidates, &numCandidates, &capacity, builtInNames[i]);
+            }
+        }
+    }
+    else
+    {
+        // look in the directory part of the word for names starting with the rest
+        char directoryPath[PATH_MAX];
+        char *lastSlash = strrchr(word, '/');
+        if(lastSlash != NULL)
+        {
+            baseName = lastSlash + 1;
+            snprintf(directoryPath, sizeof(directoryPath), "%.*s", (int)(lastSlash - word + 1), word);
+        }
+        else
+        {
+            strcpy(directoryPath, ".");
+        }
+
+        size_t baseLength = strlen(baseName);
+        DIR *directory = opendir(directoryPath);
+        struct dirent *directoryEntry;
+        while(directory != NULL && (directoryEntry = readdir(directory)) != NULL)
+        {
+            const char *name = directoryEntry->d_name;
+            if(strncmp(name, baseName, baseLength) != 0 || strcmp(name, ".") == 0 || strcmp(name, "..") == 0 ||
+               (name[0] == '.' && baseName[0] != '.'))
+            {
+                continue;
+            }
+
+            // directories are completed with a / so the next tab goes into them
+            struct stat nameInfo;
+            bool isDirectory = directoryEntry->d_type == DT_DIR ||
+                               ((directoryEntry->d_type == DT_LNK || directoryEntry->d_type == DT_UNKNOWN) &&
+                                fstatat(dirfd(directory), name, &nameInfo, 0) == 0 && S_ISDIR(nameInfo.st_mode));
+
+            char *candidate = malloc(strlen(name) + 2);
+            sprintf(candidate, "%s%s", name, isDirectory == true ? "/" : "");
+            addCandidate(&candidates, &numCandidates, &capacity, candidate);
+        }
+        if(directory != NULL)
+        {
+            closedir(directory);
+        }
+        freeCandidates = true;
+    }
+
+    size_t baseLength = strlen(baseName);
+
+    if(numCandidates == 0)
+    {
+        write(STDOUT_FILENO, "\a", 1);
+    }
+    else
+    {
+        // how far every candidate agrees
+        size_t commonLength = strlen(candidates[0]);
+        int i;
+        for(i = 1; i < numCandidates; i++)
+        {
+            size_t j = 0;
+            while(j < commonLength && candidates[i][j] == candidates[0][j])
+            {
+                j++;
+            }
+            commonLength = j;
+        }
+
+        if(commonLength > baseLength || numCandidates == 1)
+        {
+            editInsert(candidates[0] + baseLength, commonLength - baseLength);
+            if(numCandidates == 1 && candidates[0][commonLength - 1] != '/')
+            {
+                editInsert(" ", 1);
+            }
+        }
+        else
+        {
+            // show the choices below the line, at most a hundred of them
+            editOutput.length = 0;
+            bufferAppend(&editOutput, "\r\n", 2);
+            for(i = 0; i < numCandidates && i < 100; i++)
+            {
+                bufferAppend(&editOutput, candidates[i], strlen(candidates[i]));
+                bufferAppend(&editOutput, "  ", 2);
+            }
+            if(numCandidates > 100)
+            {
+                char moreText[32];
+                bufferAppend(&editOutput, moreText, sprintf(moreText, "... %d more", numCandidates - 100));
+            }
+            bufferAppend(&editOutput, "\r\n", 2);
+            write(STDOUT_FILENO, editOutput.data, editOutput.length);
+        }
+    }
+
+    int i;
+    for(i = 0; i < numCandidates && freeCandidates == true; i++)
+    {
+        free(candidates[i]);
+    }
+    free(candidates);
+}
+
+/*************************************************************************************************
+** Name: addCandidate
+**
+** Description: This function adds a completion candidate to a list which doubles as it grows.
+**
+** Parameters: list of candidates, number of candidates, capacity of the list, candidate to add
+**
+** Returns: N/A
+*************************************************************************************************/
+
+void addCandidate(char ***candidates, int *numCandidates, int *capacity, char *candidate)
+{
+    if(*numCandidates == *capacity)
+    {
+        *capacity = *capacity == 0 ? 64 : *capacity * 2;
+        *candidates = realloc(*candidates, *capacity * sizeof(char *));
+    }
+
+    (*candidates)[(*numCandidates)++] = candidate;
+}
+
+/*************************************************************************************************
+** Name: buildExecutableIndex
+**
+** Description: This function builds the index of executables on PATH from scratch. Every absolute
+** directory of PATH, up to 64 of them, gets an inotify watch first and is then read once, so no
+** change made while it is being read is missed. The inotify descriptor joins the epoll set so its
+** events are applied while the shell waits for input. Relative directories depend on the current
+** directory and are left out like they are from the command cache.
+**
+** Parameters: N/A
+**
+** Returns: N/A
+*************************************************************************************************/
+
+void buildExecutableIndex()
+{
+    clearExecutableIndex();
+
+    const char *pathValue = variableValue("PATH", 4);
+    executableIndex.pathCopy = strdup(pathValue == NULL ? "" : pathValue);
+    executableIndex.built = true;
+
+    inotifyFd = highDescriptor(inotify_init1(IN_NONBLOCK | IN_CLOEXEC));
+    if(inotifyFd != -1)
+    {
+        struct epoll_event watchEvent = {0};
+        watchEvent.events = EPOLLIN;
+        watchEvent.data.fd = inotifyFd;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, inotifyFd, &watchEvent);
+    }
+
+    char *pathList = strdup(executableIndex.pathCopy);
+    char *savePointer;
+    char *directoryPath;
+    for(directoryPath = strtok_r(pathList, ":", &savePointer); directoryPath != NULL && executableIndex.numDirs < 64;
+        directoryPath = strtok_r(NULL, ":", &savePointer))
+    {
+        if(directoryPath[0] != '/')
+        {
+            continue;
+        }
+
+        int dirIndex = executableIndex.numDirs++;
+        executableIndex.dirs[dirIndex] = strdup(directoryPath);
+        executableIndex.watches[dirIndex] = inotifyFd == -1 ? -1 :
+            inotify_add_watch(inotifyFd, directoryPath, IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO |
+                              IN_ATTRIB | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR);
+
+        DIR *directory = opendir(directoryPath);
+        struct dirent *directoryEntry;
+        while(directory != NULL && (directoryEntry = readdir(directory)) != NULL)
+        {
+            struct stat fileInfo;
+            if(directoryEntry->d_type != DT_DIR && directoryEntry->d_name[0] != '.' &&
+               fstatat(dirfd(directory), directoryEntry->d_name, &fileInfo, 0) == 0 &&
+               S_ISREG(fileInfo.st_mode) && (fileInfo.st_mode & 0111) != 0)
+            {
+                addExecutable(directoryEntry->d_name, dirIndex);
+            }
+        }
+        if(directory != NULL)
+        {
+            closedir(directory);
+        }
+    }
+    free(pathList);
+}
+
+/*************************************************************************************************
+** Name: clearExecutableIndex
+**
+** Description: This function empties the executable index. Closing the inotify descriptor removes
+** every watch and takes it out of the epoll set, so no event from before can reach a new index.
+**
+** Parameters: N/A
+**
+** Returns: N/A
+*************************************************************************************************/
+
+void clearExecutableIndex()
+{
+    int i;
+    for(i = 0; i < executableIndex.count; i++)
+    {
+        free(executableIndex.entries[i].name);
+    }
+    executableIndex.count = 0;
+
+    for(i = 0; i < executableIndex.numDirs; i++)
+    {
+        free(executableIndex.dirs[i]);
+    }
+    executableIndex.numDirs = 0;
+
+    free(executableIndex.pathCopy);
+    executableIndex.pathCopy = NULL;
+    executableIndex.built = false;
+
+    if(inotifyFd != -1)
+    {
+        close(inotifyFd);
+        inotifyFd = -1;
+    }
+}
+
+/*************************************************************************************************
+** Name: findExecutable
+**
+** Description: This function finds where a name is or would go in the sorted executable index with a
+** binary search. Since every name starting with a prefix sorts right after the prefix itself, this is
+** also where the names completing a prefix begin.
+**
+** Parameters: name to look for, set to whether the name is in the index
+**
+** Returns: position of the name or of the first name after it
+*************************************************************************************************/
+
+int findExecutable(const char *name, bool *found)
+{
+    int low = 0;
+    int high = executableIndex.count;
+
+    while(low < high)
+    {
+        int middle = (low + high) / 2;
+        if(strcmp(executableIndex.entries[middle].name, name) < 0)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    *found = low < executableIndex.count && strcmp(executableIndex.entries[low].name, name) == 0;
+    return low;
+}
+
+/*************************************************************************************************
+** Name: addExecutable
+**
+** Description: This function records that a name is an executable in a PATH directory. A name
+** already in the index only gets the bit of the directory set, a new one is inserted in order.
+**
+** Parameters: name of the executable, number of its directory
+**
+** Returns: N/A
+*************************************************************************************************/
+
+void addExecutable(const char *name, int dirIndex)
+{
+    bool found;
+    int position = findExecutable(name, &found);
+    if(found == true)
+    {
+        executableIndex.entries[position].dirs |= (uint64_t)1 << dirIndex;
+        return;
+    }
+
+    if(executableIndex.count == executableIndex.capacity)
+    {
+        executableIndex.capacity = executableIndex.capacity == 0 ? 1024 : executableIndex.capacity * 2;
+        executableIndex.entries = realloc(executableIndex.entries, executableIndex.capacity * sizeof(struct executableEntry));
+    }
+
+    memmove(&executableIndex.entries[position + 1], &executableIndex.entries[position],
+            (executableIndex.count - position) * sizeof(struct executableEntry));
+    executableIndex.entries[position].name = strdup(name);
+    executableIndex.entries[position].dirs = (uint64_t)1 << dirIndex;
+    executableIndex.count++;
+}
+
+/*************************************************************************************************
+** Name: removeExecutable
+**
+** Description: This function records that a name is no longer an executable in a PATH directory. The
+** name leaves the index once no directory has it.
+**
+** Parameters: name of the executable, number of its directory
+**
+** Returns: N/A
+*************************************************************************************************/
+
+void removeExecutable(const char *name, int dirIndex)
+{
+    bool found;
+    int position = findExecutable(name, &found);
+    if(found == false)
+    {
+        return;
+    }
+
+    executableIndex.entries[position].dirs &= ~((uint64_t)1 << dirIndex);
+    if(executableIndex.entries[position].dirs != 0)
+    {
+        return;
+    }
+
+    free(executableIndex.entries[position].name);
+    memmove(&executableIndex.entries[position], &executableIndex.entries[position + 1],
+            (executableIndex.count - position - 1) * sizeof(struct executableEntry));
+    executableIndex.count--;
+}
+
+/*************************************************************************************************
+** Name: processExecutableEvents
+**
+** Description: This function applies the inotify events of the PATH directories to the executable
+** index. A file created, moved in or with changed permissions is checked and added or removed, and a
+** file deleted or moved out is removed. When a watched directory itself goes away or events were
+** lost the index is rebuilt the next time it is needed.
+**
+** Parameters: N/A
+**
+** Returns: N/A
+*************************************************************************************************/
+
+void processExecutableEvents()
+{
+    char eventBuffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t numRead;
+
+    while(inotifyFd != -1 && (numRead = read(inotifyFd, eventBuffer, sizeof(eventBuffer))) > 0)
+    {
+        char *eventPointer;
+        for(eventPointer = eventBuffer; eventPointer < eventBuffer + numRead;
+            eventPointer += sizeof(struct inotify_event) + ((struct inotify_event *)eventPointer)->len)
+        {
+            const struct inotify_event *pathEvent = (const struct inotify_event *)eventPointer;
+
+            if(pathEvent->mask & IN_Q_OVERFLOW)
+            {
+                executableIndex.built = false;
+                continue;
+            }
+
+            // the same directory may be on PATH more than once
+            int dirIndex;
+            for(dirIndex = 0; dirIndex < executableIndex.numDirs; dirIndex++)
+            {
+                if(executableIndex.watches[dirIndex] != pathEvent->wd)
+                {
+                    continue;
+                }
+
+                if(pathEvent->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED))
+                {
+                    executableIndex.built = false;
+                }
+                else if(pathEvent->len == 0 || pathEvent->name[0] == '.')
+                {
+                    continue;
+                }
+                else if(pathEvent->mask & (IN_DELETE | IN_MOVED_FROM))
+                {
+                    removeExecutable(pathEvent->name, dirIndex);
+                }
+                else
+                {
+                    char filePath[PATH_MAX];
+                    struct stat fileInfo;
+                    snprintf(filePath, sizeof(filePath), "%s/%s", executableIndex.dirs[dirIndex], pathEvent->name);
+
+                    if(stat(filePath, &fileInfo) == 0 && S_ISREG(fileInfo.st_mode) && (fileInfo.st_mode & 0111) != 0)
+                    {
+                        addExecutable(pathEvent->name, dirIndex);
+                    }
+                    else
+                    {
+                        removeExecutable(pathEvent->name, dirIndex);
+                    }
+                }
+            }
+        }
+    }
+}
+
+/*************************************************************************************************
+** Name: readHereDocuments
+**
+** Description: This function reads the body of every here-document of a line of a command. The body
+** is made of the lines of input after the line up to a line which is just the delimiter, with its
+** quotes removed, read the same way commands are so they may come from a terminal, a script, -c or
+** the text a copy of the shell runs. The body replaces the delimiter as the text of the word after
+** the <<, as it was written, since its parameters are expanded by expandRedirections every time the
+** command runs unless the delimiter was quoted. After <<- the tabs at the start of every line are
+** removed before it is compared with the delimiter, so the body can be indented along with the
+** script. Input ending before the delimiter ends the body with a warning.
+**
+** Parameters: tokens of the line, number of tokens, arena to allocate the bodies from
+**
+** Returns: true if every delimiter could be expanded, false otherwise
+*************************************************************************************************/
+
+bool readHereDocuments(struct token *tokens, int numTokens, struct arena *treeArena)
+{
+    int i;
+    for(i = 0; i + 1 < numTokens; i++)
+    {
+        if(tokens[i].type != TOKEN_HEREDOC || tokens[i + 1].type != TOKEN_WORD)
+        {
+            continue;
+        }
+
+        char *delimiter = expandString(tokens[i + 1].text);
+        if(delimiter == NULL)
+        {
+            return false;
+        }
+
+        struct stringBuffer body = {NULL, 0, 0};
+        while(true)
+        {
+            promptText = "> ";
+            if(interactiveShell == true)
+            {
+                printf("> ");
+                fflush(stdout);
+            }
+
+            char *bodyLine;
+            ssize_t lineLength = readCommandLine(&bodyLine);
+            if(lineLength == -1)
+            {
+                fprintf(stderr, "warning: here-document ended by end of input (wanted '%s')\n", delimiter);
+                fflush(stderr);
+                break;
+            }
+
+            // an interrupted read is not a line
+            if(lineLength == 0)
+            {
+                continue;
+            }
+
+            if(strcmp(tokens[i].text, "<<-") == 0)
+            {
+                bodyLine += strspn(bodyLine, "\t");
+            }
+
+            if(strcmp(bodyLine, delimiter) == 0)
+            {
+                break;
+            }
+
+            bufferAppend(&body, bodyLine, strlen(bodyLine));
+            bufferAppendChar(&body, '\n');
+        }
+
+        tokens[i + 1].text = bufferToArena(&body, treeArena);
+        free(body.data);
+    }
+
+    return true;
+}
+
+/*************************************************************************************************
+** Name: expandHereDocumentLine
+**
+** Description: This function appends the text of a here-document to its body with its parameters
+** expanded by variableExpansion and its $(command) and `command` substitutions replaced by the
+** output of the command from commandSubstitution, which is never split into words. Quotes have no
+** meaning in a here-document, and a backslash only escapes $, ` and another backslash.
+**
+** Parameters: text of the here-document, body to append to
+**
+** Returns: true if every parameter and substitution could be expanded, false otherwise
+*************************************************************************************************/
+
+bool expandHereDocumentLine(const char *line, struct stringBuffer *body)
+{
+    bool expanded = true;
+
+    const char *currChar = line;
+    while(*currChar != '\0')
+    {
+        if(*currChar == '\\' && currChar[1] != '\0' && strchr("$`\\", currChar[1]) != NULL)
+        {
+            bufferAppendChar(body, currChar[1]);
+            currChar += 2;
+        }
+        else if((*currChar == '$' && currChar[1] == '(') || *currChar == '`')
+        {
+            size_t numUsed = commandSubstitution(currChar, &substitutionOutput);
+            if(numUsed == 0)
+            {
+                // keep the rest of the text as it is
+                expanded = false;
+                numUsed = 1;
+                bufferAppendChar(body, *currChar);
+            }
+            else
+            {
+                bufferAppend(body, substitutionOutput.data, substitutionOutput.length);
+            }
+            currChar += numUsed;
+        }
+        else if(*currChar == '$')
+        {
+            size_t numUsed = variableExpansion(currChar, body);
+            if(numUsed == 0)
+            {
+                // keep the rest of the line as it is
+                expanded = false;
+                numUsed = 1;
+                bufferAppendChar(body, '$');
+            }
+            currChar += numUsed;
+        }
+        else
+        {
+            // copy everything up to the next special character at once
+            size_t plainLength = strcspn(currChar, "\\$`");
+            if(plainLength == 0)
+            {
+                plainLength = 1;
+            }
+            bufferAppend(body, currChar, plainLength);
+            currChar += plainLength;
+        }
+    }
+
+    return expanded;
+}
+
+/*************************************************************************************************
+** Name: hereDocumentFd
+**
+** Description: This function puts the text of a here-document or here-string where a command can read
+** it as its standard input without touching the filesystem. Text which fits in a pipe in a single
+** atomic write goes into a pipe whose write end is closed straight away. Anything longer goes into an
+** anonymous file made with memfd_create which is rewound to its start. Both are close-on-exec so only
+** the copy duplicated onto standard input reaches the command.
+**
+** Parameters: text to read, boolean indicating if a newline ends the text as it does for a here-string
+**
+** Returns: file descriptor to read the text from or -1 if it could not be created
+*************************************************************************************************/
+
+int hereDocumentFd(const char *text, bool addNewLine)
+{
+    size_t textLength = strlen(text);
+    int pipeFds[2];
+
+    // a small text can never block writing into a pipe
+    if(textLength + 1 <= PIPE_BUF && pipe2(pipeFds, O_CLOEXEC) == 0)
+    {
+        char pipeText[PIPE_BUF];
+        memcpy(pipeText, text, textLength);
+        if(addNewLine == true)
+        {
+            pipeText[textLength++] = '\n';
+        }
+
+        write(pipeFds[1], pipeText, textLength);
+        close(pipeFds[1]);
+        return pipeFds[0];
+    }
+
+    int memoryFd = memfd_create("smallsh-heredoc", MFD_CLOEXEC);
+    if(memoryFd == -1)
+    {
+        return -1;
+    }
+
+    // write the whole text even if it takes more than one write
+    size_t numWritten = 0;
+    while(numWritten < textLength)
+    {
+        ssize_t writeResult = write(memoryFd, text + numWritten, textLength - numWritten);
+        if(writeResult == -1)
+        {
+            if(errno == EINTR)
+            {
+                continue;
+            }
+            close(memoryFd);
+            return -1;
+        }
+        numWritten += writeResult;
+    }
+
+    if(addNewLine == true)
+    {
+        write(memoryFd, "\n", 1);
+    }
+
+    lseek(memoryFd, 0, SEEK_SET);
+
+    return memoryFd;
+}
+
+/*************************************************************************************************
+** Name: openInput
+**
+** Description: This function works out where the shell reads its commands from. With -c the commands
+** are the argument that follows. With a file name the commands are read from that script, which is
+** mapped into memory with mmap so it is handed out line by line without being copied, falling back
+** to large reads when the file cannot be mapped. Otherwise the commands come from standard input.
+** The shell is only interactive when reading standard input from a terminal. Everywhere else the
+** prompt is not printed and standard input is read with large blocking reads.
+**
+** Parameters: number of command line arguments, command line arguments
+**
+** Returns: N/A
+*************************************************************************************************/
+
+void openInput(int argc, char *argv[])
+{
+    // a client sends its command line to a server and does nothing else
+    if(argc > 1 && strcmp(argv[1], "--client") == 0)
+    {
+        exit(runClient(argc, argv));
+    }
+
+    // commands given on the command line, or by the clients of a server
+    if(argc > 1 && (strcmp(argv[1], "-c") == 0 || strcmp(argv[1], "--serve") == 0))
+    {
+        if(argc < 3)
+        {
+            fprintf(stderr, "usage: smallsh [-c commands | script | --serve socket | --client socket command]\n");
+            exit(2);
+        }
+
+        if(argv[1][1] == '-')
+        {
+            serverSocket = argv[2];
+            inputFd = -1;
+            interactiveShell = false;
+            return;
+        }
+
+        inputBuffer = strdup(argv[2]);
+        inputLength = strlen(inputBuffer);
+        inputFd = -1;
+        interactiveShell = false;
+        return;
+    }
+
+    // commands in a script
+    if(argc > 1)
+    {
+        inputFd = highDescriptor(open(argv[1], O_RDONLY | O_CLOEXEC));
+        if(inputFd == -1)
+        {
+            perror(argv[1]);
+            exit(127);
+        }
+        interactiveShell = false;
+
+        // the arguments after the script are its positional parameters
+        positionalParams = argv + 2;
+        numPositional = argc - 2;
+
+        // map the script so its lines are used where they are
+        struct stat scriptInfo;
+        if(fstat(inputFd, &scriptInfo) == 0 && S_ISREG(scriptInfo.st_mode) && scriptInfo.st_size > 0)
+        {
+            void *script = mmap(NULL, scriptInfo.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, inputFd, 0);
+            if(script != MAP_FAILED)
+            {
+                madvise(script, scriptInfo.st_size, MADV_SEQUENTIAL);
+                inputBuffer = script;
+                inputLength = scriptInfo.st_size;
+                close(inputFd);
+                inputFd = -1;
+            }
+        }
+        return;
+    }
+
+    inputFd = STDIN_FILENO;
+    interactiveShell = isatty(STDIN_FILENO);
+}
+
+/*************************************************************************************************
+** Name: setupSignals
+**
+** Description: This function sets up the signal handling of the shell once when it starts. For the
+** SIGINT signal one struct handles ignoring of the signal so that parent is not terminated by cntrl+c
+** and the other struct related to SIGINT is so that termination only happens to foreground child
+** processes. The function also declares two structs for SIGTSTP one being a sighandler which prints a
+** message giving notification of switching between foreground only mode and when that mode is off,
+** and the other to ignore SIGTSTP so that it does not stop any of the child processes made.
+**
+** Parameters: N/A
+**
+** Returns: N/A
+*************************************************************************************************/
+
+void setupSignals()
+{
+    // struct to ignore SIGINT
+    struct sigaction ignoreSIGINT = {0};
+    ignoreSIGINT.sa_handler = SIG_IGN;
+    sigfillset(&ignoreSIGINT.sa_mask);
+    ignoreSIGINT.sa_flags = 0;
+
+    // setting parent to ignore SIGINT
+    sigaction(SIGINT, &ignoreSIGINT, NULL);
+
+    //struct to terminate foreground child
+    terminateFgChild.sa_handler = SIG_DFL;
+    sigfillset(&terminateFgChild.sa_mask);
+    terminateFgChild.sa_flags = 0;
+
+    // struct to have signal handler with message
+    struct sigaction SIGTSTP_action = {0};
+    SIGTSTP_action.sa_handler = catchSIGTSTP;
+    sigfillset(&SIGTSTP_action.sa_mask);
+    sigaction(SIGTSTP, &SIGTSTP_action, NULL);
+
+    // struct to ignore SIGTSTP
+    ignoreSIGTSTP.sa_handler = SIG_IGN;
+    sigfillset(&ignoreSIGTSTP.sa_mask);
+}
+
+/*************************************************************************************************
+** Name: printShellPrompt
+**
+** Description: This function obtains user input and ensures validity before being processed. The
+** signal handling it relies on is set up once by setupSignals when the shell starts.
+**
+** The function then uses readCommandLine to obtain input form the user after printing the shells
+** prompt ":" After reporting any background processes which finished since the last prompt. The
+** prompt is only printed when the shell is interactive. Finished background processes are only looked
+** for when the signalfd says a child has ended, and the shell sleeps in the event loop until then.
+** The function then hands the line to readCommand, which reads as many more lines as the command
+** it starts needs, lexes every line in a single pass which also drops comments, so blank lines and
+** comment lines # are completely ignored as they have no tokens, and parses the tokens into a syntax
+** tree. runCommand then runs the tree, expanding variables such as $$, which is replaced by the
+** shell's PID at any occurrence, every time a command of it runs. Everything made from the command
+** lives in the tree and line arenas which are reset once the command is done. A shell which is not
+** interactive stops at a command with a syntax error, the way it does at the end of its input.
+**
+** The function is called in a loop in main until the user calls exit or there is no more input
+**
+** Parameters: N/A
+**
+** Returns: true if a line was processed, false once input has ended or a script had a syntax error
+*************************************************************************************************/
+
+bool printShellPrompt()
+{
+    char* lineEntered = NULL; // Points into the input buffer at our entered string + \0
+
+
+    // Get input from the user
+    do
+    {
+        // make sure variable gets reset each iteration
+        askInput = true;
+
+        //check on background processes being killed or finishing since the last prompt
+        if(drainSignalFd() == true)
+        {
+            checkBackgroundStatus();
+        }
+
+        // a script reads no input through the event loop, so captured jobs are drained here as well
+        if(jobCapture.numOpen > 0)
+        {
+            drainCaptures();
+        }
+
+        // only a person at a terminal needs a prompt
+        promptText = ":";
+        if(interactiveShell == true)
+        {
+            printf(":");
+            fflush(stdout);
+        }
+
+        // Get a line from the user. there is nothing left to run once input ends
+        if(readCommandLine(&lineEntered) == -1)
+        {
+            return false;
+        }
+
+        // the command the line starts, which may take more lines, is parsed into its syntax tree
+        bool isSyntaxError;
+        struct node *program = readCommand(lineEntered, &isSyntaxError);
+        if(program != NULL)
+        {
+            askInput = false;
+            runCommand(program);
+        }
+
+        // a script or -c with a syntax error stops there, with the status of the error
+        if(isSyntaxError == true && interactiveShell == false)
+        {
+            arenaReset(&treeArena);
+            arenaReset(&lineArena);
+            return false;
+        }
+
+        // everything made from the command is released at once, unless it defined functions
+        if(runningTree != NULL)
+        {
+            releaseTree(runningTree);
+            runningTree = NULL;
+        }
+        else
+        {
+            arenaReset(&treeArena);
+        }
+        arenaReset(&lineArena);
+
+    }while(askInput == true);
+
+    return true;
+}
+
+/*************************************************************************************************
+** Name: openHistory
+**
+** Description: This function opens the history file of an interactive shell, SMALLSH_HISTFILE or
+** .smallsh_history in the home directory, where an empty SMALLSH_HISTFILE keeps history in memory
+** only. The file is opened for appending and what it holds is mapped into memory without being read,
+** so startup takes the same time however many lines it has. Lines other shells add later are not
+** seen by this one.
+**
+** Parameters: N/A
+**
+** Returns: N/A
+*************************************************************************************************/
+
+void openHistory()
+{
+    if(interactiveShell == false)
+    {
+        return;
+    }
+
+    char defaultPath[PATH_MAX];
+    const char *historyPath = getenv("SMALLSH_HISTFILE");
+    if(historyPath == NULL)
+    {
+        const char *homeDirectory = getenv("HOME");
+        if(homeDirectory == NULL)
+        {
+            return;
+        }
+        snprintf(defaultPath, sizeof(defaultPath), "%s/.smallsh_history", homeDirectory);
+        historyPath = defaultPath;
+    }
+
+    if(historyPath[0] == '\0')
+    {
+        return;
+    }
+
+    commandHistory.fd = highDescriptor(open(historyPath, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0600));
+    if(commandHistory.fd == -1)
+    {
+        return;
+    }
+
+    struct stat historyInfo;
+    if(fstat(commandHistory.fd, &historyInfo) == 0 && historyInfo.st_size > 0)
+    {
+        void *mapping = mmap(NULL, historyInfo.st_size, PROT_READ, MAP_PRIVATE, commandHistory.fd, 0);
+        if(mapping != MAP_FAILED)
+        {
+            commandHistory.mapped = mapping;
+            commandHistory.mappedLength = historyInfo.st_size;
+        }
+    }
+}
+
+/*************************************************************************************************
+** Name: addHistory
+**
+** Description: This function adds a command line to the history of this session and appends it to
+** the history file. The line and its newline go to the file in a single write on a descriptor opened
+** with O_APPEND, so several shells appending at the same time never split or overwrite each others
+** lines.
+**
+** Parameters: command line to add
+**
+** Returns: N/A
+*************************************************************************************************/
+
+void addHistory(const char *line)
+{
+    if(commandHistory.numSessionLines == commandHistory.sessionCapacity)
+    {
+        commandHistory.sessionCapacity = commandHistory.sessionCapacity == 0 ? 64 : commandHistory.sessionCapacity * 2;
+        commandHistory.sessionLines = realloc(commandHistory.sessionLines, commandHistory.sessionCapacity * sizeof(size_t));
+    }
+
+    size_t lineStart = commandHistory.sessionText.length;
+    size_t lineLength = strlen(line);
+    commandHistory.sessionLines[commandHistory.numSessionLines++] = lineStart;
+    bufferAppend(&commandHistory.sessionText, line, lineLength);
+    bufferAppendChar(&commandHistory.sessionText, '\n');
+
+    if(commandHistory.fd != -1)
+    {
+        write(commandHistory.fd, commandHistory.sessionText.data + lineStart, lineLength + 1);
+    }
+}
+
+/*************************************************************************************************
+** Name: indexHistoryFile
+**
+** Description: This function finds where every line of the mapped history file starts, in a single
+** pass with memchr. It is only done the first time an entry is needed. A last line cut short
+** without its newline still counts as a line.
+**
+** Parameters: N/A
+**
+** Returns: N/A
+*************************************************************************************************/
+
+void indexHistoryFile()
+{
+    if(commandHistory.fileLines != NULL || commandHistory.mapped == NULL)
+    {
+        return;
+    }
+
+    int capacity = 1024;
+    commandHistory.fileLines = malloc(capacity * sizeof(size_t));
+
+    size_t offset = 0;
+    while(offset < commandHistory.mappedLength)
+    {
+        if(commandHistory.numFileLines == capacity)
+        {
+            capacity *= 2;
+            commandHistory.fileLines = realloc(commandHistory.fileLines, capacity * sizeof(size_t));
+        }
+        commandHistory.fileLines[commandHistory.numFileLines++] = offset;
+
+        const char *newLine = memchr(commandHistory.mapped + offset, '\n', commandHistory.mappedLength - offset);
+        offset = newLine != NULL ? (size_t)(newLine - commandHistory.mapped) + 1 : commandHistory.mappedLength;
+    }
+}
+
+/*************************************************************************************************
+** Name: numHistoryEntries
+**
+** Description: This function counts the entries of the history, the lines of the history file
+** followed by the lines of this session.
+**
+** Parameters: N/A
+**
+** Returns: number of entries
+*************************************************************************************************/
+
+int numHistoryEntries()
+{
+    indexHistoryFile();
+
+    return commandHistory.numFileLines + commandHistory.numSessionLines;
+}
+
+/*************************************************************************************************
+** Name: historyEntry
+**
+** Description: This function finds an entry of the history by its number, counting from 1 for the
+** oldest line of the history file. The entry is not copied or null terminated, it is where it sits in
+** the mapped file or the session lines.
+**
+** Parameters: number of the entry, length of the entry
+**
+** Returns: start of the entry or NULL if there is no entry with that number
+*************************************************************************************************/
+
+const char* historyEntry(int entryNumber, size_t *entryLength)
+{
+    if(entryNumber < 1 || entryNumber > numHistoryEntries())
+    {
+        return NULL;
+    }
+
+    const char *text;
+    size_t *lineStarts;
+    int numLines;
+    size_t textLength;
+    int lineIndex = entryNumber - 1;
+
+    if(lineIndex < commandHistory.numFileLines)
+    {
+        text = commandHistory.mapped;
+        textLength = commandHistory.mappedLength;
+        lineStarts = commandHistory.fileLines;
+        numLines = commandHistory.numFileLines;
+    }
+    else
+    {
+        lineIndex -= commandHistory.numFileLines;
+        text = commandHistory.sessionText.data;
+        textLength = commandHistory.sessionText.length;
+        lineStarts = commandHistory.sessionLines;
+        numLines = commandHistory.numSessionLines;
+    }
+
+    // a line runs up to the start of the next one, less its newline
+    size_t lineEnd = lineIndex + 1 < numLines ? lineStarts[lineIndex + 1] : textLength;
+    if(lineEnd > lineStarts[lineIndex] && text[lineEnd - 1] == '\n')
+    {
+        lineEnd--;
+    }
+
+    *entryLength = lineEnd - lineStarts[lineIndex];
+    return text + lineStarts[lineIndex];
+}
+
+/*************************************************************************************************
+** Name: historyMatches
+**
+** Description: This function checks if an entry of the history starts with or contains some text.
+**
+** Parameters: entry, length of the entry, text to look for, length of the text, boolean indicating
+** if the entry has to start with the text
+**
+** Returns: true if the entry matches, false otherwise
+*************************************************************************************************/
+
+bool historyMatches(const char *entryText, size_t entryLength, const char *text, size_t textLength, bool prefixOnly)
+{
+    if(prefixOnly == true)
+    {
+        return entryLength >= textLength && memcmp(entryText, text, textLength) == 0;
+    }
+
+    return memmem(entryText, entryLength, text, textLength) != NULL;
+}
+
+/*************************************************************************************************
+** Name: findHistory
+**
+** Description: This function finds the most recent entry of the history which starts with or
+** contains some text, searching from the newest entry back.
+**
+** Parameters: text to look for, its length, boolean indicating if the entry has to start with it
+**
+** Returns: number of the entry or 0 if none matches
+*************************************************************************************************/
+
+int findHistory(const char *text, size_t textLength, bool prefixOnly)
+{
+    int entryNumber;
+    for(entryNumber = numHistoryEntries(); entryNumber > 0; entryNumber--)
+    {
+        size_t entryLength;
+        const char *entryText = historyEntry(entryNumber, &entryLength);
+        if(historyMatches(entryText, entryLength, text, textLength, prefixOnly) == true)
+        {
+            return entryNumber;
+        }
+    }
+
+    return 0;
+}
+
+/*************************************************************************************************
+** Name: expandHistory
+**
+** Description: This function replaces the history references of a line with the entries they name.
+** !! is the last entry, !n entry n, !-n the nth entry back, !prefix the last entry starting with the
+** prefix and !?text? the last entry containing the text. A ! inside single quotes, after a backslash,
+** or followed by a blank, = or ( is left alone. Lines without a ! are not copied at all.
+**
+** Parameters: line entered, buffer to build the expanded line in
+**
+** Returns: 1 if the line was expanded into the buffer, 0 if it has no references, -1 if a reference
+** names no entry
+*************************************************************************************************/
+
+int expandHistory(const char *line, struct stringBuffer *expanded)
+{
+    if(strchr(line, '!') == NULL)
+    {
+        return 0;
+    }
+
+    expanded->length = 0;
+    bool changed = false;
+    char quote = '\0';
+
+    const char *currChar = line;
+    while(*currChar != '\0')
+    {
+        // quotes are kept for the lexer but single quotes stop expansion
+        if((*currChar == '\'' || *currChar == '"') && (quote == '\0' || quote == *currChar))
+        {
+            quote = quote == '\0' ? *currChar : '\0';
+        }
+
+        if(*currChar == '\\' && currChar[1] != '\0' && quote != '\'')
+        {
+            bufferAppend(expanded, currChar, 2);
+            currChar += 2;
+            continue;
+        }
+
+        if(*currChar != '!' || quote == '\'' || currChar[1] == '\0' || isspace((unsigned char)currChar[1]) || strchr("=(", currChar[1]) != NULL)
+        {
+            bufferAppendChar(expanded, *currChar++);
+            continue;
+        }
+
+        const char *designator = currChar + 1;
+        size_t numUsed;
+        int entryNumber;
+        int numEntries = numHistoryEntries();
+
+        if(*designator == '!')
+        {
+            entryNumber = numEntries;
+            numUsed = 1;
+        }
+        else if(isdigit((unsigned char)designator[0]) || (designator[0] == '-' && isdigit((unsigned char)designator[1])))
+        {
+            char *numberEnd;
+            long number = strtol(designator, &numberEnd, 10);
+            entryNumber = number < 0 ? numEntries + 1 + number : number;
+            numUsed = numberEnd - designator;
+        }
+        else if(*designator == '?')
+        {
+            const char *textEnd = strchr(designator + 1, '?');
+            size_t textLength = textEnd != NULL ? (size_t)(textEnd - designator - 1) : strlen(designator + 1);
+            entryNumber = findHistory(designator + 1, textLength, false);
+            numUsed = textLength + (textEnd != NULL ? 2 : 1);
+        }
+        else
+        {
+            numUsed = strcspn(designator, " \t;&|<>()'\"");
+            entryNumber = numUsed > 0 ? findHistory(designator, numUsed, true) : 0;
+        }
+
+        size_t entryLength;
+        const char *entryText = historyEntry(entryNumber, &entryLength);
+        if(entryText == NULL)
+        {
+            fprintf(stderr, "ERROR: !%.*s: event not found\n", (int)numUsed, designator);
+            fflush(stderr);
+            return -1;
+        }
+
+        bufferAppend(expanded, entryText, entryLength);
+        changed = true;
+        currChar = designator + numUsed;
+    }
+
+    return changed == true ? 1 : 0;
+}
+
+/*************************************************************************************************
+** Name: historyCommand
+**
+** Description: This function is the history built in. On its own it lists every entry with its
+** number, history N lists the last N entries, history -p PREFIX the entries starting with the prefix
+** and history -s TEXT the entries containing the text.
+**
+** Parameters: string for user input which has been tokenized
+**
+** Returns: exit value of the command
+*************************************************************************************************/
+
+int historyCommand(char **commandLine)
+{
+    int numEntries = numHistoryEntries();
+    int firstEntry = 1;
+    const char *searchText = NULL;
+    bool prefixOnly = false;
+
+    bool validArguments = true;
+
+    if(commandLine[1] != NULL && (strcmp(commandLine[1], "-s") == 0 || strcmp(commandLine[1], "-p") == 0))
+    {
+        searchText = commandLine[2];
+        prefixOnly = commandLine[1][1] == 'p';
+        validArguments = searchText != NULL;
+    }
+    else if(commandLine[1] != NULL)
+    {
+        char *numberEnd;
+        long numShown = strtol(commandLine[1], &numberEnd, 10);
+        validArguments = commandLine[1][0] != '\0' && *numberEnd == '\0' && numShown >= 0;
+
+        if(numShown < numEntries)
+        {
+            firstEntry = numEntries - numShown + 1;
+        }
+    }
+
+    if(validArguments == false)
+    {
+        fprintf(stderr, "usage: history [N | -p prefix | -s text]\n");
+        fflush(stderr);
+        return 2;
+    }
+
+    size_t searchLength = searchText != NULL ? strlen(searchText) : 0;
+
+    int entryNumber;
+    for(entryNumber = firstEntry; entryNumber <= numEntries; entryNumber++)
+    {
+        size_t entryLength;
+        const char *entryText = historyEntry(entryNumber, &entryLength);
+        if(searchText == NULL || historyMatches(entryText, entryLength, searchText, searchLength, prefixOnly) == true)
+        {
+            printf("%5d  %.*s\n", entryNumber, (int)entryLength, entryText);
+        }
+    }
+
+    return 0;
+}
+
+/*************************************************************************************************
+** Name: serveRequests
+**
+** Description: This function runs the shell as a server on a Unix domain socket, so a program
+** which runs many commands pays for starting a shell once. Clients send command lines in frames,
+** each a type byte and a four byte length in network order followed by that many bytes. A C frame
+** holds a command line to run. The server answers with O and E frames holding what the command
+** writes to its standard output and error as it writes it, and ends every request with an X frame
+** holding the four byte exit value. Every request runs in a copy of the shell forked by
+** startRequest, so cd or exit only affect that request and a slow command holds up nobody but its
+** own client. The requests of one connection run one after another, while any number of
+** connections are served at once from the one event loop.
+**
+** Parameters: path of the socket, which is removed first if it is left over from an earlier server
+**
+** Returns: exit value of the shell if the socket could not be set up, otherwise it does not return
+*************************************************************************************************/
+
+int serveRequests(const char *socketPath)
+{
+    struct sockaddr_un address = {0};
+    address.sun_family = AF_UNIX;
+    if(strlen(socketPath) >= sizeof(address.sun_path))
+    {
+        fprintf(stderr, "%s: socket path is too long\n", socketPath);
+        fflush(stderr);
+        return 2;
+    }
+    strcpy(address.sun_path, socketPath);
+
+    serverListenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    unlink(socketPath);
+    if(serverListenFd == -1 || bind(serverListenFd, (struct sockaddr *)&address, sizeof(address)) == -1 ||
+       listen(serverListenFd, SOMAXCONN) == -1)
+    {
+        perror(socketPath);
+        fflush(stderr);
+        return 1;
+    }
+
+    // the events of the server are told apart by their tags rather than by descriptor
+    struct epoll_event watchEvent = {0};
+    watchEvent.events = EPOLLIN;
+    watchEvent.data.u64 = SERVER_LISTEN_EVENT;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, serverListenFd, &watchEvent);
+    watchEvent.data.u64 = SERVER_SIGNAL_EVENT;
+    epoll_ctl(epollFd, EPOLL_CTL_MOD, signalFd, &watchEvent);
+
+    struct epoll_event readyEvents[64];
+    while(true)
+    {
+        int numReady = epoll_wait(epollFd, readyEvents, 64, -1);
+        if(numReady == -1 && errno != EINTR)
+        {
+            perror("ERROR: Unable to wait for clients");
+            fflush(stderr);
+            return 1;
+        }
+
+        int i;
+        for(i = 0; i < numReady; i++)
+        {
+            uint64_t tag = readyEvents[i].data.u64;
+            if(tag == SERVER_LISTEN_EVENT)
+            {
+                acceptClients();
+            }
+            else if(tag == SERVER_SIGNAL_EVENT)
+            {
+                if(drainSignalFd() == true)
+                {
+                    reapRequests();
+                }
+            }
+            else if((tag & 3) == REQUEST_CLIENT)
+            {
+                readClient(tag >> 2, readyEvents[i].events);
+            }
+            else
+            {
+                readRequestOutput(tag >> 2, (tag & 3) - REQUEST_STDOUT);
+            }
+        }
+    }
+}
+
+/*************************************************************************************************
+** Name: acceptClients
+**
+** Description: This function takes every connection waiting on the listening socket and gives it
+** a free slot in the table of clients, which grows as needed.
+**
+** Parameters: N/A
+**
+** Returns: N/A
+*************************************************************************************************/
+
+void acceptClients()
+{
+    while(true)
+    {
+        int clientFd = accept4(serverListenFd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if(clientFd == -1)
+        {
+            if(errno == EINTR)
+            {
+                continue;
+            }
+            if(errno != EAGAIN)
+            {
+                perror("ERROR: Unable to accept a client");
+                fflush(stderr);
+            }
+            return;
+        }
+
+        int slot;
+        for(slot = 0; slot < numServerClients && serverClients[slot].socketFd != -1; slot++)
+        {
+        }
+
+        if(slot == numServerClients)
+        {
+            int newCount = numServerClients == 0 ? 16 : numServerClients * 2;
+            serverClients = realloc(serverClients, newCount * sizeof(struct serverClient));
+            memset(serverClients + numServerClients, 0, (newCount - numServerClients) * sizeof(struct serverClient));
+
+            int i;
+            for(i = numServerClients; i < newCount; i++)
+            {
+                serverClients[i].socketFd = -1;
+            }
+            numServerClients = newCount;
+        }
+
+        struct serverClient *client = &serverClients[slot];
+        client->socketFd = clientFd;
+        client->input.length = 0;
+        client->inputUsed = 0;
+        client->output.length = 0;
+        client->outputSent = 0;
+        client->requestPid = 0;
+        client->outputFds[0] = -1;
+        client->outputFds[1] = -1;
+        client->inputEnded = false;
+        client->outputPaused = false;
+
+        struct epoll_event watchEvent = {0};
+        watchEvent.events = EPOLLIN;
+        watchEvent.data.u64 = ((uint64_t)slot << 2) | REQUEST_CLIENT;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, clientFd, &watchEvent);
+    }
+}
+
+/*************************************************************************************************
+** Name: readClient
+**
+** Description: This function handles a client whose socket is ready. Replies waiting to be written
+** are sent and whatever the client sent is added to its input, after which the next request is
+** started if the client is idle. A client which shuts down its side of the connection still gets
+** the replies to what it sent, while one which is gone is closed at once.
+**
+** Parameters: slot of the client, events reported for its socket
+**
+** Returns: N/A
+*************************************************************************************************/
+
+void readClient(int slot, uint32_t events)
+{
+    struct serverClient *client = &serverClients[slot];
+    if(client->socketFd == -1)
+    {
+        return;
+    }
+
+    if((events & (EPOLLHUP | EPOLLERR)) != 0)
+    {
+        closeClient(slot);
+        return;
+    }
+
+    while((events & EPOLLIN) != 0 && client->inputEnded == false)
+    {
+        if(client->input.capacity - client->input.length < 4096)
+        {
+            client->input.capacity = client->input.capacity < 4096 ? 8192 : client->input.capacity * 2;
+            client->input.data = realloc(client->input.data, client->input.capacity);
+        }
+
+        ssize_t numRead = read(client->socketFd, client->input.data + client->input.length,
+                               client->input.capacity - client->input.length);
+        if(numRead > 0)
+        {
+            client->input.length += numRead;
+        }
+        else if(numRead == 0)
+        {
+            client->inputEnded = true;
+        }
+        else if(errno == EAGAIN)
+        {
+            break;
+        }
+        else if(errno != EINTR)
+        {
+            closeClient(slot);
+            return;
+        }
+    }
+
+    startNextRequest(slot);
+    flushClient(slot);
+}
+
+/*************************************************************************************************
+** Name: startNextRequest
+**
+** Description: This function starts the next request of an idle client once the whole of its frame
+** has been read. A frame which is not a command line or is too long ends the connection, since
+** nothing after it can be trusted to start where a frame does.
+**
+** Parameters: slot of the client
+**
+** Returns: N/A
+*************************************************************************************************/
+
+void startNextRequest(int slot)
+{
+    struct serverClient *client = &serverClients[slot];
+
+    while(client->socketFd != -1 && client->requestPid == 0 && client->input.length - client->inputUsed >= 5)
+    {
+        const char *frame = client->input.data + client->inputUsed;
+        uint32_t length;
+        memcpy(&length, frame + 1, 4);
+        length = ntohl(length);
+
+        if(frame[0] != 'C' || length > MAX_REQUEST)
+        {
+            closeClient(slot);
+            return;
+        }
+        if(client->input.length - client->inputUsed - 5 < length)
+        {
+            break;
+        }
+
+        client->inputUsed += 5 + length;
+        startRequest(slot, frame + 5, length);
+    }
+
+    // input which has been used up is dropped so the buffer does not grow with the connection
+    if(client->inputUsed == client->input.length)
+    {
+        client->input.length = 0;
+        client->inputUsed = 0;
+    }
+    else if(client->inputUsed > 65536)
+    {
+        memmove(client->input.data, client->input.data + client->inputUsed, client->input.length - client->inputUsed);
+        client->input.length -= client->inputUsed;
+        client->inputUsed = 0;
+    }
+}
+
+/*************************************************************************************************
+** Name: startRequest
+**
+** Description: This function starts a request of a client. The shell forks a copy of itself with
+** its standard output and error going into two pipes and its input coming from /dev/null, and the
+** copy runs the command line with runLineInCopy, so the line goes through the same lexing,
+** parsing and createFork as one typed at the prompt. The copy first closes the sockets and pipes
+** of the server, so a client sees its connection end and a request given up sees its pipes close.
+** The server watches the read ends of the pipes, and a request which cannot be started is answered
+** with an error and exit value 1.
+**
+** Parameters: slot of the client, command line and its length, which is not NUL terminated
+**
+** Returns: true if the request was started
+*************************************************************************************************/
+
+bool startRequest(int slot, const char *commandText, size_t length)
+{
+    struct serverClient *client = &serverClients[slot];
+    int outputPipe[2];
+    int errorPipe[2];
+
+    if(pipe2(outputPipe, O_CLOEXEC) == -1)
+    {
+        outputPipe[0] = -1;
+    }
+    else if(pipe2(errorPipe, O_CLOEXEC) == -1)
+    {
+        close(outputPipe[0]);
+        close(outputPipe[1]);
+        outputPipe[0] = -1;
+    }
+
+    pid_t requestPid = -1;
+    if(outputPipe[0] != -1)
+    {
+        fflush(stdout);
+        fflush(stderr);
+
+        requestPid = fork();
+        if(requestPid == 0)
+        {
+            int nullFd = open("/dev/null", O_RDONLY);
+            dup2(nullFd, STDIN_FILENO);
+            dup2(outputPipe[1], STDOUT_FILENO);
+            dup2(errorPipe[1], STDERR_FILENO);
+
+            // the copy holds no read end either, so writing to a request which was given up fails
+            close(outputPipe[0]);
+            close(errorPipe[0]);
+            close(serverListenFd);
+            int i;
+            for(i = 0; i < numServerClients; i++)
+            {
+                if(serverClients[i].socketFd != -1)
+                {
+                    close(serverClients[i].socketFd);
+                }
+                if(serverClients[i].outputFds[0] != -1)
+                {
+                    close(serverClients[i].outputFds[0]);
+                }
+                if(serverClients[i].outputFds[1] != -1)
+                {
+                    close(serverClients[i].outputFds[1]);
+                }
+            }
+
+            runLineInCopy(strndup(commandText, length));
+        }
+
+        close(outputPipe[1]);
+        close(errorPipe[1]);
+        if(requestPid == -1)
+        {
+            close(outputPipe[0]);
+            close(errorPipe[0]);
+        }
+    }
+
+    if(requestPid == -1)
+    {
+        const char *message = "smallsh: unable to start the command\n";
+        uint32_t exitValue = htonl(1);
+        appendFrame(&client->output, 'E', message, strlen(message));
+        appendFrame(&client->output, 'X', &exitValue, 4);
+        return false;
+    }
+
+    client->requestPid = requestPid;
+    client->reaped = false;
+    client->outputFds[0] = outputPipe[0];
+    client->outputFds[1] = errorPipe[0];
+
+    // only the read ends are made non-blocking, the copy writes as usual
+    struct epoll_event watchEvent = {0};
+    watchEvent.events = EPOLLIN;
+
+    int stream;
+    for(stream = 0; stream < 2; stream++)
+    {
+        fcntl(client->outputFds[stream], F_SETFL, O_NONBLOCK);
+        watchEvent.data.u64 = ((uint64_t)slot << 2) | (REQUEST_STDOUT + stream);
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, client->outputFds[stream], &watchEvent);
+    }
+
+    return true;
+}
+
+/*************************************************************************************************
+** Name: readRequestOutput
+**
+** Description: This function reads what the request of a client has written to one of its pipes
+** and queues it for the client in a frame of its own. Once every process of the request has closed
+** the pipe it is closed here as well, and the request is answered if it has also been reaped.
+**
+** Parameters: slot of the client, 0 for standard output or 1 for standard error
+**
+** Returns: N/A
+*************************************************************************************************/
+
+void readRequestOutput(int slot, int stream)
+{
+    struct serverClient *client = &serverClients[slot];
+    if(client->socketFd == -1 || client->outputFds[stream] == -1)
+    {
+        return;
+    }
+
+    char outputData[65536];
+    ssize_t numRead = read(client->outputFds[stream], outputData, sizeof(outputData));
+    if(numRead > 0)
+    {
+        appendFrame(&client->output, stream == 0 ? 'O' : 'E', outputData, numRead);
+        flushClient(slot);
+        return;
+    }
+    if(numRead == -1 && (errno == EAGAIN || errno == EINTR))
+    {
+        return;
+    }
+
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, client->outputFds[stream], NULL);
+    close(client->outputFds[stream]);
+    client->outputFds[stream] = -1;
+
+    if(client->reaped == true && client->outputFds[1 - stream] == -1)
+    {
+        finishRequest(slot);
+    }
+}
+
+/*************************************************************************************************
+** Name: reapRequests
+**
+** Description: This function reaps the copies of the shell which have finished their request. A
+** request whose pipes are already closed is answered at once, otherwise the answer waits until
+** everything the request started has finished writing.
+**
+** Parameters: N/A
+**
+** Returns: N/A
+*************************************************************************************************/
+
+void reapRequests()
+{
+    pid_t requestPid;
+    int exitMethod;
+
+    while((requestPid = waitpid(-1, &exitMethod, WNOHANG)) > 0)
+    {
+        int slot;
+        for(slot = 0; slot < numServerClients; slot++)
+        {
+            struct serverClient *client = &serverClients[slot];
+            if(client->socketFd != -1 && client->requestPid == requestPid)
+            {
+                client->exitMethod = exitMethod;
+                client->reaped = true;
+                if(client->outputFds[0] == -1 && client->outputFds[1] == -1)
+                {
+                    finishRequest(slot);
+                }
+                break;
+            }
+        }
+    }
+}
+
+/*************************************************************************************************
+** Name: finishRequest
+**
+** Description: This function answers a finished request with its exit value and moves on to the
+** next request of the client, if it has already sent one.
+**
+** Parameters: slot of the client
+**
+** Returns: N/A
+*************************************************************************************************/
+
+void finishRequest(int slot)
+{
+    struct serverClient *client = &serverClients[slot];
+
+    uint32_t exitValueSent = htonl(exitValue(client->exitMethod));
+    appendFrame(&client->output, 'X', &exitValueSent, 4);
+    client->requestPid = 0;
+    client->outputPaused = false;
+
+    startNextRequest(slot);
+    flushClient(slot);
+}
+
+/*************************************************************************************************
+** Name: appendFrame
+**
+** Description: This function queues a frame for a client.
+**
+** Parameters: output of the client, type of frame, data of the frame and its length
+**
+** Returns: N/A
+*************************************************************************************************/
+
+void appendFrame(struct stringBuffer *output, char type, const void *data, uint32_t length)
+{
+    char header[5];
+    uint32_t networkLength = htonl(length);
+    header[0] = type;
+    memcpy(header + 1, &networkLength, 4);
+
+    bufferAppend(output, header, 5);
+    bufferAppend(output, data, length);
+}
+
+/*************************************************************************************************
+** Name: flushClient
+**
+** Description: This function writes as much of the replies queued for a client as its socket
+** takes and watches for the socket becoming writable again if some are left. A client which falls
+** too far behind has the output of its request left in the pipes until it catches up, so the
+** command waits for it instead of the server holding everything it writes. A client which has
+** sent its last request is closed once the replies to all of them are written.
+**
+** Parameters: slot of the client
+**
+** Returns: N/A
+*************************************************************************************************/
+
+void flushClient(int slot)
+{
+    struct serverClient *client = &serverClients[slot];
+    if(client->socketFd == -1)
+    {
+        return;
+    }
+
+    while(client->outputSent < client->output.length)
+    {
+        ssize_t numWritten = send(client->socketFd, client->output.data + client->outputSent,
+                                  client->output.length - client->outputSent, MSG_NOSIGNAL);
+        if(numWritten > 0)
+        {
+            client->outputSent += numWritten;
+        }
+        else if(errno == EAGAIN)
+        {
+            break;
+        }
+        else if(errno != EINTR)
+        {
+            closeClient(slot);
+            return;
+        }
+    }
+
+    size_t pending = client->output.length - client->outputSent;
+    if(pending == 0)
+    {
+        client->output.length = 0;
+        client->outputSent = 0;
+
+        if(client->inputEnded == true && client->requestPid == 0)
+        {
+            closeClient(slot);
+            return;
+        }
+    }
+
+    if(client->requestPid != 0)
+    {
+        pauseRequestOutput(slot, pending > MAX_PENDING_REPLY);
+    }
+
+    struct epoll_event watchEvent = {0};
+    watchEvent.events = (client->inputEnded == false ? EPOLLIN : 0) | (pending > 0 ? EPOLLOUT : 0);
+    watchEvent.data.u64 = ((uint64_t)slot << 2) | REQUEST_CLIENT;
+    epoll_ctl(epollFd, EPOLL_CTL_MOD, client->socketFd, &watchEvent);
+}
+
+/*************************************************************************************************
+** Name: pauseRequestOutput
+**
+** Description: This function stops or starts watching the pipes of a request. The pipes are taken
+** out of the event loop altogether while paused, since a pipe whose writers are gone is reported
+** whatever it is watched for.
+**
+** Parameters: slot of the client, true to stop reading the pipes or false to read them again
+**
+** Returns: N/A
+*************************************************************************************************/
+
+void pauseRequestOutput(int slot, bool pause)
+{
+    struct serverClient *client = &serverClients[slot];
+    if(client->outputPaused == pause)
+    {
+        return;
+    }
+    client->outputPaused = pause;
+
+    struct epoll_event watchEvent = {0};
+    watchEvent.events = EPOLLIN;
+
+    int stream;
+    for(stream = 0; stream < 2; stream++)
+    {
+        if(client->outputFds[stream] != -1)
+        {
+            watchEvent.data.u64 = ((uint64_t)slot << 2) | (REQUEST_STDOUT + stream);
+            epoll_ctl(epollFd, pause == true ? EPOLL_CTL_DEL : EPOLL_CTL_ADD, client->outputFds[stream], &watchEvent);
+        }
+    }
+}
+
+/*************************************************************************************************
+** Name: closeClient
+**
+** Description: This function ends the connection of a client and frees its slot. The pipes of a
+** request still running are closed too, so its commands see their output go nowhere the way they
+** would if their terminal went away, and the copy running it is reaped without being answered.
+**
+** Parameters: slot of the client
+**
+** Returns: N/A
+*************************************************************************************************/
+
+void closeClient(int slot)
+{
+    struct serverClient *client = &serverClients[slot];
+
+    int stream;
+    for(stream = 0; stream < 2; stream++)
+    {
+        if(client->outputFds[stream] != -1)
+        {
+            epoll_ctl(epollFd, EPOLL_CTL_DEL, client->outputFds[stream], NULL);
+            close(client->outputFds[stream]);
+            client->outputFds[stream] = -1;
+        }
+    }
+
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, client->socketFd, NULL);
+    close(client->socketFd);
+    client->socketFd = -1;
+    client->requestPid = 0;
+}
+
+/*************************************************************************************************
+** Name: runClient
+**
+** Description: This function is the client of a server started with --serve. It sends the command
+** line made of the rest of its arguments, copies what the command writes to its own standard output
+** and error as it arrives, and leaves with the exit value of the command.
+**
+** Parameters: arguments of smallsh --client socket command...
+**
+** Returns: exit value of the command, or 2 if it could not be run
+*************************************************************************************************/
+
+int runClient(int argc, char *argv[])
+{
+    if(argc < 4)
+    {
+        fprintf(stderr, "usage: smallsh --client socket command\n");
+        return 2;
+    }
+
+    struct sockaddr_un address = {0};
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, argv[2], sizeof(address.sun_path) - 1);
+
+    int socketFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(socketFd == -1 || connect(socketFd, (struct sockaddr *)&address, sizeof(address)) == -1)
+    {
+        perror(argv[2]);
+        return 2;
+    }
+
+    struct stringBuffer request = {NULL, 0, 0};
+    struct stringBuffer commandText = {NULL, 0, 0};
+    int i;
+    for(i = 3; i < argc; i++)
+    {
+        if(i > 3)
+        {
+            bufferAppendChar(&commandText, ' ');
+        }
+        bufferAppend(&commandText, argv[i], strlen(argv[i]));
+    }
+    appendFrame(&request, 'C', commandText.data, commandText.length);
+
+    // the server answers every request it was sent before it closes the connection
+    if(write(socketFd, request.data, request.length) != (ssize_t)request.length)
+    {
+        perror(argv[2]);
+        return 2;
+    }
+    shutdown(socketFd, SHUT_WR);
+
+    char header[5];
+    char *frameData = NULL;
+    while(readFully(socketFd, header, 5) == true)
+    {
+        uint32_t length;
+        memcpy(&length, header + 1, 4);
+        length = ntohl(length);
+
+        frameData = realloc(frameData, length + 1);
+        if(readFully(socketFd, frameData, length) == false)
+        {
+            break;
+        }
+
+        if(header[0] == 'X' && length == 4)
+        {
+            uint32_t exitValueSent;
+            memcpy(&exitValueSent, frameData, 4);
+            return ntohl(exitValueSent);
+        }
+
+        if(write(header[0] == 'E' ? STDERR_FILENO : STDOUT_FILENO, frameData, length) == -1)
+        {
+            break;
+        }
+    }
+
+    fprintf(stderr, "%s: the server closed the connection\n", argv[2]);
+    return 2;
+}
+
+/*************************************************************************************************
+** Name: readFully
+**
+** Description: This function reads exactly the number of bytes asked for from a descriptor.
+**
+** Parameters: descriptor, where to put the bytes, how many to read
+**
+** Returns: false if the descriptor ended or failed first
+*************************************************************************************************/
+
+bool readFully(int fd, void *data, size_t length)
+{
+    size_t numDone = 0;
+    while(numDone < length)
+    {
+        ssize_t numRead = read(fd, (char *)data + numDone, length - numDone);
+        if(numRead == -1 && errno == EINTR)
+        {
+            continue;
+        }
+        if(numRead <= 0)
+        {
+            return false;
+        }
+        numDone += numRead;
+    }
+
+    return true;
+}
+
+/*************************************************************************************************
+** Name: sendFully
+**
+** Description: This function writes all of the bytes given to a socket. A peer which is gone
+** makes it fail rather than raise SIGPIPE.
+**
+** Parameters: socket, bytes to write, how many there are
+**
+** Returns: false if the socket failed first
+*************************************************************************************************/
+
+bool sendFully(int socketFd, const void *data, size_t length)
+{
+    size_t numDone = 0;
+    while(numDone < length)
+    {
+        ssize_t numWritten = send(socketFd, (const char *)data + numDone, length - numDone, MSG_NOSIGNAL);
+        if(numWritten == -1 && errno == EINTR)
+        {
+            continue;
+        }
+        if(numWritten <= 0)
+        {
+            return false;
+        }
+        numDone += numWritten;
+    }
+
+    return true;
+}
+
+/*************************************************************************************************
+** Name: startZygote
+**
+** Description: This function forks the zygote, a helper which forks the copies of the shell that
+** run command substitutions. Forking copies the page tables of the process being forked, so a
+** shell which has grown large with history, caches and captured output pays for it on every copy,
+** while the zygote is forked at startup and stays as small as the shell was then. Commands are
+** spawned with posix_spawn, which shares the memory of the shell rather than copying it, so only
+** the copies need the zygote. The zygote is in the process group of the shell and has the signal
+** handling the shell has at startup, and it leaves once the shell closes its end of the socket.
+**
+** Parameters: N/A
+**
+** Returns: N/A
+*************************************************************************************************/
+
+void startZygote()
+{
+    int sockets[2];
+    if(socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sockets) == -1)
+    {
+        perror("ERROR: Unable to start the zygote");
+        fflush(stderr);
+        return;
+    }
+
+    pid_t zygotePid = fork();
+    if(zygotePid == 0)
+    {
+        close(sockets[0]);
+        runZygote(sockets[1]);
+    }
+    close(sockets[1]);
+
+    if(zygotePid == -1)
+    {
+        perror("ERROR: Unable to start the zygote");
+        fflush(stderr);
+        close(sockets[0]);
+        return;
+    }
+
+    zygoteFd = sockets[0];
+}
+
+/*************************************************************************************************
+** Name: runZygote
+**
+** Description: This function is the zygote. For every request it receives the descriptors of the
+** copy along with the request, forks the copy, which takes on the working directory, environment
+** and special parameters of the shell before running the command line with runLineInCopy, and
+** answers with the exit method of the copy once it is done. The copy sees its settings as the
+** shell had them at startup, so $$ is set from the request rather than being the pid of the copy.
+**
+** Parameters: socket to the shell
+**
+** Returns: N/A, the zygote exits once the shell is gone
+*************************************************************************************************/
+
+void runZygote(int socketFd)
+{
+    while(true)
+    {
+        struct zygoteRequest request;
+        int fds[4];
+        char control[CMSG_SPACE(sizeof(fds))];
+        struct iovec requestVector = {&request, sizeof(request)};
+        struct msghdr message = {0};
+        message.msg_iov = &requestVector;
+        message.msg_iovlen = 1;
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+
+        ssize_t numReceived = recvmsg(socketFd, &message, MSG_WAITALL | MSG_CMSG_CLOEXEC);
+        if(numReceived == -1 && errno == EINTR)
+        {
+            continue;
+        }
+
+        struct cmsghdr *controlHeader = CMSG_FIRSTHDR(&message);
+        if(numReceived != sizeof(request) || controlHeader == NULL || controlHeader->cmsg_type != SCM_RIGHTS ||
+           controlHeader->cmsg_len != CMSG_LEN(sizeof(fds)))
+        {
+            _exit(0);
+        }
+        memcpy(fds, CMSG_DATA(controlHeader), sizeof(fds));
+
+        char *requestData = malloc(request.textLength + request.environmentLength + 1);
+        if(readFully(socketFd, requestData, request.textLength + request.environmentLength) == false)
+        {
+            _exit(0);
+        }
+
+        pid_t copyPid = fork();
+        if(copyPid == 0)
+        {
+            close(socketFd);
+            dup2(fds[0], STDIN_FILENO);
+            dup2(fds[1], STDOUT_FILENO);
+            dup2(fds[2], STDERR_FILENO);
+            fchdir(fds[3]);
+
+            // the environment is pointed into where it was received
+            char *environmentData = requestData + request.textLength;
+            int numVariables = 0;
+            uint32_t i;
+            for(i = 0; i < request.environmentLength; i++)
+            {
+                numVariables += environmentData[i] == '\0';
+            }
+
+            char **environment = malloc((numVariables + 1) * sizeof(char *));
+            numVariables = 0;
+            for(i = 0; i < request.environmentLength; i += strlen(environmentData + i) + 1)
+            {
+                environment[numVariables++] = environmentData + i;
+            }
+            environment[numVariables] = NULL;
+            environ = environment;
+
+            childExitMethod = request.exitMethod;
+            lastBackgroundPid = request.lastBackgroundPid;
+            isForegroundOnly = request.foregroundOnly;
+            shellPid = request.shellPid;
+            shellPidLength = snprintf(shellPidString, sizeof(shellPidString), "%d", shellPid);
+
+            // the environment ends with a NUL so the command line can end with one of its own
+            requestData[request.textLength] = '\0';
+            runLineInCopy(requestData);
+        }
+
+        int i;
+        for(i = 0; i < 4; i++)
+        {
+            close(fds[i]);
+        }
+        free(requestData);
+
+        int exitMethod = W_EXITCODE(1, 0);
+        while(copyPid != -1 && waitpid(copyPid, &exitMethod, 0) == -1 && errno == EINTR)
+        {
+        }
+
+        if(sendFully(socketFd, &exitMethod, sizeof(exitMethod)) == false)
+        {
+            _exit(0);
+        }
+    }
+}
+
+/*************************************************************************************************
+** Name: sendToZygote
+**
+** Description: This function asks the zygote to run a command line in a copy of the shell with its
+** standard output going to the descriptor given. Standard input and error of the shell and its
+** working directory are passed along with SCM_RIGHTS, and its environment and special parameters
+** as they are now. A zygote which is gone is not asked again and the shell forks the copy itself.
+**
+** Parameters: command line to run, descriptor the copy writes its output to
+**
+** Returns: true if the zygote has the request, which it answers with the exit method of the copy
+*************************************************************************************************/
+
+bool sendToZygote(const char *commandText, int outputFd)
+{
+    // the working directory goes as a descriptor so a deep or removed path needs no special case
+    int directoryFd = open(".", O_PATH | O_DIRECTORY | O_CLOEXEC);
+    if(directoryFd == -1)
+    {
+        return false;
+    }
+
+    static struct stringBuffer environmentData = {NULL, 0, 0};
+    environmentData.length = 0;
+    bufferAppend(&environmentData, "", 0);
+
+    char **variable;
+    for(variable = environ; *variable != NULL; variable++)
+    {
+        bufferAppend(&environmentData, *variable, strlen(*variable) + 1);
+    }
+
+    struct zygoteRequest request = {0};
+    request.textLength = strlen(commandText);
+    request.environmentLength = environmentData.length;
+    request.exitMethod = childExitMethod;
+    request.lastBackgroundPid = lastBackgroundPid;
+    request.shellPid = shellPid;
+    request.foregroundOnly = isForegroundOnly;
+
+    int fds[4] = {STDIN_FILENO, outputFd, STDERR_FILENO, directoryFd};
+    char control[CMSG_SPACE(sizeof(fds))];
+    memset(control, 0, sizeof(control));
+    struct iovec requestVector = {&request, sizeof(request)};
+    struct msghdr message = {0};
+    message.msg_iov = &requestVector;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+
+    struct cmsghdr *controlHeader = CMSG_FIRSTHDR(&message);
+    controlHeader->cmsg_level = SOL_SOCKET;
+    controlHeader->cmsg_type = SCM_RIGHTS;
+    controlHeader->cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(controlHeader), fds, sizeof(fds));
+
+    ssize_t numSent;
+    do
+    {
+        numSent = sendmsg(zygoteFd, &message, MSG_NOSIGNAL);
+    }while(numSent == -1 && errno == EINTR);
+    close(directoryFd);
+
+    if(numSent != sizeof(request) || sendFully(zygoteFd, commandText, request.textLength) == false ||
+       sendFully(zygoteFd, environmentData.data, environmentData.length) == false)
+    {
+        close(zygoteFd);
+        zygoteFd = -1;
+        return false;
+    }
+
+    return true;
+}
+
+/*************************************************************************************************
+** Name: waitChild
+**
+** Description: This function waits for a child the way wait4 does. While background jobs have
+** their output captured the shell cannot simply block, since a job which fills its pipe would wait
+** on the shell while the shell waits on it. It sleeps in poll on the signalfd and the captured pipes
+** instead, drains the pipes whenever they have output and checks the child again whenever a child
+** has changed. A SIGCHLD read here is left for drainSignalFd to report, so background jobs which
+** finish meanwhile are still reported at the next prompt.
+**
+** Parameters: the same as wait4
+**
+** Returns: the same as wait4, including -1 with EINTR when a signal handler interrupts the wait
+*************************************************************************************************/
+
+pid_t waitChild(pid_t pid, int *exitMethod, int options, struct rusage *usage)
+{
+    while(jobCapture.numOpen > 0)
+    {
+        pid_t donePid = wait4(pid, exitMethod, options | WNOHANG, usage);
+        if(donePid != 0)
+        {
+            return donePid;
+        }
+
+        struct pollfd waitFds[2] = {{signalFd, POLLIN, 0}, {jobCapture.epollFd, POLLIN, 0}};
+        if(poll(waitFds, 2, -1) == -1)
+        {
+            if(errno == EINTR)
+            {
+                return -1;
+            }
+            break;
+        }
+
+        if(waitFds[1].revents != 0)
+        {
+            drainCaptures();
+        }
+        if(waitFds[0].revents != 0 && drainSignalFd() == true)
+        {
+            childSignalPending = true;
+        }
+    }
+
+    return wait4(pid, exitMethod, options, usage);
+}
+
+/*************************************************************************************************
+** Name: joblogCommand
+**
+** Description: This function runs the joblog built in. Without arguments it shows whether capture
+** is on, its budgets and every log kept. joblog on turns capture on for the background jobs started
+** from then on, optionally with the bytes kept for one job and for all of them, which take a k, m
+** or g suffix, and joblog off turns it off again while keeping the logs there are. joblog %n, or
+** just n, prints what was kept of log n, which only touches the disk when it is redirected there,
+** and reports on standard error how many earlier bytes were dropped. Logs are numbered in the order
+** their jobs were started and a number is never used twice, so the log of a job which is done is
+** still there after its slot in the job table goes to a new job, until the budget gives it up.
+**
+** Parameters: command line of the built in
+**
+** Returns: exit status of the built in
+*************************************************************************************************/
+
+int joblogCommand(char **commandLine)
+{
+    // whatever the jobs wrote so far is included
+    if(jobCapture.numOpen > 0)
+    {
+        drainCaptures();
+    }
+
+    if(commandLine[1] == NULL)
+    {
+        printf("capture %s: %zu bytes a job, %zu in all, %zu in use\n", jobCapture.enabled == true ? "on" : "off",
+               jobCapture.jobBudget, jobCapture.totalBudget, jobCapture.totalUsed);
+
+        int i;
+        for(i = 0; i < jobCapture.numLogs; i++)
+        {
+            struct jobLog *log = &jobCapture.logs[i];
+            if(log->jobNumber == 0)
+            {
+                continue;
+            }
+
+            printf("[%d] %d %s\t%zu bytes kept, %llu dropped\t%s\n", log->jobNumber, log->pid,
+                   jobLogRunning(log) == true ? "Running" : "Done", log->length, log->dropped, log->commandLine);
+        }
+        return 0;
+    }
+
+    if(strcmp(commandLine[1], "on") == 0 && (commandLine[2] == NULL || commandLine[3] == NULL || commandLine[4] == NULL))
+    {
+        return setCapture(commandLine[2], commandLine[2] != NULL ? commandLine[3] : NULL) == true ? 0 : 2;
+    }
+
+    if(strcmp(commandLine[1], "off") == 0 && commandLine[2] == NULL)
+    {
+        jobCapture.enabled = false;
+        return 0;
+    }
+
+    char *numberEnd;
+    const char *jobName = commandLine[1][0] == '%' ? commandLine[1] + 1 : commandLine[1];
+    long jobNumber = strtol(jobName, &numberEnd, 10);
+    if(jobName[0] == '\0' || *numberEnd != '\0' || commandLine[2] != NULL)
+    {
+        fprintf(stderr, "usage: joblog [on [job-bytes [total-bytes]] | off | %%job]\n");
+        fflush(stderr);
+        return 2;
+    }
+
+    int logIndex = jobNumber > 0 && jobNumber <= INT_MAX ? findJobLog(jobNumber) : -1;
+    if(logIndex == -1)
+    {
+        fprintf(stderr, "joblog: %s: no output kept under that number\n", commandLine[1]);
+        fflush(stderr);
+        return 1;
+    }
+
+    // the ring is written out oldest byte first, in at most two pieces
+    struct jobLog *log = &jobCapture.logs[logIndex];
+    if(log->dropped > 0)
+    {
+        fprintf(stderr, "joblog: the first %llu bytes of log %d were not kept\n", log->dropped, log->jobNumber);
+        fflush(stderr);
+    }
+
+    size_t firstLength = log->length < log->capacity - log->start ? log->length : log->capacity - log->start;
+    fwrite(log->ring + log->start, 1, firstLength, stdout);
+    fwrite(log->ring, 1, log->length - firstLength, stdout);
+    fflush(stdout);
+    return 0;
+}
+
+/*************************************************************************************************
+** Name: setCapture
+**
+** Description: This function turns capture of background job output on with the budgets given,
+** keeping the ones there are for any not given. The epoll of the capture pipes is made the first
+** time and added to the event loop.
+**
+** Parameters: bytes kept for one job and for all jobs together, NULL to keep the current ones
+**
+** Returns: true if capture is on
+*************************************************************************************************/
+
+bool setCapture(const char *jobBudgetText, const char *totalBudgetText)
+{
+    size_t jobBudget = jobCapture.jobBudget;
+    size_t totalBudget = jobCapture.totalBudget;
+
+    if((jobBudgetText != NULL && parseByteSize(jobBudgetText, &jobBudget) == false) ||
+       (totalBudgetText != NULL && parseByteSize(totalBudgetText, &totalBudget) == false))
+    {
+        fprintf(stderr, "joblog: budgets are a number of bytes with an optional k, m or g\n");
+        fflush(stderr);
+        return false;
+    }
+
+    if(jobCapture.epollFd == -1)
+    {
+        jobCapture.epollFd = highDescriptor(epoll_create1(EPOLL_CLOEXEC));
+        if(jobCapture.epollFd == -1)
+        {
+            perror("ERROR: Unable to capture job output");
+            fflush(stderr);
+            return false;
+        }
+
+        struct epoll_event watchEvent = {0};
+        watchEvent.events = EPOLLIN;
+        watchEvent.data.fd = jobCapture.epollFd;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, jobCapture.epollFd, &watchEvent);
+    }
+
+    jobCapture.jobBudget = jobBudget;
+    jobCapture.totalBudget = totalBudget;
+    jobCapture.enabled = true;
+    return true;
+}
+
+/*************************************************************************************************
+** Name: parseByteSize
+**
+** Description: This function reads a number of bytes with an optional k, m or g suffix for
+** kilobytes, megabytes or gigabytes.
+**
+** Parameters: text to read, where to put the number of bytes
+**
+** Returns: true if the text is a size of at least one byte
+*************************************************************************************************/
+
+bool parseByteSize(const char *text, size_t *size)
+{
+    char *numberEnd;
+    errno = 0;
+    unsigned long long number = strtoull(text, &numberEnd, 10);
+    if(errno != 0 || numberEnd == text || text[0] == '-' || number == 0)
+    {
+        return false;
+    }
+
+    int shift = 0;
+    switch(tolower((unsigned char)*numberEnd))
+    {
+        case 'g':
+            shift += 10;
+            // fall through
+        case 'm':
+            shift += 10;
+            // fall through
+        case 'k':
+            shift += 10;
+            numberEnd++;
+            break;
+    }
+
+    if(*numberEnd != '\0' || number > (SIZE_MAX >> shift))
+    {
+        return false;
+    }
+
+    *size = number << shift;
+    return true;
+}
+
+/*************************************************************************************************
+** Name: startJobLog
+**
+** Description: This function starts the log of a background job which was started with its output
+** captured and starts watching the read end of its pipe. The log gets the next log number rather
+** than the number of the job, which goes to another job as soon as this one is done. The ring is
+** only allocated once output arrives, so a quiet job costs no memory.
+**
+** Parameters: slot of the job in the job table, pid of its last stage, its command line, read end of
+** its pipe
+**
+** Returns: N/A
+*************************************************************************************************/
+
+void startJobLog(int jobIndex, pid_t pid, const char *commandLine, int fd)
+{
+    int logIndex;
+    for(logIndex = 0; logIndex < jobCapture.numLogs && jobCapture.logs[logIndex].jobNumber != 0; logIndex++)
+    {
+    }
+
+    if(logIndex == jobCapture.numLogs)
+    {
+        int newCount = jobCapture.numLogs == 0 ? 16 : jobCapture.numLogs * 2;
+        jobCapture.logs = realloc(jobCapture.logs, newCount * sizeof(struct jobLog));
+        memset(jobCapture.logs + jobCapture.numLogs, 0, (newCount - jobCapture.numLogs) * sizeof(struct jobLog));
+        jobCapture.numLogs = newCount;
+    }
+
+    struct jobLog *log = &jobCapture.logs[logIndex];
+    memset(log, 0, sizeof(*log));
+    log->jobNumber = jobCapture.nextJobNumber++;
+    log->jobIndex = jobIndex;
+    log->pid = pid;
+    log->commandLine = strdup(commandLine);
+    log->fd = fd;
+
+    struct epoll_event watchEvent = {0};
+    watchEvent.events = EPOLLIN;
+    watchEvent.data.u32 = logIndex;
+    epoll_ctl(jobCapture.epollFd, EPOLL_CTL_ADD, fd, &watchEvent);
+    jobCapture.numOpen++;
+}
+
+/*************************************************************************************************
+** Name: findJobLog
+**
+** Description: This function finds the log kept under a number.
+**
+** Parameters: number of the log
+**
+** Returns: slot of the log, -1 if none is kept
+*************************************************************************************************/
+
+int findJobLog(int jobNumber)
+{
+    int i;
+    for(i = 0; i < jobCapture.numLogs; i++)
+    {
+        if(jobCapture.logs[i].jobNumber == jobNumber)
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+/*************************************************************************************************
+** Name: jobLogRunning
+**
+** Description: This function tells whether the job of a log is still running or stopped. The slot
+** of the job in the job table may belong to a later job by now, so it has to end in the same pid.
+**
+** Parameters: log of the job
+**
+** Returns: true if the job has not finished
+*************************************************************************************************/
+
+bool jobLogRunning(const struct jobLog *log)
+{
+    const struct job *logJob = &jobTable.jobs[log->jobIndex];
+    return (logJob->state == JOB_RUNNING || logJob->state == JOB_STOPPED) && logJob->pids[logJob->numPids - 1] == log->pid;
+}
+
+/*************************************************************************************************
+** Name: drainCaptures
+**
+** Description: This function reads whatever the captured jobs have written since the last time
+** without waiting, one read for every pipe which has output so a busy job does not keep the shell
+** from everything else. A pipe is closed once every process which could write to it is gone.
+**
+** Parameters: N/A
+**
+** Returns: N/A
+*************************************************************************************************/
+
+void drainCaptures()
+{
+    struct epoll_event readyEvents[16];
+    int numEvents = epoll_wait(jobCapture.epollFd, readyEvents, 16, 0);
+
+    int i;
+    for(i = 0; i < numEvents; i++)
+    {
+        struct jobLog *log = &jobCapture.logs[readyEvents[i].data.u32];
+        if(log->jobNumber == 0 || log->fd == -1)
+        {
+            continue;
+        }
+
+        char outputData[65536];
+        ssize_t numRead = read(log->fd, outputData, sizeof(outputData));
+        if(numRead > 0)
+        {
+            appendJobLog(log, outputData, numRead);
+        }
+        else if(numRead == 0 || (errno != EAGAIN && errno != EINTR))
+        {
+            closeJobLog(log);
+        }
+    }
+}
+
+/*************************************************************************************************
+** Name: closeJobLog
+**
+** Description: This function stops watching the pipe of a log and closes it.
+**
+** Parameters: log of the job
+**
+** Returns: N/A
+*************************************************************************************************/
+
+void closeJobLog(struct jobLog *log)
+{
+    if(log->fd == -1)
+    {
+        return;
+    }
+
+    epoll_ctl(jobCapture.epollFd, EPOLL_CTL_DEL, log->fd, NULL);
+    close(log->fd);
+    log->fd = -1;
+    jobCapture.numOpen--;
+}
+
+/*************************************************************************************************
+** Name: appendJobLog
+**
+** Description: This function adds output of a job to its ring, growing the ring first if the
+** budgets allow. Once the ring cannot grow the newest bytes overwrite the oldest, which are counted
+** as dropped.
+**
+** Parameters: log of the job, output and its length
+**
+** Returns: N/A
+*************************************************************************************************/
+
+void appendJobLog(struct jobLog *log, const char *data, size_t length)
+{
+    if(log->length + length > log->capacity)
+    {
+        growJobLog(log, log->length + length);
+    }
+
+    if(log->capacity == 0)
+    {
+        log->dropped += length;
+        return;
+    }
+
+    // output longer than the whole ring leaves only its own end
+    if(length > log->capacity)
+    {
+        log->dropped += log->length + length - log->capacity;
+        data += length - log->capacity;
+        length = log->capacity;
+        log->start = 0;
+        log->length = 0;
+    }
+
+    // the oldest bytes make room for the new ones
+    if(log->length + length > log->capacity)
+    {
+        size_t overwritten = log->length + length - log->capacity;
+        log->start = (log->start + overwritten) % log->capacity;
+        log->length -= overwritten;
+        log->dropped += overwritten;
+    }
+
+    size_t end = (log->start + log->length) % log->capacity;
+    size_t firstLength = length < log->capacity - end ? length : log->capacity - end;
+    memcpy(log->ring + end, data, firstLength);
+    memcpy(log->ring, data + firstLength, length - firstLength);
+    log->length += length;
+}
+
+/*************************************************************************************************
+** Name: growJobLog
+**
+** Description: This function grows the ring of a log towards the size wanted, doubling it up to
+** the budget of one job. When that would take the logs past the budget of all of them, the logs of
+** jobs which are done are given up oldest first, and if that is not enough the ring grows only as
+** far as the budget allows. The ring is copied into the new one oldest byte first.
+**
+** Parameters: log of the job, bytes it would need to keep everything
+**
+** Returns: true if the ring grew
+*************************************************************************************************/
+
+bool growJobLog(struct jobLog *log, size_t wanted)
+{
+    size_t newCapacity = log->capacity == 0 ? 4096 : log->capacity;
+    while(newCapacity < wanted && newCapacity < jobCapture.jobBudget)
+    {
+        newCapacity *= 2;
+    }
+    if(newCapacity > jobCapture.jobBudget)
+    {
+        newCapacity = jobCapture.jobBudget;
+    }
+
+    while(newCapacity > log->capacity && jobCapture.totalUsed + newCapacity - log->capacity > jobCapture.totalBudget)
+    {
+        int oldest = -1;
+        int i;
+        for(i = 0; i < jobCapture.numLogs; i++)
+        {
+            struct jobLog *other = &jobCapture.logs[i];
+            if(other != log && other->jobNumber != 0 && other->capacity > 0 && jobLogRunning(other) == false &&
+               (oldest == -1 || other->jobNumber < jobCapture.logs[oldest].jobNumber))
+            {
+                oldest = i;
+            }
+        }
+
+        if(oldest == -1)
+        {
+            newCapacity = jobCapture.totalBudget > jobCapture.totalUsed ? jobCapture.totalBudget - jobCapture.totalUsed + log->capacity : log->capacity;
+            break;
+        }
+        freeJobLog(&jobCapture.logs[oldest]);
+    }
+
+    if(newCapacity <= log->capacity)
+    {
+        return false;
+    }
+
+    char *newRing = malloc(newCapacity);
+    size_t firstLength = log->length < log->capacity - log->start ? log->length : log->capacity - log->start;
+    memcpy(newRing, log->ring + log->start, firstLength);
+    memcpy(newRing + firstLength, log->ring, log->length - firstLength);
+    free(log->ring);
+
+    jobCapture.totalUsed += newCapacity - log->capacity;
+    log->ring = newRing;
+    log->capacity = newCapacity;
+    log->start = 0;
+    return true;
+}
+
+/*************************************************************************************************
+** Name: freeJobLog
+**
+** Description: This function gives up a log, closing its pipe if it is still open and giving its
+** memory back to the budget.
+**
+** Parameters: log to free
+**
+** Returns: N/A
+*************************************************************************************************/
+
+void freeJobLog(struct jobLog *log)
+{
+    closeJobLog(log);
+    jobCapture.totalUsed -= log->capacity;
+    free(log->ring);
+    free(log->commandLine);
+    memset(log, 0, sizeof(*log));
+    log->fd = -1;
+}
+
+/*************************************************************************************************
+** Name: readCommand
+**
+** Description: This function reads a command, which may take several lines, and parses it into its
+** syntax tree. Every line is lexed raw on its own as soon as it is read, unless it ends inside a quote
+** or substitution or with a backslash, in which case it is lexed again along with the next line
+** until the word is complete. Here-documents after it are read right away, and its tokens are joined to the ones before it with a newline in between. The
+** tokens are then parsed, and while the parser runs out of tokens before the command is complete,
+** such as in the middle of a loop or after a | or &&, another line is read with the "> " prompt and
+** the tokens are parsed again. What an attempt which ran out of tokens allocated is given back, so a
+** long loop costs its size once. At a terminal every line goes through history expansion and every
+** line which is not blank is added to the history. A command which cannot be lexed or parsed, or
+** which input ends in the middle of, sets the status to 2 like any other syntax error.
+**
+** Parameters: first line of the command, set to whether the command had a syntax error
+**
+** Returns: first command of the syntax tree, or NULL if there is nothing to run or it has an error
+*************************************************************************************************/
+
+struct node* readCommand(char *firstLine, bool *isSyntaxError)
+{
+    static struct token lineEnd = {TOKEN_NEWLINE, "\n", false, -1, 0, 0};
+    struct token *tokens = NULL;
+    int numTokens = 0;
+    int tokenCapacity = 0;
+    char *line = firstLine;
+    size_t lexStart = 0;
+    bool wordContinues = false;
+
+    programText.length = 0;
+    bufferAppend(&programText, "", 0);
+    *isSyntaxError = false;
+
+    while(true)
+    {
+        // history references are replaced before anything else and the line is shown as it will run
+        if(interactiveShell == true)
+        {
+            int historyResult = expandHistory(line, &expandedLine);
+            if(historyResult == -1)
+            {
+                return NULL;
+            }
+            if(historyResult == 1)
+            {
+                line = expandedLine.data;
+                printf("%s\n", line);
+                fflush(stdout);
+            }
+        }
+
+        // the line is kept with the ones before it so every pipeline has its text
+        size_t lineStart = programText.length;
+        bufferAppend(&programText, line, strlen(line));
+
+        // every line typed at the prompt which is not blank is remembered
+        if(interactiveShell == true && line[strspn(line, " \t")] != '\0')
+        {
+            addHistory(programText.data + lineStart);
+        }
+
+        // a line which ended inside a quote is lexed again along with the one after it
+        if(wordContinues == false)
+        {
+            lexStart = lineStart;
+        }
+
+        struct token *lineTokens = NULL;
+        double lexTime = traceTime();
+        int numLineTokens = lexLine(programText.data + lexStart, &treeArena, &lineTokens, LEX_RAW);
+        traceEvent("lex", 0, lexTime, NULL);
+        wordContinues = numLineTokens == -1 && lexIncomplete == true;
+
+        if(wordContinues == true)
+        {
+            // nothing to parse until the rest of the word is read
+        }
+        else if(numLineTokens == -1 || readHereDocuments(lineTokens, numLineTokens, &treeArena) == false)
+        {
+            *isSyntaxError = true;
+            childExitMethod = W_EXITCODE(2, 0);
+            return NULL;
+        }
+        else
+        {
+            // blank and comment lines have nothing to run
+            if(numTokens == 0 && numLineTokens == 0)
+            {
+                return NULL;
+            }
+
+            if(numTokens + numLineTokens + 1 > tokenCapacity)
+            {
+                tokenCapacity = 2 * (numTokens + numLineTokens + 1);
+                struct token *largerList = arenaAlloc(&treeArena, tokenCapacity * sizeof(struct token));
+                if(numTokens > 0)
+                {
+                    memcpy(largerList, tokens, numTokens * sizeof(struct token));
+                }
+                tokens = largerList;
+            }
+
+            int i;
+            for(i = 0; i < numLineTokens; i++)
+            {
+                tokens[numTokens] = lineTokens[i];
+                tokens[numTokens].start += lexStart;
+                tokens[numTokens++].end += lexStart;
+            }
+            tokens[numTokens] = lineEnd;
+            tokens[numTokens].start = programText.length;
+            tokens[numTokens++].end = programText.length;
+
+            // parse everything read so far
+            struct arenaMark beforeParse = arenaMark(&treeArena);
+            struct parser commandParser = {tokens, numTokens, 0, programText.data, false, false};
+            double parseStart = traceTime();
+            struct node *program = parseList(&commandParser);
+            if(commandParser.failed == false && commandParser.incomplete == false && commandParser.position < numTokens)
+            {
+                // a closing word or ) with nothing to close
+                syntaxError(&commandParser);
+            }
+            traceEvent("parse", 0, parseStart, NULL);
+
+            if(commandParser.incomplete == false && commandParser.failed == true)
+            {
+                *isSyntaxError = true;
+                childExitMethod = W_EXITCODE(2, 0);
+                return NULL;
+            }
+            if(commandParser.incomplete == false)
+            {
+                return program;
+            }
+            arenaRollback(&treeArena, beforeParse);
+        }
+
+        // the command goes on in the next line
+        ssize_t lineLength;
+        do
+        {
+            promptText = "> ";
+            if(interactiveShell == true)
+            {
+                printf("> ");
+                fflush(stdout);
+            }
+            lineLength = readCommandLine(&line);
+        }while(lineLength == 0);
+
+        if(lineLength == -1)
+        {
+            fprintf(stderr, "ERROR: syntax error: unexpected end of input\n");
+            fflush(stderr);
+            *isSyntaxError = true;
+            childExitMethod = W_EXITCODE(2, 0);
+            return NULL;
+        }
+
+        bufferAppendChar(&programText, '\n');
+    }
+}
+
+/*************************************************************************************************
+** Name: parseList
+**
+** Description: This function parses a list of commands, each of them an and-or list ended by ;, &
+** or a newline, up to a word which closes the compound command the list is part of, a ) or ;; of a
+** case, or the end of the tokens. Newlines between the commands are skipped. A command followed by &
+** runs in the background, which only a pipeline can, and the & becomes part of its text.
+**
+** Parameters: parser
+**
+** Returns: first command of the list, chained through next, or NULL if it is empty or has an error
+*************************************************************************************************/
+
+struct node* parseList(struct parser *commandParser)
+{
+    struct node *firstCommand = NULL;
+    struct node *lastCommand = NULL;
+
+    while(true)
+    {
+        skipNewLines(commandParser);
+        if(commandParser->position == commandParser->numTokens)
+        {
+            break;
+        }
+
+        // these close the compound command or case item the list is part of
+        struct token *current = &commandParser->tokens[commandParser->position];
+        if(current->type == TOKEN_RPAREN || current->type == TOKEN_DSEMI ||
+           isReservedWord(commandParser, "then") || isReservedWord(commandParser, "else") ||
+           isReservedWord(commandParser, "elif") || isReservedWord(commandParser, "fi") ||
+           isReservedWord(commandParser, "do") || isReservedWord(commandParser, "done") ||
+           isReservedWord(commandParser, "esac") || isReservedWord(commandParser, "}"))
+        {
+            break;
+        }
+
+        size_t commandStart = current->start;
+        struct node *command = parseAndOr(commandParser);
+        if(command == NULL)
+        {
+            return NULL;
+        }
+
+        if(lastCommand == NULL)
+        {
+            firstCommand = command;
+        }
+        else
+        {
+            lastCommand->next = command;
+        }
+        lastCommand = command;
+
+        // a command ends at ;, & or a newline, or at whatever closes the list
+        if(commandParser->position == commandParser->numTokens)
+        {
+            break;
+        }
+
+        current = &commandParser->tokens[commandParser->position];
+        if(current->type == TOKEN_AMP)
+        {
+            if(command->type != NODE_PIPELINE)
+            {
+                fprintf(stderr, "ERROR: only a pipeline can run in the background\n");
+                fflush(stderr);
+                childExitMethod = W_EXITCODE(1, 0);
+                commandParser->failed = true;
+                return NULL;
+            }
+
+            command->commandPipeline->background = true;
+            command->commandPipeline->text = sourceText(commandParser, commandStart, current->end);
+            commandParser->position++;
+        }
+        else if(current->type == TOKEN_SEMI || current->type == TOKEN_NEWLINE)
+        {
+            commandParser->position++;
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    return firstCommand;
+}
+
+/*************************************************************************************************
+** Name: parseAndOr
+**
+** Description: This function parses commands joined by && and ||, which group from the left. A
+** newline may follow either operator.
+**
+** Parameters: parser
+**
+** Returns: the command, or NULL if it has an error
+*************************************************************************************************/
+
+struct node* parseAndOr(struct parser *commandParser)
+{
+    struct node *leftSide = parseCommand(commandParser);
+
+    while(leftSide != NULL && commandParser->position < commandParser->numTokens)
+    {
+        enum tokenType operatorType = commandParser->tokens[commandParser->position].type;
+        if(operatorType != TOKEN_AND_IF && operatorType != TOKEN_OR_IF)
+        {
+            break;
+        }
+        commandParser->position++;
+        skipNewLines(commandParser);
+
+        struct node *bothSides = newNode(operatorType == TOKEN_AND_IF ? NODE_AND : NODE_OR);
+        bothSides->first = leftSide;
+        bothSides->second = parseCommand(commandParser);
+        if(bothSides->second == NULL)
+        {
+            return NULL;
+        }
+        leftSide = bothSides;
+    }
+
+    return leftSide;
+}
+
+/*************************************************************************************************
+** Name: parseCommand
+**
+** Description: This function parses one command of an and-or list. A ! in front runs the command and
+** turns its status around, a name followed by () defines a function whose body is the compound
+** command after it, a reserved word starts a compound command, and anything else is a pipeline.
+** Compound commands run in the shell itself, so they cannot be a stage of a pipeline.
+**
+** Parameters: parser
+**
+** Returns: the command, or NULL if it has an error
+*************************************************************************************************/
+
+struct node* parseCommand(struct parser *commandParser)
+{
+    if(commandParser->position == commandParser->numTokens)
+    {
+        syntaxError(commandParser);
+        return NULL;
+    }
+
+    if(isReservedWord(commandParser, "!"))
+    {
+        commandParser->position++;
+        struct node *negated = newNode(NODE_NOT);
+        negated->first = parseCommand(commandParser);
+        return negated->first == NULL ? NULL : negated;
+    }
+
+    struct token *current = &commandParser->tokens[commandParser->position];
+    if(current->type == TOKEN_WORD && commandParser->position + 2 < commandParser->numTokens &&
+       current[1].type == TOKEN_LPAREN && current[2].type == TOKEN_RPAREN)
+    {
+        if(current->text[nameLength(current->text)] != '\0')
+        {
+            commandParser->position++;
+            syntaxError(commandParser);
+            return NULL;
+        }
+
+        struct node *definition = newNode(NODE_FUNCTION);
+        definition->name = current->text;
+        commandParser->position += 3;
+        skipNewLines(commandParser);
+        definition->first = parseCompound(commandParser);
+        return definition->first == NULL ? NULL : definition;
+    }
+
+    if(isReservedWord(commandParser, "if") || isReservedWord(commandParser, "while") ||
+       isReservedWord(commandParser, "until") || isReservedWord(commandParser, "for") ||
+       isReservedWord(commandParser, "case") || isReservedWord(commandParser, "{"))
+    {
+        struct node *command = parseCompound(commandParser);
+        if(command != NULL && commandParser->position < commandParser->numTokens &&
+           commandParser->tokens[commandParser->position].type == TOKEN_PIPE)
+        {
+            syntaxError(commandParser);
+            return NULL;
+        }
+        return command;
+    }
+
+    return parseSimplePipeline(commandParser);
+}
+
+/*************************************************************************************************
+** Name: parseCompound
+**
+** Description: This function parses a compound command, an if, while, until, for or case command or
+** a { } group, along with the redirections after it, which apply to everything it runs.
+**
+** Parameters: parser
+**
+** Returns: the command, or NULL if it has an error
+*************************************************************************************************/
+
+struct node* parseCompound(struct parser *commandParser)
+{
+    struct node *command = NULL;
+
+    if(isReservedWord(commandParser, "if"))
+    {
+        command = parseIf(commandParser);
+    }
+    else if(isReservedWord(commandParser, "while") || isReservedWord(commandParser, "until"))
+    {
+        command = newNode(isReservedWord(commandParser, "while") ? NODE_WHILE : NODE_UNTIL);
+        commandParser->position++;
+        if((command->first = parseBody(commandParser)) == NULL || expectReservedWord(commandParser, "do") == false ||
+           (command->second = parseBody(commandParser)) == NULL || expectReservedWord(commandParser, "done") == false)
+        {
+            return NULL;
+        }
+    }
+    else if(isReservedWord(commandParser, "for"))
+    {
+        command = parseFor(commandParser);
+    }
+    else if(isReservedWord(commandParser, "case"))
+    {
+        command = parseCase(commandParser);
+    }
+    else if(isReservedWord(commandParser, "{"))
+    {
+        command = newNode(NODE_GROUP);
+        commandParser->position++;
+        if((command->first = parseBody(commandParser)) == NULL || expectReservedWord(commandParser, "}") == false)
+        {
+            return NULL;
+        }
+    }
+    else
+    {
+        syntaxError(commandParser);
+    }
+
+    if(command == NULL)
+    {
+        return NULL;
+    }
+
+    // every redirection takes the word after it
+    int firstRedirection = commandParser->position;
+    while(commandParser->position < commandParser->numTokens && commandParser->tokens[commandParser->position].type > TOKEN_AMP)
+    {
+        commandParser->position++;
+        if(commandParser->position == commandParser->numTokens || commandParser->tokens[commandParser->position].type != TOKEN_WORD)
+        {
+            syntaxError(commandParser);
+            return NULL;
+        }
+        commandParser->position++;
+    }
+
+    int numRedirections = (commandParser->position - firstRedirection) / 2;
+    if(numRedirections > 0)
+    {
+        struct commandStage *stage = arenaAlloc(&treeArena, sizeof(struct commandStage));
+        stage->argv = arenaAlloc(&treeArena, sizeof(char *));
+        stage->argv[0] = NULL;
+        stage->argc = 0;
+        stage->redirections = arenaAlloc(&treeArena, numRedirections * sizeof(struct redirection));
+        stage->numRedirections = numRedirections;
+        stage->assignments = NULL;
+        stage->numAssignments = 0;
+
+        int i;
+        for(i = 0; i < numRedirections; i++)
+        {
+            struct token *redirectionToken = &commandParser->tokens[firstRedirection + 2 * i];
+            stage->redirections[i].type = redirectionToken->type;
+            stage->redirections[i].fd = redirectionToken->ioNumber;
+            stage->redirections[i].quoted = redirectionToken[1].quoted;
+            stage->redirections[i].target = redirectionToken[1].text;
+        }
+        command->redirections = stage;
+    }
+
+    return command;
+}
+
+/*************************************************************************************************
+** Name: parseIf
+**
+** Description: This function parses an if command from its if or elif up to its fi. An elif is
+** parsed as another if in the else part, which takes the fi along with it.
+**
+** Parameters: parser
+**
+** Returns: the command, or NULL if it has an error
+*************************************************************************************************/
+
+struct node* parseIf(struct parser *commandParser)
+{
+    struct node *command = newNode(NODE_IF);
+    commandParser->position++;
+
+    if((command->first = parseBody(commandParser)) == NULL || expectReservedWord(commandParser, "then") == false ||
+       (command->second = parseBody(commandParser)) == NULL)
+    {
+        return NULL;
+    }
+
+    if(isReservedWord(commandParser, "elif"))
+    {
+        command->third = parseIf(commandParser);
+        return command->third == NULL ? NULL : command;
+    }
+
+    if(isReservedWord(commandParser, "else"))
+    {
+        commandParser->position++;
+        if((command->third = parseBody(commandParser)) == NULL)
+        {
+            return NULL;
+        }
+    }
+
+    return expectReservedWord(commandParser, "fi") == true ? command : NULL;
+}
+
+/*************************************************************************************************
+** Name: parseFor
+**
+** Description: This function parses a for loop. Its words run from the in after the name to a ; or
+** newline, and without an in the loop goes through the positional parameters.
+**
+** Parameters: parser
+**
+** Returns: the command, or NULL if it has an error
+*************************************************************************************************/
+
+struct node* parseFor(struct parser *commandParser)
+{
+    struct node *command = newNode(NODE_FOR);
+    commandParser->position++;
+
+    if(commandParser->position == commandParser->numTokens || commandParser->tokens[commandParser->position].type != TOKEN_WORD ||
+       commandParser->tokens[commandParser->position].text[nameLength(commandParser->tokens[commandParser->position].text)] != '\0')
+    {
+        syntaxError(commandParser);
+        return NULL;
+    }
+    command->name = commandParser->tokens[commandParser->position++].text;
+    skipNewLines(commandParser);
+
+    if(isReservedWord(commandParser, "in"))
+    {
+        commandParser->position++;
+        int firstWord = commandParser->position;
+        while(commandParser->position < commandParser->numTokens && commandParser->tokens[commandParser->position].type == TOKEN_WORD)
+        {
+            commandParser->position++;
+        }
+
+        int numWords = commandParser->position - firstWord;
+        command->words = arenaAlloc(&treeArena, (numWords + 1) * sizeof(char *));
+        int i;
+        for(i = 0; i < numWords; i++)
+        {
+            command->words[i] = commandParser->tokens[firstWord + i].text;
+        }
+        command->words[numWords] = NULL;
+
+        // the words end at ; or a newline
+        if(commandParser->position == commandParser->numTokens ||
+           (commandParser->tokens[commandParser->position].type != TOKEN_SEMI && commandParser->tokens[commandParser->position].type != TOKEN_NEWLINE))
+        {
+            syntaxError(commandParser);
+            return NULL;
+        }
+        commandParser->position++;
+    }
+    else if(commandParser->position < commandParser->numTokens && commandParser->tokens[commandParser->position].type == TOKEN_SEMI)
+    {
+        commandParser->position++;
+    }
+
+    skipNewLines(commandParser);
+    if(expectReservedWord(commandParser, "do") == false || (command->second = parseBody(commandParser)) == NULL ||
+       expectReservedWord(commandParser, "done") == false)
+    {
+        return NULL;
+    }
+
+    return command;
+}
+
+/*************************************************************************************************
+** Name: parseCase
+**
+** Description: This function parses a case command. Every item has one or more patterns separated
+** by |, optionally after a (, then a ) and the commands it runs, which may be none, up to a ;; or
+** the esac.
+**
+** Parameters: parser
+**
+** Returns: the command, or NULL if it has an error
+*************************************************************************************************/
+
+struct node* parseCase(struct parser *commandParser)
+{
+    struct node *command = newNode(NODE_CASE);
+    commandParser->position++;
+
+    if(commandParser->position == commandParser->numTokens || commandParser->tokens[commandParser->position].type != TOKEN_WORD)
+    {
+        syntaxError(commandParser);
+        return NULL;
+    }
+    command->name = commandParser->tokens[commandParser->position++].text;
+    skipNewLines(commandParser);
+    if(expectReservedWord(commandParser, "in") == false)
+    {
+        return NULL;
+    }
+
+    // there are never more items or patterns than tokens left
+    int tokensLeft = commandParser->numTokens - commandParser->position;
+    command->items = arenaAlloc(&treeArena, (tokensLeft + 1) * sizeof(struct caseItem));
+
+    while(true)
+    {
+        skipNewLines(commandParser);
+        if(isReservedWord(commandParser, "esac"))
+        {
+            commandParser->position++;
+            break;
+        }
+
+        if(commandParser->position < commandParser->numTokens && commandParser->tokens[commandParser->position].type == TOKEN_LPAREN)
+        {
+            commandParser->position++;
+        }
+
+        struct caseItem *item = &command->items[command->numItems];
+        item->patterns = arenaAlloc(&treeArena, (tokensLeft + 1) * sizeof(char *));
+        int numPatterns = 0;
+        while(true)
+        {
+            if(commandParser->position == commandParser->numTokens || commandParser->tokens[commandParser->position].type != TOKEN_WORD)
+            {
+                syntaxError(commandParser);
+                return NULL;
+            }
+            item->patterns[numPatterns++] = commandParser->tokens[commandParser->position++].text;
+
+            if(commandParser->position == commandParser->numTokens || commandParser->tokens[commandParser->position].type != TOKEN_PIPE)
+            {
+                break;
+            }
+            commandParser->position++;
+        }
+        item->patterns[numPatterns] = NULL;
+
+        if(commandParser->position == commandParser->numTokens || commandParser->tokens[commandParser->position].type != TOKEN_RPAREN)
+        {
+            syntaxError(commandParser);
+            return NULL;
+        }
+        commandParser->position++;
+
+        item->body = parseList(commandParser);
+        if(commandParser->failed == true || commandParser->incomplete == true)
+        {
+            return NULL;
+        }
+        command->numItems++;
+
+        // ;; ends the item, unless esac ends the whole case
+        if(commandParser->position < commandParser->numTokens && commandParser->tokens[commandParser->position].type == TOKEN_DSEMI)
+        {
+            commandParser->position++;
+        }
+        else if(isReservedWord(commandParser, "esac") == false)
+        {
+            syntaxError(commandParser);
+            return NULL;
+        }
+    }
+
+    return command;
+}
+
+/*************************************************************************************************
+** Name: parseSimplePipeline
+**
+** Description: This function parses a pipeline of simple commands, which takes every word,
+** redirection and | up to the first other operator. A newline after a | is skipped. The tokens are
+** sorted into the stages of the pipeline by parsePipeline once, with the words as they were written,
+** and the pipeline keeps its text for the job table. A reserved word where a stage would start is a
+** syntax error, and so is a pipeline of more than 512 words.
+**
+** Parameters: parser
+**
+** Returns: the command, or NULL if it has an error
+*************************************************************************************************/
+
+struct node* parseSimplePipeline(struct parser *commandParser)
+{
+    static const char *reservedWords[] = {"if", "then", "else", "elif", "fi", "do", "done", "while", "until", "for",
+                                          "case", "esac", "{", "}", "!"};
+    struct token *pipelineTokens = arenaAlloc(&treeArena, (commandParser->numTokens - commandParser->position) * sizeof(struct token));
+    int numPipelineTokens = 0;
+    bool stageStart = true;
+
+    while(commandParser->position < commandParser->numTokens)
+    {
+        struct token *current = &commandParser->tokens[commandParser->position];
+        if(current->type != TOKEN_WORD && current->type != TOKEN_PIPE && current->type <= TOKEN_AMP)
+        {
+            break;
+        }
+
+        if(stageStart == true && current->type == TOKEN_WORD)
+        {
+            int i;
+            for(i = 0; i < sizeof(reservedWords) / sizeof(reservedWords[0]); i++)
+            {
+                if(strcmp(current->text, reservedWords[i]) == 0)
+                {
+                    syntaxError(commandParser);
+                    return NULL;
+                }
+            }
+        }
+
+        pipelineTokens[numPipelineTokens++] = *current;
+        commandParser->position++;
+
+        if(current->type == TOKEN_PIPE)
+        {
+            stageStart = true;
+            skipNewLines(commandParser);
+        }
+        else if(current->type == TOKEN_WORD)
+        {
+            stageStart = false;
+        }
+        // the word after a redirection is its target
+        else if(commandParser->position < commandParser->numTokens && current[1].type == TOKEN_WORD)
+        {
+            pipelineTokens[numPipelineTokens++] = current[1];
+            commandParser->position++;
+        }
+    }
+
+    // a | at the very end leaves the pipeline to go on in the next line
+    if(numPipelineTokens == 0 || (pipelineTokens[numPipelineTokens - 1].type == TOKEN_PIPE && commandParser->position == commandParser->numTokens))
+    {
+        syntaxError(commandParser);
+        return NULL;
+    }
+
+    if(numPipelineTokens > MAX_ARGS)
+    {
+        fprintf(stderr, "ERROR: a pipeline is limited to %d words\n", MAX_ARGS);
+        fflush(stderr);
+        childExitMethod = W_EXITCODE(1, 0);
+        commandParser->failed = true;
+        return NULL;
+    }
+
+    struct node *command = newNode(NODE_PIPELINE);
+    command->commandPipeline = arenaAlloc(&treeArena, sizeof(struct pipeline));
+    char *pipelineText = sourceText(commandParser, pipelineTokens[0].start, pipelineTokens[numPipelineTokens - 1].end);
+    if(parsePipeline(pipelineTokens, numPipelineTokens, &treeArena, pipelineText, command->commandPipeline) == false)
+    {
+        commandParser->failed = true;
+        return NULL;
+    }
+
+    return command;
+}
+
+/*************************************************************************************************
+** Name: parseBody
+**
+** Description: This function parses the list of commands a compound command needs, which may not be
+** empty.
+**
+** Parameters: parser
+**
+** Returns: first command of the list, or NULL if it is empty or has an error
+*************************************************************************************************/
+
+struct node* parseBody(struct parser *commandParser)
+{
+    struct node *body = parseList(commandParser);
+    if(body == NULL && commandParser->failed == false && commandParser->incomplete == false)
+    {
+        syntaxError(commandParser);
+    }
+
+    return body;
+}
+
+/*************************************************************************************************
+** Name: newNode
+**
+** Description: This function allocates a command of the syntax tree from the tree arena with every
+** field empty.
+**
+** Parameters: kind of command
+**
+** Returns: the command
+*************************************************************************************************/
+
+struct node* newNode(enum nodeType type)
+{
+    struct node *command = arenaAlloc(&treeArena, sizeof(struct node));
+    memset(command, 0, sizeof(struct node));
+    command->type = type;
+
+    return command;
+}
+
+/*************************************************************************************************
+** Name: sourceText
+**
+** Description: This function copies part of the text of the command into the tree arena.
+**
+** Parameters: parser, where the part starts and ends in the text
+**
+** Returns: the copy
+*************************************************************************************************/
+
+char* sourceText(struct parser *commandParser, size_t start, size_t end)
+{
+    char *text = arenaAlloc(&treeArena, end - start + 1);
+    memcpy(text, commandParser->text + start, end - start);
+    text[end - start] = '\0';
+
+    return text;
+}
+
+/*************************************************************************************************
+** Name: isReservedWord
+**
+** Description: This function checks if the next token is a reserved word. Since raw words keep their
+** quotes a quoted reserved word never is one.
+**
+** Parameters: parser, reserved word
+**
+** Returns: true if the next token is the reserved word
+*************************************************************************************************/
+
+bool isReservedWord(struct parser *commandParser, const char *word)
+{
+    return commandParser->position < commandParser->numTokens && commandParser->tokens[commandParser->position].type == TOKEN_WORD &&
+           strcmp(commandParser->tokens[commandParser->position].text, word) == 0;
+}
+
+/*************************************************************************************************
+** Name: expectReservedWord
+**
+** Description: This function takes the reserved word a compound command needs next, which is a
+** syntax error if it is not there.
+**
+** Parameters: parser, reserved word
+**
+** Returns: true if the reserved word was taken
+*************************************************************************************************/
+
+bool expectReservedWord(struct parser *commandParser, const char *word)
+{
+    if(isReservedWord(commandParser, word) == false)
+    {
+        syntaxError(commandParser);
+        return false;
+    }
+
+    commandParser->position++;
+    return true;
+}
+
+/*************************************************************************************************
+** Name: skipNewLines
+**
+** Description: This function skips the newlines at the next token.
+**
+** Parameters: parser
+**
+** Returns: N/A
+*************************************************************************************************/
+
+void skipNewLines(struct parser *commandParser)
+{
+    while(commandParser->position < commandParser->numTokens && commandParser->tokens[commandParser->position].type == TOKEN_NEWLINE)
+    {
+        commandParser->position++;
+    }
+}
+
+/*************************************************************************************************
+** Name: syntaxError
+**
+** Description: This function reports that the next token cannot be where it is. Running out of
+** tokens is not an error, only a command which is not complete yet, so nothing is reported.
+**
+** Parameters: parser
+**
+** Returns: N/A
+*************************************************************************************************/
+
+void syntaxError(struct parser *commandParser)
+{
+    if(commandParser->position == commandParser->numTokens)
+    {
+        commandParser->incomplete = true;
+        return;
+    }
+
+    struct token *badToken = &commandParser->tokens[commandParser->position];
+    fprintf(stderr, "ERROR: syntax error near unexpected token '%s'\n", badToken->type == TOKEN_NEWLINE ? "newline" : badToken->text);
+    fflush(stderr);
+    childExitMethod = W_EXITCODE(1, 0);
+    commandParser->failed = true;
+}
+
+/*************************************************************************************************
+** Name: runCommand
+**
+** Description: This function runs the syntax tree of a command. At a terminal cntrl+c stops the rest
+** of it, which only the shell sees while it runs built ins itself, such as a loop of them. Jobs have
+** process groups of their own there, so the handler never reaches them. A break, continue or return
+** with nothing left to unwind is dropped once the command is done.
+**
+** Parameters: first command of the syntax tree
+**
+** Returns: N/A
+*************************************************************************************************/
+
+void runCommand(struct node *program)
+{
+    struct sigaction interruptCommand = {0};
+    struct sigaction shellSIGINT;
+    if(jobControl == true)
+    {
+        interruptCommand.sa_handler = catchSIGINT;
+        interruptCommand.sa_flags = SA_RESTART;
+        sigaction(SIGINT, &interruptCommand, &shellSIGINT);
+    }
+    interruptRequested = 0;
+
+    double commandStart = traceTime();
+    runList(program);
+    traceEvent("command", 0, commandStart, programText.data);
+
+    if(jobControl == true)
+    {
+        sigaction(SIGINT, &shellSIGINT, NULL);
+    }
+    unwinding = UNWIND_NONE;
+}
+
+/*************************************************************************************************
+** Name: runList
+**
+** Description: This function runs a list of commands one after another until one of them unwinds.
+**
+** Parameters: first command of the list
+**
+** Returns: N/A
+*************************************************************************************************/
+
+void runList(struct node *list)
+{
+    struct node *command;
+    for(command = list; command != NULL && unwinding == UNWIND_NONE; command = command->next)
+    {
+        runNode(command);
+    }
+}
+
+/*************************************************************************************************
+** Name: runNode
+**
+** Description: This function runs one command of the syntax tree, leaving its status in
+** childExitMethod. The redirections of a compound command are applied to the shell itself for as
+** long as it runs, the same way they are for a built in. An if whose conditions all fail has the
+** status 0, and so does the definition of a function.
+**
+** Parameters: command to run
+**
+** Returns: N/A
+*************************************************************************************************/
+
+void runNode(struct node *command)
+{
+    struct savedDescriptors saved;
+    if(command->redirections != NULL)
+    {
+        struct commandStage stage;
+        if(expandRedirections(command->redirections, &stage) == false)
+        {
+            childExitMethod = W_EXITCODE(1, 0);
+            return;
+        }
+        if(redirectBuiltIn(&stage, &saved) == false)
+        {
+            restoreBuiltIn(&saved);
+            childExitMethod = W_EXITCODE(1, 0);
+            return;
+        }
+    }
+
+    switch(command->type)
+    {
+        case NODE_PIPELINE:
+            runPipeline(command->commandPipeline);
+            break;
+
+        case NODE_NOT:
+            runNode(command->first);
+            childExitMethod = W_EXITCODE(exitValue(childExitMethod) == 0 ? 1 : 0, 0);
+            break;
+
+        case NODE_AND:
+        case NODE_OR:
+            runNode(command->first);
+            if(unwinding == UNWIND_NONE && (exitValue(childExitMethod) == 0) == (command->type == NODE_AND))
+            {
+                runNode(command->second);
+            }
+            break;
+
+        case NODE_IF:
+            runList(command->first);
+            if(unwinding != UNWIND_NONE)
+            {
+                break;
+            }
+
+            if(exitValue(childExitMethod) == 0)
+            {
+                runList(command->second);
+            }
+            else if(command->third != NULL)
+            {
+                runList(command->third);
+            }
+            else
+            {
+                childExitMethod = W_EXITCODE(0, 0);
+            }
+            break;
+
+        case NODE_WHILE:
+        case NODE_UNTIL:
+            runLoop(command);
+            break;
+
+        case NODE_FOR:
+            runFor(command);
+            break;
+
+        case NODE_CASE:
+            runCase(command);
+            break;
+
+        case NODE_GROUP:
+            runList(command->first);
+            break;
+
+        case NODE_FUNCTION:
+            defineFunction(command);
+            childExitMethod = W_EXITCODE(0, 0);
+            break;
+    }
+
+    if(command->redirections != NULL)
+    {
+        restoreBuiltIn(&saved);
+    }
+}
+
+/*************************************************************************************************
+** Name: runLoop
+**
+** Description: This function runs a while or until loop. The body runs for as long as the condition
+** succeeds, or fails for until, and the status is that of the last run of the body, 0 if it never
+** ran.
+**
+** Parameters: the loop
+**
+** Returns: N/A
 *************************************************************************************************/
 
-void ioRedirect(char **commandLine, bool runBackground)
+void runLoop(struct node *loop)
 {
-    int inputFileDescriptor = 4;
-    int outputFileDescriptor = 4;
-    int devNullOutputDescriptor = -4;
-    int devNullInputDescriptor = -4;
+    int loopStatus = W_EXITCODE(0, 0);
+    loopDepth++;
 
-    // assumes no redirection was given to background command
-    if(runBackground == true)
+    while(true)
     {
-        // make a file using /dev/null as file name and allow writing to file
-        // taken from lecture 3.4
-        devNullOutputDescriptor = open("/dev/null", O_WRONLY , 0644);
+        runList(loop->first);
+        if(unwinding != UNWIND_NONE)
+        {
+            loopStatus = childExitMethod;
+            if(loopUnwound() == true)
+            {
+                break;
+            }
+            continue;
+        }
 
-        // error handling
-        if(devNullOutputDescriptor == -1)
+        if((exitValue(childExitMethod) == 0) != (loop->type == NODE_WHILE))
         {
-            // taken from lecture 3.4
-            perror("ERROR: open() failed. Cannot output to file");
-            fflush(stderr);
-            exit(1);
+            break;
         }
 
-        // copy file descriptor
-        dup2(devNullOutputDescriptor, 1);
+        runList(loop->second);
+        loopStatus = childExitMethod;
+        if(unwinding != UNWIND_NONE && loopUnwound() == true)
+        {
+            break;
+        }
+    }
+
+    loopDepth--;
+    childExitMethod = loopStatus;
+}
+
+/*************************************************************************************************
+** Name: runFor
+**
+** Description: This function runs a for loop. Its words are expanded once before the first pass and
+** copied, since everything made while the body runs is released after every pipeline, and the body
+** runs with the variable set to each of them in turn.
+**
+** Parameters: the loop
+**
+** Returns: N/A
+*************************************************************************************************/
+
+void runFor(struct node *loop)
+{
+    char **values = NULL;
+    int numValues = 0;
+    int capacity = 0;
+
+    // without words the loop goes through the positional parameters
+    char *const *rawWords = loop->words != NULL ? loop->words : positionalParams;
+    int numRawWords = 0;
+    while(loop->words != NULL ? rawWords[numRawWords] != NULL : numRawWords < numPositional)
+    {
+        numRawWords++;
+    }
+
+    int i;
+    for(i = 0; i < numRawWords; i++)
+    {
+        struct token *fields = NULL;
+        int numFields = 1;
+        if(loop->words != NULL && strpbrk(rawWords[i], "$`'\"\\") != NULL)
+        {
+            numFields = lexLine(rawWords[i], &lineArena, &fields, LEX_EXPAND);
+            if(numFields == -1)
+            {
+                break;
+            }
+        }
 
-        // close any open files
-        close(devNullOutputDescriptor);
+        int j;
+        for(j = 0; j < numFields; j++)
+        {
+            if(numValues == capacity)
+            {
+                capacity = capacity == 0 ? 16 : capacity * 2;
+                values = realloc(values, capacity * sizeof(char *));
+            }
+            values[numValues++] = strdup(fields == NULL ? rawWords[i] : fields[j].text);
+        }
+    }
+    arenaReset(&lineArena);
 
-        // make a file using /dev/null as file name and allow reading from file
-        // taken from lecture 3.4
-        devNullInputDescriptor = open("/dev/null", O_RDONLY, 0);
+    int loopStatus = W_EXITCODE(i < numRawWords ? 1 : 0, 0);
+    loopDepth++;
 
-        // error handling
-        if(devNullInputDescriptor == -1)
+    for(i = 0; i < numValues; i++)
+    {
+        setVariable(loop->name, values[i]);
+        runList(loop->second);
+        loopStatus = childExitMethod;
+        if(unwinding != UNWIND_NONE && loopUnwound() == true)
         {
-            // taken from lecture 3.4
-            perror("ERROR: open() failed. Cannot input to file");
-            fflush(stderr);
-            exit(1);
+            break;
         }
+    }
+
+    loopDepth--;
+    for(i = 0; i < numValues; i++)
+    {
+        free(values[i]);
+    }
+    free(values);
+    childExitMethod = loopStatus;
+}
 
-        // copy file descriptor
-        dup2(devNullInputDescriptor, 0);
+/*************************************************************************************************
+** Name: loopUnwound
+**
+** Description: This function is called by a loop whose body is unwinding. A break or continue
+** unwinds one more loop, and the last loop it reaches either stops, for a break, or goes on with its
+** next pass, for a continue. A return or an interrupt unwinds every loop.
+**
+** Parameters: N/A
+**
+** Returns: true if the loop stops, false if it goes on
+*************************************************************************************************/
+
+bool loopUnwound()
+{
+    if(unwinding != UNWIND_BREAK && unwinding != UNWIND_CONTINUE)
+    {
+        return true;
+    }
 
-        // close any open files
-        close(devNullInputDescriptor);
+    if(--unwindLevels > 0)
+    {
+        return true;
     }
 
+    bool isBreak = unwinding == UNWIND_BREAK;
+    unwinding = UNWIND_NONE;
+
+    return isBreak;
+}
+
+/*************************************************************************************************
+** Name: runCase
+**
+** Description: This function runs a case command. Its word is matched against the patterns of each
+** item in turn with fnmatch, and the first item with a pattern which matches runs. The status is 0
+** if no item matches or the item has no commands.
+**
+** Parameters: the case command
+**
+** Returns: N/A
+*************************************************************************************************/
+
+void runCase(struct node *caseCommand)
+{
+    const char *subject = expandString(caseCommand->name);
+    childExitMethod = W_EXITCODE(0, 0);
+    if(subject == NULL)
+    {
+        childExitMethod = W_EXITCODE(1, 0);
+        return;
+    }
 
-    // loop through all the tokens and check for redirection
     int i;
-    for(i = 0; commandLine[i] != NULL; i++)
+    for(i = 0; i < caseCommand->numItems; i++)
     {
-        // if the redirection is right pointing then make a file to redirect to
-        if(strcmp(commandLine[i], ">") == 0)
+        char **pattern;
+        for(pattern = caseCommand->items[i].patterns; *pattern != NULL; pattern++)
         {
-            // make a file using following token as file name and allow writing to file
-            // taken from lecture 3.4
-            outputFileDescriptor = open(commandLine[i + 1], O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            const char *expandedPattern = expandString(*pattern);
+            if(expandedPattern != NULL && fnmatch(expandedPattern, subject, 0) == 0)
+            {
+                runList(caseCommand->items[i].body);
+                return;
+            }
+        }
+    }
+}
 
-            // error handling
-            if(outputFileDescriptor == -1)
+/*************************************************************************************************
+** Name: runPipeline
+**
+** Description: This function runs a pipeline of the syntax tree. Its words are expanded by
+** expandPipeline, so they have the values parameters and command substitutions have at the time, and
+** the pipeline then runs like any other, unless its command is a function or break, continue or
+** return. A command may start with NAME=value words. Those of a command run by itself set variables
+** of the shell when nothing else follows and are only exported to the command otherwise, and those of
+** a stage of a longer pipeline are only in the environment of that stage. A command without a name
+** has the status of the last command substitution in its words, or 0. A pipeline ended by
+** cntrl+c interrupts the rest of the command. Everything made from the words is released afterwards.
+**
+** Parameters: pipeline as it was parsed
+**
+** Returns: N/A
+*************************************************************************************************/
+
+void runPipeline(struct pipeline *rawPipeline)
+{
+    int substitutionsBefore = numSubstitutions;
+    struct pipeline commandPipeline;
+    if(expandPipeline(rawPipeline, &commandPipeline) == false)
+    {
+        childExitMethod = W_EXITCODE(1, 0);
+        arenaReset(&lineArena);
+        return;
+    }
+
+    // the assignments of a command run by itself are made in the shell, while those of a stage of a
+    // longer pipeline go with it into its child
+    struct commandStage *stage = &commandPipeline.stages[0];
+    char **assignments = NULL;
+    int numAssignments = 0;
+    if(commandPipeline.numStages == 1)
+    {
+        assignments = stage->assignments;
+        numAssignments = stage->numAssignments;
+        stage->numAssignments = 0;
+    }
+
+    int i;
+    if(stage->argc == 0)
+    {
+        // assignments on their own set variables of the shell, and redirections on their own only open
+        // their files. the status is that of the last command substitution made on the way, if any
+        if(numSubstitutions == substitutionsBefore)
+        {
+            childExitMethod = W_EXITCODE(0, 0);
+        }
+        if(stage->numRedirections > 0)
+        {
+            struct savedDescriptors saved;
+            if(redirectBuiltIn(stage, &saved) == false)
             {
-                // taken from lecture 3.4
-                perror("ERROR: open() failed. Cannot output to file");
-                fflush(stderr);
-                exit(1);
+                childExitMethod = W_EXITCODE(1, 0);
             }
+            restoreBuiltIn(&saved);
+        }
+
+        for(i = 0; i < numAssignments; i++)
+        {
+            char *value = strchr(assignments[i], '=');
+            *value = '\0';
+            setVariable(assignments[i], value + 1);
+        }
+        arenaReset(&lineArena);
+        return;
+    }
+
+    // variables assigned for the command alone are exported to it and the environment gets its old
+    // values back after it
+    char **oldValues = NULL;
+    if(numAssignments > 0)
+    {
+        oldValues = malloc(numAssignments * sizeof(char *));
+        for(i = 0; i < numAssignments; i++)
+        {
+            char *value = strchr(assignments[i], '=');
+            *value = '\0';
+            const char *oldValue = getenv(assignments[i]);
+            oldValues[i] = oldValue == NULL ? NULL : strdup(oldValue);
+            exportVariable(assignments[i], value + 1);
+        }
+    }
+
+    // the pipeline made from the words is gone once a function has run
+    int functionIndex = commandPipeline.numStages == 1 ? findFunction(stage->argv[0]) : -1;
+    if(functionIndex != -1 && commandPipeline.timed == false && commandPipeline.background == false)
+    {
+        callFunction(functionIndex, stage);
+    }
+    else if(commandPipeline.numStages == 1 && commandPipeline.timed == false && commandPipeline.background == false &&
+            (strcmp(stage->argv[0], "break") == 0 || strcmp(stage->argv[0], "continue") == 0 || strcmp(stage->argv[0], "return") == 0))
+    {
+        childExitMethod = W_EXITCODE(flowCommand(stage->argv), 0);
+    }
+    else
+    {
+        builtInFunctions(&commandPipeline, &terminateFgChild, &ignoreSIGTSTP);
+    }
 
-            // copy file descriptor
-            dup2(outputFileDescriptor, 1);
+    if(interruptRequested != 0 || (WIFSIGNALED(childExitMethod) && WTERMSIG(childExitMethod) == SIGINT))
+    {
+        unwinding = UNWIND_INTERRUPT;
+    }
+
+    for(i = 0; i < numAssignments; i++)
+    {
+        if(oldValues[i] == NULL)
+        {
+            unexportVariable(assignments[i]);
+        }
+        else
+        {
+            exportVariable(assignments[i], oldValues[i]);
+            free(oldValues[i]);
+        }
+    }
+    free(oldValues);
+
+    arenaReset(&lineArena);
+}
 
-            // close any open files
-            close(outputFileDescriptor);
+/*************************************************************************************************
+** Name: expandPipeline
+**
+** Description: This function makes the pipeline to run from a pipeline as it was parsed, with every
+** word expanded by lexLine into as many arguments as it splits into. Words without anything to
+** expand are used as they are. The NAME=value words a stage starts with are kept apart from its
+** arguments as assignments, with their values expanded as single words. The pipeline and its words
+** are allocated from the line arena.
+**
+** Parameters: pipeline as it was parsed, pipeline to fill in
+**
+** Returns: true if every word could be expanded, false otherwise
+*************************************************************************************************/
 
-            // set redirection symbol to null
-            commandLine[i] = NULL;
+bool expandPipeline(struct pipeline *rawPipeline, struct pipeline *commandPipeline)
+{
+    *commandPipeline = *rawPipeline;
+    commandPipeline->stages = arenaAlloc(&lineArena, rawPipeline->numStages * sizeof(struct commandStage));
 
+    int numWords = 0;
+    int s;
+    for(s = 0; s < rawPipeline->numStages; s++)
+    {
+        struct commandStage *rawStage = &rawPipeline->stages[s];
+        struct commandStage *stage = &commandPipeline->stages[s];
+        if(expandRedirections(rawStage, stage) == false)
+        {
+            return false;
         }
-            // if the redirection is left pointing then make redirect from file to command
-        else if (strcmp(commandLine[i], "<") == 0)
+
+        // assignments come before the command name and are expanded without splitting
+        int firstWord = 0;
+        while(firstWord < rawStage->argc && nameLength(rawStage->argv[firstWord]) > 0 &&
+              rawStage->argv[firstWord][nameLength(rawStage->argv[firstWord])] == '=')
         {
-            // make a file using following token as file name and allow reading from file
-            // taken from lecture 3.4
-            inputFileDescriptor = open(commandLine[i + 1], O_RDONLY, 0);
+            firstWord++;
+        }
 
-            // error handling
-            if(inputFileDescriptor == -1)
+        stage->assignments = arenaAlloc(&lineArena, (firstWord + 1) * sizeof(char *));
+        stage->numAssignments = firstWord;
+
+        int i;
+        for(i = 0; i < firstWord; i++)
+        {
+            size_t length = nameLength(rawStage->argv[i]);
+            char *value = expandString(rawStage->argv[i] + length + 1);
+            if(value == NULL)
             {
-                // taken from lecture 3.4
-                perror("ERROR: open() failed. Cannot input to file");
-                fflush(stderr);
-                exit(1);
+                return false;
             }
 
-            // copy file descriptor
-            dup2(inputFileDescriptor, 0);
+            size_t valueLength = strlen(value);
+            stage->assignments[i] = arenaAlloc(&lineArena, length + valueLength + 2);
+            memcpy(stage->assignments[i], rawStage->argv[i], length + 1);
+            memcpy(stage->assignments[i] + length + 1, value, valueLength + 1);
+        }
+        stage->assignments[firstWord] = NULL;
 
-            // close any open files
-            close(inputFileDescriptor);
+        // a word which expands to nothing adds no argument and one which splits adds several
+        struct token **fields = arenaAlloc(&lineArena, (rawStage->argc + 1) * sizeof(struct token *));
+        int *numFields = arenaAlloc(&lineArena, (rawStage->argc + 1) * sizeof(int));
+        int numArguments = 0;
+
+        for(i = firstWord; i < rawStage->argc; i++)
+        {
+            fields[i] = NULL;
+            numFields[i] = 1;
+            if(strpbrk(rawStage->argv[i], "$`'\"\\~") != NULL)
+            {
+                numFields[i] = lexLine(rawStage->argv[i], &lineArena, &fields[i], LEX_EXPAND);
+                if(numFields[i] == -1)
+                {
+                    return false;
+                }
+            }
+            numArguments += numFields[i];
+        }
+
+        stage->argv = arenaAlloc(&lineArena, (numArguments + 1) * sizeof(char *));
+        stage->argc = 0;
+        for(i = firstWord; i < rawStage->argc; i++)
+        {
+            int j;
+            for(j = 0; j < numFields[i]; j++)
+            {
+                stage->argv[stage->argc++] = fields[i] == NULL ? rawStage->argv[i] : fields[i][j].text;
+            }
+        }
+        stage->argv[stage->argc] = NULL;
+        numWords += stage->argc;
 
-            // set redirection symbol to null
-            commandLine[i] = NULL;
+        if(stage->argc == 0 && rawPipeline->numStages > 1)
+        {
+            fprintf(stderr, "ERROR: a stage of the pipeline has no command\n");
+            fflush(stderr);
+            return false;
         }
     }
+
+    if(numWords > MAX_ARGS)
+    {
+        fprintf(stderr, "ERROR: a pipeline is limited to %d words\n", MAX_ARGS);
+        fflush(stderr);
+        return false;
+    }
+
+    return true;
 }
 
 /*************************************************************************************************
-** Name: isBackgroundProcess
+** Name: expandRedirections
 **
-** Description: This function checks if the last argument in the user's input is an & symbol.
-** If so, the user is requesting the process to be run in the background. First the & is set to
-** null so that it will not be processed by execvp. Next, the function checks if the user is in
-** foreground only mode which ignores any requests to run in the background. If the user is in
-** normal mode and has requested the process to run in the background, the function returns true
-** If the user did not request the process to run in the background then the function returns false.
+** Description: This function copies a stage as it was parsed with the targets of its redirections
+** expanded into single words. The body of a here-document has its parameters expanded unless its
+** delimiter was quoted.
+**
+** Parameters: stage as it was parsed, stage to fill in
+**
+** Returns: true if every target could be expanded, false otherwise
+*************************************************************************************************/
+
+bool expandRedirections(struct commandStage *rawStage, struct commandStage *stage)
+{
+    *stage = *rawStage;
+    if(rawStage->numRedirections == 0)
+    {
+        return true;
+    }
+
+    stage->redirections = arenaAlloc(&lineArena, rawStage->numRedirections * sizeof(struct redirection));
+
+    int i;
+    for(i = 0; i < rawStage->numRedirections; i++)
+    {
+        stage->redirections[i] = rawStage->redirections[i];
+        if(rawStage->redirections[i].type == TOKEN_HEREDOC)
+        {
+            if(rawStage->redirections[i].quoted == false)
+            {
+                wordBuffer.length = 0;
+                if(expandHereDocumentLine(rawStage->redirections[i].target, &wordBuffer) == false)
+                {
+                    return false;
+                }
+                stage->redirections[i].target = bufferToArena(&wordBuffer, &lineArena);
+            }
+        }
+        else if((stage->redirections[i].target = expandString(rawStage->redirections[i].target)) == NULL)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/*************************************************************************************************
+** Name: expandString
+**
+** Description: This function expands a word into a single string the way the word of an assignment
+** or redirection is, without splitting it. A word without anything to expand is its own expansion.
+**
+** Parameters: word as it was written
+**
+** Returns: the expansion, allocated from the line arena, or NULL if it could not be expanded
+*************************************************************************************************/
+
+char* expandString(const char *rawWord)
+{
+    if(strpbrk(rawWord, "$`'\"\\~") == NULL)
+    {
+        return (char *)rawWord;
+    }
+
+    struct token *tokens = NULL;
+    int numTokens = lexLine(rawWord, &lineArena, &tokens, LEX_EXPAND_UNSPLIT);
+    if(numTokens == -1)
+    {
+        return NULL;
+    }
+    if(numTokens == 0)
+    {
+        char *emptyWord = arenaAlloc(&lineArena, 1);
+        emptyWord[0] = '\0';
+        return emptyWord;
+    }
+
+    return tokens[0].text;
+}
+
+/*************************************************************************************************
+** Name: nameLength
 **
-** Parameters: user string entered and the last index of the user input after it is tokenized
+** Description: This function measures the name of a variable at the start of a text, which is made
+** of letters, digits and underscores and does not start with a digit.
 **
-** Returns: boolean variable true or false depending on whether the user requested the process
-** is to be run in the background or not. The request to run in the background is superseded by
-** a boolean which is set from a SIGTSTP sighandler.
+** Parameters: text
+**
+** Returns: length of the name, 0 if the text does not start with one
 *************************************************************************************************/
 
-bool isBackgroundProcess(char **commandLine, int lastIndex)
+size_t nameLength(const char *text)
 {
-    // if & was used last in command indicating background process
-    if(strcmp(commandLine[lastIndex], "&") == 0)
+    if(isdigit((unsigned char)text[0]))
     {
-        // set string to null so it doesn't get processed by execvp
-        commandLine[lastIndex] = NULL;
+        return 0;
+    }
 
-        // if user has entered foreground only mode then it supersedes request
-        // for process to run in the background
-        if(isForegroundOnly == true)
-        {
-            return false;
-        }
-        // if user not in foreground mode and requested background process, allow it
-        else
-        {
-            return true;
-        }
+    size_t length = 0;
+    while(isalnum((unsigned char)text[length]) || text[length] == '_')
+    {
+        length++;
     }
 
-    return false;
+    return length;
 }
 
 /*************************************************************************************************
-** Name: execError
+** Name: setVariable
 **
-** Description: This function is used to handle the failure of the execvp function which is called
-** prior. This function simply returns a message stating the user has entered an invalid command
-** end exits with EXIT FAILURE. Note that this function will only trigger upon a failed call to
-** the execvp function.
+** Description: This function sets a variable of the shell. A variable which is exported, being in
+** the environment or marked by export before it had a value, is set in the environment so commands
+** see the new value. Any other variable is kept in shellVariables where only the shell sees it.
 **
-** Parameters: N/A
+** Parameters: name of the variable, value
 **
 ** Returns: N/A
 *************************************************************************************************/
 
-void execError()
+void setVariable(const char *name, const char *value)
 {
-    perror("ERROR: the command you entered does not exist");
-    fflush(stderr);
-    exit(EXIT_FAILURE);
+    size_t length = strlen(name);
+    int variableIndex = findShellVariable(name, length);
+
+    if(getenv(name) != NULL || (variableIndex != -1 && shellVariables[variableIndex][length] == '\0'))
+    {
+        if(variableIndex != -1 && shellVariables[variableIndex][length] == '\0')
+        {
+            free(shellVariables[variableIndex]);
+            shellVariables[variableIndex] = shellVariables[--numShellVariables];
+        }
+        exportVariable(name, value);
+        return;
+    }
+
+    size_t assignmentSize = length + strlen(value) + 2;
+    char *assignment = malloc(assignmentSize);
+    if(assignment == NULL)
+    {
+        perror("ERROR: Unable to set the variable");
+        fflush(stderr);
+        return;
+    }
+    snprintf(assignment, assignmentSize, "%s=%s", name, value);
+
+    if(variableIndex != -1)
+    {
+        free(shellVariables[variableIndex]);
+        shellVariables[variableIndex] = assignment;
+        return;
+    }
+
+    shellVariables = realloc(shellVariables, (numShellVariables + 1) * sizeof(char *));
+    shellVariables[numShellVariables++] = assignment;
 }
 
 /*************************************************************************************************
-** Name: checkBackgroundStatus
+** Name: findShellVariable
 **
-** Description: This function checks on the status of background processes. The function checks
-** an array which is storing the PIDS of background processes. The function looks at all the PID
-** of the processes in the background and checks if any child process in the background has terminated.
-** If any process is terminated the function then checks if a signal caused the termination. If
-** a signal resulted in the child process ending. Then a message displays stating the child process
-** with stated PID has completed and the type of signal that terminated it. Otherwise if a child process
-** ends via normal methods, the function prints a message stating the child is now done and its exit
-** method. After a child process has ended, its PID is set to 0 so it can be removed from the array
-** to not be checked again.
-** SOURCE : improvised from LECTURE CODE in 3.1 slide 26 updated with recommendations in notes
+** Description: This function finds a variable which is not exported in shellVariables, either with
+** its value or marked to be exported once it has one.
 **
-** Parameters: N/A
+** Parameters: name of the variable, length of the name
 **
-** Returns: N/A
+** Returns: index in shellVariables or -1 if it is not there
 *************************************************************************************************/
 
-void checkBackgroundStatus()
+int findShellVariable(const char *name, size_t length)
 {
     int i;
-
-    // search through all processes running in the background using their PID
-    for(i = 0; i < 100; i++)
+    for(i = 0; i < numShellVariables; i++)
     {
-        // only check active PIDs
-        if(pidArray[i] != 0)
+        if(shellVariables[i][0] == name[0] && strncmp(shellVariables[i], name, length) == 0 &&
+           (shellVariables[i][length] == '=' || shellVariables[i][length] == '\0'))
         {
-            // wait only for terminated child processes
-            if (waitpid(pidArray[i], &childExitMethod, WNOHANG) > 0)
-            {
-                // if process ended via signal display message with PID of process & termination value
-                if(WIFSIGNALED(childExitMethod))
-                {
-                    printf("background pid %d is done: terminated by signal: %d\n", pidArray[i], WTERMSIG(childExitMethod));
-                    fflush(stdout);
-                }
-                // if process ended normally display message with PID of process & its exit value
-                else if(WIFEXITED(childExitMethod))
-                {
-                    printf("background pid %d is done: exit value: %d\n", pidArray[i], childExitMethod);
-                    fflush(stdout);
-                }
-                //zero out the PID removing it from being checked again
-                pidArray[i] = 0;
-            }
+            return i;
         }
     }
+
+    return -1;
 }
 
 /*************************************************************************************************
-** Name: catchSIGTSTP
+** Name: variableValue
 **
-** Description: This function is a signal handler used by the parent to display a message using
-** the write command to allow for re-entrance which states the mode the user is changing to. The
-** function handles the use of cntrl+z to change between foreground only mode: where requests to
-** send processes to teh background are ignored, and regular mode which operates as usual. The
-** function checks on a global variable isForegroundOnly which is originally set to false. The
-** function checks the status of the boolean and prints a message switching modes upon receipt
-** of the SIGTSTP signal and changes the variable to reflect the mode change. The isForegroundOnly
-** variable status is later used in another function that checks if a process should be run in the
-** background. The boolean variable used here will supersede calls to the background and ignore them
-** if Foreground only mode is set to active.
+** Description: This function looks up the value of a variable without copying its name out of the
+** text it is in. The environment comes first, so a variable assigned for a single command is seen
+** with that value while the command runs.
 **
-** Parameters: integer for signal number
+** Parameters: name of the variable, length of the name
 **
-** Returns: N/A
+** Returns: value of the variable or NULL if it is not set
 *************************************************************************************************/
 
-void catchSIGTSTP(int signo)
+const char* variableValue(const char *name, size_t length)
 {
-    if(isForegroundOnly == false)
+    char **variable;
+    for(variable = environ; *variable != NULL; variable++)
     {
-        char *foreground = "Entering foreground-only mode (& is now ignored)\n";
-        write(STDOUT_FILENO, foreground, 49);
-
-        // change the status to reflect foreground only
-        isForegroundOnly = true;
+        if((*variable)[0] == name[0] && strncmp(*variable, name, length) == 0 && (*variable)[length] == '=')
+        {
+            return *variable + length + 1;
+        }
     }
-    else
-    {
-        char *fullShell = "Exiting foreground-only mode\n";
-        write(STDOUT_FILENO, fullShell, 29);
 
-        // change the status to reflect exit foreground
-        isForegroundOnly = false;
+    int variableIndex = findShellVariable(name, length);
+    if(variableIndex != -1 && shellVariables[variableIndex][length] == '=')
+    {
+        return shellVariables[variableIndex] + length + 1;
     }
+
+    return NULL;
 }
 
 /*************************************************************************************************
-** Name: checkEmptyLine
+** Name: exportVariable
 **
-** Description: This function takes the user's input and searches the line for any input. If the line
-** contains anything aside from blanks during the iteration of the input, the loop used to check ends
-** and the global boolean to continue asking the user for input is set to false as the line has passed
-** the contains no blanks test - as blank lines in the input are to be ignored.
+** Description: This function puts a variable in the environment so commands see it. The NAME=value
+** string is put there with putenv and kept in exportedVariables, so the string it replaces can be
+** freed, which setenv would leak.
 **
-** Parameters: string containing user input
+** Parameters: name of the variable, value
 **
 ** Returns: N/A
 *************************************************************************************************/
 
-void checkEmptyLine(const char *lineEntered)
+void exportVariable(const char *name, const char *value)
 {
-    // check the string for blank input
-    int i = 0;
-    while(lineEntered[i])
+    size_t length = strlen(name);
+    size_t assignmentSize = length + strlen(value) + 2;
+    char *assignment = malloc(assignmentSize);
+    if(assignment == NULL)
     {
-        char currentChar = lineEntered[i++];
+        perror("ERROR: Unable to export the variable");
+        fflush(stderr);
+        return;
+    }
+    snprintf(assignment, assignmentSize, "%s=%s", name, value);
+    putenv(assignment);
 
-        // if any character in string is other than blanks change to false and exit checking
-        if(isspace(currentChar) == false)
+    int i;
+    for(i = 0; i < numExportedVariables; i++)
+    {
+        if(strncmp(exportedVariables[i], name, length) == 0 && exportedVariables[i][length] == '=')
         {
-            askInput = false;
-            break;
+            free(exportedVariables[i]);
+            exportedVariables[i] = assignment;
+            return;
         }
     }
+
+    exportedVariables = realloc(exportedVariables, (numExportedVariables + 1) * sizeof(char *));
+    exportedVariables[numExportedVariables++] = assignment;
 }
 
 /*************************************************************************************************
-** Name: variableExpansion
+** Name: unexportVariable
 **
-** Description: This function checks if the user requested variable expansion in their entry using
-** "$$". The function first checks to see if there is an occurrence of $$. If so, it obtains the PID
-** of the shell and converts it into a string. Next it allocates a buffer of the max length to help
-** process the input.  THe function keeps track of the size of the line at all times so that the
-** number of characters do not exceed allowable amounts. The function then iterates over the string
-** and copies all data after the occurrence of the "$$". It then adds the PID of the shell and the
-** remaining string which was copied into the buffer to the position in the original string. Each
-** time the loop passes it accounts the increase of the number of characters due to variable expansion
-** and repeats the process. When the processing is finished the memory of the buffer is cleared and
-** the number of characters in the input is updated while not counting the terminating character
-** against the count of chars.
+** Description: This function removes a variable from the environment and frees its string if the
+** shell put it there. A value the shell keeps for itself in shellVariables is left as it is.
 **
-** Parameters: string of user input and a integers representing number of characters entered
+** Parameters: name of the variable
 **
 ** Returns: N/A
 *************************************************************************************************/
 
-void variableExpansion(char *lineEntered, int *numCharsEntered)
+void unexportVariable(const char *name)
 {
-    // check if there is any variable expansion request in the line entered
-    char *expChk = strstr(lineEntered, "$$");
+    unsetenv(name);
 
-    // if it was found enter conditional
-    if(expChk)
+    size_t length = strlen(name);
+    int i;
+    for(i = 0; i < numExportedVariables; i++)
     {
-        // get the shells pid
-        pid_t shellPid = getpid();
-
-        // make space to store the pid
-        char pidString[10];
-
-        // convert pid to a string
-        sprintf(pidString, "%d", shellPid);
-
-        // allocate size of the new buffer to be max
-        char *newBuffer = malloc(sizeof(char) * MAX_CHARS);
+        if(strncmp(exportedVariables[i], name, length) == 0 && exportedVariables[i][length] == '=')
+        {
+            free(exportedVariables[i]);
+            exportedVariables[i] = exportedVariables[--numExportedVariables];
+            return;
+        }
+    }
+}
 
-        // pointer to line entered
-        char *charPtr = lineEntered;
+/*************************************************************************************************
+** Name: exportCommand
+**
+** Description: This function is the export built in. Each NAME=value argument sets the variable and
+** exports it, and each NAME exports the variable with the value it has, or once it is given one if
+** it has none yet. Without arguments, or with -p, the exported variables are listed sorted by name
+** in the form export NAME='value' which can be read back by the shell.
+**
+** Parameters: argument list of the command
+**
+** Returns: status of the command
+*************************************************************************************************/
 
-        // variable to keep track so we dont exceed max allowable characters
-        int buffSizeTrack = strlen(lineEntered);
+int exportCommand(char **commandLine)
+{
+    if(commandLine[1] == NULL || (strcmp(commandLine[1], "-p") == 0 && commandLine[2] == NULL))
+    {
+        int numVariables = 0;
+        char **variable;
+        for(variable = environ; *variable != NULL; variable++)
+        {
+            numVariables++;
+        }
 
-        while((charPtr = strstr(charPtr, "$$")))
+        char **sortedVariables = malloc((numVariables + numShellVariables + 1) * sizeof(char *));
+        memcpy(sortedVariables, environ, numVariables * sizeof(char *));
+        int i;
+        for(i = 0; i < numShellVariables; i++)
         {
-            // add the pid to the size of the tracking variable
-            buffSizeTrack += strlen(pidString);
+            if(strchr(shellVariables[i], '=') == NULL)
+            {
+                sortedVariables[numVariables++] = shellVariables[i];
+            }
+        }
+        qsort(sortedVariables, numVariables, sizeof(char *), compareVariables);
 
-            // if allowable character max is exceeded. print message and break out of loop
-            if(buffSizeTrack > MAX_CHARS)
+        for(i = 0; i < numVariables; i++)
+        {
+            const char *equalsSign = strchr(sortedVariables[i], '=');
+            if(equalsSign == NULL)
             {
-                printf("\nYou have exceeded the allowable size of the buffer!\n");
-                fflush(stdout);
-                break;
+                printf("export %s\n", sortedVariables[i]);
+                continue;
             }
 
-            // copy everything after the $$ into the buffer
-            strcpy(newBuffer, charPtr + strlen("$$"));
+            // a quote in the value ends the quoted text, is itself quoted with double quotes, and
+            // the quoted text starts again
+            printf("export %.*s='", (int)(equalsSign - sortedVariables[i]), sortedVariables[i]);
+            const char *valueChar;
+            for(valueChar = equalsSign + 1; *valueChar != '\0'; valueChar++)
+            {
+                if(*valueChar == '\'')
+                {
+                    fputs("'\"'\"'", stdout);
+                }
+                else
+                {
+                    putchar(*valueChar);
+                }
+            }
+            printf("'\n");
+        }
+        fflush(stdout);
+        free(sortedVariables);
+        return 0;
+    }
 
-            // pointer in original input still pointing to $$. now add the pid
-            // and what was stored into newBuffer
-            sprintf(charPtr, "%s%s", pidString, newBuffer);
+    int exitStatus = 0;
+    int i;
+    for(i = 1; commandLine[i] != NULL; i++)
+    {
+        char *name = commandLine[i];
+        size_t length = nameLength(name);
+        if(length == 0 || (name[length] != '=' && name[length] != '\0'))
+        {
+            fprintf(stderr, "export: %s: bad variable name\n", name);
+            fflush(stderr);
+            exitStatus = 1;
+            continue;
         }
 
-        // Free the memory allocated for the buffer
-        free(newBuffer);
+        // the value the shell kept for itself moves to the environment
+        int variableIndex = findShellVariable(name, length);
+        char *shellValue = NULL;
+        if(variableIndex != -1)
+        {
+            shellValue = shellVariables[variableIndex];
+            shellVariables[variableIndex] = shellVariables[--numShellVariables];
+        }
 
-        // update the number of characters due to expansion. dont count \0 against string
-        *numCharsEntered = strlen(lineEntered) - 1;
+        char *equalsSign = name[length] == '=' ? &name[length] : NULL;
+        if(equalsSign != NULL)
+        {
+            *equalsSign = '\0';
+            exportVariable(name, equalsSign + 1);
+            *equalsSign = '=';
+        }
+        else if(shellValue != NULL && shellValue[length] == '=')
+        {
+            shellValue[length] = '\0';
+            exportVariable(shellValue, shellValue + length + 1);
+        }
+        else if(getenv(name) == NULL)
+        {
+            // the variable is marked and exported once it has a value
+            shellVariables = realloc(shellVariables, (numShellVariables + 1) * sizeof(char *));
+            shellVariables[numShellVariables++] = strdup(name);
+        }
+        free(shellValue);
     }
+
+    return exitStatus;
 }
 
 /*************************************************************************************************
-** Name: printShellPrompt
+** Name: compareVariables
 **
-** Description: This function obtains user input and ensures validity before being processed. Initially
-** the function creates structs to handle signals. For the SIGINT signal one struct handles ignoring of
-** the signal so that parent is not terminated by cntrl+c and the other struct related to SIGINT is so
-** that termination only happens to foreground child processes. The function also declares two structs
-** for SIGTSTP one being a sighandler which prints a message giving notification of switching between
-** foreground only mode and when that mode is off, and the other to ignore SIGTSTP so that it does not
-** stop any of the child processes made.
+** Description: This function orders two NAME=value strings by their names for qsort.
 **
-** The function then uses getline (CODE USED FROM PROF LECTURE 3.3) to obtain input form the user after
-** printing the shells prompt ":" After calling a micro sleep and checking on any background processes
-** status. The function then grabs the user input and checks several methods to ensure its validity.
-** Blank lines and comment lines # are completely ignored. The function also checks if the line entered
-** has any variable expansion $$ to which it attaches the shell's PID at any occurrence. The function
-** also ensures that the number of characters entered are > 2048, the number of arguments are less than
-** 512 and that the line is not a comment. The function also keeps track of the index of the last argument
-** to later check if the user request the process to run in the background.
+** Parameters: pointers to the two strings
 **
-** If the string has passed all the tests then it removes the trailing \0and passes the string to be
-** tokenized and sent to the function builtInFunctions which will determine how to handle the input.
+** Returns: less than, equal to or greater than zero as the first name sorts before, with or after
+** the second
+*************************************************************************************************/
+
+int compareVariables(const void *first, const void *second)
+{
+    const char *firstName = *(char * const *)first;
+    const char *secondName = *(char * const *)second;
+    size_t firstLength = strcspn(firstName, "=");
+    size_t secondLength = strcspn(secondName, "=");
+    int order = strncmp(firstName, secondName, firstLength < secondLength ? firstLength : secondLength);
+
+    return order != 0 ? order : (int)firstLength - (int)secondLength;
+}
+
+/*************************************************************************************************
+** Name: flowCommand
 **
-** The loop runs continuously as it is called in main until the user calls exit
+** Description: This function is for the built in commands break, continue and return. break and
+** continue take the number of loops to unwind, 1 by default and at most the number of loops running,
+** and do nothing outside of a loop. return ends the function being run with the status it is given,
+** or the status of the last command.
 **
-** Parameters: N/A
+** Parameters: argument list of the command
 **
-** Returns: N/A
+** Returns: status of the command
 *************************************************************************************************/
 
-void printShellPrompt()
+int flowCommand(char **commandLine)
 {
-    // struct to ignore SIGINT
-    struct sigaction ignoreSIGINT = {0};
-    ignoreSIGINT.sa_handler = SIG_IGN;
-    sigfillset(&ignoreSIGINT.sa_mask);
-    ignoreSIGINT.sa_flags = 0;
+    char *numberEnd = NULL;
+    long number = 0;
+    if(commandLine[1] != NULL)
+    {
+        number = strtol(commandLine[1], &numberEnd, 10);
+    }
 
-    // setting parent to ignore SIGINT
-    sigaction(SIGINT, &ignoreSIGINT, NULL);
+    if(strcmp(commandLine[0], "return") == 0)
+    {
+        if(functionDepth == 0)
+        {
+            fprintf(stderr, "ERROR: return: can only be used in a function\n");
+            fflush(stderr);
+            return 1;
+        }
+        if(commandLine[1] != NULL && (*numberEnd != '\0' || numberEnd == commandLine[1]))
+        {
+            fprintf(stderr, "ERROR: return: %s: a number is required\n", commandLine[1]);
+            fflush(stderr);
+            return 2;
+        }
 
-    //struct to terminate foreground child
-    struct sigaction terminateFgChild = {0};
-    terminateFgChild.sa_handler = SIG_DFL;
-    sigfillset(&terminateFgChild.sa_mask);
-    ignoreSIGINT.sa_flags = 0;
+        unwinding = UNWIND_RETURN;
+        return commandLine[1] != NULL ? (int)(number & 0xff) : exitValue(childExitMethod);
+    }
 
-    // struct to have signal handler with message
-    struct sigaction SIGTSTP_action = {0};
-    SIGTSTP_action.sa_handler = catchSIGTSTP;
-    sigfillset(&SIGTSTP_action.sa_mask);
-    sigaction(SIGTSTP, &SIGTSTP_action, NULL);
+    if(commandLine[1] != NULL && (*numberEnd != '\0' || numberEnd == commandLine[1] || number < 1))
+    {
+        fprintf(stderr, "ERROR: %s: %s: loop count out of range\n", commandLine[0], commandLine[1]);
+        fflush(stderr);
+        return 1;
+    }
 
-    // struct to ignore SIGTSTP
-    struct sigaction ignoreSIGTSTP = {0};
-    ignoreSIGTSTP.sa_handler = SIG_IGN;
-    sigfillset(&ignoreSIGTSTP.sa_mask);
+    if(loopDepth == 0)
+    {
+        return 0;
+    }
 
+    unwinding = strcmp(commandLine[0], "break") == 0 ? UNWIND_BREAK : UNWIND_CONTINUE;
+    unwindLevels = commandLine[1] == NULL ? 1 : (number > loopDepth ? loopDepth : (int)number);
 
-    int numCharsEntered = -5; // How many chars we entered
-    int currChar = -5; // Tracks where we are when we print out every char
-    size_t bufferSize = 0; // Holds how large the allocated buffer is
-    char* lineEntered = NULL; // Points to a buffer allocated by getline() that holds our entered string + \n + \0
+    return 0;
+}
 
+/*************************************************************************************************
+** Name: findFunction
+**
+** Description: This function looks up a shell function by its name.
+**
+** Parameters: name of the function
+**
+** Returns: index of the function in shellFunctions, -1 if there is none
+*************************************************************************************************/
 
-    // Get input from the user
-    do
+int findFunction(const char *name)
+{
+    int i;
+    for(i = 0; i < numShellFunctions; i++)
     {
-        // make sure variable gets reset each iteration
-        askInput = true;
+        if(strcmp(shellFunctions[i].name, name) == 0)
+        {
+            return i;
+        }
+    }
 
-        // briefly pause so background process errors can be displayed immediate if killed
-        usleep(10);
+    return -1;
+}
 
-        //check on background processes being killed or finishing
-        checkBackgroundStatus();
+/*************************************************************************************************
+** Name: defineFunction
+**
+** Description: This function defines a shell function, or replaces the body of one. The body stays in
+** the syntax tree it was parsed into, so the first definition run from a tree keeps the whole tree
+** from being released after the command, and the tree is released once neither a function nor
+** anything running needs it any more.
+**
+** Parameters: the definition
+**
+** Returns: N/A
+*************************************************************************************************/
 
-        printf(":");
-        fflush(stdout);
-        // Get a line from the user
-        numCharsEntered = getline(&lineEntered, &bufferSize, stdin);
+void defineFunction(struct node *definition)
+{
+    // the arena of the command is handed over to the tree, which the command holds until it is done
+    if(runningTree == NULL)
+    {
+        runningTree = malloc(sizeof(struct keptTree));
+        runningTree->memory = treeArena;
+        runningTree->references = 1;
+        treeArena.head = NULL;
+    }
+    runningTree->references++;
+
+    int functionIndex = findFunction(definition->name);
+    if(functionIndex == -1)
+    {
+        shellFunctions = realloc(shellFunctions, (numShellFunctions + 1) * sizeof(struct shellFunction));
+        functionIndex = numShellFunctions++;
+    }
+    else
+    {
+        releaseTree(shellFunctions[functionIndex].tree);
+    }
 
-        // get number of arguments entered. less 1 since newline is counted
-        int numArgs = numArguments(lineEntered);
+    shellFunctions[functionIndex].name = definition->name;
+    shellFunctions[functionIndex].body = definition->first;
+    shellFunctions[functionIndex].tree = runningTree;
+}
 
-        // clear if there was an error
-        if (numCharsEntered == -1)
-        {
-            clearerr(stdin);
-        }
+/*************************************************************************************************
+** Name: callFunction
+**
+** Description: This function runs a shell function in the shell itself, with the redirections of
+** the call applied like they are for a built in and the arguments of the call as its positional
+** parameters. The function may be redefined while it runs, so its tree is held until it is done.
+** Loops of the caller cannot be unwound from inside the function. Calls may nest 1000 deep.
+**
+** Parameters: index of the function in shellFunctions, stage of the call
+**
+** Returns: N/A
+*************************************************************************************************/
+
+void callFunction(int functionIndex, struct commandStage *stage)
+{
+    struct savedDescriptors saved;
+    if(redirectBuiltIn(stage, &saved) == false)
+    {
+        restoreBuiltIn(&saved);
+        childExitMethod = W_EXITCODE(1, 0);
+        return;
+    }
 
-        // call function to check if the user has entered an empty line
-        checkEmptyLine(lineEntered);
+    if(functionDepth >= 1000)
+    {
+        fprintf(stderr, "ERROR: %s: functions are nested too deep\n", stage->argv[0]);
+        fflush(stderr);
+        restoreBuiltIn(&saved);
+        childExitMethod = W_EXITCODE(1, 0);
+        unwinding = UNWIND_INTERRUPT;
+        return;
+    }
 
-        // check if there is any variable expansion request in the line entered
-        char *expChk = strstr(lineEntered, "$$");
+    // the arguments outlive the words of the call, which the body releases
+    char **arguments = malloc(stage->argc * sizeof(char *));
+    int numArguments = stage->argc - 1;
+    int i;
+    for(i = 0; i < numArguments; i++)
+    {
+        arguments[i] = strdup(stage->argv[i + 1]);
+    }
+    arguments[numArguments] = NULL;
 
-        // if it was found enter conditional
-        if(expChk)
-        {
-            // call function to check and expand any variables if needed
-            variableExpansion(lineEntered, &numCharsEntered);
-        }
+    struct keptTree *tree = shellFunctions[functionIndex].tree;
+    struct node *body = shellFunctions[functionIndex].body;
+    tree->references++;
 
-        // check if user enters more than 2048 characters has more than 512 args or comment line & prompt again if any true
-        if (numCharsEntered > MAX_CHARS || numArgs > MAX_ARGS || lineEntered[0] == '#')
-        {
-            askInput = true;
-        }
+    char **callerParams = positionalParams;
+    int callerNumPositional = numPositional;
+    struct keptTree *callerTree = runningTree;
+    int callerLoopDepth = loopDepth;
 
-        // get the last index of the array that will be created used to check for & background commands
-        int lastIndex = numArgs;
+    positionalParams = arguments;
+    numPositional = numArguments;
+    runningTree = tree;
+    loopDepth = 0;
+    functionDepth++;
 
-        // Remove the trailing \n that getline adds - from  prof. code lecture 3.3
-        lineEntered[strcspn(lineEntered, "\n")] = '\0';
+    runNode(body);
+    if(unwinding == UNWIND_RETURN)
+    {
+        unwinding = UNWIND_NONE;
+    }
 
+    functionDepth--;
+    loopDepth = callerLoopDepth;
+    runningTree = callerTree;
+    positionalParams = callerParams;
+    numPositional = callerNumPositional;
 
-        // only process string if input was valid
-        if (askInput == false)
-        {
-            // break up the strings into tokens and place tokens into arrays of chars
-            builtInFunctions((tokenizeString(lineEntered)), lastIndex, &terminateFgChild, &ignoreSIGTSTP);
-        }
+    for(i = 0; i < numArguments; i++)
+    {
+        free(arguments[i]);
+    }
+    free(arguments);
+    releaseTree(tree);
+    restoreBuiltIn(&saved);
+}
+
+/*************************************************************************************************
+** Name: releaseTree
+**
+** Description: This function drops a reference to a kept syntax tree and frees it along with its
+** arena once nothing refers to it.
+**
+** Parameters: the tree
+**
+** Returns: N/A
+*************************************************************************************************/
 
-        // Free the memory allocated by getline() or else memory leak
-        free(lineEntered);
-        lineEntered = NULL;
+void releaseTree(struct keptTree *tree)
+{
+    if(--tree->references > 0)
+    {
+        return;
+    }
 
-    }while(askInput == true);
+    arenaReset(&tree->memory);
+    free(tree->memory.head);
+    free(tree);
 }